@@ -0,0 +1,134 @@
+/**
+ * Host benchmark for the animation engine.
+ *
+ * Drives AnimationEngine with a VirtualClock so every loop() call renders
+ * exactly one frame, and reports frames/sec and ns/frame per animation.
+ *
+ * Usage: program [--frames=N] [--max-ns=N]
+ *   --frames  Frames rendered per animation (default 200000)
+ *   --max-ns  Exit non-zero if any animation exceeds this cost per frame
+ */
+
+#include <Arduino.h>
+#include <chrono>
+
+#include "anim/AnimationEngine.h"
+#include "hw/Clock.h"
+#include "state/DeviceConfig.h"
+#include "state/DeviceState.h"
+
+namespace {
+
+enum class BenchAnim { Sunrise, Sunset, Rainbow, Fire, Breathe, Ocean };
+
+struct BenchCase {
+  const char* name;
+  BenchAnim anim;
+  unsigned long frameMs;  // Matches the animation's internal throttle
+};
+
+const BenchCase CASES[] = {
+  { "sunrise", BenchAnim::Sunrise, 100 },
+  { "sunset",  BenchAnim::Sunset,  100 },
+  { "rainbow", BenchAnim::Rainbow, 16 },
+  { "fire",    BenchAnim::Fire,    33 },
+  { "breathe", BenchAnim::Breathe, 33 },
+  { "ocean",   BenchAnim::Ocean,   33 },
+};
+
+void startCase(AnimationEngine& engine, BenchAnim anim) {
+  switch (anim) {
+    case BenchAnim::Sunrise: engine.startSunrise(180, 100); break;
+    case BenchAnim::Sunset:  engine.startSunset(180, 0); break;
+    case BenchAnim::Rainbow: engine.startRainbow(); break;
+    case BenchAnim::Fire:    engine.startFire(70, 5); break;
+    case BenchAnim::Breathe: engine.startBreathe(4, 70, 10); break;
+    case BenchAnim::Ocean:   engine.startOcean(5, 70); break;
+  }
+}
+
+double runCase(const BenchCase& c, unsigned long frames, uint32_t& checksum) {
+  DeviceState state;
+  DeviceConfig config;
+  VirtualClock clock(1);
+  AnimationEngine engine;
+  engine.begin(&state, &config, &clock);
+  startCase(engine, c.anim);
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < frames; i++) {
+    clock.advance(c.frameMs);
+    engine.loop();
+    if (!engine.isActive()) {
+      startCase(engine, c.anim);
+    }
+    checksum += state.brightness + state.colorR + state.colorG + state.colorB;
+  }
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+}
+
+// A full-length sunrise must finish at its target without real waiting.
+bool verifySunrise(double& wallMs) {
+  DeviceState state;
+  DeviceConfig config;
+  VirtualClock clock(1);
+  AnimationEngine engine;
+  engine.begin(&state, &config, &clock);
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  engine.startSunrise(30, 90);
+  unsigned long simulatedMs = 0;
+  while (engine.isActive() && simulatedMs <= 31UL * 60UL * 1000UL) {
+    clock.advance(100);
+    simulatedMs += 100;
+    engine.loop();
+  }
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  wallMs = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000.0;
+
+  return !engine.isActive() &&
+         state.mode == LampMode::STATIC &&
+         state.brightness == 90 &&
+         simulatedMs >= 30UL * 60UL * 1000UL;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned long frames = 200000;
+  double maxNs = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--frames=", 9) == 0) {
+      frames = strtoul(argv[i] + 9, nullptr, 10);
+    } else if (strncmp(argv[i], "--max-ns=", 9) == 0) {
+      maxNs = atof(argv[i] + 9);
+    }
+  }
+  if (frames == 0) frames = 1;
+
+  bool ok = true;
+  uint32_t checksum = 0;
+
+  printf("%-10s %12s %14s %12s\n", "animation", "frames", "frames/sec", "ns/frame");
+  for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+    double ns = runCase(CASES[i], frames, checksum);
+    double nsPerFrame = ns / frames;
+    double fps = nsPerFrame > 0 ? 1e9 / nsPerFrame : 0;
+    bool over = maxNs > 0 && nsPerFrame > maxNs;
+    printf("%-10s %12lu %14.0f %12.1f%s\n", CASES[i].name, frames, fps, nsPerFrame,
+           over ? "  OVER BUDGET" : "");
+    if (over) ok = false;
+  }
+
+  double wallMs = 0;
+  bool sunriseOk = verifySunrise(wallMs);
+  printf("\n30-minute sunrise simulated in %.2f ms wall time: %s\n",
+         wallMs, sunriseOk ? "PASS" : "FAIL");
+  if (!sunriseOk) ok = false;
+
+  printf("(checksum %lu)\n", (unsigned long)checksum);
+  return ok ? 0 : 1;
+}
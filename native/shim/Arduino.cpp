@@ -0,0 +1,104 @@
+#include "Arduino.h"
+#include "driver/ledc.h"
+#include <stdarg.h>
+#include <chrono>
+#include <thread>
+
+HostSerial Serial;
+
+static uint8_t pinLevels[64];
+static uint32_t ledcDuty[16];
+static uint32_t ledcFadeTarget[16];
+static uint32_t ledcFadeTimeMs[16];
+static uint32_t ledcFadeCount[16];
+
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - bootTime).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - bootTime).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+size_t HostSerial::printf(const char* fmt, ...) {
+  if (!enabled) return 0;
+  va_list args;
+  va_start(args, fmt);
+  int n = vprintf(fmt, args);
+  va_end(args);
+  return n > 0 ? (size_t)n : 0;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < sizeof(pinLevels) && mode == INPUT_PULLUP) pinLevels[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < sizeof(pinLevels)) pinLevels[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < sizeof(pinLevels) ? pinLevels[pin] : LOW;
+}
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits) {
+  return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+  if (channel < 16) ledcDuty[channel] = duty;
+}
+
+uint32_t ledcRead(uint8_t channel) {
+  return channel < 16 ? ledcDuty[channel] : 0;
+}
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags) {
+  return ESP_OK;
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode, ledc_channel_t channel,
+                                  uint32_t target_duty, int max_fade_time_ms) {
+  if (channel < 0 || channel >= 16) return -1;
+  ledcFadeTarget[channel] = target_duty;
+  ledcFadeTimeMs[channel] = (uint32_t)max_fade_time_ms;
+  return ESP_OK;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel,
+                          ledc_fade_mode_t fade_mode) {
+  if (channel < 0 || channel >= 16) return -1;
+  ledcDuty[channel] = ledcFadeTarget[channel];
+  ledcFadeCount[channel]++;
+  return ESP_OK;
+}
+
+uint32_t ledcShimFadeCount(uint8_t channel) {
+  return channel < 16 ? ledcFadeCount[channel] : 0;
+}
+
+uint32_t ledcShimFadeTime(uint8_t channel) {
+  return channel < 16 ? ledcFadeTimeMs[channel] : 0;
+}
+
+void ledcShimReset() {
+  memset(ledcDuty, 0, sizeof(ledcDuty));
+  memset(ledcFadeTarget, 0, sizeof(ledcFadeTarget));
+  memset(ledcFadeTimeMs, 0, sizeof(ledcFadeTimeMs));
+  memset(ledcFadeCount, 0, sizeof(ledcFadeCount));
+}
@@ -0,0 +1,154 @@
+#ifndef NATIVE_ARDUINO_SHIM_H
+#define NATIVE_ARDUINO_SHIM_H
+
+/**
+ * Minimal Arduino core replacement for the host (native) build.
+ * 
+ * Only the subset used by the portable modules (animations, state,
+ * config) is provided. Time comes from the host monotonic clock;
+ * Serial output is discarded until Serial.begin() is called.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// GPIO / LEDC stand-ins: writes are recorded so tests can read them back
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
+
+/**
+ * std::string-backed subset of Arduino's String.
+ */
+class String {
+public:
+  String() {}
+  String(const char* s) : str(s ? s : "") {}
+  String(const std::string& s) : str(s) {}
+  String(char c) : str(1, c) {}
+  explicit String(int v) : str(std::to_string(v)) {}
+  explicit String(unsigned int v) : str(std::to_string(v)) {}
+  explicit String(long v) : str(std::to_string(v)) {}
+  explicit String(unsigned long v) : str(std::to_string(v)) {}
+
+  unsigned int length() const { return (unsigned int)str.size(); }
+  const char* c_str() const { return str.c_str(); }
+
+  bool operator==(const String& o) const { return str == o.str; }
+  bool operator==(const char* o) const { return str == (o ? o : ""); }
+  bool operator!=(const String& o) const { return str != o.str; }
+  bool operator!=(const char* o) const { return !(*this == o); }
+
+  String& operator+=(const String& o) { str += o.str; return *this; }
+  String& operator+=(const char* o) { str += (o ? o : ""); return *this; }
+  String& operator+=(char c) { str += c; return *this; }
+  String operator+(const String& o) const { return String(str + o.str); }
+  String operator+(const char* o) const { return String(str + (o ? o : "")); }
+
+  char operator[](unsigned int i) const { return i < str.size() ? str[i] : 0; }
+  char charAt(unsigned int i) const { return (*this)[i]; }
+
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t p = str.find(c, from);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  int indexOf(const String& s, unsigned int from = 0) const {
+    size_t p = str.find(s.str, from);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  int indexOf(const char* s, unsigned int from = 0) const { return indexOf(String(s), from); }
+
+  String substring(unsigned int from) const {
+    return from >= str.size() ? String() : String(str.substr(from));
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= str.size()) return String();
+    return String(str.substr(from, to - from));
+  }
+
+  long toInt() const { return atol(str.c_str()); }
+  float toFloat() const { return (float)atof(str.c_str()); }
+
+  void toLowerCase() {
+    for (size_t i = 0; i < str.size(); i++) {
+      str[i] = (char)tolower((unsigned char)str[i]);
+    }
+  }
+  void trim() {
+    size_t b = str.find_first_not_of(" \t\r\n");
+    size_t e = str.find_last_not_of(" \t\r\n");
+    str = (b == std::string::npos) ? std::string() : str.substr(b, e - b + 1);
+  }
+
+private:
+  std::string str;
+};
+
+/**
+ * Serial port stand-in writing to stdout once begin() was called.
+ */
+class HostSerial {
+public:
+  void begin(unsigned long) { enabled = true; }
+  void end() { enabled = false; }
+
+  size_t print(const char* s) { return enabled ? (size_t)fputs(s, stdout) : 0; }
+  size_t print(const String& s) { return print(s.c_str()); }
+  size_t print(char c) { return enabled ? (size_t)fputc(c, stdout) : 0; }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned int v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(double v) { return printf("%.2f", v); }
+
+  size_t println() { return print("\n"); }
+  template <typename T>
+  size_t println(const T& v) { size_t n = print(v); return n + println(); }
+
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  operator bool() const { return enabled; }
+
+private:
+  bool enabled = false;
+};
+
+extern HostSerial Serial;
+
+#endif // NATIVE_ARDUINO_SHIM_H
@@ -0,0 +1,106 @@
+#include "Preferences.h"
+
+static std::map<std::string, std::map<std::string, std::vector<uint8_t> > >& storage() {
+  static std::map<std::string, std::map<std::string, std::vector<uint8_t> > > instance;
+  return instance;
+}
+
+bool Preferences::begin(const char* name, bool ro) {
+  ns = &storage()[name];
+  readOnly = ro;
+  return true;
+}
+
+void Preferences::end() {
+  ns = nullptr;
+}
+
+bool Preferences::clear() {
+  if (!ns || readOnly) return false;
+  ns->clear();
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  if (!ns || readOnly) return false;
+  return ns->erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  return ns && ns->count(key) > 0;
+}
+
+size_t Preferences::put(const char* key, const void* value, size_t len) {
+  if (!ns || readOnly) return 0;
+  const uint8_t* p = (const uint8_t*)value;
+  (*ns)[key] = std::vector<uint8_t>(p, p + len);
+  return len;
+}
+
+bool Preferences::get(const char* key, void* out, size_t len) {
+  if (!ns) return false;
+  Namespace::const_iterator it = ns->find(key);
+  if (it == ns->end() || it->second.size() != len) return false;
+  memcpy(out, it->second.data(), len);
+  return true;
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t def) {
+  uint8_t v;
+  return get(key, &v, sizeof(v)) ? v : def;
+}
+
+uint16_t Preferences::getUShort(const char* key, uint16_t def) {
+  uint16_t v;
+  return get(key, &v, sizeof(v)) ? v : def;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t def) {
+  uint32_t v;
+  return get(key, &v, sizeof(v)) ? v : def;
+}
+
+String Preferences::getString(const char* key, const String& def) {
+  if (!ns) return def;
+  Namespace::const_iterator it = ns->find(key);
+  if (it == ns->end()) return def;
+  return String(std::string(it->second.begin(), it->second.end()));
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (!ns) return 0;
+  Namespace::const_iterator it = ns->find(key);
+  return it == ns->end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  if (!ns) return 0;
+  Namespace::const_iterator it = ns->find(key);
+  if (it == ns->end() || it->second.size() > maxLen) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::putUChar(const char* key, uint8_t value) {
+  return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUShort(const char* key, uint16_t value) {
+  return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+  return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putString(const char* key, const String& value) {
+  return put(key, value.c_str(), value.length());
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  return put(key, value, len);
+}
+
+void Preferences::resetAll() {
+  storage().clear();
+}
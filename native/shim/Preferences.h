@@ -0,0 +1,51 @@
+#ifndef NATIVE_PREFERENCES_SHIM_H
+#define NATIVE_PREFERENCES_SHIM_H
+
+#include "Arduino.h"
+#include <map>
+#include <vector>
+
+/**
+ * In-memory stand-in for the ESP32 NVS Preferences API.
+ * 
+ * Values live for the lifetime of the process and are shared by all
+ * instances opened on the same namespace, like real NVS.
+ */
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false);
+  void end();
+
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+  uint8_t  getUChar(const char* key, uint8_t defaultValue = 0);
+  uint16_t getUShort(const char* key, uint16_t defaultValue = 0);
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+  String   getString(const char* key, const String& defaultValue = String());
+  size_t   getBytesLength(const char* key);
+  size_t   getBytes(const char* key, void* buf, size_t maxLen);
+
+  size_t putUChar(const char* key, uint8_t value);
+  size_t putUShort(const char* key, uint16_t value);
+  size_t putUInt(const char* key, uint32_t value);
+  size_t putString(const char* key, const String& value);
+  size_t putBytes(const char* key, const void* value, size_t len);
+
+  /**
+   * Drop every namespace (host tests only).
+   */
+  static void resetAll();
+
+private:
+  typedef std::map<std::string, std::vector<uint8_t> > Namespace;
+
+  Namespace* ns = nullptr;
+  bool readOnly = false;
+
+  size_t put(const char* key, const void* value, size_t len);
+  bool get(const char* key, void* out, size_t len);
+};
+
+#endif // NATIVE_PREFERENCES_SHIM_H
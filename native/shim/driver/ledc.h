@@ -0,0 +1,51 @@
+#ifndef NATIVE_DRIVER_LEDC_H
+#define NATIVE_DRIVER_LEDC_H
+
+/**
+ * Host stand-in for the ESP-IDF LEDC fade API.
+ * 
+ * There is no fade hardware on the host: a started fade lands on its
+ * target duty immediately. Each started fade is counted so tests can
+ * tell hardware fades from firmware-stepped writes.
+ */
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#endif
+
+typedef enum {
+  LEDC_LOW_SPEED_MODE = 0,
+} ledc_mode_t;
+
+typedef enum {
+  LEDC_FADE_NO_WAIT = 0,
+  LEDC_FADE_WAIT_DONE,
+} ledc_fade_mode_t;
+
+typedef int ledc_channel_t;
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags);
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode, ledc_channel_t channel,
+                                  uint32_t target_duty, int max_fade_time_ms);
+esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel,
+                          ledc_fade_mode_t fade_mode);
+
+/**
+ * Number of hardware fades started on a channel since the last reset.
+ */
+uint32_t ledcShimFadeCount(uint8_t channel);
+
+/**
+ * Duration of the last fade configured on a channel.
+ */
+uint32_t ledcShimFadeTime(uint8_t channel);
+
+/**
+ * Clear fade counters and duties.
+ */
+void ledcShimReset();
+
+#endif // NATIVE_DRIVER_LEDC_H
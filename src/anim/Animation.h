@@ -0,0 +1,110 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <Arduino.h>
+#include "../state/DeviceState.h"
+#include "../state/DeviceConfig.h"
+#include "../hw/Clock.h"
+
+/**
+ * Generic animation parameters.
+ *
+ * Same layout as the favorite animation in DeviceConfig; the meaning
+ * of param1..param3 is defined per animation by its registry entry.
+ */
+struct AnimationParams {
+  uint8_t param1;
+  uint8_t param2;
+  uint8_t param3;
+  uint8_t colorR;
+  uint8_t colorG;
+  uint8_t colorB;
+};
+
+/**
+ * Common interface of all animations.
+ *
+ * Responsibilities:
+ * - Start from generic parameters
+ * - Update device state each loop
+ * - Pause/resume and stop
+ */
+class Animation {
+public:
+  virtual ~Animation() {}
+
+  /**
+   * Start the animation.
+   *
+   * @param state Device state to update
+   * @param config Device config (used for defaults)
+   * @param params Parameters as described by the registry entry
+   */
+  virtual void start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) = 0;
+
+  /**
+   * Stop the animation.
+   *
+   * @param state Device state to update
+   */
+  virtual void stop(DeviceState* state) = 0;
+
+  /**
+   * Pause or resume the animation.
+   *
+   * @param paused True to pause, false to resume
+   * @param state Device state to update
+   */
+  virtual void setPaused(bool paused, DeviceState* state) = 0;
+
+  /**
+   * Update animation state. Call every loop iteration.
+   *
+   * @return True if animation is complete
+   */
+  virtual bool update(DeviceState* state, DeviceConfig* config) = 0;
+
+  /**
+   * Continue as if the animation had been running for elapsedMs. Used to
+   * keep lamps of a group in phase; only looping animations whose look
+   * depends on nothing but their running time override it.
+   */
+  virtual void alignPhase(unsigned long elapsedMs) {}
+
+  /**
+   * Running time so far, pauses excluded. Saved by the state journal so
+   * the animation can be continued after a power loss.
+   */
+  virtual unsigned long elapsedMs() const { return 0; }
+
+  /**
+   * Continue a just started animation as if it had been running for
+   * elapsedMs. Unlike alignPhase() this also moves animations with an
+   * end; animations without a notion of progress ignore it.
+   */
+  virtual void resumeAt(unsigned long elapsedMs) {}
+
+  /**
+   * Time until update() has work to do.
+   *
+   * @return Milliseconds (0 = now), Clock::NO_DEADLINE when inactive or paused
+   */
+  virtual unsigned long msUntilUpdate() const = 0;
+
+  /**
+   * Check if animation is currently active.
+   */
+  virtual bool isActive() const = 0;
+
+  /**
+   * Check if animation is currently paused.
+   */
+  virtual bool isPaused() const = 0;
+
+  /**
+   * Replace the time source (defaults to the system clock).
+   */
+  virtual void setClock(const Clock* clock) = 0;
+};
+
+#endif // ANIMATION_H
@@ -1,183 +1,115 @@
 #include "AnimationEngine.h"
 
 AnimationEngine::AnimationEngine() 
-  : state(nullptr), config(nullptr) {
+  : state(nullptr), config(nullptr), clock(&Clock::system()), current(nullptr),
+    activeId(AnimationId::Count), activeParams(), originBrightness(0), originR(0), originG(0), originB(0) {
 }
 
-void AnimationEngine::begin(DeviceState* s, DeviceConfig* c) {
+AnimationEngine::~AnimationEngine() {
+  release();
+}
+
+void AnimationEngine::begin(DeviceState* s, DeviceConfig* c, const Clock* clk) {
   Serial.println("[ANIM] Initializing animation engine");
   state = s;
   config = c;
+
+  clock = clk ? clk : &Clock::system();
+  if (current) {
+    current->setClock(clock);
+  }
 }
 
 void AnimationEngine::loop() {
   if (!state || !config) return;
 
-  if (sunrise.isActive()) {
-    sunrise.update(state, config);
-  }
-  
-  if (sunset.isActive()) {
-    sunset.update(state, config);
-  }
-  
-  if (rainbow.isActive()) {
-    rainbow.update(state, config);
-  }
-  
-  if (fire.isActive()) {
-    fire.update(state, config);
-  }
-  
-  if (breathe.isActive()) {
-    breathe.update(state, config);
-  }
-  
-  if (ocean.isActive()) {
-    ocean.update(state, config);
+  if (current && current->isActive()) {
+    current->update(state, config);
   }
 }
 
-void AnimationEngine::startSunrise(uint8_t durationMinutes, uint8_t targetBrightness,
-                                   uint8_t targetR, uint8_t targetG, uint8_t targetB) {
+void AnimationEngine::start(AnimationId id, const AnimationParams& params) {
   if (!state || !config) return;
+  if (id >= AnimationId::Count) return;
   
   // Stop any active animation first
   stop();
-  
-  sunrise.start(state, config, durationMinutes, targetBrightness, targetR, targetG, targetB);
+  release();
+
+  activeId = id;
+  activeParams = params;
+  originBrightness = state->brightness;
+  originR = state->colorR;
+  originG = state->colorG;
+  originB = state->colorB;
+
+  current = AnimationRegistry::get(id).construct(slot);
+  current->setClock(clock);
+  current->start(state, config, params);
+}
+
+void AnimationEngine::startSunrise(uint8_t durationMinutes, uint8_t targetBrightness,
+                                   uint8_t targetR, uint8_t targetG, uint8_t targetB) {
+  AnimationParams params = { durationMinutes, targetBrightness, 0, targetR, targetG, targetB };
+  start(AnimationId::Sunrise, params);
 }
 
 void AnimationEngine::startRainbow() {
-  if (!state || !config) return;
-  
-  // Stop any active animation first
-  stop();
-  
-  rainbow.start(state, config);
+  start(AnimationId::Rainbow, AnimationRegistry::defaults(AnimationRegistry::get(AnimationId::Rainbow)));
 }
 
 void AnimationEngine::startFire(uint8_t intensity, uint8_t speed) {
-  if (!state || !config) return;
-  
-  // Stop any active animation first
-  stop();
-  
-  fire.start(state, config, intensity, speed);
+  AnimationParams params = { intensity, speed, 0, 0, 0, 0 };
+  start(AnimationId::Fire, params);
 }
 
 void AnimationEngine::startBreathe(uint8_t cycleDuration, uint8_t maxBrightness, 
                                     uint8_t minBrightness, uint8_t targetR, 
                                     uint8_t targetG, uint8_t targetB) {
-  if (!state || !config) return;
-  
-  // Stop any active animation first
-  stop();
-  
-  breathe.start(state, config, cycleDuration, maxBrightness, minBrightness, 
-                targetR, targetG, targetB);
+  AnimationParams params = { cycleDuration, maxBrightness, minBrightness, targetR, targetG, targetB };
+  start(AnimationId::Breathe, params);
 }
 
 void AnimationEngine::startSunset(uint8_t durationMinutes, uint8_t finalBrightness) {
-  if (!state || !config) return;
-  
-  // Stop any active animation first
-  stop();
-  
-  sunset.start(state, config, durationMinutes, finalBrightness);
+  AnimationParams params = { durationMinutes, finalBrightness, 0, 0, 0, 0 };
+  start(AnimationId::Sunset, params);
 }
 
 void AnimationEngine::startOcean(uint8_t speed, uint8_t brightness) {
-  if (!state || !config) return;
-  
-  // Stop any active animation first
-  stop();
-  
-  ocean.start(state, config, speed, brightness);
+  AnimationParams params = { brightness, speed, 0, 0, 0, 0 };
+  start(AnimationId::Ocean, params);
 }
 
 void AnimationEngine::startFavorite() {
   if (!state || !config) return;
   
-  // Stop any active animation first
-  stop();
-  
-  // Start animation based on favoriteAnimation name
-  String anim = config->favoriteAnimation;
-  
-  if (anim == "sunrise") {
-    startSunrise(config->favAnimParam1, config->favAnimParam2, 
-                 config->favAnimColorR, config->favAnimColorG, config->favAnimColorB);
-  } else if (anim == "sunset") {
-    startSunset(config->favAnimParam1, config->favAnimParam2);
-  } else if (anim == "fire") {
-    startFire(config->favAnimParam1, config->favAnimParam2);
-  } else if (anim == "breathe") {
-    startBreathe(config->favAnimParam1, config->favAnimParam2, config->favAnimParam3,
-                 config->favAnimColorR, config->favAnimColorG, config->favAnimColorB);
-  } else if (anim == "ocean") {
-    startOcean(config->favAnimParam1, config->favAnimParam2);
-  } else if (anim == "rainbow") {
-    startRainbow();
-  } else {
+  const AnimationInfo* info = AnimationRegistry::find(config->favoriteAnimation.c_str());
+  if (!info) {
     // Default to fire if unknown
     startFire(70, 5);
+    return;
   }
+
+  AnimationParams params = {
+    config->favAnimParam1, config->favAnimParam2, config->favAnimParam3,
+    config->favAnimColorR, config->favAnimColorG, config->favAnimColorB
+  };
+  start(info->id, params);
 }
 
 void AnimationEngine::stop() {
   if (!state) return;
   
-  if (sunrise.isActive()) {
-    sunrise.stop(state);
-  }
-  
-  if (sunset.isActive()) {
-    sunset.stop(state);
-  }
-  
-  if (rainbow.isActive()) {
-    rainbow.stop(state);
-  }
-  
-  if (fire.isActive()) {
-    fire.stop(state);
-  }
-  
-  if (breathe.isActive()) {
-    breathe.stop(state);
-  }
-  
-  if (ocean.isActive()) {
-    ocean.stop(state);
+  if (current && current->isActive()) {
+    current->stop(state);
   }
 }
 
 void AnimationEngine::setPaused(bool paused) {
   if (!state) return;
   
-  if (sunrise.isActive()) {
-    sunrise.setPaused(paused, state);
-  }
-  
-  if (sunset.isActive()) {
-    sunset.setPaused(paused, state);
-  }
-  
-  if (rainbow.isActive()) {
-    rainbow.setPaused(paused, state);
-  }
-  
-  if (fire.isActive()) {
-    fire.setPaused(paused, state);
-  }
-  
-  if (breathe.isActive()) {
-    breathe.setPaused(paused, state);
-  }
-  
-  if (ocean.isActive()) {
-    ocean.setPaused(paused, state);
+  if (current && current->isActive()) {
+    current->setPaused(paused, state);
   }
 }
 
@@ -188,7 +120,60 @@ void AnimationEngine::togglePause() {
   setPaused(!state->animationPaused);
 }
 
+void AnimationEngine::alignPhase(unsigned long elapsedMs) {
+  if (current && current->isActive() && !current->isPaused()) {
+    current->alignPhase(elapsedMs);
+  }
+}
+
+bool AnimationEngine::snapshot(AnimationSnapshot& out) const {
+  if (!current || !current->isActive()) return false;
+
+  out.id = activeId;
+  out.params = activeParams;
+  out.originBrightness = originBrightness;
+  out.originR = originR;
+  out.originG = originG;
+  out.originB = originB;
+  out.elapsedMs = current->elapsedMs();
+  out.paused = current->isPaused();
+  return true;
+}
+
+void AnimationEngine::resume(const AnimationSnapshot& snapshot) {
+  if (!state || !config) return;
+  if (snapshot.id >= AnimationId::Count) return;
+
+  // Start from the same light as the first time, so the animation
+  // captures the same starting point (stopping first, which holds the
+  // light of the animation being replaced)
+  stop();
+  release();
+  state->brightness = snapshot.originBrightness;
+  state->colorR = snapshot.originR;
+  state->colorG = snapshot.originG;
+  state->colorB = snapshot.originB;
+
+  start(snapshot.id, snapshot.params);
+  if (!current) return;
+  current->resumeAt(snapshot.elapsedMs);
+  if (snapshot.paused) {
+    current->setPaused(true, state);
+  }
+}
+
 bool AnimationEngine::isActive() const {
-  return sunrise.isActive() || sunset.isActive() || rainbow.isActive() || 
-         fire.isActive() || breathe.isActive() || ocean.isActive();
+  return current && current->isActive();
+}
+
+unsigned long AnimationEngine::msUntilUpdate() const {
+  if (!current || !current->isActive()) return Clock::NO_DEADLINE;
+  return current->msUntilUpdate();
+}
+
+void AnimationEngine::release() {
+  if (current) {
+    current->~Animation();
+    current = nullptr;
+  }
 }
@@ -2,14 +2,26 @@
 #define ANIMATION_ENGINE_H
 
 #include <Arduino.h>
-#include "SunriseAnimation.h"
-#include "SunsetAnimation.h"
-#include "RainbowAnimation.h"
-#include "FireAnimation.h"
-#include "BreatheAnimation.h"
-#include "OceanAnimation.h"
+#include "Animation.h"
+#include "AnimationRegistry.h"
 #include "../state/DeviceState.h"
 #include "../state/DeviceConfig.h"
+#include "../hw/Clock.h"
+
+/**
+ * What is needed to continue an animation after a restart: how it was
+ * started, the light it started from and how far it got.
+ */
+struct AnimationSnapshot {
+  AnimationId id;
+  AnimationParams params;
+  uint8_t originBrightness;   // Light before the animation started; sunset
+  uint8_t originR;            // fades from it and breathe keeps its color
+  uint8_t originG;
+  uint8_t originB;
+  unsigned long elapsedMs;
+  bool paused;
+};
 
 /**
  * Animation engine coordinator.
@@ -18,24 +30,38 @@
  * - Manage active animation
  * - Route animation commands
  * - Update animation state each loop
+ * 
+ * Only one animation exists at a time. It is constructed in place in a
+ * slot sized for the largest registered animation, so dispatch is a
+ * single virtual call and RAM does not grow with the registry.
  */
 class AnimationEngine {
 public:
   AnimationEngine();
+  ~AnimationEngine();
 
   /**
    * Initialize animation engine.
    * 
    * @param state Pointer to device state
    * @param config Pointer to device config
+   * @param clock Time source for all animations (nullptr = system clock)
    */
-  void begin(DeviceState* state, DeviceConfig* config);
+  void begin(DeviceState* state, DeviceConfig* config, const Clock* clock = nullptr);
 
   /**
    * Update active animation. Call every loop iteration.
    */
   void loop();
 
+  /**
+   * Start a registered animation, replacing the active one.
+   * 
+   * @param id Animation to start
+   * @param params Parameters (see AnimationRegistry for their meaning)
+   */
+  void start(AnimationId id, const AnimationParams& params);
+
   /**
    * Start sunrise animation.
    * 
@@ -113,20 +139,56 @@ public:
    */
   void togglePause();
 
+  /**
+   * Move the active animation to a shared running time (see
+   * Animation::alignPhase). Paused animations keep their own phase.
+   *
+   * @param elapsedMs Running time all lamps of a group agree on
+   */
+  void alignPhase(unsigned long elapsedMs);
+
+  /**
+   * Describe the active animation for the state journal.
+   *
+   * @return False when no animation is active
+   */
+  bool snapshot(AnimationSnapshot& out) const;
+
+  /**
+   * Restart an animation from a snapshot, at the point it had reached.
+   */
+  void resume(const AnimationSnapshot& snapshot);
+
   /**
    * Check if any animation is active.
    */
   bool isActive() const;
 
+  /**
+   * Time until loop() has work to do.
+   * 
+   * @return Milliseconds (0 = now), Clock::NO_DEADLINE when idle
+   */
+  unsigned long msUntilUpdate() const;
+
 private:
   DeviceState* state;
   DeviceConfig* config;
-  SunriseAnimation sunrise;
-  SunsetAnimation sunset;
-  RainbowAnimation rainbow;
-  FireAnimation fire;
-  BreatheAnimation breathe;
-  OceanAnimation ocean;
+  const Clock* clock;
+
+  // The single animation slot; current points into it when occupied
+  alignas(AnimationSlot::ALIGN) unsigned char slot[AnimationSlot::SIZE];
+  Animation* current;
+
+  // How the animation in the slot was started
+  AnimationId activeId;
+  AnimationParams activeParams;
+  uint8_t originBrightness, originR, originG, originB;
+
+  void release();
+
+  AnimationEngine(const AnimationEngine&);
+  AnimationEngine& operator=(const AnimationEngine&);
 };
 
 #endif // ANIMATION_ENGINE_H
@@ -0,0 +1,224 @@
+#include "AnimationRegistry.h"
+#include <new>
+
+namespace {
+
+template <typename T>
+Animation* construct(void* slot) {
+  static_assert(sizeof(T) <= AnimationSlot::SIZE, "Animation larger than engine slot");
+  static_assert(alignof(T) <= AnimationSlot::ALIGN, "Animation alignment exceeds engine slot");
+  return new (slot) T();
+}
+
+char toLowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+// Key token matches one of the '|'-separated spellings exactly
+bool keyMatches(const char* keys, const char* key, size_t keyLen) {
+  const char* start = keys;
+  while (*start) {
+    const char* end = strchr(start, '|');
+    size_t len = end ? (size_t)(end - start) : strlen(start);
+    if (len == keyLen && memcmp(start, key, len) == 0) return true;
+    if (!end) break;
+    start = end + 1;
+  }
+  return false;
+}
+
+const ParamSpec* findSpec(const AnimationInfo& info, const char* key, size_t keyLen) {
+  for (uint8_t i = 0; i < info.paramCount; i++) {
+    if (keyMatches(info.params[i].keys, key, keyLen)) return &info.params[i];
+  }
+  return nullptr;
+}
+
+// Optional '-' and digits at text[*pos]; advances *pos past them.
+// Returns false (value untouched) if there are no digits.
+bool parseNumber(const char* text, size_t length, size_t* pos, long* value) {
+  size_t i = *pos;
+  bool negative = i < length && text[i] == '-';
+  if (negative) i++;
+
+  size_t digitsStart = i;
+  long v = 0;
+  while (i < length && text[i] >= '0' && text[i] <= '9') {
+    if (v < 100000) v = v * 10 + (text[i] - '0');
+    i++;
+  }
+  if (i == digitsStart) return false;
+
+  *pos = i;
+  *value = negative ? -v : v;
+  return true;
+}
+
+uint8_t clampByte(long v, uint8_t lo, uint8_t hi) {
+  if (v < lo) return lo;
+  if (v > hi) return hi;
+  return (uint8_t)v;
+}
+
+// Store clamped values: one for Number, three for Color
+void applySpec(const ParamSpec& spec, const long* values, AnimationParams& params) {
+  if (spec.type == ParamType::Color) {
+    params.colorR = clampByte(values[0], spec.minValue, spec.maxValue);
+    params.colorG = clampByte(values[1], spec.minValue, spec.maxValue);
+    params.colorB = clampByte(values[2], spec.minValue, spec.maxValue);
+    return;
+  }
+  uint8_t* slots[3] = { &params.param1, &params.param2, &params.param3 };
+  *slots[spec.slot] = clampByte(values[0], spec.minValue, spec.maxValue);
+}
+
+// Parameter schemas: keys, type, slot, min, max, default
+const ParamSpec SUNRISE_PARAMS[] = {
+  { "duration",   ParamType::Number, 0, 0, 180, 0 },  // Minutes, 0 = config sunrise_minutes
+  { "brightness", ParamType::Number, 1, 0, 100, 0 },  // 0 = config final brightness
+  { "color",      ParamType::Color,  0, 0, 255, 0 },  // 0,0,0 = config default color
+};
+
+const ParamSpec SUNSET_PARAMS[] = {
+  { "duration",   ParamType::Number, 0, 0, 180, 0 },  // Minutes, 0 = config sunrise_minutes
+  { "brightness", ParamType::Number, 1, 0, 100, 0 },  // Final brightness
+};
+
+const ParamSpec FIRE_PARAMS[] = {
+  { "intensity|brightness", ParamType::Number, 0, 0, 100, 70 },
+  { "speed",                ParamType::Number, 1, 1, 10,  5 },
+};
+
+const ParamSpec BREATHE_PARAMS[] = {
+  { "duration",           ParamType::Number, 0, 1, 60,  4 },   // Cycle seconds
+  { "brightness|max",     ParamType::Number, 1, 0, 100, 70 },
+  { "min_brightness|min", ParamType::Number, 2, 0, 100, 10 },
+  { "color",              ParamType::Color,  0, 0, 255, 0 },   // 0,0,0 = current color
+};
+
+// Stored as brightness, speed (favorite config layout)
+const ParamSpec OCEAN_PARAMS[] = {
+  { "brightness|intensity", ParamType::Number, 0, 0, 100, 70 },
+  { "speed",                ParamType::Number, 1, 1, 10,  5 },
+};
+
+#define PARAMS(table) table, (uint8_t)(sizeof(table) / sizeof(table[0]))
+
+}  // namespace
+
+// Order must match AnimationId
+const AnimationInfo AnimationRegistry::ENTRIES[(size_t)AnimationId::Count] = {
+  { "sunrise", AnimationId::Sunrise, PARAMS(SUNRISE_PARAMS), &construct<SunriseAnimation> },
+  { "sunset",  AnimationId::Sunset,  PARAMS(SUNSET_PARAMS),  &construct<SunsetAnimation> },
+  { "rainbow", AnimationId::Rainbow, nullptr, 0,             &construct<RainbowAnimation> },
+  { "fire",    AnimationId::Fire,    PARAMS(FIRE_PARAMS),    &construct<FireAnimation> },
+  { "breathe", AnimationId::Breathe, PARAMS(BREATHE_PARAMS), &construct<BreatheAnimation> },
+  { "ocean",   AnimationId::Ocean,   PARAMS(OCEAN_PARAMS),   &construct<OceanAnimation> },
+};
+
+#undef PARAMS
+
+const AnimationInfo* AnimationRegistry::find(const char* name) {
+  if (!name) return nullptr;
+  for (size_t i = 0; i < (size_t)AnimationId::Count; i++) {
+    if (strcmp(ENTRIES[i].name, name) == 0) {
+      return &ENTRIES[i];
+    }
+  }
+  return nullptr;
+}
+
+const AnimationInfo* AnimationRegistry::find(const char* name, size_t length) {
+  for (size_t i = 0; i < (size_t)AnimationId::Count; i++) {
+    const char* candidate = ENTRIES[i].name;
+    if (strlen(candidate) != length) continue;
+
+    size_t j = 0;
+    while (j < length && toLowerAscii(name[j]) == candidate[j]) j++;
+    if (j == length) return &ENTRIES[i];
+  }
+  return nullptr;
+}
+
+const AnimationInfo& AnimationRegistry::get(AnimationId id) {
+  return ENTRIES[(size_t)id];
+}
+
+AnimationParams AnimationRegistry::defaults(const AnimationInfo& info) {
+  AnimationParams params = { 0, 0, 0, 0, 0, 0 };
+  uint8_t* slots[3] = { &params.param1, &params.param2, &params.param3 };
+
+  for (uint8_t i = 0; i < info.paramCount; i++) {
+    const ParamSpec& spec = info.params[i];
+    if (spec.type == ParamType::Color) {
+      params.colorR = params.colorG = params.colorB = spec.defaultValue;
+    } else {
+      *slots[spec.slot] = spec.defaultValue;
+    }
+  }
+  return params;
+}
+
+void AnimationRegistry::parseParams(const char* text, const AnimationInfo& info,
+                                    AnimationParams& params) {
+  parseParams(text, strlen(text), info, params);
+}
+
+void AnimationRegistry::parseParams(const char* text, size_t length, const AnimationInfo& info,
+                                    AnimationParams& params) {
+  size_t pos = 0;
+
+  while (pos < length) {
+    // Key runs to '='; a token without one is skipped
+    size_t keyStart = pos;
+    while (pos < length && text[pos] != '=' && text[pos] != ',') pos++;
+    if (pos < length && text[pos] == '=') {
+      const ParamSpec* spec = findSpec(info, text + keyStart, pos - keyStart);
+      pos++;
+
+      if (spec && spec->type == ParamType::Color) {
+        // "R,G,B" spans two commas; applied only if complete
+        long rgb[3];
+        if (parseNumber(text, length, &pos, &rgb[0]) &&
+            pos < length && text[pos++] == ',' &&
+            parseNumber(text, length, &pos, &rgb[1]) &&
+            pos < length && text[pos++] == ',' &&
+            parseNumber(text, length, &pos, &rgb[2])) {
+          applySpec(*spec, rgb, params);
+        }
+      } else if (spec) {
+        long v;
+        if (parseNumber(text, length, &pos, &v)) {
+          applySpec(*spec, &v, params);
+        }
+      }
+    }
+
+    // Skip the rest of this token
+    while (pos < length && text[pos] != ',') pos++;
+    pos++;
+  }
+}
+
+bool AnimationRegistry::setParam(const AnimationInfo& info, const char* key, size_t keyLength,
+                                 const long* values, uint8_t count, AnimationParams& params) {
+  const ParamSpec* spec = findSpec(info, key, keyLength);
+  if (!spec || count != (spec->type == ParamType::Color ? 3 : 1)) return false;
+  applySpec(*spec, values, params);
+  return true;
+}
+
+const AnimationInfo* AnimationRegistry::parseCommand(const char* text, size_t length,
+                                                     AnimationParams& params) {
+  const char* colon = (const char*)memchr(text, ':', length);
+  size_t nameLength = colon ? (size_t)(colon - text) : length;
+
+  const AnimationInfo* info = find(text, nameLength);
+  if (!info) return nullptr;
+
+  params = defaults(*info);
+  if (colon) {
+    parseParams(colon + 1, length - nameLength - 1, *info, params);
+  }
+  return info;
+}
@@ -0,0 +1,166 @@
+#ifndef ANIMATION_REGISTRY_H
+#define ANIMATION_REGISTRY_H
+
+#include <Arduino.h>
+#include "Animation.h"
+#include "SunriseAnimation.h"
+#include "SunsetAnimation.h"
+#include "RainbowAnimation.h"
+#include "FireAnimation.h"
+#include "BreatheAnimation.h"
+#include "OceanAnimation.h"
+
+/**
+ * Index of each registered animation.
+ */
+enum class AnimationId : uint8_t {
+  Sunrise,
+  Sunset,
+  Rainbow,
+  Fire,
+  Breathe,
+  Ocean,
+  Count
+};
+
+/**
+ * Kind of value a parameter takes.
+ */
+enum class ParamType : uint8_t {
+  Number,   // "key=N", stored in param1..param3
+  Color     // "key=R,G,B", stored in colorR/G/B
+};
+
+/**
+ * Schema entry for one animation parameter.
+ */
+struct ParamSpec {
+  const char* keys;        // MQTT key; alternative spellings separated by '|'
+  ParamType type;
+  uint8_t slot;            // 0..2 = param1..param3 (Number only)
+  uint8_t minValue;        // Values are clamped to [minValue, maxValue]
+  uint8_t maxValue;
+  uint8_t defaultValue;    // Used when the key is absent (Color: all channels)
+};
+
+/**
+ * Registry entry describing one animation.
+ */
+struct AnimationInfo {
+  const char* name;
+  AnimationId id;
+  const ParamSpec* params;     // Parameter schema (nullptr if none)
+  uint8_t paramCount;
+
+  // Construct the animation in engine-owned storage
+  Animation* (*construct)(void* slot);
+};
+
+/**
+ * Compile-time table of all animations.
+ * 
+ * Responsibilities:
+ * - Look up animations by name or id
+ * - Parse "key=value" parameter lists (or single keys) against each
+ *   animation's schema
+ * - Size the engine's single in-place animation slot
+ * 
+ * Adding an animation: add its id, include its header, list it in
+ * AnimationSlot below and add its parameter schema and one entry to the
+ * tables in the .cpp. A new parameter is one ParamSpec line.
+ */
+class AnimationRegistry {
+public:
+  /**
+   * Find an animation by name (case-sensitive).
+   * 
+   * @return Entry, or nullptr if unknown
+   */
+  static const AnimationInfo* find(const char* name);
+
+  /**
+   * Find an animation by a name that is not NUL-terminated
+   * (ASCII case-insensitive).
+   *
+   * @return Entry, or nullptr if unknown
+   */
+  static const AnimationInfo* find(const char* name, size_t length);
+
+  /**
+   * Get the entry for an id.
+   */
+  static const AnimationInfo& get(AnimationId id);
+
+  /**
+   * Parameters with every schema default applied.
+   */
+  static AnimationParams defaults(const AnimationInfo& info);
+
+  /**
+   * Parse a parameter list like "duration=10,color=255,100,0" in one pass.
+   * Keys must match a schema spelling exactly; unknown keys and values
+   * that are not numbers are ignored. Numbers are clamped to the schema.
+   * 
+   * @param text Parameter list (after the ':'), need not be NUL-terminated
+   * @param length Length of text
+   * @param info Animation to parse for
+   * @param params Updated in place; missing keys keep their value
+   */
+  static void parseParams(const char* text, size_t length, const AnimationInfo& info,
+                          AnimationParams& params);
+
+  /**
+   * Parse a NUL-terminated parameter list.
+   */
+  static void parseParams(const char* text, const AnimationInfo& info, AnimationParams& params);
+
+  /**
+   * Set one parameter by key, clamped like parseParams() does.
+   *
+   * @param key Key (one of the schema spellings), need not be NUL-terminated
+   * @param keyLength Length of key
+   * @param values One number, or R, G, B for a color
+   * @param count Number of values
+   * @return False if the key is unknown or the count does not match its type
+   */
+  static bool setParam(const AnimationInfo& info, const char* key, size_t keyLength,
+                       const long* values, uint8_t count, AnimationParams& params);
+
+  /**
+   * Parse a full command "name" or "name:key=value,...".
+   *
+   * @param text Command text, need not be NUL-terminated
+   * @param length Length of text
+   * @param params Set to the schema defaults overridden by the given values
+   * @return Entry, or nullptr if the name is unknown
+   */
+  static const AnimationInfo* parseCommand(const char* text, size_t length, AnimationParams& params);
+
+private:
+  static const AnimationInfo ENTRIES[(size_t)AnimationId::Count];
+};
+
+/**
+ * Size and alignment of storage large enough for any animation.
+ */
+template <typename... Ts>
+struct AnimationSlotFor;
+
+template <typename T>
+struct AnimationSlotFor<T> {
+  static const size_t SIZE = sizeof(T);
+  static const size_t ALIGN = alignof(T);
+};
+
+template <typename T, typename... Rest>
+struct AnimationSlotFor<T, Rest...> {
+  static const size_t SIZE = sizeof(T) > AnimationSlotFor<Rest...>::SIZE
+                               ? sizeof(T) : AnimationSlotFor<Rest...>::SIZE;
+  static const size_t ALIGN = alignof(T) > AnimationSlotFor<Rest...>::ALIGN
+                                ? alignof(T) : AnimationSlotFor<Rest...>::ALIGN;
+};
+
+typedef AnimationSlotFor<SunriseAnimation, SunsetAnimation, RainbowAnimation,
+                         FireAnimation, BreatheAnimation, OceanAnimation> AnimationSlot;
+
+#endif // ANIMATION_REGISTRY_H
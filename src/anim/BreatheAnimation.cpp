@@ -1,11 +1,17 @@
 #include "BreatheAnimation.h"
+#include "FixedTrig.h"
 
 BreatheAnimation::BreatheAnimation() 
-  : active(false), paused(false), startMillis(0), pausedOffset(0),
+  : clock(&Clock::system()), active(false), paused(false), startMillis(0), pausedOffset(0),
     lastUpdateTime(0), cycleDuration(4), maxBrightness(70), 
     minBrightness(10), targetR(0), targetG(0), targetB(0) {
 }
 
+void BreatheAnimation::start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) {
+  start(state, config, params.param1, params.param2, params.param3,
+        params.colorR, params.colorG, params.colorB);
+}
+
 void BreatheAnimation::start(DeviceState* state, DeviceConfig* config, 
                               uint8_t cycleDur, uint8_t maxBri, uint8_t minBri,
                               uint8_t r, uint8_t g, uint8_t b) {
@@ -13,7 +19,7 @@ void BreatheAnimation::start(DeviceState* state, DeviceConfig* config,
   
   active = true;
   paused = false;
-  startMillis = millis();
+  startMillis = clock->millis();
   pausedOffset = 0;
   lastUpdateTime = 0;
   
@@ -61,11 +67,11 @@ void BreatheAnimation::setPaused(bool shouldPause, DeviceState* state) {
   
   if (shouldPause && !paused) {
     // Pause: capture current offset
-    unsigned long elapsed = millis() - startMillis;
+    unsigned long elapsed = clock->millis() - startMillis;
     pausedOffset = elapsed;
   } else if (!shouldPause && paused) {
     // Resume: adjust start time
-    startMillis = millis() - pausedOffset;
+    startMillis = clock->millis() - pausedOffset;
   }
   
   paused = shouldPause;
@@ -76,10 +82,10 @@ void BreatheAnimation::setPaused(bool shouldPause, DeviceState* state) {
 bool BreatheAnimation::update(DeviceState* state, DeviceConfig* config) {
   if (!active || paused || !state || !config) return false;
   
-  unsigned long now = millis();
+  unsigned long now = clock->millis();
   
   // Throttle to ~30 FPS (33ms)
-  if (now - lastUpdateTime < 33) {
+  if ((now - lastUpdateTime) < FRAME_MS) {
     return false;
   }
   lastUpdateTime = now;
@@ -88,26 +94,49 @@ bool BreatheAnimation::update(DeviceState* state, DeviceConfig* config) {
   unsigned long elapsed = now - startMillis;
   unsigned long cycleMillis = (unsigned long)cycleDuration * 1000UL;
   
-  // Position in cycle (0.0 to 1.0)
-  float cycleProgress = (float)(elapsed % cycleMillis) / (float)cycleMillis;
+  unsigned long cycleElapsed = elapsed % cycleMillis;
   
-  // Use sine wave for smooth breathing (0 to 1 to 0)
-  float breatheFactor = (sin(cycleProgress * 2.0f * PI - PI / 2.0f) + 1.0f) / 2.0f;
+  // Position in cycle as a 16-bit angle (one cycle = one turn)
+  uint16_t cycleAngle = (uint16_t)(((uint32_t)cycleElapsed << 16) / cycleMillis);
+  
+  // Use sine wave for smooth breathing (0 to 1 to 0), shifted by -1/4 turn
+  int32_t breatheFactor = (FixedTrig::sinQ15((uint16_t)(cycleAngle - 16384)) + FixedTrig::Q15_ONE) >> 1;
   
   // Map to brightness range
-  uint8_t brightness = minBrightness + (uint8_t)(breatheFactor * (maxBrightness - minBrightness));
+  uint8_t brightness = minBrightness + (uint8_t)FixedTrig::mulQ15(breatheFactor, (int32_t)maxBrightness - minBrightness);
   
   state->colorR = targetR;
   state->colorG = targetG;
   state->colorB = targetB;
   state->brightness = brightness;
-  state->progress = (uint8_t)(cycleProgress * 100);
+  state->progress = (uint8_t)(cycleElapsed * 100 / cycleMillis);
   
   state->bumpVersion();
   
   return false;  // Breathe loops indefinitely
 }
 
+void BreatheAnimation::alignPhase(unsigned long elapsedMs) {
+  if (!active || paused) return;
+  startMillis = clock->millis() - elapsedMs;
+}
+
+unsigned long BreatheAnimation::elapsedMs() const {
+  if (!active) return 0;
+  return paused ? pausedOffset : clock->millis() - startMillis;
+}
+
+void BreatheAnimation::resumeAt(unsigned long elapsedMs) {
+  if (!active || paused) return;
+  startMillis = clock->millis() - elapsedMs;
+}
+
+unsigned long BreatheAnimation::msUntilUpdate() const {
+  if (!active || paused) return Clock::NO_DEADLINE;
+  unsigned long sinceFrame = clock->millis() - lastUpdateTime;
+  return sinceFrame >= FRAME_MS ? 0 : FRAME_MS - sinceFrame;
+}
+
 bool BreatheAnimation::isActive() const {
   return active;
 }
@@ -115,3 +144,7 @@ bool BreatheAnimation::isActive() const {
 bool BreatheAnimation::isPaused() const {
   return paused;
 }
+
+void BreatheAnimation::setClock(const Clock* c) {
+  clock = c;
+}
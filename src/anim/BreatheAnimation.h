@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include "../state/DeviceState.h"
 #include "../state/DeviceConfig.h"
+#include "../hw/Clock.h"
+#include "Animation.h"
 
 /**
  * Breathe/Pulse animation.
@@ -11,10 +13,15 @@
  * Smooth fade in/out at a specific color, like breathing.
  * Perfect for meditation, relaxation, or visual feedback.
  */
-class BreatheAnimation {
+class BreatheAnimation : public Animation {
 public:
   BreatheAnimation();
 
+  /**
+   * Start from generic parameters (mapping in AnimationRegistry).
+   */
+  void start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) override;
+
   /**
    * Start breathe animation.
    * 
@@ -31,19 +38,27 @@ public:
              uint8_t cycleDuration = 4, uint8_t maxBrightness = 70, 
              uint8_t minBrightness = 10, uint8_t targetR = 0, 
              uint8_t targetG = 0, uint8_t targetB = 0);
-  void stop(DeviceState* state);
-  void setPaused(bool shouldPause, DeviceState* state);
+  void stop(DeviceState* state) override;
+  void setPaused(bool shouldPause, DeviceState* state) override;
   
   /**
    * Update animation state.
    * @return true if animation completed, false otherwise (breathe loops indefinitely)
    */
-  bool update(DeviceState* state, DeviceConfig* config);
+  bool update(DeviceState* state, DeviceConfig* config) override;
   
-  bool isActive() const;
-  bool isPaused() const;
+  void alignPhase(unsigned long elapsedMs) override;
+  unsigned long elapsedMs() const override;
+  void resumeAt(unsigned long elapsedMs) override;
+  unsigned long msUntilUpdate() const override;
+  bool isActive() const override;
+  bool isPaused() const override;
+  void setClock(const Clock* clock) override;
 
 private:
+  static const unsigned long FRAME_MS = 33;  // ~30 fps
+
+  const Clock* clock;
   bool active;
   bool paused;
   unsigned long startMillis;
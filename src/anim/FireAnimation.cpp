@@ -1,8 +1,20 @@
 #include "FireAnimation.h"
+#include "FixedTrig.h"
+
+// Per-frame phase step for speed=1, in 32-bit turns: 0.01, 0.023 and
+// 0.047 rad, i.e. the 1.0x, 2.3x and 4.7x octaves of the noise
+static const uint32_t NOISE_STEP_PER_SPEED[3] = { 6835653UL, 15722001UL, 32127568UL };
+
+// Octave weights in Q15 (0.5, 0.3, 0.2 - sum is exactly 1.0)
+static const int32_t NOISE_WEIGHT[3] = { 16384, 9830, 6554 };
 
 FireAnimation::FireAnimation() 
-  : active(false), paused(false), lastUpdateTime(0), 
-    intensity(70), speed(5), noiseOffset(0.0f) {
+  : clock(&Clock::system()), active(false), paused(false), lastUpdateTime(0), 
+    intensity(70), speed(5), noisePhase(), noiseStep() {
+}
+
+void FireAnimation::start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) {
+  start(state, config, params.param1, params.param2);
 }
 
 void FireAnimation::start(DeviceState* state, DeviceConfig* config, uint8_t intens, uint8_t spd) {
@@ -10,11 +22,15 @@ void FireAnimation::start(DeviceState* state, DeviceConfig* config, uint8_t inte
   
   active = true;
   paused = false;
-  lastUpdateTime = millis();
-  noiseOffset = 0.0f;
+  lastUpdateTime = clock->millis();
   
   intensity = constrain(intens, 0, 100);
   speed = constrain(spd, 1, 10);
+
+  for (uint8_t i = 0; i < 3; i++) {
+    noisePhase[i] = 0;
+    noiseStep[i] = NOISE_STEP_PER_SPEED[i] * speed;
+  }
   
   state->powerOn = true;
   state->setAnimationMode("fire");
@@ -51,34 +67,38 @@ void FireAnimation::setPaused(bool shouldPause, DeviceState* state) {
 bool FireAnimation::update(DeviceState* state, DeviceConfig* config) {
   if (!active || paused || !state || !config) return false;
   
-  unsigned long now = millis();
+  unsigned long now = clock->millis();
   
   // Throttle to ~30 FPS (33ms)
-  if (now - lastUpdateTime < 33) {
+  if ((now - lastUpdateTime) < FRAME_MS) {
     return false;
   }
   lastUpdateTime = now;
   
-  // Update noise offset based on speed
-  noiseOffset += 0.01f * speed;
+  // Advance noise phases based on speed
+  for (uint8_t i = 0; i < 3; i++) {
+    noisePhase[i] += noiseStep[i];
+  }
   
-  // Generate flame color with smooth random variations
-  float flicker = smoothNoise(noiseOffset);
+  // Generate flame color with smooth random variations (Q15, -1..1)
+  int32_t flicker = smoothNoise();
   
   // Base flame colors (warm spectrum)
   // Red: 255, Orange: 255,100,0, Yellow: 255,180,0
-  float colorMix = (flicker + 1.0f) / 2.0f;  // 0.0 to 1.0
+  // colorMix = (flicker + 1) / 2, 0.0 to 1.0 in Q15
+  int32_t colorMix = (flicker + FixedTrig::Q15_ONE) >> 1;
   
   // Interpolate between deep red and bright orange-yellow
   uint8_t r = 255;
-  uint8_t g = (uint8_t)(80 + colorMix * 100);  // 80 to 180
+  uint8_t g = (uint8_t)(80 + ((colorMix * 100) >> 15));  // 80 to 180
   uint8_t b = 0;
   
-  // Brightness flicker based on intensity parameter
-  float brightnessFactor = 0.5f + (flicker * 0.5f * intensity / 100.0f);
-  brightnessFactor = constrain(brightnessFactor, 0.3f, 1.0f);
+  // Brightness flicker based on intensity parameter:
+  // 0.5 + flicker * 0.5 * intensity / 100, clamped to 0.3..1.0 (Q15)
+  int32_t brightnessFactor = 16384 + (flicker * intensity) / 200;
+  brightnessFactor = constrain(brightnessFactor, 9831, FixedTrig::Q15_ONE);
   
-  uint8_t brightness = (uint8_t)(70 * brightnessFactor);  // Base 70%, flicker around it
+  uint8_t brightness = (uint8_t)((70 * brightnessFactor) >> 15);  // Base 70%, flicker around it
   
   state->colorR = r;
   state->colorG = g;
@@ -92,12 +112,20 @@ bool FireAnimation::update(DeviceState* state, DeviceConfig* config) {
 }
 
 // Simple smooth noise approximation using sine waves
-float FireAnimation::smoothNoise(float x) {
+int16_t FireAnimation::smoothNoise() {
   // Combine multiple sine waves for organic-looking noise
-  float n1 = sin(x * 1.0f) * 0.5f;
-  float n2 = sin(x * 2.3f) * 0.3f;
-  float n3 = sin(x * 4.7f) * 0.2f;
-  return constrain(n1 + n2 + n3, -1.0f, 1.0f);
+  int32_t sum = 0;
+  for (uint8_t i = 0; i < 3; i++) {
+    sum += FixedTrig::sinQ15((uint16_t)(noisePhase[i] >> 16)) * NOISE_WEIGHT[i];
+  }
+  sum >>= 15;
+  return (int16_t)constrain(sum, -32767L, 32767L);
+}
+
+unsigned long FireAnimation::msUntilUpdate() const {
+  if (!active || paused) return Clock::NO_DEADLINE;
+  unsigned long sinceFrame = clock->millis() - lastUpdateTime;
+  return sinceFrame >= FRAME_MS ? 0 : FRAME_MS - sinceFrame;
 }
 
 bool FireAnimation::isActive() const {
@@ -107,3 +135,7 @@ bool FireAnimation::isActive() const {
 bool FireAnimation::isPaused() const {
   return paused;
 }
+
+void FireAnimation::setClock(const Clock* c) {
+  clock = c;
+}
@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include "../state/DeviceState.h"
 #include "../state/DeviceConfig.h"
+#include "../hw/Clock.h"
+#include "Animation.h"
 
 /**
  * Fire/Candle flickering animation.
@@ -11,10 +13,15 @@
  * Simulates flickering flames with random intensity variations
  * through warm colors (red → orange → yellow).
  */
-class FireAnimation {
+class FireAnimation : public Animation {
 public:
   FireAnimation();
 
+  /**
+   * Start from generic parameters (mapping in AnimationRegistry).
+   */
+  void start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) override;
+
   /**
    * Start fire animation.
    * 
@@ -24,19 +31,24 @@ public:
    * @param speed Flicker speed 1-10 (default: 5)
    */
   void start(DeviceState* state, DeviceConfig* config, uint8_t intensity = 70, uint8_t speed = 5);
-  void stop(DeviceState* state);
-  void setPaused(bool shouldPause, DeviceState* state);
+  void stop(DeviceState* state) override;
+  void setPaused(bool shouldPause, DeviceState* state) override;
   
   /**
    * Update animation state.
    * @return true if animation completed, false otherwise (fire loops indefinitely)
    */
-  bool update(DeviceState* state, DeviceConfig* config);
+  bool update(DeviceState* state, DeviceConfig* config) override;
   
-  bool isActive() const;
-  bool isPaused() const;
+  unsigned long msUntilUpdate() const override;
+  bool isActive() const override;
+  bool isPaused() const override;
+  void setClock(const Clock* clock) override;
 
 private:
+  static const unsigned long FRAME_MS = 33;  // ~30 fps
+
+  const Clock* clock;
   bool active;
   bool paused;
   unsigned long lastUpdateTime;
@@ -44,9 +56,12 @@ private:
   uint8_t intensity;  // 0-100
   uint8_t speed;      // 1-10
   
-  // Smooth flickering using Perlin-like noise approximation
-  float noiseOffset;
-  float smoothNoise(float x);
+  // Smooth flickering using Perlin-like noise approximation.
+  // Three sine octaves with independent 32-bit phase accumulators
+  // (2^32 = one turn), so each wraps on its own without drift.
+  uint32_t noisePhase[3];
+  uint32_t noiseStep[3];
+  int16_t smoothNoise();
 };
 
 #endif // FIRE_ANIMATION_H
@@ -0,0 +1,41 @@
+#ifndef FIXED_TRIG_H
+#define FIXED_TRIG_H
+
+#include <Arduino.h>
+
+/**
+ * Q15 fixed-point trigonometry for the animations.
+ * 
+ * The ESP32-C3 has no FPU, so per-frame sin() runs in soft-float.
+ * These helpers use a 256-segment lookup table with linear
+ * interpolation instead (max error ~3 LSB of Q15).
+ * 
+ * Angles are expressed in "turns": 0..65535 covers one full circle
+ * (0..2*PI). Results are Q15: -32767..32767 maps to -1.0..1.0.
+ */
+namespace FixedTrig {
+
+  static const int32_t Q15_ONE = 32768;
+
+  /**
+   * Sine of an angle in 16-bit turns.
+   */
+  int16_t sinQ15(uint16_t angle);
+
+  /**
+   * Cosine of an angle in 16-bit turns.
+   */
+  inline int16_t cosQ15(uint16_t angle) {
+    return sinQ15((uint16_t)(angle + 16384));
+  }
+
+  /**
+   * Multiply a Q15 value by an integer scale, truncating toward zero.
+   */
+  inline int32_t mulQ15(int32_t q15, int32_t scale) {
+    return (q15 * scale) / Q15_ONE;
+  }
+
+}  // namespace FixedTrig
+
+#endif // FIXED_TRIG_H
@@ -1,8 +1,25 @@
 #include "OceanAnimation.h"
+#include "FixedTrig.h"
+
+// Wave phase is kept in 24-bit turns so the 1.3x/0.7x/0.5x harmonics
+// can be formed with integer multiplies before dropping to 16-bit angles
+static const uint32_t PHASE_ONE_TURN = 1UL << 24;
+static const uint32_t PHASE_STEP_PER_SPEED = 13351;  // 0.005 rad
+static const uint32_t PHASE_OFFSET_1RAD = 2670177;
+static const uint32_t PHASE_OFFSET_2RAD = 5340354;
+
+static inline uint16_t phaseToAngle(uint32_t phase) {
+  return (uint16_t)(phase >> 8);
+}
 
 OceanAnimation::OceanAnimation() 
-  : active(false), paused(false), startMillis(0), pausedOffset(0),
-    lastUpdateTime(0), speed(5), maxBrightness(70), wavePhase(0.0f) {
+  : clock(&Clock::system()), active(false), paused(false), startMillis(0), pausedOffset(0),
+    lastUpdateTime(0), speed(5), maxBrightness(70), wavePhase(0) {
+}
+
+void OceanAnimation::start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) {
+  // Stored as brightness, speed (favorite config layout)
+  start(state, config, params.param2, params.param1);
 }
 
 void OceanAnimation::start(DeviceState* state, DeviceConfig* config, 
@@ -11,10 +28,10 @@ void OceanAnimation::start(DeviceState* state, DeviceConfig* config,
   
   active = true;
   paused = false;
-  startMillis = millis();
+  startMillis = clock->millis();
   pausedOffset = 0;
   lastUpdateTime = 0;
-  wavePhase = 0.0f;
+  wavePhase = 0;
   
   speed = constrain(spd, 1, 10);
   maxBrightness = constrain(brightness, 0, 100);
@@ -48,11 +65,11 @@ void OceanAnimation::setPaused(bool shouldPause, DeviceState* state) {
   
   if (shouldPause && !paused) {
     // Pause: capture current offset
-    unsigned long elapsed = millis() - startMillis;
+    unsigned long elapsed = clock->millis() - startMillis;
     pausedOffset = elapsed;
   } else if (!shouldPause && paused) {
     // Resume: adjust start time
-    startMillis = millis() - pausedOffset;
+    startMillis = clock->millis() - pausedOffset;
   }
   
   paused = shouldPause;
@@ -63,63 +80,83 @@ void OceanAnimation::setPaused(bool shouldPause, DeviceState* state) {
 bool OceanAnimation::update(DeviceState* state, DeviceConfig* config) {
   if (!active || paused || !state || !config) return false;
   
-  unsigned long now = millis();
+  unsigned long now = clock->millis();
   
   // Throttle to ~30 FPS (33ms)
-  if (now - lastUpdateTime < 33) {
+  if ((now - lastUpdateTime) < FRAME_MS) {
     return false;
   }
   lastUpdateTime = now;
   
-  // Update wave phase
-  wavePhase += 0.005f * speed;
-  if (wavePhase > 2.0f * PI) {
-    wavePhase -= 2.0f * PI;
-  }
+  // Wave phase from the running time (PHASE_STEP_PER_SPEED per frame), so
+  // it does not depend on how many frames were drawn and can be aligned
+  uint64_t steps = (uint64_t)(now - startMillis) * PHASE_STEP_PER_SPEED * speed / FRAME_MS;
+  wavePhase = (uint32_t)(steps % PHASE_ONE_TURN);
   
-  // Create wave effect using multiple sine waves
-  float wave1 = sin(wavePhase) * 0.5f;
-  float wave2 = sin(wavePhase * 1.3f + 1.0f) * 0.3f;
-  float wave3 = sin(wavePhase * 0.7f + 2.0f) * 0.2f;
-  float combinedWave = (wave1 + wave2 + wave3 + 1.0f) / 2.0f;  // 0.0 to 1.0
+  // Create wave effect using multiple sine waves (Q15 weights 0.5/0.3/0.2)
+  int32_t wave1 = FixedTrig::sinQ15(phaseToAngle(wavePhase)) * 16384;
+  int32_t wave2 = FixedTrig::sinQ15(phaseToAngle(wavePhase * 13 / 10 + PHASE_OFFSET_1RAD)) * 9830;
+  int32_t wave3 = FixedTrig::sinQ15(phaseToAngle(wavePhase * 7 / 10 + PHASE_OFFSET_2RAD)) * 6554;
+  int32_t combinedWave = (wave1 + wave2 + wave3) >> 15;                    // -1.0 to 1.0
   
   // Map to ocean colors: Deep Blue → Cyan → Teal
   // Deep Blue: (0, 100, 180)
   // Cyan: (0, 180, 220)
   // Teal: (0, 200, 180)
   
-  float colorPhase = combinedWave;
+  int32_t colorPhase = (combinedWave + FixedTrig::Q15_ONE) >> 1;            // 0.0 to 1.0
   
   uint8_t r = 0;
   uint8_t g, b;
   
-  if (colorPhase < 0.5f) {
+  if (colorPhase < 16384) {
     // Deep Blue → Cyan
-    float t = colorPhase * 2.0f;
-    g = 100 + (uint8_t)(t * 80);   // 100 to 180
-    b = 180 + (uint8_t)(t * 40);   // 180 to 220
+    int32_t t = colorPhase * 2;
+    g = 100 + (uint8_t)((t * 80) >> 15);   // 100 to 180
+    b = 180 + (uint8_t)((t * 40) >> 15);   // 180 to 220
   } else {
     // Cyan → Teal
-    float t = (colorPhase - 0.5f) * 2.0f;
-    g = 180 + (uint8_t)(t * 20);   // 180 to 200
-    b = 220 - (uint8_t)(t * 40);   // 220 to 180
+    int32_t t = (colorPhase - 16384) * 2;
+    g = 180 + (uint8_t)((t * 20) >> 15);   // 180 to 200
+    b = 220 - (uint8_t)((t * 40) >> 15);   // 220 to 180
   }
   
-  // Subtle brightness variation (wave effect)
-  float brightnessFactor = 0.7f + (sin(wavePhase * 0.5f) * 0.3f);
-  uint8_t brightness = (uint8_t)(maxBrightness * brightnessFactor);
+  // Subtle brightness variation (wave effect): 0.7 + sin(phase / 2) * 0.3
+  int32_t brightnessFactor = 22938 + ((FixedTrig::sinQ15(phaseToAngle(wavePhase / 2)) * 9830) >> 15);
+  uint8_t brightness = (uint8_t)((maxBrightness * brightnessFactor) >> 15);
   
   state->colorR = r;
   state->colorG = g;
   state->colorB = b;
   state->brightness = brightness;
-  state->progress = (uint8_t)((wavePhase / (2.0f * PI)) * 100.0f);
+  state->progress = (uint8_t)((wavePhase * 100) >> 24);
   
   state->bumpVersion();
   
   return false;  // Ocean loops indefinitely
 }
 
+void OceanAnimation::alignPhase(unsigned long elapsedMs) {
+  if (!active || paused) return;
+  startMillis = clock->millis() - elapsedMs;
+}
+
+unsigned long OceanAnimation::elapsedMs() const {
+  if (!active) return 0;
+  return paused ? pausedOffset : clock->millis() - startMillis;
+}
+
+void OceanAnimation::resumeAt(unsigned long elapsedMs) {
+  if (!active || paused) return;
+  startMillis = clock->millis() - elapsedMs;
+}
+
+unsigned long OceanAnimation::msUntilUpdate() const {
+  if (!active || paused) return Clock::NO_DEADLINE;
+  unsigned long sinceFrame = clock->millis() - lastUpdateTime;
+  return sinceFrame >= FRAME_MS ? 0 : FRAME_MS - sinceFrame;
+}
+
 bool OceanAnimation::isActive() const {
   return active;
 }
@@ -127,3 +164,7 @@ bool OceanAnimation::isActive() const {
 bool OceanAnimation::isPaused() const {
   return paused;
 }
+
+void OceanAnimation::setClock(const Clock* c) {
+  clock = c;
+}
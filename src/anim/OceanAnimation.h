@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include "../state/DeviceState.h"
 #include "../state/DeviceConfig.h"
+#include "../hw/Clock.h"
+#include "Animation.h"
 
 /**
  * Ocean/Water wave animation.
@@ -11,10 +13,15 @@
  * Gentle waves through blue-cyan-teal spectrum with
  * smooth transitions, creating a calming aquatic effect.
  */
-class OceanAnimation {
+class OceanAnimation : public Animation {
 public:
   OceanAnimation();
 
+  /**
+   * Start from generic parameters (mapping in AnimationRegistry).
+   */
+  void start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) override;
+
   /**
    * Start ocean animation.
    * 
@@ -25,19 +32,27 @@ public:
    */
   void start(DeviceState* state, DeviceConfig* config, 
              uint8_t speed = 5, uint8_t brightness = 70);
-  void stop(DeviceState* state);
-  void setPaused(bool shouldPause, DeviceState* state);
+  void stop(DeviceState* state) override;
+  void setPaused(bool shouldPause, DeviceState* state) override;
   
   /**
    * Update animation state.
    * @return true if animation completed, false otherwise (ocean loops indefinitely)
    */
-  bool update(DeviceState* state, DeviceConfig* config);
+  bool update(DeviceState* state, DeviceConfig* config) override;
   
-  bool isActive() const;
-  bool isPaused() const;
+  void alignPhase(unsigned long elapsedMs) override;
+  unsigned long elapsedMs() const override;
+  void resumeAt(unsigned long elapsedMs) override;
+  unsigned long msUntilUpdate() const override;
+  bool isActive() const override;
+  bool isPaused() const override;
+  void setClock(const Clock* clock) override;
 
 private:
+  static const unsigned long FRAME_MS = 33;  // ~30 fps
+
+  const Clock* clock;
   bool active;
   bool paused;
   unsigned long startMillis;
@@ -47,7 +62,7 @@ private:
   uint8_t speed;       // 1-10
   uint8_t maxBrightness;
   
-  float wavePhase;
+  uint32_t wavePhase;   // 0..2^24 = one wave period (0..2*PI)
 };
 
 #endif // OCEAN_ANIMATION_H
@@ -1,13 +1,17 @@
 #include "RainbowAnimation.h"
 
 RainbowAnimation::RainbowAnimation() 
-  : active(false), paused(false), startMillis(0), pausedOffset(0), lastUpdateTime(0) {
+  : clock(&Clock::system()), active(false), paused(false), startMillis(0), pausedOffset(0), lastUpdateTime(0) {
+}
+
+void RainbowAnimation::start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) {
+  start(state, config);
 }
 
 void RainbowAnimation::start(DeviceState* state, DeviceConfig* config) {
   active = true;
   paused = false;
-  startMillis = millis();
+  startMillis = clock->millis();
   pausedOffset = 0;
 
   state->setAnimationMode("rainbow");
@@ -37,12 +41,12 @@ void RainbowAnimation::setPaused(bool shouldPause, DeviceState* state) {
 
   if (shouldPause && !paused) {
     paused = true;
-    pausedOffset = millis() - startMillis;
+    pausedOffset = clock->millis() - startMillis;
     state->animationPaused = true;
     state->bumpVersion();
   } else if (!shouldPause && paused) {
     paused = false;
-    startMillis = millis() - pausedOffset;
+    startMillis = clock->millis() - pausedOffset;
     state->animationPaused = false;
     state->bumpVersion();
   }
@@ -51,10 +55,10 @@ void RainbowAnimation::setPaused(bool shouldPause, DeviceState* state) {
 bool RainbowAnimation::update(DeviceState* state, DeviceConfig* config) {
   if (!active || paused) return false;
 
-  unsigned long now = millis();
+  unsigned long now = clock->millis();
   
   // Throttle updates to ~60 FPS to reduce CPU load
-  if ((now - lastUpdateTime) < 16) {
+  if ((now - lastUpdateTime) < FRAME_MS) {
     return false;
   }
   lastUpdateTime = now;
@@ -63,15 +67,13 @@ bool RainbowAnimation::update(DeviceState* state, DeviceConfig* config) {
 
   // Complete cycle every 10 seconds (fast enough to track)
   const unsigned long CYCLE_TIME_MS = 10000;
-  float progress = (float)(elapsed % CYCLE_TIME_MS) / (float)CYCLE_TIME_MS;
   
   // Hue cycles from 0 to 360 degrees
-  float hue = progress * 360.0f;
+  uint32_t hue = (uint32_t)(elapsed % CYCLE_TIME_MS) * HUE_RANGE / CYCLE_TIME_MS;
   
   // Convert HSV to RGB (full saturation, brightness from state)
   uint8_t r, g, b;
-  float brightness = state->brightness / 100.0f;
-  hsvToRgb(hue, 1.0f, brightness, r, g, b);
+  hsvToRgb(hue, state->brightness, r, g, b);
   
   // Update state if color changed
   if (r != state->colorR || g != state->colorG || b != state->colorB) {
@@ -87,6 +89,27 @@ bool RainbowAnimation::update(DeviceState* state, DeviceConfig* config) {
   return false;
 }
 
+void RainbowAnimation::alignPhase(unsigned long elapsedMs) {
+  if (!active || paused) return;
+  startMillis = clock->millis() - elapsedMs;
+}
+
+unsigned long RainbowAnimation::elapsedMs() const {
+  if (!active) return 0;
+  return paused ? pausedOffset : clock->millis() - startMillis;
+}
+
+void RainbowAnimation::resumeAt(unsigned long elapsedMs) {
+  if (!active || paused) return;
+  startMillis = clock->millis() - elapsedMs;
+}
+
+unsigned long RainbowAnimation::msUntilUpdate() const {
+  if (!active || paused) return Clock::NO_DEADLINE;
+  unsigned long sinceFrame = clock->millis() - lastUpdateTime;
+  return sinceFrame >= FRAME_MS ? 0 : FRAME_MS - sinceFrame;
+}
+
 bool RainbowAnimation::isActive() const {
   return active;
 }
@@ -95,31 +118,29 @@ bool RainbowAnimation::isPaused() const {
   return paused;
 }
 
-void RainbowAnimation::hsvToRgb(float h, float s, float v, uint8_t& r, uint8_t& g, uint8_t& b) {
-  // HSV to RGB conversion
-  // h: 0-360, s: 0-1, v: 0-1
+void RainbowAnimation::hsvToRgb(uint32_t hue, uint8_t value, uint8_t& r, uint8_t& g, uint8_t& b) {
+  // HSV to RGB conversion with s = 1
+  // hue: six 16-bit sectors, value: 0-100
   
-  float c = v * s;
-  float x = c * (1.0f - fabs(fmod(h / 60.0f, 2.0f) - 1.0f));
-  float m = v - c;
+  uint8_t sector = (uint8_t)(hue >> 16);
+  uint32_t frac = hue & 0xFFFF;
   
-  float rp, gp, bp;
+  // Work in value*255 (0..25500) and round once at the end
+  uint32_t c = (uint32_t)value * 255UL;
+  uint8_t full = (uint8_t)((c + 50) / 100);
+  uint8_t rising = (uint8_t)((c * frac + 50UL * 65536UL) / (100UL * 65536UL));
+  uint8_t falling = (uint8_t)((c * (65536UL - frac) + 50UL * 65536UL) / (100UL * 65536UL));
   
-  if (h < 60) {
-    rp = c; gp = x; bp = 0;
-  } else if (h < 120) {
-    rp = x; gp = c; bp = 0;
-  } else if (h < 180) {
-    rp = 0; gp = c; bp = x;
-  } else if (h < 240) {
-    rp = 0; gp = x; bp = c;
-  } else if (h < 300) {
-    rp = x; gp = 0; bp = c;
-  } else {
-    rp = c; gp = 0; bp = x;
+  switch (sector) {
+    case 0:  r = full;    g = rising;  b = 0;       break;
+    case 1:  r = falling; g = full;    b = 0;       break;
+    case 2:  r = 0;       g = full;    b = rising;  break;
+    case 3:  r = 0;       g = falling; b = full;    break;
+    case 4:  r = rising;  g = 0;       b = full;    break;
+    default: r = full;    g = 0;       b = falling; break;
   }
-  
-  r = (uint8_t)round((rp + m) * 255.0f);
-  g = (uint8_t)round((gp + m) * 255.0f);
-  b = (uint8_t)round((bp + m) * 255.0f);
+}
+
+void RainbowAnimation::setClock(const Clock* c) {
+  clock = c;
 }
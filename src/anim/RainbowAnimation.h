@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include "../state/DeviceState.h"
 #include "../state/DeviceConfig.h"
+#include "../hw/Clock.h"
+#include "Animation.h"
 
 /**
  * Rainbow color cycling animation.
@@ -11,32 +13,47 @@
  * Cycles through hue spectrum at configurable speed.
  * Colors change fast enough to track visually.
  */
-class RainbowAnimation {
+class RainbowAnimation : public Animation {
 public:
   RainbowAnimation();
 
+  /**
+   * Start from generic parameters (mapping in AnimationRegistry).
+   */
+  void start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) override;
+
   void start(DeviceState* state, DeviceConfig* config);
-  void stop(DeviceState* state);
-  void setPaused(bool shouldPause, DeviceState* state);
+  void stop(DeviceState* state) override;
+  void setPaused(bool shouldPause, DeviceState* state) override;
   
   /**
    * Update animation state.
    * @return true if animation completed, false otherwise
    */
-  bool update(DeviceState* state, DeviceConfig* config);
+  bool update(DeviceState* state, DeviceConfig* config) override;
   
-  bool isActive() const;
-  bool isPaused() const;
+  void alignPhase(unsigned long elapsedMs) override;
+  unsigned long elapsedMs() const override;
+  void resumeAt(unsigned long elapsedMs) override;
+  unsigned long msUntilUpdate() const override;
+  bool isActive() const override;
+  bool isPaused() const override;
+  void setClock(const Clock* clock) override;
 
 private:
+  static const unsigned long FRAME_MS = 16;  // ~62 fps
+
+  const Clock* clock;
   bool active;
   bool paused;
   unsigned long startMillis;
   unsigned long pausedOffset;
   unsigned long lastUpdateTime;
   
-  // HSV to RGB conversion
-  void hsvToRgb(float h, float s, float v, uint8_t& r, uint8_t& g, uint8_t& b);
+  // Fully saturated HSV to RGB conversion in integer math.
+  // hue: 0..HUE_RANGE-1 covers 0-360 degrees, value: 0-100
+  static const uint32_t HUE_RANGE = 6UL << 16;
+  void hsvToRgb(uint32_t hue, uint8_t value, uint8_t& r, uint8_t& g, uint8_t& b);
 };
 
 #endif // RAINBOW_ANIMATION_H
@@ -1,10 +1,15 @@
 #include "SunriseAnimation.h"
 
 SunriseAnimation::SunriseAnimation() 
-  : active(false), paused(false), startMillis(0), pausedOffset(0), lastUpdateTime(0),
+  : clock(&Clock::system()), active(false), paused(false), startMillis(0), pausedOffset(0), nextSegmentTime(0),
     durationMs(0), targetBrightness(100), targetR(255), targetG(255), targetB(255) {
 }
 
+void SunriseAnimation::start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) {
+  start(state, config, params.param1, params.param2,
+        params.colorR, params.colorG, params.colorB);
+}
+
 void SunriseAnimation::start(DeviceState* state, DeviceConfig* config,
                               uint8_t durationMinutes, uint8_t targetBri,
                               uint8_t targetRed, uint8_t targetGreen, uint8_t targetBlue) {
@@ -12,7 +17,8 @@ void SunriseAnimation::start(DeviceState* state, DeviceConfig* config,
   
   active = true;
   paused = false;
-  startMillis = millis();
+  startMillis = clock->millis();
+  nextSegmentTime = startMillis;
   pausedOffset = 0;
 
   // Use provided parameters or fall back to config
@@ -29,6 +35,7 @@ void SunriseAnimation::start(DeviceState* state, DeviceConfig* config,
   state->setAnimationMode("sunrise");
   state->powerOn = true;
   state->brightness = 1;  // Start from very dim
+  state->transitionMs = 0;
   state->colorR = targetR;
   state->colorG = targetG;
   state->colorB = targetB;
@@ -48,6 +55,12 @@ void SunriseAnimation::stop(DeviceState* state) {
   if (!active) return;
   
   Serial.println("[ANIM] Stopping sunrise");
+
+  // Hold the point reached instead of finishing the running segment
+  if (!paused) {
+    render(state, clock->millis() - startMillis);
+    state->transitionMs = 0;
+  }
   
   active = false;
   paused = false;
@@ -60,15 +73,18 @@ void SunriseAnimation::setPaused(bool shouldPause, DeviceState* state) {
   if (shouldPause && !paused) {
     // Pausing - save elapsed time so far
     paused = true;
-    pausedOffset = millis() - startMillis;  // How much time has elapsed
+    pausedOffset = clock->millis() - startMillis;  // How much time has elapsed
+    render(state, pausedOffset);  // Freeze mid-segment
+    state->transitionMs = 0;
     state->animationPaused = true;
     state->bumpVersion();
     Serial.println("[ANIM] Sunrise paused");
   } else if (!shouldPause && paused) {
     // Resuming - adjust start time to maintain elapsed time
     paused = false;
-    startMillis = millis() - pausedOffset;  // Resume from where we paused
+    startMillis = clock->millis() - pausedOffset;  // Resume from where we paused
     pausedOffset = 0;  // Clear pause offset
+    nextSegmentTime = clock->millis();  // Start a new segment right away
     state->animationPaused = false;
     state->bumpVersion();
     Serial.println("[ANIM] Sunrise resumed");
@@ -78,29 +94,63 @@ void SunriseAnimation::setPaused(bool shouldPause, DeviceState* state) {
 bool SunriseAnimation::update(DeviceState* state, DeviceConfig* config) {
   if (!active || paused) return false;
 
-  unsigned long now = millis();
+  unsigned long now = clock->millis();
   
-  // Throttle updates to reduce CPU load (update every 100ms)
-  if ((now - lastUpdateTime) < 100) {
+  // The hardware is fading through the current segment; nothing to do
+  if ((long)(now - nextSegmentTime) < 0) {
     return false;
   }
-  lastUpdateTime = now;
   
   // Calculate elapsed time (pausedOffset is 0 when running, only used during pause)
   unsigned long elapsed = now - startMillis;
 
-  // Use captured duration from start time
+  // Check if complete
+  if (elapsed >= durationMs) {
+    // Ensure final state is set before stopping
+    state->brightness = targetBrightness;
+    state->colorR = targetR;
+    state->colorG = targetG;
+    state->colorB = targetB;
+    state->transitionMs = 0;
+    state->progress = 100;
+    state->powerOn = true;
+    state->bumpVersion();
+    
+    // Transition to static mode with current color/brightness
+    Serial.println("[ANIM] Sunrise complete - transitioning to static mode");
+    active = false;
+    paused = false;
+    state->setStaticMode();
+    
+    return true;  // Animation complete
+  }
+
+  state->progress = (uint8_t)((elapsed * 100ULL + durationMs / 2) / durationMs);
+
+  // Next segment boundary; the color phase ends at 70% so split there
+  unsigned long segmentMs = durationMs / SEGMENTS;
+  if (segmentMs < MIN_SEGMENT_MS) segmentMs = MIN_SEGMENT_MS;
+  unsigned long colorEnd = durationMs / 10 * 7;
+  unsigned long segmentEnd = elapsed + segmentMs;
+  if (elapsed < colorEnd && segmentEnd > colorEnd) segmentEnd = colorEnd;
+  if (segmentEnd > durationMs) segmentEnd = durationMs;
+
+  // Target the end of the segment and let the hardware fade there
+  render(state, segmentEnd);
+  state->transitionMs = segmentEnd - elapsed;
+  state->powerOn = true;
+  state->bumpVersion();
+
+  nextSegmentTime = startMillis + segmentEnd;
+  return false;
+}
+
+void SunriseAnimation::render(DeviceState* state, unsigned long elapsed) const {
   float progress = (float)elapsed / (float)durationMs;
   if (progress >= 1.0f) {
     progress = 1.0f;
   }
 
-  uint8_t progressPct = (uint8_t)round(progress * 100.0f);
-  if (progressPct != state->progress) {
-    state->progress = progressPct;
-    state->bumpVersion();
-  }
-
   // Brightness ramp: from 1% to captured target brightness
   float startBri = 1.0f;
   float endBri = (float)targetBrightness;
@@ -109,11 +159,7 @@ bool SunriseAnimation::update(DeviceState* state, DeviceConfig* config) {
   if (logicalBri > 100.0f) logicalBri = 100.0f;
   if (logicalBri < 1.0f)   logicalBri = 1.0f;
 
-  uint8_t newBrightness = (uint8_t)round(logicalBri);
-  if (newBrightness != state->brightness) {
-    state->brightness = newBrightness;
-    state->bumpVersion();  // Trigger hardware update
-  }
+  state->brightness = (uint8_t)round(logicalBri);
   
   // Color temperature progression: Red (2000K) → Orange → Yellow → Target color
   // First 70% of animation: warm up from deep red to target
@@ -130,28 +176,28 @@ bool SunriseAnimation::update(DeviceState* state, DeviceConfig* config) {
     state->colorR = (uint8_t)round(startR + (targetR - startR) * colorProgress);
     state->colorG = (uint8_t)round(startG + (targetG - startG) * colorProgress);
     state->colorB = (uint8_t)round(startB + (targetB - startB) * colorProgress);
+  } else {
+    state->colorR = targetR;
+    state->colorG = targetG;
+    state->colorB = targetB;
   }
-  
-  state->powerOn = true;
+}
 
-  // Check if complete
-  if (progress >= 1.0f) {
-    // Ensure final state is set before stopping
-    state->brightness = targetBrightness;
-    state->progress = 100;
-    state->powerOn = true;
-    state->bumpVersion();
-    
-    // Transition to static mode with current color/brightness
-    Serial.println("[ANIM] Sunrise complete - transitioning to static mode");
-    active = false;
-    paused = false;
-    state->setStaticMode();
-    
-    return true;  // Animation complete
-  }
+unsigned long SunriseAnimation::elapsedMs() const {
+  if (!active) return 0;
+  return paused ? pausedOffset : clock->millis() - startMillis;
+}
 
-  return false;
+void SunriseAnimation::resumeAt(unsigned long elapsedMs) {
+  if (!active || paused) return;
+  startMillis = clock->millis() - elapsedMs;
+  nextSegmentTime = clock->millis();  // Render the point reached right away
+}
+
+unsigned long SunriseAnimation::msUntilUpdate() const {
+  if (!active || paused) return Clock::NO_DEADLINE;
+  long remaining = (long)(nextSegmentTime - clock->millis());
+  return remaining > 0 ? (unsigned long)remaining : 0;
 }
 
 bool SunriseAnimation::isActive() const {
@@ -161,3 +207,7 @@ bool SunriseAnimation::isActive() const {
 bool SunriseAnimation::isPaused() const {
   return paused;
 }
+
+void SunriseAnimation::setClock(const Clock* c) {
+  clock = c;
+}
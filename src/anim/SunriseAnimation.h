@@ -4,19 +4,27 @@
 #include <Arduino.h>
 #include "../state/DeviceState.h"
 #include "../state/DeviceConfig.h"
+#include "../hw/Clock.h"
+#include "Animation.h"
 
 /**
  * Sunrise animation implementation.
  * 
  * Responsibilities:
  * - Smooth brightness ramp from dim to target
+ * - Hand the ramp to the hardware fader in linear segments
  * - Progress tracking
  * - Pause/resume support
  */
-class SunriseAnimation {
+class SunriseAnimation : public Animation {
 public:
   SunriseAnimation();
 
+  /**
+   * Start from generic parameters (mapping in AnimationRegistry).
+   */
+  void start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) override;
+
   /**
    * Start the sunrise animation.
    * 
@@ -38,7 +46,7 @@ public:
    * 
    * @param state Device state to update
    */
-  void stop(DeviceState* state);
+  void stop(DeviceState* state) override;
 
   /**
    * Pause or resume the animation.
@@ -46,36 +54,57 @@ public:
    * @param paused True to pause, false to resume
    * @param state Device state to update
    */
-  void setPaused(bool paused, DeviceState* state);
+  void setPaused(bool paused, DeviceState* state) override;
 
   /**
    * Update animation state. Call every loop iteration.
    * 
+   * Only does work at segment boundaries: each segment sets the state
+   * to the value at its end with state->transitionMs covering the gap.
+   * 
    * @param state Device state to update
    * @param config Device config (for animation parameters)
    * @return True if animation is complete
    */
-  bool update(DeviceState* state, DeviceConfig* config);
+  bool update(DeviceState* state, DeviceConfig* config) override;
 
   /**
    * Check if animation is currently active.
    */
-  bool isActive() const;
+  unsigned long elapsedMs() const override;
+  void resumeAt(unsigned long elapsedMs) override;
+  unsigned long msUntilUpdate() const override;
+  bool isActive() const override;
 
   /**
    * Check if animation is currently paused.
    */
-  bool isPaused() const;
+  bool isPaused() const override;
+
+  /**
+   * Replace the time source (defaults to the system clock).
+   */
+  void setClock(const Clock* clock) override;
 
 private:
+  const Clock* clock;
   bool active;
   bool paused;
   unsigned long startMillis;
   unsigned long pausedOffset;  // Elapsed time when paused
-  unsigned long lastUpdateTime;
+  unsigned long nextSegmentTime;  // When the running fade segment ends
   unsigned long durationMs;  // Total duration captured at start
   uint8_t targetBrightness;  // Final brightness captured at start
   uint8_t targetR, targetG, targetB;  // Final color captured at start
+
+  // Segments per ramp; each is one hardware fade
+  static const unsigned long SEGMENTS = 100;
+  static const unsigned long MIN_SEGMENT_MS = 100;
+
+  /**
+   * Set brightness/color to their values at a point of the ramp.
+   */
+  void render(DeviceState* state, unsigned long elapsed) const;
 };
 
 #endif // SUNRISE_ANIMATION_H
@@ -1,20 +1,24 @@
 #include "SunsetAnimation.h"
 
 SunsetAnimation::SunsetAnimation() 
-  : active(false), paused(false), startMillis(0), pausedOffset(0),
-    lastUpdateTime(0), durationMinutes(30), finalBrightness(0),
+  : clock(&Clock::system()), active(false), paused(false), startMillis(0), pausedOffset(0),
+    nextSegmentTime(0), durationMinutes(30), finalBrightness(0),
     startBrightness(100), startR(255), startG(147), startB(41) {
 }
 
+void SunsetAnimation::start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) {
+  start(state, config, params.param1, params.param2);
+}
+
 void SunsetAnimation::start(DeviceState* state, DeviceConfig* config, 
                              uint8_t durMin, uint8_t finalBri) {
   if (!state || !config) return;
   
   active = true;
   paused = false;
-  startMillis = millis();
+  startMillis = clock->millis();
   pausedOffset = 0;
-  lastUpdateTime = 0;
+  nextSegmentTime = startMillis;
   
   // Use config default if not specified
   durationMinutes = (durMin == 0) ? config->sunriseMinutes : durMin;
@@ -29,6 +33,7 @@ void SunsetAnimation::start(DeviceState* state, DeviceConfig* config,
   startB = state->colorB;
   
   state->powerOn = true;
+  state->transitionMs = 0;
   state->setAnimationMode("sunset");
   state->animationPaused = false;
   state->progress = 0;
@@ -46,6 +51,12 @@ void SunsetAnimation::start(DeviceState* state, DeviceConfig* config,
 
 void SunsetAnimation::stop(DeviceState* state) {
   if (!state || !active) return;
+
+  // Hold the point reached instead of finishing the running segment
+  if (!paused) {
+    render(state, clock->millis() - startMillis);
+    state->transitionMs = 0;
+  }
   
   active = false;
   paused = false;
@@ -58,11 +69,14 @@ void SunsetAnimation::setPaused(bool shouldPause, DeviceState* state) {
   
   if (shouldPause && !paused) {
     // Pause: capture current offset
-    unsigned long elapsed = millis() - startMillis;
+    unsigned long elapsed = clock->millis() - startMillis;
     pausedOffset = elapsed;
+    render(state, elapsed);  // Freeze mid-segment
+    state->transitionMs = 0;
   } else if (!shouldPause && paused) {
-    // Resume: adjust start time
-    startMillis = millis() - pausedOffset;
+    // Resume: adjust start time and start a new segment right away
+    startMillis = clock->millis() - pausedOffset;
+    nextSegmentTime = clock->millis();
   }
   
   paused = shouldPause;
@@ -73,24 +87,24 @@ void SunsetAnimation::setPaused(bool shouldPause, DeviceState* state) {
 bool SunsetAnimation::update(DeviceState* state, DeviceConfig* config) {
   if (!active || paused || !state || !config) return false;
   
-  unsigned long now = millis();
+  unsigned long now = clock->millis();
   
-  // Throttle to 10 Hz (100ms intervals)
-  if (now - lastUpdateTime < 100) {
+  // The hardware is fading through the current segment; nothing to do
+  if ((long)(now - nextSegmentTime) < 0) {
     return false;
   }
-  lastUpdateTime = now;
   
   // Calculate elapsed time
   unsigned long elapsed = now - startMillis;
-  unsigned long totalMillis = (unsigned long)durationMinutes * 60UL * 1000UL;
+  unsigned long total = totalMillis();
   
-  if (elapsed >= totalMillis) {
+  if (elapsed >= total) {
     // Animation complete
     state->brightness = finalBrightness;
     state->colorR = 255;
     state->colorG = 80;
     state->colorB = 0;
+    state->transitionMs = 0;
     state->progress = 100;
     
     if (finalBrightness == 0) {
@@ -98,13 +112,39 @@ bool SunsetAnimation::update(DeviceState* state, DeviceConfig* config) {
     }
     
     state->bumpVersion();
-    stop(state);
+    active = false;
+    paused = false;
+    state->setStaticMode();
     return true;
   }
   
+  state->progress = (uint8_t)(elapsed * 100ULL / total);
+
+  // Next segment boundary; the color phase ends at 70% so split there
+  unsigned long segmentMs = total / SEGMENTS;
+  if (segmentMs < MIN_SEGMENT_MS) segmentMs = MIN_SEGMENT_MS;
+  unsigned long colorEnd = total / 10 * 7;
+  unsigned long segmentEnd = elapsed + segmentMs;
+  if (elapsed < colorEnd && segmentEnd > colorEnd) segmentEnd = colorEnd;
+  if (segmentEnd > total) segmentEnd = total;
+
+  // Target the end of the segment and let the hardware fade there
+  render(state, segmentEnd);
+  state->transitionMs = segmentEnd - elapsed;
+  state->bumpVersion();
+
+  nextSegmentTime = startMillis + segmentEnd;
+  return false;
+}
+
+unsigned long SunsetAnimation::totalMillis() const {
+  return (unsigned long)durationMinutes * 60UL * 1000UL;
+}
+
+void SunsetAnimation::render(DeviceState* state, unsigned long elapsed) const {
   // Progress (0.0 to 1.0)
-  float progress = (float)elapsed / (float)totalMillis;
-  state->progress = (uint8_t)(progress * 100.0f);
+  float progress = (float)elapsed / (float)totalMillis();
+  if (progress > 1.0f) progress = 1.0f;
   
   // Reverse color temperature progression (70% of animation)
   // Start color → Warm White (255,147,41) → Orange (255,100,20) → Deep Red (255,80,0)
@@ -128,10 +168,23 @@ bool SunsetAnimation::update(DeviceState* state, DeviceConfig* config) {
   state->colorG = g;
   state->colorB = b;
   state->brightness = brightness;
-  
-  state->bumpVersion();
-  
-  return false;
+}
+
+unsigned long SunsetAnimation::elapsedMs() const {
+  if (!active) return 0;
+  return paused ? pausedOffset : clock->millis() - startMillis;
+}
+
+void SunsetAnimation::resumeAt(unsigned long elapsedMs) {
+  if (!active || paused) return;
+  startMillis = clock->millis() - elapsedMs;
+  nextSegmentTime = clock->millis();  // Render the point reached right away
+}
+
+unsigned long SunsetAnimation::msUntilUpdate() const {
+  if (!active || paused) return Clock::NO_DEADLINE;
+  long remaining = (long)(nextSegmentTime - clock->millis());
+  return remaining > 0 ? (unsigned long)remaining : 0;
 }
 
 bool SunsetAnimation::isActive() const {
@@ -141,3 +194,7 @@ bool SunsetAnimation::isActive() const {
 bool SunsetAnimation::isPaused() const {
   return paused;
 }
+
+void SunsetAnimation::setClock(const Clock* c) {
+  clock = c;
+}
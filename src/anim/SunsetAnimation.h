@@ -4,17 +4,25 @@
 #include <Arduino.h>
 #include "../state/DeviceState.h"
 #include "../state/DeviceConfig.h"
+#include "../hw/Clock.h"
+#include "Animation.h"
 
 /**
  * Sunset animation - reverse of sunrise.
  * 
  * Gradually dims from current brightness through warm colors
  * (warm white → orange → red → off), perfect for bedtime routine.
+ * Like sunrise, the ramp is handed to the hardware fader in segments.
  */
-class SunsetAnimation {
+class SunsetAnimation : public Animation {
 public:
   SunsetAnimation();
 
+  /**
+   * Start from generic parameters (mapping in AnimationRegistry).
+   */
+  void start(DeviceState* state, DeviceConfig* config, const AnimationParams& params) override;
+
   /**
    * Start sunset animation.
    * 
@@ -25,29 +33,40 @@ public:
    */
   void start(DeviceState* state, DeviceConfig* config, 
              uint8_t durationMinutes = 0, uint8_t finalBrightness = 0);
-  void stop(DeviceState* state);
-  void setPaused(bool shouldPause, DeviceState* state);
+  void stop(DeviceState* state) override;
+  void setPaused(bool shouldPause, DeviceState* state) override;
   
   /**
    * Update animation state.
    * @return true if animation completed, false otherwise
    */
-  bool update(DeviceState* state, DeviceConfig* config);
+  bool update(DeviceState* state, DeviceConfig* config) override;
   
-  bool isActive() const;
-  bool isPaused() const;
+  unsigned long elapsedMs() const override;
+  void resumeAt(unsigned long elapsedMs) override;
+  unsigned long msUntilUpdate() const override;
+  bool isActive() const override;
+  bool isPaused() const override;
+  void setClock(const Clock* clock) override;
 
 private:
+  const Clock* clock;
   bool active;
   bool paused;
   unsigned long startMillis;
   unsigned long pausedOffset;
-  unsigned long lastUpdateTime;
+  unsigned long nextSegmentTime;
   
   uint8_t durationMinutes;
   uint8_t finalBrightness;
   uint8_t startBrightness;
   uint8_t startR, startG, startB;
+
+  static const unsigned long SEGMENTS = 100;
+  static const unsigned long MIN_SEGMENT_MS = 100;
+
+  unsigned long totalMillis() const;
+  void render(DeviceState* state, unsigned long elapsed) const;
 };
 
 #endif // SUNSET_ANIMATION_H
@@ -1,75 +1,180 @@
 #include "Button.h"
+#include "SleepManager.h"
 
-Button::Button() 
-  : lastStable(HIGH), lastRaw(HIGH), lastChange(0), 
-    pressStartTime(0), longPressReported(false),
-    lastReleaseTime(0), awaitingSecondClick(false) {
+#ifndef NATIVE_BUILD
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+#endif
+
+Button::Button()
+  : head(0), tail(0), overflow(false), dropped(0),
+    clock(&Clock::system()), sleeper(nullptr),
+    lastStable(HIGH), lastRaw(HIGH), lastChangeUs(0),
+    pressStartUs(0), longPressReported(false),
+    lastReleaseUs(0), awaitingSecondClick(false) {
 }
 
 void Button::begin() {
   Serial.println("[BTN] Initializing button");
   pinMode(PIN_BUTTON, INPUT_PULLUP);
   lastRaw = lastStable = digitalRead(PIN_BUTTON);
+  lastChangeUs = clock->micros();
+
+#ifndef NATIVE_BUILD
+  gpio_num_t pin = (gpio_num_t)PIN_BUTTON;
+  gpio_install_isr_service(0);  // ESP_ERR_INVALID_STATE if already installed
+  gpio_isr_handler_add(pin, isrHandler, this);
+  gpio_wakeup_enable(pin, lastRaw ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  gpio_intr_enable(pin);
+  esp_sleep_enable_gpio_wakeup();
+#endif
+}
+
+void Button::isrHandler(void* arg) {
+#ifndef NATIVE_BUILD
+  Button* self = (Button*)arg;
+  gpio_num_t pin = (gpio_num_t)PIN_BUTTON;
+  bool level = gpio_get_level(pin);
+
+  // Wait for the opposite level next; this also sets the light sleep wake level
+  gpio_wakeup_enable(pin, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+
+  self->onEdge(level, (uint32_t)micros());
+  if (self->sleeper) self->sleeper->wake();
+#endif
+}
+
+void Button::onEdge(bool level, uint32_t timestampUs) {
+  uint8_t h = head.load(std::memory_order_relaxed);
+  uint8_t next = (h + 1) & (QUEUE_SIZE - 1);
+  if (next == tail.load(std::memory_order_acquire)) {
+    overflow.store(true, std::memory_order_relaxed);
+    dropped = dropped + 1;
+    return;
+  }
+  queue[h].timeUs = timestampUs;
+  queue[h].level = level;
+  head.store(next, std::memory_order_release);
 }
 
 ButtonEvent Button::update() {
-  int raw = digitalRead(PIN_BUTTON);
-  unsigned long now = millis();
-
-  // Detect edge
-  if (raw != lastRaw) {
-    lastRaw = raw;
-    lastChange = now;
-    return ButtonEvent::None;
+  if (overflow.load(std::memory_order_relaxed)) {
+    resync(clock->micros());
   }
 
-  // Wait for debounce period
-  if ((now - lastChange) < DEBOUNCE_MS) {
-    return ButtonEvent::None;
+  // Replay queued edges at their own timestamps
+  uint8_t t = tail.load(std::memory_order_relaxed);
+  while (t != head.load(std::memory_order_acquire)) {
+    const Edge& edge = queue[t];
+
+    // Anything that became due before this edge is reported first;
+    // the edge stays queued for the next call
+    ButtonEvent event = advanceTo(edge.timeUs);
+    if (event != ButtonEvent::None) return event;
+
+    if (edge.level != lastRaw) {
+      lastRaw = edge.level;
+      lastChangeUs = edge.timeUs;
+    }
+    t = (t + 1) & (QUEUE_SIZE - 1);
+    tail.store(t, std::memory_order_release);
   }
 
-  // Check if stable state changed
-  if (raw != lastStable) {
-    lastStable = raw;
+  return advanceTo(clock->micros());
+}
+
+ButtonEvent Button::advanceTo(uint32_t nowUs) {
+  while (true) {
+    // Level stable for the debounce period; the change dates from its edge
+    bool settling = lastRaw != lastStable && (nowUs - lastChangeUs) >= DEBOUNCE_US;
+
+    // Check if double-click window expired (before any later press)
+    if (awaitingSecondClick && (nowUs - lastReleaseUs) >= DOUBLE_CLICK_US &&
+        !(settling && (lastChangeUs - lastReleaseUs) < DOUBLE_CLICK_US)) {
+      awaitingSecondClick = false;
+      return ButtonEvent::Press;  // Single press confirmed
+    }
+
+    // Check for long press (button held down, not released in time)
+    if (lastStable == LOW && !longPressReported && (nowUs - pressStartUs) >= LONG_PRESS_US &&
+        !(settling && (lastChangeUs - pressStartUs) < LONG_PRESS_US)) {
+      longPressReported = true;
+      awaitingSecondClick = false;
+      return ButtonEvent::LongPress;
+    }
+
+    if (!settling) {
+      return ButtonEvent::None;
+    }
+
+    lastStable = lastRaw;
+    uint32_t at = lastChangeUs;
 
-    if (raw == LOW) {
+    if (lastStable == LOW) {
       // Button pressed
-      if (awaitingSecondClick && (now - lastReleaseTime) < DOUBLE_CLICK_MS) {
+      if (awaitingSecondClick && (at - lastReleaseUs) < DOUBLE_CLICK_US) {
         // Second press within double-click window - it's a double-click!
         awaitingSecondClick = false;
         longPressReported = true;  // Prevent release from triggering single press
         return ButtonEvent::DoublePress;
       }
-      
-      // First press or too late for double-click
-      pressStartTime = now;
+
+      pressStartUs = at;
       longPressReported = false;
       awaitingSecondClick = false;
-    } else {
-      // Button released
-      if (!longPressReported) {
-        // Short press released - start waiting for potential second click
-        lastReleaseTime = now;
-        awaitingSecondClick = true;
-        // Don't return Press yet - wait to see if there's a second click
-      }
+    } else if (!longPressReported) {
+      // Short press released - wait to see if there's a second click
+      lastReleaseUs = at;
+      awaitingSecondClick = true;
     }
   }
+}
 
-  // Check for long press (button held down)
-  if (lastStable == LOW && !longPressReported) {
-    if ((now - pressStartTime) >= 1000) {  // 1 second long press
-      longPressReported = true;
-      awaitingSecondClick = false;
-      return ButtonEvent::LongPress;
-    }
+void Button::resync(uint32_t nowUs) {
+  // Timing of the dropped burst is lost; restart debounce from the pin level
+  overflow.store(false, std::memory_order_relaxed);
+  tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+  lastRaw = digitalRead(PIN_BUTTON);
+  lastChangeUs = nowUs;
+}
+
+unsigned long Button::msUntilUpdate() const {
+  if (tail.load(std::memory_order_relaxed) != head.load(std::memory_order_acquire) ||
+      overflow.load(std::memory_order_relaxed)) {
+    return 0;
   }
 
-  // Check if double-click window expired
-  if (awaitingSecondClick && (now - lastReleaseTime) >= DOUBLE_CLICK_MS) {
-    awaitingSecondClick = false;
-    return ButtonEvent::Press;  // Single press confirmed
+  uint32_t nowUs = clock->micros();
+  uint32_t waitUs = 0xFFFFFFFFUL;
+
+  // Remaining time of a window that started at 'since'
+  auto remaining = [nowUs](uint32_t since, uint32_t length) -> uint32_t {
+    uint32_t elapsed = nowUs - since;
+    return elapsed >= length ? 0 : length - elapsed;
+  };
+
+  if (lastRaw != lastStable) {
+    waitUs = min(waitUs, remaining(lastChangeUs, DEBOUNCE_US));
+  }
+  if (lastStable == LOW && !longPressReported) {
+    waitUs = min(waitUs, remaining(pressStartUs, LONG_PRESS_US));
+  }
+  if (awaitingSecondClick) {
+    waitUs = min(waitUs, remaining(lastReleaseUs, DOUBLE_CLICK_US));
   }
 
-  return ButtonEvent::None;
+  if (waitUs == 0xFFFFFFFFUL) return Clock::NO_DEADLINE;
+  return (waitUs + 999) / 1000;
+}
+
+uint32_t Button::droppedEdges() const {
+  return dropped;
+}
+
+void Button::setSleepManager(SleepManager* s) {
+  sleeper = s;
+}
+
+void Button::setClock(const Clock* c) {
+  clock = c;
 }
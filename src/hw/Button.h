@@ -2,13 +2,23 @@
 #define BUTTON_H
 
 #include <Arduino.h>
+#include <atomic>
+#include "Clock.h"
+
+class SleepManager;
 
 /**
  * Debounced button handler.
- * 
+ *
  * Responsibilities:
- * - Hardware debouncing
- * - Generate clean button press events
+ * - Capture edges in a GPIO interrupt with microsecond timestamps
+ * - Debounce and classify press/long press/double press from those timestamps
+ * - Wake the main loop (and the CPU from light sleep) on button activity
+ *
+ * The interrupt is level-triggered and re-armed for the opposite level on
+ * every edge, because only level triggers can wake the ESP32-C3 from light
+ * sleep. Edges go through a single-producer/single-consumer ring, so the
+ * ISR never blocks and update() can run late without losing timing.
  */
 enum class ButtonEvent {
   None,
@@ -22,30 +32,86 @@ public:
   Button();
 
   /**
-   * Initialize button pin with internal pull-up.
+   * Initialize button pin with internal pull-up and attach the interrupt.
    * Call once in setup().
    */
   void begin();
 
   /**
-   * Update button state. Call every loop iteration.
-   * 
-   * @return ButtonEvent::Press on clean button press, ButtonEvent::None otherwise
+   * Consume queued edges and advance the click state machine.
+   * Returns at most one event per call; remaining edges stay queued.
+   *
+   * @return Detected event, ButtonEvent::None otherwise
    */
   ButtonEvent update();
 
+  /**
+   * Time until update() must run again.
+   *
+   * Zero while edges are queued, the remaining debounce/click/hold window
+   * while one is being timed, Clock::NO_DEADLINE when idle.
+   *
+   * @return Milliseconds (0 = now)
+   */
+  unsigned long msUntilUpdate() const;
+
+  /**
+   * Record an edge. Called from the GPIO interrupt; host tests call it
+   * directly to inject edges.
+   *
+   * @param level Pin level after the edge
+   * @param timestampUs micros() at the edge
+   */
+  void onEdge(bool level, uint32_t timestampUs);
+
+  /**
+   * Number of edges dropped because the queue was full.
+   */
+  uint32_t droppedEdges() const;
+
+  /**
+   * Wake this sleep manager from the interrupt.
+   */
+  void setSleepManager(SleepManager* sleeper);
+
+  /**
+   * Replace the time source (defaults to the system clock).
+   */
+  void setClock(const Clock* clock);
+
 private:
   static const uint8_t PIN_BUTTON = 5;
-  static const unsigned long DEBOUNCE_MS = 40;
-  static const unsigned long DOUBLE_CLICK_MS = 400;  // Max time between clicks
+  static const uint32_t DEBOUNCE_US = 40000;
+  static const uint32_t DOUBLE_CLICK_US = 400000;  // Max time between clicks
+  static const uint32_t LONG_PRESS_US = 1000000;
+  static const uint8_t QUEUE_SIZE = 32;            // Power of two
+
+  struct Edge {
+    uint32_t timeUs;
+    bool level;
+  };
+
+  // Edge ring: head written by the ISR, tail by update()
+  Edge queue[QUEUE_SIZE];
+  std::atomic<uint8_t> head;
+  std::atomic<uint8_t> tail;
+  std::atomic<bool> overflow;
+  volatile uint32_t dropped;  // Only written by the ISR
+
+  const Clock* clock;
+  SleepManager* sleeper;
 
   bool lastStable;
   bool lastRaw;
-  unsigned long lastChange;
-  unsigned long pressStartTime;
+  uint32_t lastChangeUs;
+  uint32_t pressStartUs;
   bool longPressReported;
-  unsigned long lastReleaseTime;
+  uint32_t lastReleaseUs;
   bool awaitingSecondClick;
+
+  ButtonEvent advanceTo(uint32_t nowUs);
+  void resync(uint32_t nowUs);
+  static void isrHandler(void* arg);
 };
 
 #endif // BUTTON_H
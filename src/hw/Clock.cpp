@@ -0,0 +1,38 @@
+#include "Clock.h"
+
+const Clock& Clock::system() {
+  static SystemClock instance;
+  return instance;
+}
+
+unsigned long SystemClock::millis() const {
+  return ::millis();
+}
+
+unsigned long SystemClock::micros() const {
+  return ::micros();
+}
+
+VirtualClock::VirtualClock(unsigned long startMs)
+  : nowUs((unsigned long long)startMs * 1000ULL) {
+}
+
+unsigned long VirtualClock::millis() const {
+  return (unsigned long)(nowUs / 1000ULL);
+}
+
+unsigned long VirtualClock::micros() const {
+  return (unsigned long)nowUs;
+}
+
+void VirtualClock::advance(unsigned long ms) {
+  nowUs += (unsigned long long)ms * 1000ULL;
+}
+
+void VirtualClock::advanceMicros(unsigned long us) {
+  nowUs += us;
+}
+
+void VirtualClock::set(unsigned long ms) {
+  nowUs = (unsigned long long)ms * 1000ULL;
+}
@@ -0,0 +1,81 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <Arduino.h>
+
+/**
+ * Monotonic time source.
+ * 
+ * Responsibilities:
+ * - Decouple time-driven modules from millis()/micros()
+ * - Allow the host build to run animations faster than real time
+ */
+class Clock {
+public:
+  // Returned by msUntilUpdate()-style queries when nothing is scheduled
+  static const unsigned long NO_DEADLINE = 0xFFFFFFFFUL;
+
+  virtual ~Clock() {}
+
+  /**
+   * Milliseconds since an arbitrary epoch (wraps like millis()).
+   */
+  virtual unsigned long millis() const = 0;
+
+  /**
+   * Microseconds since an arbitrary epoch (wraps like micros()).
+   */
+  virtual unsigned long micros() const = 0;
+
+  /**
+   * Shared clock backed by the hardware timer.
+   */
+  static const Clock& system();
+};
+
+/**
+ * Clock reading the real Arduino millis()/micros() counters.
+ */
+class SystemClock : public Clock {
+public:
+  unsigned long millis() const override;
+  unsigned long micros() const override;
+};
+
+/**
+ * Manually advanced clock for host tests and benchmarks.
+ * Time only moves when advance() or set() is called.
+ */
+class VirtualClock : public Clock {
+public:
+  explicit VirtualClock(unsigned long startMs = 0);
+
+  unsigned long millis() const override;
+  unsigned long micros() const override;
+
+  /**
+   * Move time forward.
+   * 
+   * @param ms Milliseconds to advance
+   */
+  void advance(unsigned long ms);
+
+  /**
+   * Move time forward with sub-millisecond resolution.
+   * 
+   * @param us Microseconds to advance
+   */
+  void advanceMicros(unsigned long us);
+
+  /**
+   * Jump to an absolute time.
+   * 
+   * @param ms Milliseconds since the clock epoch
+   */
+  void set(unsigned long ms);
+
+private:
+  unsigned long long nowUs;
+};
+
+#endif // CLOCK_H
@@ -0,0 +1,71 @@
+#include "FlashRegion.h"
+
+#ifndef NATIVE_BUILD
+#include "esp_partition.h"
+#endif
+
+MemoryFlash::MemoryFlash(size_t sectors)
+  : length(sectors * SECTOR_SIZE), bytes(new uint8_t[sectors * SECTOR_SIZE]),
+    erases(new uint32_t[sectors]) {
+  memset(bytes, 0xFF, length);
+  memset(erases, 0, sectors * sizeof(uint32_t));
+}
+
+MemoryFlash::~MemoryFlash() {
+  delete[] bytes;
+  delete[] erases;
+}
+
+bool MemoryFlash::read(size_t offset, void* data, size_t count) const {
+  if (offset > length || count > length - offset) return false;
+  memcpy(data, bytes + offset, count);
+  return true;
+}
+
+bool MemoryFlash::write(size_t offset, const void* data, size_t count) {
+  if (offset > length || count > length - offset) return false;
+  const uint8_t* src = (const uint8_t*)data;
+  for (size_t i = 0; i < count; i++) {
+    bytes[offset + i] &= src[i];
+  }
+  return true;
+}
+
+bool MemoryFlash::erase(size_t offset) {
+  if (offset % SECTOR_SIZE != 0 || offset >= length) return false;
+  memset(bytes + offset, 0xFF, SECTOR_SIZE);
+  erases[offset / SECTOR_SIZE]++;
+  return true;
+}
+
+uint32_t MemoryFlash::eraseCount(size_t sector) const {
+  return sector < length / SECTOR_SIZE ? erases[sector] : 0;
+}
+
+#ifndef NATIVE_BUILD
+
+PartitionFlash::PartitionFlash() : partition(nullptr) {
+}
+
+bool PartitionFlash::begin(const char* label) {
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  return partition != nullptr;
+}
+
+size_t PartitionFlash::size() const {
+  return partition ? partition->size - partition->size % SECTOR_SIZE : 0;
+}
+
+bool PartitionFlash::read(size_t offset, void* data, size_t length) const {
+  return partition && esp_partition_read(partition, offset, data, length) == ESP_OK;
+}
+
+bool PartitionFlash::write(size_t offset, const void* data, size_t length) {
+  return partition && esp_partition_write(partition, offset, data, length) == ESP_OK;
+}
+
+bool PartitionFlash::erase(size_t offset) {
+  return partition && esp_partition_erase_range(partition, offset, SECTOR_SIZE) == ESP_OK;
+}
+
+#endif // NATIVE_BUILD
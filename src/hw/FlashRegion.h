@@ -0,0 +1,97 @@
+#ifndef FLASH_REGION_H
+#define FLASH_REGION_H
+
+#include <Arduino.h>
+
+/**
+ * Raw NOR flash area, addressed from 0.
+ *
+ * Responsibilities:
+ * - Read, program and erase by sector, with NOR semantics: erasing sets
+ *   a whole sector to 0xFF, programming can only clear bits
+ * - Hide whether the bytes live in a flash partition or in RAM, so the
+ *   state journal runs unchanged in host tests
+ */
+class FlashRegion {
+public:
+  static const size_t SECTOR_SIZE = 4096;
+
+  virtual ~FlashRegion() {}
+
+  /**
+   * Usable size in bytes (a multiple of SECTOR_SIZE).
+   */
+  virtual size_t size() const = 0;
+
+  virtual bool read(size_t offset, void* data, size_t length) const = 0;
+
+  /**
+   * Program bytes. The target must have been erased; bits already
+   * cleared stay cleared.
+   */
+  virtual bool write(size_t offset, const void* data, size_t length) = 0;
+
+  /**
+   * Erase the sector starting at offset (a multiple of SECTOR_SIZE).
+   */
+  virtual bool erase(size_t offset) = 0;
+};
+
+/**
+ * Flash region backed by RAM, for host tests. Counts erases per sector
+ * to check wear leveling.
+ */
+class MemoryFlash : public FlashRegion {
+public:
+  explicit MemoryFlash(size_t sectors);
+  ~MemoryFlash();
+
+  size_t size() const override { return length; }
+  bool read(size_t offset, void* data, size_t length) const override;
+  bool write(size_t offset, const void* data, size_t length) override;
+  bool erase(size_t offset) override;
+
+  uint32_t eraseCount(size_t sector) const;
+
+  // Direct access to simulate power loss halfway through a write
+  uint8_t* data() { return bytes; }
+
+private:
+  size_t length;
+  uint8_t* bytes;
+  uint32_t* erases;
+
+  MemoryFlash(const MemoryFlash&);
+  MemoryFlash& operator=(const MemoryFlash&);
+};
+
+#ifndef NATIVE_BUILD
+
+struct esp_partition_t;
+
+/**
+ * Flash region backed by a data partition from partitions.csv.
+ */
+class PartitionFlash : public FlashRegion {
+public:
+  PartitionFlash();
+
+  /**
+   * Look up the partition by label.
+   *
+   * @return False if the partition table has no such partition
+   */
+  bool begin(const char* label);
+
+  size_t size() const override;
+  bool read(size_t offset, void* data, size_t length) const override;
+  bool write(size_t offset, const void* data, size_t length) override;
+  bool erase(size_t offset) override;
+
+private:
+  const esp_partition_t* partition;
+};
+
+#endif // NATIVE_BUILD
+
+#endif // FLASH_REGION_H
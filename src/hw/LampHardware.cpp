@@ -1,6 +1,51 @@
 #include "LampHardware.h"
+#include "driver/ledc.h"
+#ifndef NATIVE_BUILD
+#include "soc/soc_caps.h"
+#endif
 
-LampHardware::LampHardware() {
+namespace {
+
+// Without ledc_fade_stop() a hardware segment cannot be interrupted, so
+// fades are chained in short segments and writes wait for the current
+// one to land. With it, one segment covers the whole fade.
+#if defined(SOC_LEDC_SUPPORT_FADE_STOP) && SOC_LEDC_SUPPORT_FADE_STOP
+const uint32_t MAX_SEGMENT_MS = 0;
+#else
+const uint32_t MAX_SEGMENT_MS = 1000;
+#endif
+
+// Factory calibration (min_pwm=20, max_pwm=100, gamma 2.2) baked in so
+// the default configuration never runs pow() at all.
+// Regenerate with LampHardware::buildScaleTable() if the defaults change.
+const uint8_t FACTORY_MIN_PWM = 20;
+const uint8_t FACTORY_MAX_PWM = 100;
+
+constexpr uint16_t FACTORY_SCALE_TABLE[101] = {
+      0,  1036,  1125,  1219,  1317,  1419,  1525,  1635,  1750,  1869,
+   1992,  2119,  2251,  2387,  2527,  2672,  2821,  2974,  3132,  3295,
+   3462,  3633,  3809,  3990,  4175,  4365,  4559,  4758,  4962,  5170,
+   5383,  5601,  5823,  6050,  6282,  6519,  6760,  7007,  7258,  7514,
+   7774,  8040,  8310,  8586,  8866,  9151,  9441,  9736, 10036, 10341,
+  10651, 10966, 11286, 11611, 11941, 12276, 12616, 12961, 13311, 13667,
+  14027, 14393, 14764, 15139, 15521, 15907, 16298, 16695, 17097, 17504,
+  17916, 18333, 18756, 19184, 19618, 20056, 20500, 20949, 21404, 21864,
+  22329, 22799, 23275, 23756, 24243, 24735, 25232, 25735, 26243, 26757,
+  27276, 27801, 28331, 28866, 29407, 29953, 30505, 31063, 31626, 32194,
+  32768
+};
+
+}  // namespace
+
+const uint8_t LampHardware::PWM_CHANNELS[LampHardware::CHANNEL_COUNT] = {
+  PWM_CHANNEL_RED, PWM_CHANNEL_GREEN, PWM_CHANNEL_BLUE
+};
+
+LampHardware::LampHardware()
+  : clock(&Clock::system()), fades(), fading(false), fadeStartMs(0), fadeDurationMs(0),
+    segmentRunning(false), segmentEndMs(0), pendingWrite(false), pendingDuty(), lit(false),
+    tableValid(false), tableMinPwm(0), tableMaxPwm(0),
+    gammaX100(DEFAULT_GAMMA_X100), curve(), curveCount(0) {
 }
 
 void LampHardware::begin() {
@@ -18,37 +63,318 @@ void LampHardware::begin() {
   ledcWrite(PWM_CHANNEL_RED,   0);
   ledcWrite(PWM_CHANNEL_GREEN, 0);
   ledcWrite(PWM_CHANNEL_BLUE,  0);
+
+  // Interrupt-driven fade completion for fadeTo()
+  ledc_fade_func_install(0);
 }
 
 void LampHardware::apply(bool power, uint8_t brightness,
                           uint8_t r, uint8_t g, uint8_t b,
                           uint8_t minPwmPercent, uint8_t maxPwmPercent) {
+  uint32_t duties[CHANNEL_COUNT];
+  computeDuties(power, brightness, r, g, b, minPwmPercent, maxPwmPercent, duties);
+
+  unsigned long now = clock->millis();
+  cancelFade(now);
+
+  if (segmentBusy(now)) {
+    // Land right after the running segment (at most MAX_SEGMENT_MS)
+    memcpy(pendingDuty, duties, sizeof(pendingDuty));
+    pendingWrite = true;
+    return;
+  }
+
+  writeDuties(duties);
+  // Serial output removed - was blocking loop
+}
+
+void LampHardware::fadeTo(bool power, uint8_t brightness,
+                           uint8_t r, uint8_t g, uint8_t b,
+                           uint8_t minPwmPercent, uint8_t maxPwmPercent,
+                           uint32_t durationMs) {
+  if (durationMs == 0) {
+    apply(power, brightness, r, g, b, minPwmPercent, maxPwmPercent);
+    return;
+  }
+
+  uint32_t duties[CHANNEL_COUNT];
+  computeDuties(power, brightness, r, g, b, minPwmPercent, maxPwmPercent, duties);
+
+  unsigned long now = clock->millis();
+  cancelFade(now);
+  pendingWrite = false;
+
+  // A segment that cannot be stopped lands on its target first
+  bool waitForSegment = segmentBusy(now);
+
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+    ChannelFade& f = fades[i];
+    f.fromDuty = waitForSegment ? f.lastDuty : ledcRead(PWM_CHANNELS[i]);
+    f.toDuty = duties[i];
+    f.lastDuty = f.fromDuty;
+
+    // The fade unit advances one duty step per at most 1023 PWM periods;
+    // anything slower would finish early, so step it from firmware.
+    uint32_t delta = f.toDuty > f.fromDuty ? f.toDuty - f.fromDuty : f.fromDuty - f.toDuty;
+    uint64_t periods = (uint64_t)durationMs * PWM_FREQ / 1000;
+    f.hardware = delta > 0 && periods / delta <= FADE_MAX_CYCLES_PER_STEP;
+  }
+
+  lit = lit || duties[0] || duties[1] || duties[2];
+  fading = true;
+  fadeStartMs = waitForSegment ? segmentEndMs : now;
+  fadeDurationMs = durationMs;
+  update();
+}
+
+void LampHardware::update() {
+  unsigned long now = clock->millis();
+
+  if (pendingWrite) {
+    if (segmentBusy(now)) return;
+    segmentRunning = false;
+    pendingWrite = false;
+    writeDuties(pendingDuty);
+  }
+
+  if (!fading || (long)(now - fadeStartMs) < 0) return;
+
+  uint32_t elapsed = (uint32_t)(now - fadeStartMs);
+  if (elapsed >= fadeDurationMs) {
+    if (segmentBusy(now)) return;  // Let the last segment land
+
+    segmentRunning = false;
+    fading = false;
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+      if (fades[i].lastDuty != fades[i].toDuty) {
+        ledcWrite(PWM_CHANNELS[i], fades[i].toDuty);
+        fades[i].lastDuty = fades[i].toDuty;
+      }
+    }
+    lit = fades[0].toDuty || fades[1].toDuty || fades[2].toDuty;
+    return;
+  }
+
+  // Slow channels: write only when the duty actually moves
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+    ChannelFade& f = fades[i];
+    if (f.hardware) continue;
+    uint32_t duty = dutyAt(f, elapsed);
+    if (duty != f.lastDuty) {
+      ledcWrite(PWM_CHANNELS[i], duty);
+      f.lastDuty = duty;
+    }
+  }
+
+  if (!segmentBusy(now)) {
+    startSegment(now, elapsed);
+  }
+}
+
+bool LampHardware::isFading() const {
+  return fading || pendingWrite;
+}
+
+unsigned long LampHardware::msUntilUpdate() const {
+  unsigned long now = clock->millis();
+  long wait;
+
+  if (pendingWrite || (segmentRunning && !fading)) {
+    wait = (long)(segmentEndMs - now);
+  } else if (!fading) {
+    return Clock::NO_DEADLINE;
+  } else if ((long)(now - fadeStartMs) < 0) {
+    wait = (long)(fadeStartMs - now);
+  } else {
+    uint32_t elapsed = (uint32_t)(now - fadeStartMs);
+    uint32_t next = fadeDurationMs;
+    bool hardwarePending = false;
+
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+      if (fades[i].hardware) {
+        if (fades[i].lastDuty != fades[i].toDuty) hardwarePending = true;
+      } else {
+        uint32_t step = nextStepAt(fades[i]);
+        if (step < next) next = step;
+      }
+    }
+    if (hardwarePending && segmentRunning && segmentEndMs - fadeStartMs < next) {
+      next = (uint32_t)(segmentEndMs - fadeStartMs);
+    } else if (hardwarePending && !segmentRunning) {
+      next = elapsed;
+    }
+    wait = (long)next - (long)elapsed;
+  }
+
+  return wait > 0 ? (unsigned long)wait : 0;
+}
+
+bool LampHardware::isLit() const {
+  return lit || isFading();
+}
+
+void LampHardware::setClock(const Clock* c) {
+  clock = c;
+}
+
+void LampHardware::computeDuties(bool power, uint8_t brightness,
+                                 uint8_t r, uint8_t g, uint8_t b,
+                                 uint8_t minPwm, uint8_t maxPwm, uint32_t* duties) {
   if (!power) {
-    ledcWrite(PWM_CHANNEL_RED,   0);
-    ledcWrite(PWM_CHANNEL_GREEN, 0);
-    ledcWrite(PWM_CHANNEL_BLUE,  0);
+    duties[0] = duties[1] = duties[2] = 0;
+    return;
+  }
+
+  if (brightness > 100) brightness = 100;
+  ensureTable(minPwm, maxPwm);
+  uint16_t scale = scaleTable[brightness];
+
+  duties[0] = channelDuty(r, scale);
+  duties[1] = channelDuty(g, scale);
+  duties[2] = channelDuty(b, scale);
+}
+
+void LampHardware::writeDuties(const uint32_t* duties) {
+  lit = duties[0] || duties[1] || duties[2];
+  ledcWrite(PWM_CHANNEL_RED,   duties[0]);
+  ledcWrite(PWM_CHANNEL_GREEN, duties[1]);
+  ledcWrite(PWM_CHANNEL_BLUE,  duties[2]);
+}
+
+void LampHardware::cancelFade(unsigned long now) {
+#if defined(SOC_LEDC_SUPPORT_FADE_STOP) && SOC_LEDC_SUPPORT_FADE_STOP
+  if (segmentRunning) {
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+      if (fades[i].hardware) ledc_fade_stop(LEDC_LOW_SPEED_MODE, (ledc_channel_t)PWM_CHANNELS[i]);
+    }
+    segmentRunning = false;
+  }
+#endif
+  if (!segmentBusy(now)) {
+    segmentRunning = false;
+  }
+  fading = false;
+}
+
+bool LampHardware::segmentBusy(unsigned long now) const {
+  return segmentRunning && (long)(now - segmentEndMs) < 0;
+}
+
+void LampHardware::startSegment(unsigned long now, uint32_t elapsed) {
+  uint32_t segmentEnd = fadeDurationMs;
+  if (MAX_SEGMENT_MS > 0 && fadeDurationMs - elapsed > MAX_SEGMENT_MS) {
+    segmentEnd = elapsed + MAX_SEGMENT_MS;
+  }
+  uint32_t segmentMs = segmentEnd - elapsed;
+
+  // The segment window is kept even if no channel moves in it, so the
+  // next one is scheduled at its end rather than polled for
+  segmentRunning = false;
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+    ChannelFade& f = fades[i];
+    if (!f.hardware || f.lastDuty == f.toDuty) continue;
+    segmentRunning = true;
+
+    uint32_t target = dutyAt(f, segmentEnd);
+    if (target == f.lastDuty) continue;
+
+    ledc_channel_t channel = (ledc_channel_t)PWM_CHANNELS[i];
+    ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, channel, target, (int)segmentMs);
+    ledc_fade_start(LEDC_LOW_SPEED_MODE, channel, LEDC_FADE_NO_WAIT);
+    f.lastDuty = target;
+  }
+  segmentEndMs = now + segmentMs;
+}
+
+uint32_t LampHardware::nextStepAt(const ChannelFade& f) const {
+  // Elapsed time at which the stepped duty moves past lastDuty
+  uint32_t delta = f.toDuty > f.fromDuty ? f.toDuty - f.fromDuty : f.fromDuty - f.toDuty;
+  uint32_t done = f.lastDuty > f.fromDuty ? f.lastDuty - f.fromDuty : f.fromDuty - f.lastDuty;
+  if (delta == 0 || done >= delta) return fadeDurationMs;
+  return (uint32_t)(((uint64_t)(done + 1) * fadeDurationMs + delta - 1) / delta);
+}
+
+uint32_t LampHardware::dutyAt(const ChannelFade& f, uint32_t elapsed) const {
+  if (elapsed >= fadeDurationMs) return f.toDuty;
+  int64_t delta = (int64_t)f.toDuty - (int64_t)f.fromDuty;
+  return (uint32_t)((int64_t)f.fromDuty + delta * elapsed / fadeDurationMs);
+}
+
+void LampHardware::setGamma(uint16_t gamma) {
+  if (gamma == 0) gamma = DEFAULT_GAMMA_X100;
+  if (gamma == gammaX100) return;
+  gammaX100 = gamma;
+  tableValid = false;
+}
+
+void LampHardware::setCurve(const uint16_t* pointsPermille, uint8_t count) {
+  if (!pointsPermille || count < 2) {
+    count = 0;
+  }
+  if (count > GAMMA_CURVE_MAX_POINTS) {
+    count = GAMMA_CURVE_MAX_POINTS;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    curve[i] = pointsPermille[i] > 1000 ? 1000 : pointsPermille[i];
+  }
+  curveCount = count;
+  tableValid = false;
+}
+
+void LampHardware::ensureTable(uint8_t minPwm, uint8_t maxPwm) {
+  if (tableValid && minPwm == tableMinPwm && maxPwm == tableMaxPwm) {
     return;
   }
 
-  float physicalPercent = logicalToPhysical(brightness, minPwmPercent, maxPwmPercent);
-  
-  // Apply gamma correction (2.2) for perceptually linear brightness
-  float gammaPercent = pow(physicalPercent, 2.2f);
-  
-  uint8_t adjR = (uint8_t)round(r * gammaPercent);
-  uint8_t adjG = (uint8_t)round(g * gammaPercent);
-  uint8_t adjB = (uint8_t)round(b * gammaPercent);
+  if (minPwm == FACTORY_MIN_PWM && maxPwm == FACTORY_MAX_PWM &&
+      gammaX100 == DEFAULT_GAMMA_X100 && curveCount == 0) {
+    memcpy(scaleTable, FACTORY_SCALE_TABLE, sizeof(scaleTable));
+  } else {
+    buildScaleTable(scaleTable, minPwm, maxPwm, gammaX100, curve, curveCount);
+  }
+
+  tableMinPwm = minPwm;
+  tableMaxPwm = maxPwm;
+  tableValid = true;
+}
 
+uint32_t LampHardware::channelDuty(uint8_t color, uint16_t scale) const {
+  // Color scaled to 8 bits first, then to the PWM resolution
+  uint32_t adjusted = ((uint32_t)color * scale + 16384) >> 15;
+  if (PWM_BITS == 8) {
+    return adjusted;
+  }
   uint32_t maxDuty = (1UL << PWM_BITS) - 1;
-  uint32_t dutyR = (uint32_t)round((adjR / 255.0f) * maxDuty);
-  uint32_t dutyG = (uint32_t)round((adjG / 255.0f) * maxDuty);
-  uint32_t dutyB = (uint32_t)round((adjB / 255.0f) * maxDuty);
+  return (adjusted * maxDuty + 127) / 255;
+}
 
-  ledcWrite(PWM_CHANNEL_RED,   dutyR);
-  ledcWrite(PWM_CHANNEL_GREEN, dutyG);
-  ledcWrite(PWM_CHANNEL_BLUE,  dutyB);
+void LampHardware::buildScaleTable(uint16_t* out, uint8_t minPwm, uint8_t maxPwm,
+                                   uint16_t gamma, const uint16_t* points, uint8_t count) {
+  float exponent = gamma / 100.0f;
 
-  // Serial output removed - was blocking loop
+  for (uint8_t logical = 0; logical <= 100; logical++) {
+    float physicalPercent = logicalToPhysical(logical, minPwm, maxPwm);
+    float level;
+
+    if (logical == 0) {
+      level = 0.0f;
+    } else if (points && count >= 2) {
+      // Piecewise-linear custom curve over the physical range
+      float pos = physicalPercent * (count - 1);
+      uint8_t i = (uint8_t)pos;
+      if (i >= count - 1) i = count - 2;
+      float t = pos - i;
+      level = (points[i] + (points[i + 1] - (float)points[i]) * t) / 1000.0f;
+    } else {
+      // Gamma correction for perceptually linear brightness
+      level = pow(physicalPercent, exponent);
+    }
+
+    if (level < 0.0f) level = 0.0f;
+    if (level > 1.0f) level = 1.0f;
+    out[logical] = (uint16_t)round(level * 32768.0f);
+  }
 }
 
 float LampHardware::logicalToPhysical(uint8_t logical, uint8_t minPwm, uint8_t maxPwm) {
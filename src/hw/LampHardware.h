@@ -2,6 +2,7 @@
 #define LAMP_HARDWARE_H
 
 #include <Arduino.h>
+#include "Clock.h"
 
 /**
  * Hardware abstraction for PWM-driven RGB LED lamp.
@@ -10,9 +11,14 @@
  * - Initialize PWM channels
  * - Apply brightness and color to physical LEDs
  * - Map logical brightness to physical PWM range
+ * - Cache the brightness → duty curve per calibration
+ * - Run timed transitions on the LEDC hardware fade unit
  */
 class LampHardware {
 public:
+  static const uint8_t  GAMMA_CURVE_MAX_POINTS = 17;
+  static const uint16_t DEFAULT_GAMMA_X100 = 220;
+
   LampHardware();
 
   /**
@@ -24,6 +30,10 @@ public:
   /**
    * Apply state to physical LEDs.
    * 
+   * Uses a precomputed brightness → scale table, so a frame costs a few
+   * integer multiply-shifts. The table is rebuilt only when the PWM
+   * calibration or gamma curve changes.
+   * 
    * @param power        True = lamp on, false = all LEDs off
    * @param brightness   Logical brightness (0-100)
    * @param r,g,b        Base RGB color values (0-255)
@@ -34,6 +44,79 @@ public:
              uint8_t r, uint8_t g, uint8_t b,
              uint8_t minPwmPercent, uint8_t maxPwmPercent);
 
+  /**
+   * Fade from the current output to a new state.
+   * 
+   * Channels are handed to the LEDC fade unit, so the ramp stays even
+   * regardless of loop jitter and the CPU only wakes at segment
+   * boundaries. Channels changing slower than the fade unit can step
+   * are stepped by update() instead, one duty step at a time.
+   * 
+   * A later apply() or fadeTo() replaces a running fade.
+   * 
+   * @param durationMs Fade length (0 = immediate, same as apply())
+   */
+  void fadeTo(bool power, uint8_t brightness,
+              uint8_t r, uint8_t g, uint8_t b,
+              uint8_t minPwmPercent, uint8_t maxPwmPercent,
+              uint32_t durationMs);
+
+  /**
+   * Advance a running fade: start the next hardware segment, step slow
+   * channels and land deferred writes. Call in loop().
+   */
+  void update();
+
+  /**
+   * Check if a fade is still in progress.
+   */
+  bool isFading() const;
+
+  /**
+   * Time until update() has work to do (next segment or duty step).
+   * 
+   * @return Milliseconds (0 = now), Clock::NO_DEADLINE when no fade runs
+   */
+  unsigned long msUntilUpdate() const;
+
+  /**
+   * Check if any channel is driven (or about to be).
+   * The LEDC timer stops in light sleep, so the lamp must stay awake.
+   */
+  bool isLit() const;
+
+  /**
+   * Replace the time source (host tests use a VirtualClock).
+   */
+  void setClock(const Clock* clock);
+
+  /**
+   * Set gamma exponent used when no custom curve is loaded.
+   * 
+   * @param gammaX100 Exponent * 100 (e.g. 220 = 2.2)
+   */
+  void setGamma(uint16_t gammaX100);
+
+  /**
+   * Load a custom transfer curve replacing the gamma exponent.
+   * 
+   * Points are evenly spaced over the physical PWM range and give the
+   * output level in permille (0-1000); values in between are linearly
+   * interpolated.
+   * 
+   * @param pointsPermille Curve points, or nullptr to return to gamma
+   * @param count Number of points (2..GAMMA_CURVE_MAX_POINTS, 0 = none)
+   */
+  void setCurve(const uint16_t* pointsPermille, uint8_t count);
+
+  /**
+   * Fill a brightness → Q15 scale table for the given calibration.
+   * 
+   * @param out Table with 101 entries (logical brightness 0-100)
+   */
+  static void buildScaleTable(uint16_t* out, uint8_t minPwmPercent, uint8_t maxPwmPercent,
+                              uint16_t gammaX100, const uint16_t* curve, uint8_t curveCount);
+
 private:
   static const uint8_t PIN_RED   = 1;
   static const uint8_t PIN_GREEN = 4;
@@ -46,11 +129,59 @@ private:
   static const uint16_t PWM_FREQ = 5000;  // Hz
   static const uint8_t  PWM_BITS = 8;     // 0-255 duty
 
+  static const uint8_t  CHANNEL_COUNT = 3;
+  static const uint8_t  PWM_CHANNELS[CHANNEL_COUNT];      // Red, green, blue
+  static const uint16_t FADE_MAX_CYCLES_PER_STEP = 1023;  // LEDC duty_cycle field limit
+
+  const Clock* clock;
+
+  // One channel of a running fade
+  struct ChannelFade {
+    uint32_t fromDuty;
+    uint32_t toDuty;
+    uint32_t lastDuty;   // Last duty written or handed to the fade unit
+    bool     hardware;   // Driven by the fade unit (else stepped in update())
+  };
+
+  ChannelFade   fades[CHANNEL_COUNT];
+  bool          fading;
+  unsigned long fadeStartMs;
+  uint32_t      fadeDurationMs;
+  bool          segmentRunning;   // Hardware segment in flight
+  unsigned long segmentEndMs;
+
+  // Immediate write waiting for a hardware segment that cannot be stopped
+  bool          pendingWrite;
+  uint32_t      pendingDuty[CHANNEL_COUNT];
+
+  bool          lit;              // Last written or targeted duty is non-zero
+
+  // Active brightness → scale table (Q15, 32768 = full duty)
+  uint16_t scaleTable[101];
+  bool     tableValid;
+  uint8_t  tableMinPwm;
+  uint8_t  tableMaxPwm;
+
+  uint16_t gammaX100;
+  uint16_t curve[GAMMA_CURVE_MAX_POINTS];
+  uint8_t  curveCount;
+
+  void ensureTable(uint8_t minPwm, uint8_t maxPwm);
+  uint32_t channelDuty(uint8_t color, uint16_t scale) const;
+  void computeDuties(bool power, uint8_t brightness, uint8_t r, uint8_t g, uint8_t b,
+                     uint8_t minPwm, uint8_t maxPwm, uint32_t* duties);
+  void writeDuties(const uint32_t* duties);
+  void cancelFade(unsigned long now);
+  bool segmentBusy(unsigned long now) const;
+  void startSegment(unsigned long now, uint32_t elapsed);
+  uint32_t dutyAt(const ChannelFade& fade, uint32_t elapsed) const;
+  uint32_t nextStepAt(const ChannelFade& fade) const;
+
   /**
    * Map logical brightness (0-100) to physical PWM percentage.
    * Accounts for minimum PWM needed to light LEDs.
    */
-  float logicalToPhysical(uint8_t logical, uint8_t minPwm, uint8_t maxPwm);
+  static float logicalToPhysical(uint8_t logical, uint8_t minPwm, uint8_t maxPwm);
 };
 
 #endif // LAMP_HARDWARE_H
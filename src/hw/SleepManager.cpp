@@ -0,0 +1,152 @@
+#include "SleepManager.h"
+
+#include <sys/select.h>
+#include <unistd.h>
+
+#ifdef NATIVE_BUILD
+#include <sys/eventfd.h>
+#else
+#include "esp_vfs_eventfd.h"
+#include "esp_timer.h"
+#include "esp32c3/pm.h"
+#endif
+
+namespace {
+
+int64_t monotonicMicros() {
+#ifdef NATIVE_BUILD
+  return (int64_t)micros();
+#else
+  return esp_timer_get_time();
+#endif
+}
+
+}  // namespace
+
+SleepManager::SleepManager()
+  : wakeFd(-1), lightSleep(false), lockHeld(false) {
+#if !defined(NATIVE_BUILD) && CONFIG_PM_ENABLE
+  litLock = nullptr;
+#endif
+}
+
+SleepManager::~SleepManager() {
+  if (wakeFd >= 0) close(wakeFd);
+}
+
+void SleepManager::begin(bool managePower) {
+#ifdef NATIVE_BUILD
+  wakeFd = eventfd(0, EFD_NONBLOCK);
+#else
+  // Registering again from a second instance is harmless
+  esp_vfs_eventfd_config_t eventfdConfig = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+  esp_vfs_eventfd_register(&eventfdConfig);
+  wakeFd = eventfd(0, EFD_SUPPORT_ISR);
+#endif
+
+  if (managePower) {
+    // The mode actually in effect, so idle power can be checked from the
+    // serial console
+    Serial.printf("[PWR] Power mode: %s\n", configurePower());
+  }
+
+  if (wakeFd < 0) {
+    Serial.println("[PWR] Wake event unavailable, falling back to timed sleep");
+  }
+}
+
+const char* SleepManager::configurePower() {
+#ifdef NATIVE_BUILD
+  return "select() sleep only (native build)";
+#elif CONFIG_PM_ENABLE
+  esp_pm_config_esp32c3_t pmConfig;
+  pmConfig.max_freq_mhz = getCpuFrequencyMhz();
+  pmConfig.min_freq_mhz = 40;  // XTAL
+  pmConfig.light_sleep_enable = true;
+
+  esp_err_t err = esp_pm_configure(&pmConfig);
+  if (err == ESP_ERR_NOT_SUPPORTED) {
+    // Tickless idle not compiled in: frequency scaling only
+    pmConfig.light_sleep_enable = false;
+    err = esp_pm_configure(&pmConfig);
+  } else if (err == ESP_OK) {
+    lightSleep = true;
+  }
+
+  if (err != ESP_OK) {
+    return "select() sleep only (esp_pm_configure failed)";
+  }
+  esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "lamp_lit", &litLock);
+  return lightSleep ? "DFS and automatic light sleep"
+                    : "DFS only (framework built without tickless idle)";
+#else
+  return "select() sleep only (framework built without CONFIG_PM_ENABLE)";
+#endif
+}
+
+unsigned long SleepManager::sleep(unsigned long timeoutMs, int socketFd, bool waitWritable,
+                                  int auxFd) {
+  if (timeoutMs == 0) return 0;
+
+  int64_t start = monotonicMicros();
+
+  if (wakeFd < 0 && socketFd < 0 && auxFd < 0) {
+    delay(timeoutMs);
+    return (unsigned long)(monotonicMicros() - start);
+  }
+
+  fd_set readSet;
+  fd_set writeSet;
+  FD_ZERO(&readSet);
+  FD_ZERO(&writeSet);
+  int maxFd = -1;
+  if (wakeFd >= 0) {
+    FD_SET(wakeFd, &readSet);
+    maxFd = wakeFd;
+  }
+  if (socketFd >= 0) {
+    FD_SET(socketFd, &readSet);
+    if (waitWritable) FD_SET(socketFd, &writeSet);
+    if (socketFd > maxFd) maxFd = socketFd;
+  }
+  if (auxFd >= 0) {
+    FD_SET(auxFd, &readSet);
+    if (auxFd > maxFd) maxFd = auxFd;
+  }
+
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+  int ready = select(maxFd + 1, &readSet, &writeSet, nullptr, &tv);
+  if (ready > 0 && wakeFd >= 0 && FD_ISSET(wakeFd, &readSet)) {
+    uint64_t count;
+    read(wakeFd, &count, sizeof(count));  // Reset the event
+  }
+
+  return (unsigned long)(monotonicMicros() - start);
+}
+
+void SleepManager::wake() {
+  if (wakeFd < 0) return;
+  uint64_t one = 1;
+  write(wakeFd, &one, sizeof(one));
+}
+
+void SleepManager::setLightSleepAllowed(bool allowed) {
+  if (allowed == !lockHeld) return;
+  lockHeld = !allowed;
+
+#if !defined(NATIVE_BUILD) && CONFIG_PM_ENABLE
+  if (!litLock) return;
+  if (lockHeld) {
+    esp_pm_lock_acquire(litLock);
+  } else {
+    esp_pm_lock_release(litLock);
+  }
+#endif
+}
+
+bool SleepManager::lightSleepAvailable() const {
+  return lightSleep;
+}
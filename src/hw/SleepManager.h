@@ -0,0 +1,84 @@
+#ifndef SLEEP_MANAGER_H
+#define SLEEP_MANAGER_H
+
+#include <Arduino.h>
+
+#ifndef NATIVE_BUILD
+#include "esp_pm.h"
+#endif
+
+/**
+ * Idle handling for the main loop.
+ *
+ * Responsibilities:
+ * - Block the loop until a deadline, a wake() call or socket data
+ * - Configure ESP-IDF power management (DFS + automatic light sleep) as far
+ *   as the framework build allows, and log the mode in effect
+ * - Keep the APB clock pinned while the LEDs are lit
+ *
+ * While the loop task is blocked the FreeRTOS idle task runs, which lets
+ * the power manager drop into automatic light sleep when no lock is held.
+ * LEDC PWM runs from the APB clock, so light sleep and frequency scaling
+ * are only allowed while the lamp is dark.
+ */
+class SleepManager {
+public:
+  SleepManager();
+  ~SleepManager();
+
+  /**
+   * Create the wake event and, for the main loop's instance, configure
+   * power management. Call once in setup().
+   *
+   * @param managePower False for other tasks' instances, which only
+   *                    need sleep() and wake()
+   */
+  void begin(bool managePower = true);
+
+  /**
+   * Block until the timeout expires, wake() is called, or socketFd
+   * becomes readable (or writable, if asked).
+   *
+   * @param timeoutMs Maximum time to block (0 = just poll)
+   * @param socketFd Socket to watch for incoming data, -1 for none
+   * @param waitWritable Also return once socketFd is writable
+   *                     (a non-blocking connect finished)
+   * @param auxFd Second socket to watch for incoming data, -1 for none
+   * @return Microseconds actually spent blocked
+   */
+  unsigned long sleep(unsigned long timeoutMs, int socketFd = -1, bool waitWritable = false,
+                      int auxFd = -1);
+
+  /**
+   * Cut the current (or next) sleep short.
+   * Safe to call from other tasks and from interrupt handlers.
+   */
+  void wake();
+
+  /**
+   * Allow or forbid light sleep and frequency scaling.
+   *
+   * @param allowed False while PWM outputs are active
+   */
+  void setLightSleepAllowed(bool allowed);
+
+  /**
+   * Check if automatic light sleep could be enabled on this build.
+   */
+  bool lightSleepAvailable() const;
+
+private:
+  int wakeFd;
+  bool lightSleep;
+  bool lockHeld;
+#if !defined(NATIVE_BUILD) && CONFIG_PM_ENABLE
+  esp_pm_lock_handle_t litLock;
+#endif
+
+  /**
+   * @return The power mode now in effect, for the log
+   */
+  const char* configurePower();
+};
+
+#endif // SLEEP_MANAGER_H
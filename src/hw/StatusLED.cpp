@@ -1,42 +1,53 @@
 #include "StatusLED.h"
 
-StatusLED::StatusLED() {
+StatusLED::StatusLED()
+  : head(0), tail(0), running(false), stepIndex(0), playing(false) {
+  lastQueued.length = 0;
+  current.length = 0;
+#ifndef NATIVE_BUILD
+  timer = nullptr;
+  producerLock = portMUX_INITIALIZER_UNLOCKED;
+#else
+  producerLock.clear();
+#endif
 }
 
 void StatusLED::begin() {
   pinMode(PIN_LED, OUTPUT);
   digitalWrite(PIN_LED, HIGH);  // HIGH = OFF (inverted logic)
+
+#ifndef NATIVE_BUILD
+  esp_timer_create_args_t args = {};
+  args.callback = timerCallback;
+  args.arg = this;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "status_led";
+  esp_timer_create(&args, &timer);
+#endif
+
   Serial.println("[LED] Status LED initialized on GPIO 8 (inverted)");
 }
 
 void StatusLED::blink(uint8_t count, uint16_t delayMs) {
-  // Quick non-blocking blink
-  for (uint8_t i = 0; i < count; i++) {
-    digitalWrite(PIN_LED, LOW);   // LOW = ON (inverted)
-    delayMicroseconds(delayMs * 1000);  // Non-blocking for short delays
-    digitalWrite(PIN_LED, HIGH);  // HIGH = OFF (inverted)
-    if (i < count - 1) {
-      delayMicroseconds(delayMs * 1000);
-    }
+  if (count == 0) return;
+  if (count > MAX_STEPS / 2) count = MAX_STEPS / 2;
+
+  Pattern pattern;
+  pattern.length = count * 2 - 1;  // No trailing off step
+  for (uint8_t i = 0; i < pattern.length; i++) {
+    pattern.stepsMs[i] = delayMs;
   }
+  play(pattern);
 }
 
 void StatusLED::startupAnimation() {
   Serial.println("[LED] Startup animation");
-  // Quick startup blinks - acceptable to block during setup
-  for (uint8_t i = 0; i < 3; i++) {
-    digitalWrite(PIN_LED, LOW);   // LOW = ON (inverted)
-    delay(100);  // Shorter delay
-    digitalWrite(PIN_LED, HIGH);  // HIGH = OFF (inverted)
-    delay(100);
-  }
+  blink(3, 100);
 }
 
 void StatusLED::wifiConnecting() {
-  // Single quick pulse - non-blocking
-  digitalWrite(PIN_LED, LOW);   // LOW = ON (inverted)
-  delayMicroseconds(50000);     // 50ms
-  digitalWrite(PIN_LED, HIGH);  // HIGH = OFF (inverted)
+  // Single quick pulse
+  blink(1, 50);
 }
 
 void StatusLED::wifiConnected() {
@@ -52,10 +63,8 @@ void StatusLED::wifiFailed() {
 }
 
 void StatusLED::mqttConnecting() {
-  // Single quick pulse - non-blocking
-  digitalWrite(PIN_LED, LOW);   // LOW = ON (inverted)
-  delayMicroseconds(30000);     // 30ms
-  digitalWrite(PIN_LED, HIGH);  // HIGH = OFF (inverted)
+  // Single quick pulse
+  blink(1, 30);
 }
 
 void StatusLED::mqttConnected() {
@@ -66,14 +75,95 @@ void StatusLED::mqttConnected() {
 
 void StatusLED::mqttFailed() {
   Serial.println("[LED] MQTT failed");
-  // Quick error indication
-  digitalWrite(PIN_LED, LOW);   // LOW = ON (inverted)
-  delayMicroseconds(200000);    // 200ms
-  digitalWrite(PIN_LED, HIGH);  // HIGH = OFF (inverted)
-  delayMicroseconds(50000);
-  blink(3, 40);  // Fast blinks
+  // Long blink, then three fast blinks
+  static const Pattern FAILED = { 7, { 200, 50, 40, 40, 40, 40, 40 } };
+  play(FAILED);
 }
 
 void StatusLED::set(bool on) {
   digitalWrite(PIN_LED, on ? LOW : HIGH);  // Inverted logic
 }
+
+bool StatusLED::isBusy() const {
+  return running.load(std::memory_order_acquire);
+}
+
+void StatusLED::play(const Pattern& pattern) {
+#ifndef NATIVE_BUILD
+  portENTER_CRITICAL(&producerLock);
+  bool queued = enqueue(pattern);
+  portEXIT_CRITICAL(&producerLock);
+#else
+  while (producerLock.test_and_set(std::memory_order_acquire)) {}
+  bool queued = enqueue(pattern);
+  producerLock.clear(std::memory_order_release);
+#endif
+  if (!queued) return;
+
+  // Idle: the timer is not armed, so start the first step from here
+  if (!running.exchange(true, std::memory_order_acq_rel)) {
+    onTimer();
+  }
+}
+
+bool StatusLED::enqueue(const Pattern& pattern) {
+  bool same = pattern.length == lastQueued.length &&
+              memcmp(pattern.stepsMs, lastQueued.stepsMs, pattern.length * sizeof(uint16_t)) == 0;
+  if (same && !queueEmpty()) return false;  // Already waiting to be shown
+
+  uint8_t h = head.load(std::memory_order_relaxed);
+  uint8_t next = (h + 1) & (QUEUE_SIZE - 1);
+  if (next == tail.load(std::memory_order_acquire)) return false;  // Full: drop
+
+  queue[h] = pattern;
+  lastQueued = pattern;
+  head.store(next, std::memory_order_release);
+  return true;
+}
+
+void StatusLED::onTimer() {
+  while (true) {
+    if (!playing) {
+      if (queueEmpty()) {
+        set(false);
+        running.store(false, std::memory_order_release);
+        // A pattern queued while going idle would otherwise be stranded
+        if (queueEmpty() || running.exchange(true, std::memory_order_acq_rel)) return;
+        continue;
+      }
+      uint8_t t = tail.load(std::memory_order_relaxed);
+      current = queue[t];
+      tail.store((t + 1) & (QUEUE_SIZE - 1), std::memory_order_release);
+      stepIndex = 0;
+      playing = true;
+    }
+
+    if (stepIndex < current.length) {
+      set(stepIndex % 2 == 0);  // Even steps are on
+      schedule(current.stepsMs[stepIndex++]);
+      return;
+    }
+
+    // Pattern done: keep the LED dark briefly so patterns stay distinct
+    playing = false;
+    set(false);
+    if (!queueEmpty()) {
+      schedule(PATTERN_GAP_MS);
+      return;
+    }
+  }
+}
+
+void StatusLED::schedule(uint16_t ms) {
+#ifndef NATIVE_BUILD
+  if (timer) esp_timer_start_once(timer, (uint64_t)ms * 1000ULL);
+#endif
+}
+
+bool StatusLED::queueEmpty() const {
+  return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+}
+
+void StatusLED::timerCallback(void* arg) {
+  ((StatusLED*)arg)->onTimer();
+}
@@ -2,29 +2,40 @@
 #define STATUS_LED_H
 
 #include <Arduino.h>
+#include <atomic>
+
+#ifndef NATIVE_BUILD
+#include "esp_timer.h"
+#endif
 
 /**
  * Status LED for visual feedback.
- * 
+ *
  * Uses internal LED (GPIO 8) to indicate:
  * - Startup sequence
  * - Button presses
  * - MQTT command received
+ *
+ * Patterns are queued and played by a one-shot esp_timer, so every call
+ * returns immediately. A pattern identical to one still waiting in the
+ * queue is dropped, and so is any pattern arriving while the queue is full.
+ * Both the render loop and the network task queue patterns; the short
+ * enqueue step is serialised, playback stays lock-free.
  */
 class StatusLED {
 public:
   StatusLED();
 
   /**
-   * Initialize LED pin.
+   * Initialize LED pin and the pattern timer.
    */
   void begin();
 
   /**
    * Quick blink for visual feedback.
-   * 
-   * @param count Number of blinks (default 1)
-   * @param delayMs Delay between blinks in ms (default 100)
+   *
+   * @param count Number of blinks (default 1, max MAX_STEPS / 2)
+   * @param delayMs On and off time of each blink in ms (default 100)
    */
   void blink(uint8_t count = 1, uint16_t delayMs = 100);
 
@@ -65,11 +76,60 @@ public:
 
   /**
    * Set LED state directly.
+   * Only meaningful while no pattern is playing.
    */
   void set(bool on);
 
+  /**
+   * Check if a pattern is playing or queued.
+   */
+  bool isBusy() const;
+
+  /**
+   * Play the next pattern step. Called from the esp_timer task; host
+   * tests call it directly to step through patterns.
+   */
+  void onTimer();
+
+  static const uint8_t MAX_STEPS = 16;
+
 private:
   static const uint8_t PIN_LED = 8;
+  static const uint8_t QUEUE_SIZE = 4;            // Power of two
+  static const uint16_t PATTERN_GAP_MS = 150;     // Dark time between patterns
+
+  /**
+   * Alternating on/off durations, starting with on.
+   */
+  struct Pattern {
+    uint8_t length;
+    uint16_t stepsMs[MAX_STEPS];
+  };
+
+  // Pattern ring: head written by callers (under producerLock), tail by the timer
+  Pattern queue[QUEUE_SIZE];
+  std::atomic<uint8_t> head;
+  std::atomic<uint8_t> tail;
+  std::atomic<bool> running;
+  Pattern lastQueued;
+
+  // Owned by the timer side
+  Pattern current;
+  uint8_t stepIndex;
+  bool playing;
+
+#ifndef NATIVE_BUILD
+  esp_timer_handle_t timer;
+  portMUX_TYPE producerLock;
+#else
+  std::atomic_flag producerLock;
+#endif
+
+  bool enqueue(const Pattern& pattern);
+  void play(const Pattern& pattern);
+  void schedule(uint16_t ms);
+  bool queueEmpty() const;
+  static void timerCallback(void* arg);
 };
 
 #endif // STATUS_LED_H
@@ -0,0 +1,38 @@
+#include "WallClock.h"
+
+WallClock::WallClock()
+  : clock(&Clock::system()), isSynced(false), baseLocalMs(0), baseEpochMs(0),
+    correctionMs(0), rttMs(0) {
+}
+
+uint64_t WallClock::epochAt(uint32_t localMs) const {
+  // Signed: a sync may describe an instant just before the base
+  int32_t delta = (int32_t)(localMs - baseLocalMs);
+  return baseEpochMs + (int64_t)delta;
+}
+
+void WallClock::apply(const Sync& sync) {
+  if (isSynced) {
+    int64_t diff = (int64_t)(sync.epochMs - epochAt(sync.localMs));
+    if (diff > INT32_MAX) diff = INT32_MAX;
+    if (diff < INT32_MIN) diff = INT32_MIN;
+    correctionMs = (int32_t)diff;
+  }
+  baseLocalMs = sync.localMs;
+  baseEpochMs = sync.epochMs;
+  rttMs = sync.rttMs;
+  isSynced = true;
+}
+
+uint64_t WallClock::now() const {
+  if (!isSynced) return 0;
+  return baseEpochMs + (uint32_t)((uint32_t)clock->millis() - baseLocalMs);
+}
+
+unsigned long WallClock::msUntil(uint64_t epochMs) const {
+  if (!isSynced) return Clock::NO_DEADLINE;
+  uint64_t current = now();
+  if (epochMs <= current) return 0;
+  uint64_t wait = epochMs - current;
+  return wait >= Clock::NO_DEADLINE ? Clock::NO_DEADLINE - 1 : (unsigned long)wait;
+}
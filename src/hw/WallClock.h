@@ -0,0 +1,79 @@
+#ifndef WALL_CLOCK_H
+#define WALL_CLOCK_H
+
+#include <Arduino.h>
+#include "Clock.h"
+
+/**
+ * Wall-clock time (Unix epoch, milliseconds) derived from time syncs.
+ *
+ * Responsibilities:
+ * - Map the monotonic millisecond counter to epoch time
+ * - Take sync results (from SntpClient) and report how far the local
+ *   estimate had drifted from them
+ * - Convert an epoch deadline into a sleep time for the loop
+ *
+ * Each sync steps the clock to the new estimate; between syncs time runs
+ * on the local oscillator. Epoch times are 64-bit, local times are
+ * millis() values, so a sync must arrive at least every 49 days.
+ */
+class WallClock {
+public:
+  /**
+   * One sync result: the epoch time at a local instant.
+   */
+  struct Sync {
+    uint32_t localMs;   // Clock::millis() at the instant
+    uint64_t epochMs;   // Epoch time at that instant
+    uint16_t rttMs;     // Round trip of the exchange (accuracy bound)
+  };
+
+  WallClock();
+
+  /**
+   * Adopt a sync result.
+   */
+  void apply(const Sync& sync);
+
+  /**
+   * Check if at least one sync was applied.
+   */
+  bool synced() const { return isSynced; }
+
+  /**
+   * Current epoch time.
+   *
+   * @return Milliseconds since 1970, 0 before the first sync
+   */
+  uint64_t now() const;
+
+  /**
+   * Time until an epoch instant.
+   *
+   * @return Milliseconds (0 = reached), Clock::NO_DEADLINE before the
+   *         first sync
+   */
+  unsigned long msUntil(uint64_t epochMs) const;
+
+  /**
+   * Difference between the last sync and the local estimate it replaced
+   * (positive = local clock was behind). 0 for the first sync.
+   */
+  int32_t lastCorrectionMs() const { return correctionMs; }
+
+  uint16_t lastRttMs() const { return rttMs; }
+
+  void setClock(const Clock* c) { clock = c; }
+
+private:
+  const Clock* clock;
+  bool isSynced;
+  uint32_t baseLocalMs;
+  uint64_t baseEpochMs;
+  int32_t correctionMs;
+  uint16_t rttMs;
+
+  uint64_t epochAt(uint32_t localMs) const;
+};
+
+#endif // WALL_CLOCK_H
@@ -5,11 +5,27 @@
 #include "hw/LampHardware.h"
 #include "hw/Button.h"
 #include "hw/StatusLED.h"
+#include "hw/SleepManager.h"
+#include "hw/WallClock.h"
+#include "hw/FlashRegion.h"
 #include "state/DeviceState.h"
 #include "state/DeviceConfig.h"
 #include "state/SystemMonitor.h"
+#include "state/FrameStats.h"
+#include "state/BootTimeline.h"
+#include "state/StateJournal.h"
 #include "net/WiFiManager.h"
 #include "net/MqttManager.h"
+#include "net/MessageView.h"
+#include "net/JsonReader.h"
+#include "net/CommandQueue.h"
+#include "net/CommandScheduler.h"
+#include "net/TopicRouter.h"
+#include "net/TopicTable.h"
+#include "net/NetworkTask.h"
+#include "net/SntpClient.h"
+#include "net/FrameStream.h"
+#include "net/PhaseGroup.h"
 #include "anim/AnimationEngine.h"
 
 // ======================= MODULE INSTANCES ===================
@@ -23,6 +39,16 @@ SystemMonitor sysmon;
 WiFiManager wifi;
 MqttManager mqtt;
 AnimationEngine anim;
+SleepManager sleeper;
+SntpClient sntp;
+WallClock wallClock;
+CommandScheduler scheduler;
+NetworkTask network(wifi, mqtt, sntp);
+FrameStream stream;
+PhaseGroup phaseGroup;
+BootTimeline bootTimeline;
+PartitionFlash journalFlash;
+StateJournal journal;
 
 // ======================= CONFIG FLAGS =======================
 
@@ -33,12 +59,37 @@ bool configDirty = false;
 unsigned long lastStatePublish = 0;
 const unsigned long STATE_PUBLISH_INTERVAL_MS = 10000;  // Every 10s (reduced to lower MQTT load)
 
+// Commands only queue publishes; each topic goes out at most this often
+const unsigned long PUBLISH_MIN_INTERVAL_MS = 100;
+
 unsigned long lastDiagnosticsPublish = 0;
 const unsigned long DIAGNOSTICS_PUBLISH_INTERVAL_MS = 30000;  // Every 30s (reduced from 10s)
 
 unsigned long lastHeartbeat = 0;
 const unsigned long HEARTBEAT_INTERVAL_MS = 10000;  // Every 10s (reduced from 5s)
 
+bool bootReported = false;  // Boot timeline sent (once per boot)
+
+// ======================= STATE JOURNAL ======================
+
+// Data partition holding the journal (see partitions.csv)
+const char* const JOURNAL_PARTITION = "journal";
+
+// ======================= LOOP TIMING ========================
+
+unsigned long lastHardwareUpdate = 0;
+const unsigned long HARDWARE_UPDATE_INTERVAL_MS = 33;  // Max 30 updates/sec
+
+// Upper bound on one sleep so the watchdog is fed and missed edge cases recover
+const unsigned long MAX_SLEEP_MS = 1000;
+
+// Render loop outranks the network task, which cannot delay a frame
+const UBaseType_t RENDER_TASK_PRIORITY = 2;
+
+// Busy time of one loop iteration beyond this counts as an overrun
+const uint32_t FRAME_BUDGET_US = 16000;  // One rainbow frame
+FrameStats frameStats(FRAME_BUDGET_US);
+
 // ======================= STATE CHANGE TRACKING ==============
 
 struct LastAppliedState {
@@ -46,608 +97,888 @@ struct LastAppliedState {
   uint8_t brightness = 0;
   uint8_t r = 0, g = 0, b = 0;
   uint8_t minPwm = 0, maxPwm = 0;
+  bool valid = false;
   
   bool hasChanged(bool power, uint8_t bri, uint8_t red, uint8_t green, uint8_t blue, uint8_t minP, uint8_t maxP) {
-    return powerOn != power || brightness != bri || r != red || g != green || b != blue || minPwm != minP || maxPwm != maxP;
+    return !valid || powerOn != power || brightness != bri || r != red || g != green || b != blue || minPwm != minP || maxPwm != maxP;
   }
   
   void update(bool power, uint8_t bri, uint8_t red, uint8_t green, uint8_t blue, uint8_t minP, uint8_t maxP) {
     powerOn = power; brightness = bri; r = red; g = green; b = blue; minPwm = minP; maxPwm = maxP;
+    valid = true;
   }
+
+  // Force the next loop to re-apply (e.g. transfer curve changed)
+  void invalidate() { valid = false; }
 };
 
 LastAppliedState lastApplied;
 
-// ======================= MQTT MESSAGE HANDLER ===============
+// Push the configured brightness curve into the hardware layer
+void applyBrightnessCurve() {
+  lamp.setGamma(config.gammaX100);
+  lamp.setCurve(config.gammaCurve, config.gammaCurveLen);
+  lastApplied.invalidate();
+}
 
-void handleMqttMessage(const String& topic, const String& msg) {
-  statusLED.blink(1, 30);  // Quick blink on MQTT command
-  
-  String lower = msg;
-  lower.toLowerCase();
-
-  // ---- Command: POWER ----
-  if (topic == "ikea_head_lamp/cmnd/power") {
-    if (lower == "toggle") {
-      state.togglePower();
-    } else if (lower == "on") {
-      state.powerOn = true;
-      state.bumpVersion();
-    } else if (lower == "off") {
-      state.powerOn = false;
-      state.bumpVersion();
-    }
+// ======================= MQTT MESSAGE HANDLERS ==============
 
-    if (state.powerOn && state.brightness == 0) {
-      state.brightness = config.defaultBrightness;
-      state.colorR = config.defaultColorR;
-      state.colorG = config.defaultColorG;
-      state.colorB = config.defaultColorB;
-    }
+// Routes "<base>/<suffix>" to the handlers below (device base set in setup())
+TopicRouter router(MqttManager::MQTT_BASE);
 
-    if (!state.powerOn) {
-      anim.stop();
-    }
+const uint32_t MAX_TRANSITION_MS = 3600000UL;  // 1 hour
 
-    mqtt.publishState(state, true);
-    return;
+// Optional ":transition_ms=N" suffix on brightness/color commands
+uint32_t parseTransitionMs(const MessageView& msg) {
+  int idx = msg.indexOf("transition_ms=");
+  if (idx < 0) return 0;
+  long v = msg.substring(idx + 14).toInt();
+  if (v < 0) v = 0;
+  if (v > (long)MAX_TRANSITION_MS) v = MAX_TRANSITION_MS;
+  return (uint32_t)v;
+}
+
+// "R,G,B" with each component clamped to 0-255
+bool parseRgb(const MessageView& text, uint8_t& r, uint8_t& g, uint8_t& b) {
+  int c1 = text.indexOf(',');
+  int c2 = text.indexOf(',', c1 + 1);
+  if (c1 <= 0 || c2 <= c1) return false;
+
+  long v[3] = {
+    text.substring(0, c1).toInt(),
+    text.substring(c1 + 1, c2).toInt(),
+    text.substring(c2 + 1).toInt()
+  };
+  for (uint8_t i = 0; i < 3; i++) {
+    if (v[i] < 0) v[i] = 0;
+    if (v[i] > 255) v[i] = 255;
   }
+  r = (uint8_t)v[0];
+  g = (uint8_t)v[1];
+  b = (uint8_t)v[2];
+  return true;
+}
 
-  // ---- Command: BRIGHTNESS ----
-  if (topic == "ikea_head_lamp/cmnd/brightness") {
-    int v = msg.toInt();
-    if (v < 0) v = 0;
-    if (v > 100) v = 100;
-    state.brightness = (uint8_t)v;
-    state.powerOn = (v > 0);
+// ---- Command: POWER ----
+void handlePower(const MessageView& msg) {
+  if (msg.equalsIgnoreCase("toggle")) {
+    state.togglePower();
+  } else if (msg.equalsIgnoreCase("on")) {
+    state.powerOn = true;
+    state.bumpVersion();
+  } else if (msg.equalsIgnoreCase("off")) {
+    state.powerOn = false;
     state.bumpVersion();
-    mqtt.publishState(state, true);
-    return;
   }
 
-  // ---- Command: COLOR (R,G,B) ----
-  if (topic == "ikea_head_lamp/cmnd/color") {
-    int r = 0, g = 0, b = 0;
-    int firstComma  = msg.indexOf(',');
-    int secondComma = msg.indexOf(',', firstComma + 1);
+  if (state.powerOn && state.brightness == 0) {
+    state.brightness = config.defaultBrightness;
+    state.colorR = config.defaultColorR;
+    state.colorG = config.defaultColorG;
+    state.colorB = config.defaultColorB;
+  }
 
-    if (firstComma > 0 && secondComma > firstComma) {
-      r = msg.substring(0, firstComma).toInt();
-      g = msg.substring(firstComma + 1, secondComma).toInt();
-      b = msg.substring(secondComma + 1).toInt();
+  if (!state.powerOn) {
+    anim.stop();
+  }
 
-      if (r < 0) r = 0; if (r > 255) r = 255;
-      if (g < 0) g = 0; if (g > 255) g = 255;
-      if (b < 0) b = 0; if (b > 255) b = 255;
+  mqtt.queueState(state, true);
+}
 
-      state.colorR = (uint8_t)r;
-      state.colorG = (uint8_t)g;
-      state.colorB = (uint8_t)b;
-      state.bumpVersion();
+// ---- Command: BRIGHTNESS ----
+void handleBrightness(const MessageView& msg) {
+  // Format: "50" or "50:transition_ms=2000"
+  long v = msg.toInt();
+  if (v < 0) v = 0;
+  if (v > 100) v = 100;
+  state.brightness = (uint8_t)v;
+  state.powerOn = (v > 0);
+  state.transitionMs = parseTransitionMs(msg);
+  state.bumpVersion();
+  mqtt.queueState(state, true);
+}
 
-      mqtt.publishState(state, true);
-    }
-    return;
+// ---- Command: COLOR (R,G,B) ----
+void handleColor(const MessageView& msg) {
+  // Format: "R,G,B" or "R,G,B:transition_ms=500"
+  int colonIdx = msg.indexOf(':');
+  MessageView rgb = colonIdx >= 0 ? msg.substring(0, colonIdx) : msg;
+
+  uint8_t r, g, b;
+  if (parseRgb(rgb, r, g, b)) {
+    state.colorR = r;
+    state.colorG = g;
+    state.colorB = b;
+    state.transitionMs = parseTransitionMs(msg);
+    state.bumpVersion();
+
+    mqtt.queueState(state, true);
   }
+}
 
-  // ---- Command: MODE ----
-  if (topic == "ikea_head_lamp/cmnd/mode") {
-    if (lower == "static") {
-      anim.stop();
-      mqtt.publishState(state, true);
-    } else if (lower == "animation") {
-      anim.startSunrise();
-      mqtt.publishState(state, true);
-    }
-    return;
+// ---- Command: MODE ----
+void handleMode(const MessageView& msg) {
+  if (msg.equalsIgnoreCase("static")) {
+    anim.stop();
+    mqtt.queueState(state, true);
+  } else if (msg.equalsIgnoreCase("animation")) {
+    anim.startSunrise();
+    mqtt.queueState(state, true);
   }
+}
 
-  // ---- Command: STATE QUERY ----
-  if (topic == "ikea_head_lamp/cmnd/query" || topic == "ikea_head_lamp/cmnd/state") {
-    mqtt.publishState(state, false);
-    return;
+// ---- Command: STATE QUERY ----
+void handleQuery(const MessageView& msg) {
+  mqtt.queueState(state, false);
+}
+
+// ---- Command: COLOR TEST ----
+// Scheduled R→G→B sequence; runs from the loop, never blocks it
+struct ColorTestJob {
+  static const unsigned long STEP_MS = 2000;
+  static const uint8_t STEPS = 4;       // Red, green, blue, back to default
+
+  bool active = false;
+  uint8_t step = 0;
+  unsigned long nextStepMs = 0;
+
+  void start(unsigned long now) {
+    active = true;
+    step = 0;
+    nextStepMs = now;
   }
 
-  // ---- Command: COLOR TEST ----
-  if (topic == "ikea_head_lamp/cmnd/test") {
-    if (lower == "color" || lower == "rgb") {
-      // Cycle through R→G→B at 70% brightness for 2 seconds each
-      state.powerOn = true;
-      state.brightness = 70;
-      
-      // Red
-      state.colorR = 255; state.colorG = 0; state.colorB = 0;
-      state.bumpVersion();
-      mqtt.publishState(state, false);
-      delay(2000);
-      
-      // Green
-      state.colorR = 0; state.colorG = 255; state.colorB = 0;
-      state.bumpVersion();
-      mqtt.publishState(state, false);
-      delay(2000);
-      
-      // Blue
-      state.colorR = 0; state.colorG = 0; state.colorB = 255;
-      state.bumpVersion();
-      mqtt.publishState(state, false);
-      delay(2000);
-      
-      // Back to warm white
+  void cancel() { active = false; }
+
+  unsigned long msUntilUpdate(unsigned long now) const {
+    if (!active) return Clock::NO_DEADLINE;
+    long remaining = (long)(nextStepMs - now);
+    return remaining > 0 ? (unsigned long)remaining : 0;
+  }
+
+  void update(unsigned long now) {
+    if (!active || (long)(now - nextStepMs) < 0) return;
+
+    static const uint8_t COLORS[STEPS - 1][3] = {
+      { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 }
+    };
+    if (step < STEPS - 1) {
+      state.colorR = COLORS[step][0];
+      state.colorG = COLORS[step][1];
+      state.colorB = COLORS[step][2];
+    } else {
       state.colorR = config.defaultColorR;
       state.colorG = config.defaultColorG;
       state.colorB = config.defaultColorB;
-      state.bumpVersion();
-      mqtt.publishState(state, false);
     }
-    return;
+    state.bumpVersion();
+    mqtt.queueState(state, false);
+
+    step++;
+    nextStepMs = now + STEP_MS;
+    active = step < STEPS;
   }
+};
 
-  // ---- Command: ANIMATION ----
-  if (topic == "ikea_head_lamp/cmnd/animation") {
-    // Parse animation command: "sunrise" or "sunrise:duration=1,brightness=80,color=0,100,255"
-    int colonIdx = msg.indexOf(':');
-    String animName = (colonIdx > 0) ? msg.substring(0, colonIdx) : msg;
-    animName.toLowerCase();
-    
-    if (animName == "sunrise") {
-      // Parse optional parameters
-      uint8_t duration = 0;  // 0 = use default
-      uint8_t brightness = 0;
-      uint8_t r = 0, g = 0, b = 0;
-      
-      if (colonIdx > 0) {
-        String params = msg.substring(colonIdx + 1);
-        
-        // Parse duration
-        int durIdx = params.indexOf("duration=");
-        if (durIdx >= 0) {
-          int durEnd = params.indexOf(',', durIdx);
-          if (durEnd < 0) durEnd = params.length();
-          duration = params.substring(durIdx + 9, durEnd).toInt();
-        }
-        
-        // Parse brightness
-        int briIdx = params.indexOf("brightness=");
-        if (briIdx >= 0) {
-          int briEnd = params.indexOf(',', briIdx);
-          if (briEnd < 0) briEnd = params.length();
-          brightness = params.substring(briIdx + 11, briEnd).toInt();
-        }
-        
-        // Parse color
-        int colIdx = params.indexOf("color=");
-        if (colIdx >= 0) {
-          int colStart = colIdx + 6;
-          int comma1 = params.indexOf(',', colStart);
-          int comma2 = params.indexOf(',', comma1 + 1);
-          int colEnd = params.indexOf(',', comma2 + 1);
-          if (colEnd < 0) colEnd = params.length();
-          
-          if (comma1 > colStart && comma2 > comma1) {
-            r = params.substring(colStart, comma1).toInt();
-            g = params.substring(comma1 + 1, comma2).toInt();
-            b = params.substring(comma2 + 1, colEnd).toInt();
-          }
-        }
-      }
-      
-      anim.startSunrise(duration, brightness, r, g, b);
-      mqtt.publishState(state, true);
-    } else if (animName == "sunset") {
-      // Parse optional parameters
-      uint8_t duration = 0;  // 0 = use default
-      uint8_t finalBrightness = 0;  // 0 = turn off
-      
-      if (colonIdx > 0) {
-        String params = msg.substring(colonIdx + 1);
-        
-        // Parse duration
-        int durIdx = params.indexOf("duration=");
-        if (durIdx >= 0) {
-          int durEnd = params.indexOf(',', durIdx);
-          if (durEnd < 0) durEnd = params.length();
-          duration = params.substring(durIdx + 9, durEnd).toInt();
-        }
-        
-        // Parse final brightness
-        int briIdx = params.indexOf("brightness=");
-        if (briIdx >= 0) {
-          int briEnd = params.indexOf(',', briIdx);
-          if (briEnd < 0) briEnd = params.length();
-          finalBrightness = params.substring(briIdx + 11, briEnd).toInt();
-        }
-      }
-      
-      anim.startSunset(duration, finalBrightness);
-      mqtt.publishState(state, true);
-    } else if (animName == "rainbow") {
-      anim.startRainbow();
-      mqtt.publishState(state, true);
-    } else if (animName == "fire") {
-      // Parse optional parameters
-      uint8_t intensity = 70;
-      uint8_t speed = 5;
-      
-      if (colonIdx > 0) {
-        String params = msg.substring(colonIdx + 1);
-        
-        // Parse intensity
-        int intIdx = params.indexOf("intensity=");
-        if (intIdx >= 0) {
-          int intEnd = params.indexOf(',', intIdx);
-          if (intEnd < 0) intEnd = params.length();
-          intensity = params.substring(intIdx + 10, intEnd).toInt();
-        }
-        
-        // Parse speed
-        int spdIdx = params.indexOf("speed=");
-        if (spdIdx >= 0) {
-          int spdEnd = params.indexOf(',', spdIdx);
-          if (spdEnd < 0) spdEnd = params.length();
-          speed = params.substring(spdIdx + 6, spdEnd).toInt();
-        }
-      }
-      
-      anim.startFire(intensity, speed);
-      mqtt.publishState(state, true);
-    } else if (animName == "breathe") {
-      // Parse optional parameters
-      uint8_t cycleDuration = 4;
-      uint8_t maxBrightness = 70;
-      uint8_t minBrightness = 10;
-      uint8_t r = 0, g = 0, b = 0;
-      
-      if (colonIdx > 0) {
-        String params = msg.substring(colonIdx + 1);
-        
-        // Parse duration (cycle duration in seconds)
-        int durIdx = params.indexOf("duration=");
-        if (durIdx >= 0) {
-          int durEnd = params.indexOf(',', durIdx);
-          if (durEnd < 0) durEnd = params.length();
-          cycleDuration = params.substring(durIdx + 9, durEnd).toInt();
-        }
-        
-        // Parse max brightness
-        int briIdx = params.indexOf("brightness=");
-        if (briIdx >= 0) {
-          int briEnd = params.indexOf(',', briIdx);
-          if (briEnd < 0) briEnd = params.length();
-          maxBrightness = params.substring(briIdx + 11, briEnd).toInt();
-        }
-        
-        // Parse min brightness
-        int minIdx = params.indexOf("min_brightness=");
-        if (minIdx >= 0) {
-          int minEnd = params.indexOf(',', minIdx);
-          if (minEnd < 0) minEnd = params.length();
-          minBrightness = params.substring(minIdx + 15, minEnd).toInt();
-        }
-        
-        // Parse color
-        int colIdx = params.indexOf("color=");
-        if (colIdx >= 0) {
-          int colStart = colIdx + 6;
-          int comma1 = params.indexOf(',', colStart);
-          int comma2 = params.indexOf(',', comma1 + 1);
-          int colEnd = params.indexOf(',', comma2 + 1);
-          if (colEnd < 0) colEnd = params.length();
-          
-          if (comma1 > colStart && comma2 > comma1) {
-            r = params.substring(colStart, comma1).toInt();
-            g = params.substring(comma1 + 1, comma2).toInt();
-            b = params.substring(comma2 + 1, colEnd).toInt();
-          }
-        }
-      }
-      
-      anim.startBreathe(cycleDuration, maxBrightness, minBrightness, r, g, b);
-      mqtt.publishState(state, true);
-    } else if (animName == "ocean") {
-      // Parse optional parameters
-      uint8_t speed = 5;
-      uint8_t brightness = 70;
-      
-      if (colonIdx > 0) {
-        String params = msg.substring(colonIdx + 1);
-        
-        // Parse speed
-        int spdIdx = params.indexOf("speed=");
-        if (spdIdx >= 0) {
-          int spdEnd = params.indexOf(',', spdIdx);
-          if (spdEnd < 0) spdEnd = params.length();
-          speed = params.substring(spdIdx + 6, spdEnd).toInt();
-        }
-        
-        // Parse brightness
-        int briIdx = params.indexOf("brightness=");
-        if (briIdx >= 0) {
-          int briEnd = params.indexOf(',', briIdx);
-          if (briEnd < 0) briEnd = params.length();
-          brightness = params.substring(briIdx + 11, briEnd).toInt();
-        }
-      }
-      
-      anim.startOcean(speed, brightness);
-      mqtt.publishState(state, true);
-    } else if (animName == "favorite") {
-      // Start the favorite animation with saved parameters
-      anim.startFavorite();
-      mqtt.publishState(state, true);
-    } else if (animName == "stop") {
-      anim.stop();
-      mqtt.publishState(state, true);
-    } else {
-      Serial.println("[CMD] Unknown animation");
-    }
-    return;
+ColorTestJob colorTest;
+
+void handleTest(const MessageView& msg) {
+  if (msg.equalsIgnoreCase("color") || msg.equalsIgnoreCase("rgb")) {
+    // Cycle through R→G→B at 70% brightness for 2 seconds each
+    anim.stop();
+    state.powerOn = true;
+    state.brightness = 70;
+    colorTest.start(millis());
+    colorTest.update(millis());
+  }
+}
+
+// ---- Command: ANIMATION ----
+void handleAnimation(const MessageView& msg) {
+  // Parse animation command: "sunrise" or "sunrise:duration=1,brightness=80,color=0,100,255"
+  int colonIdx = msg.indexOf(':');
+  MessageView animName = colonIdx > 0 ? msg.substring(0, colonIdx) : msg;
+  
+  AnimationParams params;
+  if (animName.equalsIgnoreCase("favorite")) {
+    // Start the favorite animation with saved parameters
+    anim.startFavorite();
+    mqtt.queueState(state, true);
+  } else if (animName.equalsIgnoreCase("stop")) {
+    anim.stop();
+    mqtt.queueState(state, true);
+  } else if (const AnimationInfo* info = AnimationRegistry::parseCommand(msg.data(), msg.length(), params)) {
+    // Schema defaults, overridden by any given parameters
+    anim.start(info->id, params);
+    mqtt.queueState(state, true);
+  } else {
+    Serial.println("[CMD] Unknown animation");
+  }
+}
+
+// ---- Command: PAUSE ----
+void handlePause(const MessageView& msg) {
+  if (!anim.isActive()) return;
+
+  bool newPaused = state.animationPaused;
+  if (msg.equalsIgnoreCase("toggle")) {
+    newPaused = !state.animationPaused;
+  } else if (msg.equalsIgnoreCase("true") || msg.equals("1") || msg.equalsIgnoreCase("on")) {
+    newPaused = true;
+  } else if (msg.equalsIgnoreCase("false") || msg.equals("0") || msg.equalsIgnoreCase("off")) {
+    newPaused = false;
   }
 
-  // ---- Command: PAUSE ----
-  if (topic == "ikea_head_lamp/cmnd/pause") {
-    if (!anim.isActive()) return;
+  anim.setPaused(newPaused);
+  mqtt.queueState(state, true);
+}
+
+// ---- APPLY DEFAULTS ----
+void handleApplyDefaults(const MessageView& msg) {
+  state.colorR = config.defaultColorR;
+  state.colorG = config.defaultColorG;
+  state.colorB = config.defaultColorB;
+  state.brightness = config.defaultBrightness;
+  state.powerOn = true;
+  anim.stop();
+  mqtt.queueState(state, true);
+}
+
+// ---- CONFIG setters, shared by the per-field topics and cmnd/json ----
+void setDefaultBrightness(long v) {
+  if (v < 1) v = 1;
+  if (v > 100) v = 100;
+  config.defaultBrightness = (uint8_t)v;
+  configDirty = true;
+}
 
-    bool newPaused = state.animationPaused;
-    if (lower == "toggle") {
-      newPaused = !state.animationPaused;
-    } else if (lower == "true" || lower == "1" || lower == "on") {
-      newPaused = true;
-    } else if (lower == "false" || lower == "0" || lower == "off") {
-      newPaused = false;
+void setDefaultColor(uint8_t r, uint8_t g, uint8_t b) {
+  config.defaultColorR = r;
+  config.defaultColorG = g;
+  config.defaultColorB = b;
+  configDirty = true;
+}
+
+void setSunriseMinutes(long v) {
+  if (v < 5) v = 5;
+  if (v > 180) v = 180;
+  config.sunriseMinutes = (uint16_t)v;
+  configDirty = true;
+}
+
+void setMinPwm(long v) {
+  if (v < 0) v = 0;
+  if (v > 100) v = 100;
+  config.minPwmPercent = (uint8_t)v;
+  if (config.maxPwmPercent <= config.minPwmPercent)
+    config.maxPwmPercent = config.minPwmPercent + 1;
+  configDirty = true;
+}
+
+void setMaxPwm(long v) {
+  if (v < 0) v = 0;
+  if (v > 100) v = 100;
+  config.maxPwmPercent = (uint8_t)v;
+  if (config.maxPwmPercent <= config.minPwmPercent)
+    config.minPwmPercent = config.maxPwmPercent - 1;
+  configDirty = true;
+}
+
+// Exponent, clamped to 0.5-4.0
+void setGamma(float g) {
+  if (g < 0.5f) g = 0.5f;
+  if (g > 4.0f) g = 4.0f;
+  config.gammaX100 = (uint16_t)(g * 100.0f + 0.5f);
+  applyBrightnessCurve();
+  configDirty = true;
+}
+
+// ---- CONFIG: default_brightness ----
+void handleDefaultBrightness(const MessageView& msg) {
+  setDefaultBrightness(msg.toInt());
+  mqtt.queueConfig(config);
+}
+
+// ---- CONFIG: default_color ----
+void handleDefaultColor(const MessageView& msg) {
+  uint8_t r, g, b;
+  if (parseRgb(msg, r, g, b)) {
+    setDefaultColor(r, g, b);
+    mqtt.queueConfig(config);
+  }
+}
+
+// ---- CONFIG: sunrise_minutes ----
+void handleSunriseMinutes(const MessageView& msg) {
+  setSunriseMinutes(msg.toInt());
+  mqtt.queueConfig(config);
+}
+
+// ---- CONFIG: min_pwm ----
+void handleMinPwm(const MessageView& msg) {
+  setMinPwm(msg.toInt());
+  mqtt.queueConfig(config);
+}
+
+// ---- CONFIG: max_pwm ----
+void handleMaxPwm(const MessageView& msg) {
+  setMaxPwm(msg.toInt());
+  mqtt.queueConfig(config);
+}
+
+// ---- CONFIG: gamma ----
+void handleGamma(const MessageView& msg) {
+  // Format: "2.2" (exponent, 0.5-4.0)
+  setGamma(msg.toFloat());
+  mqtt.queueConfig(config);
+}
+
+// ---- CONFIG: gamma curve ----
+void handleGammaCurve(const MessageView& msg) {
+  // Format: "0,20,80,...,1000" (output permille at evenly spaced PWM points)
+  // Empty or "off" returns to the gamma exponent
+  uint8_t count = 0;
+  if (!msg.isEmpty() && !msg.equals("off")) {
+    size_t start = 0;
+    while (count < DeviceConfig::GAMMA_CURVE_MAX_POINTS) {
+      int comma = msg.indexOf(',', start);
+      long v = msg.substring(start, comma >= 0 ? (size_t)comma : MessageView::NPOS).toInt();
+      if (v < 0) v = 0;
+      if (v > 1000) v = 1000;
+      config.gammaCurve[count++] = (uint16_t)v;
+      if (comma < 0) break;
+      start = comma + 1;
     }
+  }
+  if (count < 2) {
+    if (count == 1) Serial.println("[CFG] Gamma curve needs at least 2 points – cleared");
+    count = 0;
+  }
+  config.gammaCurveLen = count;
+  applyBrightnessCurve();
+  configDirty = true;
+  mqtt.queueConfig(config);
+}
 
-    anim.setPaused(newPaused);
-    mqtt.publishState(state, true);
+// ---- CONFIG: favorite animation ----
+void handleFavoriteAnimation(const MessageView& msg) {
+  // Format: "fire:intensity=80,speed=7" or "breathe:duration=6,color=0,100,255" or just "ocean"
+  // Missing parameters fall back to the animation's schema defaults
+  AnimationParams params;
+  const AnimationInfo* info = AnimationRegistry::parseCommand(msg.data(), msg.length(), params);
+  if (!info) {
+    Serial.println("[CFG] Unknown favorite animation");
     return;
   }
 
-  // ---- APPLY DEFAULTS ----
-  if (topic == "ikea_head_lamp/cmnd/apply_defaults") {
-    state.colorR = config.defaultColorR;
-    state.colorG = config.defaultColorG;
-    state.colorB = config.defaultColorB;
-    state.brightness = config.defaultBrightness;
-    state.powerOn = true;
-    anim.stop();
-    mqtt.publishState(state, true);
+  config.favAnimParam1 = params.param1;
+  config.favAnimParam2 = params.param2;
+  config.favAnimParam3 = params.param3;
+  config.favAnimColorR = params.colorR;
+  config.favAnimColorG = params.colorG;
+  config.favAnimColorB = params.colorB;
+  config.favoriteAnimation = info->name;
+  configDirty = true;
+  
+  Serial.print("[CFG] Favorite animation set to: ");
+  Serial.println(info->name);
+  
+  mqtt.queueConfig(config);
+}
+
+// ---- CONFIG: phase group ----
+void handlePhaseGroup(const MessageView& msg) {
+  // Format: group name (letters, digits, '-', '_', '.'); empty to leave
+  char name[PhaseGroup::MAX_NAME + 1];
+  if (msg.length() > PhaseGroup::MAX_NAME) {
+    Serial.println("[CFG] Phase group name too long");
     return;
   }
+  msg.copyTo(name, sizeof(name));
+  for (size_t i = 0; name[i]; i++) {
+    if (!isalnum((unsigned char)name[i]) && !strchr("-_.", name[i])) {
+      Serial.println("[CFG] Invalid phase group name");
+      return;
+    }
+  }
+
+  config.phaseGroup = name;
+  configDirty = true;
+  phaseGroup.join(name);
+  mqtt.queueConfig(config);
+}
 
-  // ---- CONFIG: default_brightness ----
-  if (topic == "ikea_head_lamp/config/default_brightness/set") {
-    int v = msg.toInt();
-    if (v < 1) v = 1;
-    if (v > 100) v = 100;
-    config.defaultBrightness = (uint8_t)v;
-    configDirty = true;
-    mqtt.publishConfig(config);
+// ---- CONFIG: base topic ----
+void handleBaseTopic(const MessageView& msg) {
+  // Format: base topic, e.g. "home/lamps/desk"; empty for the MAC default.
+  // Takes effect after config/save and a restart
+  char base[TopicTable::MAX_BASE + 1];
+  if (msg.length() > TopicTable::MAX_BASE) {
+    Serial.println("[CFG] Base topic too long");
     return;
   }
+  msg.copyTo(base, sizeof(base));
+  if (base[0] && !TopicTable::validBase(base)) {
+    Serial.println("[CFG] Invalid base topic");
+    return;
+  }
+
+  config.mqttBase = base;
+  configDirty = true;
+  Serial.printf("[CFG] Base topic set to '%s' (after save and restart)\n", base);
+  mqtt.queueConfig(config);
+}
+
+// ---- CONFIG: save ----
+void handleConfigSave(const MessageView& msg) {
+  if (configDirty) {
+    config.save();
+    configDirty = false;
+  } else {
+    Serial.println("[CFG] Save requested but config not dirty – skipping");
+  }
+  mqtt.queueConfig(config);
+}
+
+// ---- CONFIG: reset ----
+void handleConfigReset(const MessageView& msg) {
+  config.reset();
+  configDirty = false;
+  applyBrightnessCurve();
+  phaseGroup.join(config.phaseGroup.c_str());
+  mqtt.queueConfig(config);
+}
+
+// ---- CONFIG: request ----
+void handleConfigRequest(const MessageView& msg) {
+  mqtt.queueConfig(config);
+}
+
+// ---- Command: JSON batch ----
+// {"state":"ON","brightness":80,"color":[255,147,41],"transition_ms":2000,
+//  "effect":"fire","params":{"intensity":80},"pause":false,
+//  "config":{"default_brightness":60,"gamma":2.2,"save":true}}
+// Every field is optional. The whole batch is read and checked before
+// anything changes: a malformed batch changes nothing, a valid one costs
+// one hardware update and one state publish.
 
-  // ---- CONFIG: default_color ----
-  if (topic == "ikea_head_lamp/config/default_color/set") {
-    int r = 0, g = 0, b = 0;
-    int c1 = msg.indexOf(',');
-    int c2 = msg.indexOf(',', c1 + 1);
-    if (c1 > 0 && c2 > c1) {
-      r = msg.substring(0, c1).toInt();
-      g = msg.substring(c1 + 1, c2).toInt();
-      b = msg.substring(c2 + 1).toInt();
-      if (r < 0) r = 0; if (r > 255) r = 255;
-      if (g < 0) g = 0; if (g > 255) g = 255;
-      if (b < 0) b = 0; if (b > 255) b = 255;
-      config.defaultColorR = r;
-      config.defaultColorG = g;
-      config.defaultColorB = b;
-      configDirty = true;
-      mqtt.publishConfig(config);
+struct JsonBatch {
+  int8_t power = -1;              // -1 unchanged, 0 off, 1 on, 2 toggle
+  long brightness = -1;
+  bool hasColor = false;
+  uint8_t color[3] = { 0, 0, 0 };
+  long transitionMs = -1;
+  int8_t paused = -1;
+  MessageView effect;             // Empty = unchanged
+  MessageView params;             // Raw value, read once the effect is known
+  MessageView config;             // Raw value
+};
+
+struct JsonConfigBatch {
+  long defaultBrightness = -1;
+  bool hasDefaultColor = false;
+  uint8_t defaultColor[3] = { 0, 0, 0 };
+  long sunriseMinutes = -1;
+  long minPwm = -1;
+  long maxPwm = -1;
+  float gamma = -1.0f;
+  bool save = false;
+};
+
+uint8_t clampColor(long v) {
+  return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// Number that must not read as "unchanged" (-1) when negative
+bool readJsonAmount(JsonReader& json, long& value) {
+  if (!json.readInt(value)) return false;
+  if (value < 0) value = 0;
+  return true;
+}
+
+// [R,G,B] or {"r":R,"g":G,"b":B}
+bool readJsonColor(JsonReader& json, uint8_t rgb[3]) {
+  long v;
+  if (json.peek() == JsonReader::Type::Array) {
+    uint8_t n = 0;
+    json.enterArray();
+    while (json.nextElement()) {
+      if (n >= 3 || !json.readInt(v)) return false;
+      rgb[n++] = clampColor(v);
     }
-    return;
+    return json.ok() && n == 3;
   }
 
-  // ---- CONFIG: sunrise_minutes ----
-  if (topic == "ikea_head_lamp/config/sunrise_minutes/set") {
-    int v = msg.toInt();
-    if (v < 5) v = 5;
-    if (v > 180) v = 180;
-    config.sunriseMinutes = (uint16_t)v;
-    configDirty = true;
-    mqtt.publishConfig(config);
-    return;
+  MessageView key;
+  if (!json.enterObject()) return false;
+  while (json.nextKey(key)) {
+    int channel = key.equals("r") ? 0 : key.equals("g") ? 1 : key.equals("b") ? 2 : -1;
+    if (channel < 0) {
+      json.skipValue();
+    } else if (json.readInt(v)) {
+      rgb[channel] = clampColor(v);
+    }
   }
+  return json.ok();
+}
 
-  // ---- CONFIG: min_pwm ----
-  if (topic == "ikea_head_lamp/config/min_pwm/set") {
-    int v = msg.toInt();
-    if (v < 0) v = 0;
-    if (v > 100) v = 100;
-    config.minPwmPercent = (uint8_t)v;
-    if (config.maxPwmPercent <= config.minPwmPercent)
-      config.maxPwmPercent = config.minPwmPercent + 1;
-    configDirty = true;
-    mqtt.publishConfig(config);
-    return;
+bool parseJsonBatch(const MessageView& msg, JsonBatch& batch) {
+  JsonReader json(msg);
+  MessageView key;
+  MessageView text;
+  bool flag;
+  float seconds;
+
+  if (!json.enterObject()) return false;
+  while (json.nextKey(key)) {
+    if (key.equals("state")) {
+      if (!json.readString(text)) break;
+      if (text.equalsIgnoreCase("on")) batch.power = 1;
+      else if (text.equalsIgnoreCase("off")) batch.power = 0;
+      else if (text.equalsIgnoreCase("toggle")) batch.power = 2;
+      else return false;
+    } else if (key.equals("brightness")) {
+      readJsonAmount(json, batch.brightness);
+    } else if (key.equals("color")) {
+      if (!readJsonColor(json, batch.color)) return false;
+      batch.hasColor = true;
+    } else if (key.equals("transition_ms")) {
+      readJsonAmount(json, batch.transitionMs);
+    } else if (key.equals("transition")) {
+      // Seconds, as Home Assistant sends it. Clamped before converting:
+      // a float beyond the range of long has no defined conversion
+      if (json.readFloat(seconds)) {
+        if (!(seconds > 0.0f)) seconds = 0.0f;  // Also NaN
+        if (seconds > MAX_TRANSITION_MS / 1000.0f) seconds = MAX_TRANSITION_MS / 1000.0f;
+        batch.transitionMs = (long)(seconds * 1000.0f);
+      }
+    } else if (key.equals("effect")) {
+      json.readString(batch.effect);
+    } else if (key.equals("params")) {
+      json.skipValue(&batch.params);
+    } else if (key.equals("pause")) {
+      if (json.readBool(flag)) batch.paused = flag ? 1 : 0;
+    } else if (key.equals("config")) {
+      if (json.peek() != JsonReader::Type::Object) return false;
+      json.skipValue(&batch.config);
+    } else {
+      json.skipValue();  // Unknown fields are ignored
+    }
+  }
+  return json.finish();
+}
+
+bool parseJsonConfig(const MessageView& raw, JsonConfigBatch& batch) {
+  JsonReader json(raw);
+  MessageView key;
+
+  if (!json.enterObject()) return false;
+  while (json.nextKey(key)) {
+    if (key.equals("default_brightness")) {
+      readJsonAmount(json, batch.defaultBrightness);
+    } else if (key.equals("default_color")) {
+      if (!readJsonColor(json, batch.defaultColor)) return false;
+      batch.hasDefaultColor = true;
+    } else if (key.equals("sunrise_minutes")) {
+      readJsonAmount(json, batch.sunriseMinutes);
+    } else if (key.equals("min_pwm")) {
+      readJsonAmount(json, batch.minPwm);
+    } else if (key.equals("max_pwm")) {
+      readJsonAmount(json, batch.maxPwm);
+    } else if (key.equals("gamma")) {
+      if (json.readFloat(batch.gamma) && batch.gamma < 0.0f) batch.gamma = 0.0f;
+    } else if (key.equals("save")) {
+      json.readBool(batch.save);
+    } else {
+      json.skipValue();
+    }
   }
+  return json.finish();
+}
 
-  // ---- CONFIG: max_pwm ----
-  if (topic == "ikea_head_lamp/config/max_pwm/set") {
-    int v = msg.toInt();
-    if (v < 0) v = 0;
-    if (v > 100) v = 100;
-    config.maxPwmPercent = (uint8_t)v;
-    if (config.maxPwmPercent <= config.minPwmPercent)
-      config.minPwmPercent = config.maxPwmPercent - 1;
-    configDirty = true;
-    mqtt.publishConfig(config);
-    return;
+// Params as an object {"speed":7,"color":[0,100,255]} or the
+// "speed=7,color=0,100,255" string the animation topic takes
+bool parseJsonParams(const MessageView& raw, const AnimationInfo& info, AnimationParams& params) {
+  JsonReader json(raw);
+  if (json.peek() == JsonReader::Type::String) {
+    MessageView text;
+    json.readString(text);
+    AnimationRegistry::parseParams(text.data(), text.length(), info, params);
+    return json.finish();
   }
 
-  // ---- CONFIG: favorite animation ----
-  if (topic == "ikea_head_lamp/config/favorite_animation/set") {
-    // Format: "fire:intensity=80,speed=7" or "breathe:duration=6,color=0,100,255" or just "ocean"
-    String animName = msg;
-    int colonIdx = msg.indexOf(':');
-    
-    if (colonIdx > 0) {
-      animName = msg.substring(0, colonIdx);
-      String params = msg.substring(colonIdx + 1);
-      
-      // Reset all params to zero first
-      config.favAnimParam1 = 0;
-      config.favAnimParam2 = 0;
-      config.favAnimParam3 = 0;
-      config.favAnimColorR = 0;
-      config.favAnimColorG = 0;
-      config.favAnimColorB = 0;
-      
-      // Parse parameters based on animation type
-      if (animName == "fire" || animName == "ocean") {
-        // Parse intensity/brightness and speed
-        int intIdx = params.indexOf("intensity=");
-        if (intIdx < 0) intIdx = params.indexOf("brightness=");
-        if (intIdx >= 0) {
-          int intEnd = params.indexOf(',', intIdx);
-          if (intEnd < 0) intEnd = params.length();
-          int startPos = params.indexOf('=', intIdx) + 1;
-          config.favAnimParam1 = params.substring(startPos, intEnd).toInt();
-        }
-        
-        int spdIdx = params.indexOf("speed=");
-        if (spdIdx >= 0) {
-          int spdEnd = params.indexOf(',', spdIdx);
-          if (spdEnd < 0) spdEnd = params.length();
-          config.favAnimParam2 = params.substring(spdIdx + 6, spdEnd).toInt();
-        }
-      } else if (animName == "breathe") {
-        // Parse duration, maxBrightness, minBrightness
-        int durIdx = params.indexOf("duration=");
-        if (durIdx >= 0) {
-          int durEnd = params.indexOf(',', durIdx);
-          if (durEnd < 0) durEnd = params.length();
-          config.favAnimParam1 = params.substring(durIdx + 9, durEnd).toInt();
-        }
-        
-        int maxIdx = params.indexOf("max=");
-        if (maxIdx >= 0) {
-          int maxEnd = params.indexOf(',', maxIdx);
-          if (maxEnd < 0) maxEnd = params.length();
-          config.favAnimParam2 = params.substring(maxIdx + 4, maxEnd).toInt();
-        }
-        
-        int minIdx = params.indexOf("min=");
-        if (minIdx >= 0) {
-          int minEnd = params.indexOf(',', minIdx);
-          if (minEnd < 0) minEnd = params.length();
-          config.favAnimParam3 = params.substring(minIdx + 4, minEnd).toInt();
-        }
-        
-        // Parse color
-        int colIdx = params.indexOf("color=");
-        if (colIdx >= 0) {
-          int colStart = colIdx + 6;
-          int comma1 = params.indexOf(',', colStart);
-          int comma2 = params.indexOf(',', comma1 + 1);
-          int colEnd = params.indexOf(',', comma2 + 1);
-          if (colEnd < 0) colEnd = params.length();
-          
-          if (comma1 > colStart && comma2 > comma1) {
-            config.favAnimColorR = params.substring(colStart, comma1).toInt();
-            config.favAnimColorG = params.substring(comma1 + 1, comma2).toInt();
-            config.favAnimColorB = params.substring(comma2 + 1, colEnd).toInt();
-          }
-        }
-      } else if (animName == "sunrise" || animName == "sunset") {
-        // Parse duration, brightness/finalBrightness
-        int durIdx = params.indexOf("duration=");
-        if (durIdx >= 0) {
-          int durEnd = params.indexOf(',', durIdx);
-          if (durEnd < 0) durEnd = params.length();
-          config.favAnimParam1 = params.substring(durIdx + 9, durEnd).toInt();
-        }
-        
-        int briIdx = params.indexOf("brightness=");
-        if (briIdx >= 0) {
-          int briEnd = params.indexOf(',', briIdx);
-          if (briEnd < 0) briEnd = params.length();
-          config.favAnimParam2 = params.substring(briIdx + 11, briEnd).toInt();
-        }
-        
-        // Parse color (for sunrise)
-        int colIdx = params.indexOf("color=");
-        if (colIdx >= 0) {
-          int colStart = colIdx + 6;
-          int comma1 = params.indexOf(',', colStart);
-          int comma2 = params.indexOf(',', comma1 + 1);
-          int colEnd = params.indexOf(',', comma2 + 1);
-          if (colEnd < 0) colEnd = params.length();
-          
-          if (comma1 > colStart && comma2 > comma1) {
-            config.favAnimColorR = params.substring(colStart, comma1).toInt();
-            config.favAnimColorG = params.substring(comma1 + 1, comma2).toInt();
-            config.favAnimColorB = params.substring(comma2 + 1, colEnd).toInt();
-          }
-        }
+  MessageView key;
+  long values[3];
+  if (!json.enterObject()) return false;
+  while (json.nextKey(key)) {
+    uint8_t count = 0;
+    if (json.peek() == JsonReader::Type::Array) {
+      json.enterArray();
+      while (json.nextElement()) {
+        if (count >= 3 || !json.readInt(values[count++])) return false;
       }
-      // Rainbow has no parameters, so nothing to parse
+    } else if (json.peek() == JsonReader::Type::Number) {
+      json.readInt(values[count++]);
+    } else {
+      json.skipValue();
     }
-    
-    config.favoriteAnimation = animName;
-    configDirty = true;
-    
-    Serial.print("[CFG] Favorite animation set to: ");
-    Serial.println(animName);
-    
-    mqtt.publishConfig(config);
-    return;
+    if (count) AnimationRegistry::setParam(info, key.data(), key.length(), values, count, params);
   }
+  return json.finish();
+}
 
-  // ---- CONFIG: save ----
-  if (topic == "ikea_head_lamp/config/save") {
-    if (configDirty) {
-      config.save();
-      configDirty = false;
+void handleJson(const MessageView& msg) {
+  JsonBatch batch;
+  JsonConfigBatch cfg;
+  const AnimationInfo* effect = nullptr;
+  AnimationParams params;
+  bool stopEffect = false;
+  bool favorite = false;
+
+  // ---- Read and check everything first ----
+  bool valid = parseJsonBatch(msg, batch);
+  if (valid && !batch.config.isEmpty()) {
+    valid = parseJsonConfig(batch.config, cfg);
+  }
+  if (valid && !batch.effect.isEmpty()) {
+    if (batch.effect.equalsIgnoreCase("none") || batch.effect.equalsIgnoreCase("stop")) {
+      stopEffect = true;
+    } else if (batch.effect.equalsIgnoreCase("favorite")) {
+      favorite = true;
+    } else if ((effect = AnimationRegistry::find(batch.effect.data(), batch.effect.length()))) {
+      params = AnimationRegistry::defaults(*effect);
+      if (!batch.params.isEmpty()) valid = parseJsonParams(batch.params, *effect, params);
     } else {
-      Serial.println("[CFG] Save requested but config not dirty – skipping");
+      valid = false;
     }
-    mqtt.publishConfig(config);
+  }
+  if (!valid) {
+    Serial.println("[CMD] Malformed JSON command ignored");
     return;
   }
 
-  // ---- CONFIG: reset ----
-  if (topic == "ikea_head_lamp/config/reset") {
-    config.reset();
+  // ---- Config ----
+  if (cfg.defaultBrightness >= 0) setDefaultBrightness(cfg.defaultBrightness);
+  if (cfg.hasDefaultColor) setDefaultColor(cfg.defaultColor[0], cfg.defaultColor[1], cfg.defaultColor[2]);
+  if (cfg.sunriseMinutes >= 0) setSunriseMinutes(cfg.sunriseMinutes);
+  if (cfg.minPwm >= 0) setMinPwm(cfg.minPwm);
+  if (cfg.maxPwm >= 0) setMaxPwm(cfg.maxPwm);
+  if (cfg.gamma >= 0.0f) setGamma(cfg.gamma);
+  if (cfg.save && configDirty) {
+    config.save();
     configDirty = false;
-    mqtt.publishConfig(config);
-    return;
   }
+  if (!batch.config.isEmpty()) mqtt.queueConfig(config);
+
+  // ---- State: one version bump, one publish ----
+  bool stateTouched = batch.power >= 0 || batch.brightness >= 0 || batch.hasColor ||
+                      batch.paused >= 0 || stopEffect || favorite || effect;
+  if (!stateTouched) return;
+
+  if (batch.brightness >= 0) {
+    long v = batch.brightness > 100 ? 100 : batch.brightness;
+    state.brightness = (uint8_t)v;
+    state.powerOn = (v > 0);
+  }
+  if (batch.hasColor) {
+    state.colorR = batch.color[0];
+    state.colorG = batch.color[1];
+    state.colorB = batch.color[2];
+  }
+  if (batch.power == 2) state.powerOn = !state.powerOn;
+  else if (batch.power >= 0) state.powerOn = batch.power == 1;
+
+  if (batch.power >= 0 && state.powerOn && state.brightness == 0) {
+    state.brightness = config.defaultBrightness;
+    if (!batch.hasColor) {
+      state.colorR = config.defaultColorR;
+      state.colorG = config.defaultColorG;
+      state.colorB = config.defaultColorB;
+    }
+  }
+  long transition = batch.transitionMs < 0 ? 0 : batch.transitionMs;
+  state.transitionMs = transition > (long)MAX_TRANSITION_MS ? MAX_TRANSITION_MS : (uint32_t)transition;
+
+  if (!state.powerOn || stopEffect) {
+    anim.stop();
+  } else if (favorite) {
+    anim.startFavorite();
+  } else if (effect) {
+    anim.start(effect->id, params);
+  }
+  if (batch.paused >= 0 && anim.isActive()) {
+    anim.setPaused(batch.paused == 1);
+  }
+
+  state.bumpVersion();
+  mqtt.queueState(state, true);
+}
+
+void registerMqttRoutes() {
+  router.add("cmnd/power", handlePower);
+  // Only the latest queued brightness/color matters
+  router.add("cmnd/brightness", handleBrightness, true);
+  router.add("cmnd/color", handleColor, true);
+  router.add("cmnd/mode", handleMode);
+  router.add("cmnd/query", handleQuery);
+  router.add("cmnd/state", handleQuery);
+  router.add("cmnd/test", handleTest);
+  router.add("cmnd/animation", handleAnimation);
+  router.add("cmnd/pause", handlePause);
+  router.add("cmnd/apply_defaults", handleApplyDefaults);
+  router.add("cmnd/json", handleJson);
+  router.add("config/default_brightness/set", handleDefaultBrightness);
+  router.add("config/default_color/set", handleDefaultColor);
+  router.add("config/sunrise_minutes/set", handleSunriseMinutes);
+  router.add("config/min_pwm/set", handleMinPwm);
+  router.add("config/max_pwm/set", handleMaxPwm);
+  router.add("config/gamma/set", handleGamma);
+  router.add("config/gamma_curve/set", handleGammaCurve);
+  router.add("config/favorite_animation/set", handleFavoriteAnimation);
+  router.add("config/phase_group/set", handlePhaseGroup);
+  router.add("config/base_topic/set", handleBaseTopic);
+  router.add("config/save", handleConfigSave);
+  router.add("config/reset", handleConfigReset);
+  router.add("config/request", handleConfigRequest);
+}
+
+// Received commands wait here; the render loop runs their handlers
+CommandQueue inbox;
+
+// Called from inside the MQTT client on the network task: only queue
+// the command. Payload points into the MQTT client buffer (see MessageView).
+void handleMqttMessage(const char* topic, size_t topicLength, const MessageView& payload) {
+  int route = router.resolve(topic, topicLength);
+  if (route < 0) return;
+  // Timed commands each run at their own instant, so none replaces another
+  uint64_t atMs;
+  MessageView head, tail;
+  bool timed = CommandScheduler::findAt(payload, atMs, head, tail);
+  if (!inbox.push((uint8_t)route, payload, router.coalesces((uint8_t)route) && !timed)) {
+    Serial.println("[CMD] Inbox full or payload too long, command dropped");
+  }
+}
 
-  // ---- CONFIG: request ----
-  if (topic == "ikea_head_lamp/config/request") {
-    mqtt.publishConfig(config);
+// Furthest "at" time accepted; later ones are typos or a wrong sender clock
+const uint64_t MAX_DEFER_MS = 24ULL * 3600 * 1000;
+
+// Queue a command carrying an "at" time for its wall-clock instant
+void deferCommand(uint8_t route, uint64_t atMs, const MessageView& head, const MessageView& tail) {
+  if (!wallClock.synced()) {
+    Serial.println("[SYNC] Clock not synced yet, running timed command now");
+    atMs = 0;
+  } else if (atMs > wallClock.now() + MAX_DEFER_MS) {
+    Serial.println("[SYNC] Timed command more than 24 h ahead, dropped");
     return;
   }
+  if (!scheduler.schedule(route, atMs, head, tail)) {
+    Serial.println("[SYNC] Schedule full, timed command dropped");
+  }
+}
+
+// Run timed commands whose instant has come
+void runDueCommands() {
+  CommandScheduler::Command cmd;
+  bool ran = false;
+  uint64_t now = wallClock.now();  // 0 before the first sync
+  while (scheduler.popDue(now, cmd)) {
+    router.invoke(cmd.route, cmd.payload);
+    ran = true;
+  }
+  // Reach the LEDs in this pass, not when the apply throttle reopens
+  if (ran) lastHardwareUpdate = millis() - HARDWARE_UPDATE_INTERVAL_MS;
+}
+
+// Run every queued command
+void processCommands() {
+  CommandQueue::Command cmd;
+  bool any = false;
+  while (inbox.pop(cmd)) {
+    colorTest.cancel();  // Any command takes over from the test sequence
+    any = true;
+
+    uint64_t atMs;
+    MessageView head, tail;
+    if (CommandScheduler::findAt(cmd.payload, atMs, head, tail)) {
+      deferCommand(cmd.route, atMs, head, tail);
+    } else {
+      router.invoke(cmd.route, cmd.payload);
+    }
+  }
+  runDueCommands();
+  if (any) statusLED.blink(1, 30);  // Quick blink on MQTT command
+}
+
+// ======================= STATE JOURNAL ======================
+
+// Current light and animation, as the journal records them
+StateJournal::Entry journalEntry() {
+  StateJournal::Entry entry = {};
+  entry.powerOn = state.powerOn;
+  entry.brightness = state.brightness;
+  entry.colorR = state.colorR;
+  entry.colorG = state.colorG;
+  entry.colorB = state.colorB;
+
+  AnimationSnapshot snapshot;
+  if (anim.snapshot(snapshot)) {
+    entry.animating = true;
+    entry.paused = snapshot.paused;
+    entry.animation = (uint8_t)snapshot.id;
+    entry.params[0] = snapshot.params.param1;
+    entry.params[1] = snapshot.params.param2;
+    entry.params[2] = snapshot.params.param3;
+    entry.params[3] = snapshot.params.colorR;
+    entry.params[4] = snapshot.params.colorG;
+    entry.params[5] = snapshot.params.colorB;
+    entry.originBrightness = snapshot.originBrightness;
+    entry.originR = snapshot.originR;
+    entry.originG = snapshot.originG;
+    entry.originB = snapshot.originB;
+    entry.elapsedMs = snapshot.elapsedMs;
+  }
+  return entry;
+}
+
+// Put light and animation back as they were before the restart
+void resumeJournal(const StateJournal::Entry& entry) {
+  state.powerOn = entry.powerOn;
+  state.brightness = entry.brightness;
+  state.colorR = entry.colorR;
+  state.colorG = entry.colorG;
+  state.colorB = entry.colorB;
+  if (!entry.animating) return;
+
+  AnimationSnapshot snapshot;
+  snapshot.id = (AnimationId)entry.animation;
+  snapshot.params = {
+    entry.params[0], entry.params[1], entry.params[2],
+    entry.params[3], entry.params[4], entry.params[5]
+  };
+  snapshot.originBrightness = entry.originBrightness;
+  snapshot.originR = entry.originR;
+  snapshot.originG = entry.originG;
+  snapshot.originB = entry.originB;
+  snapshot.elapsedMs = entry.elapsedMs;
+  snapshot.paused = entry.paused;
+  anim.resume(snapshot);
+  anim.loop();  // Render the point reached before the first write
 }
 
 // ======================= SETUP ==============================
 
 void setup() {
+  // Fast path to light: config, PWM and the first write come before
+  // anything that logs, waits or touches the radio
+  bootTimeline.mark(BootTimeline::SETUP);
   Serial.begin(115200);
-  delay(1000);
-  Serial.println("\n=== IKEA Head Lamp – Modular Firmware ===");
 
-  // Initialize system monitor
-  sysmon.begin();
-
-  // Enable watchdog (30 second timeout - increased for WiFi/MQTT blocking)
-  esp_task_wdt_init(30, true);
-  esp_task_wdt_add(NULL);
-  Serial.println("[SYS] Watchdog enabled (30s timeout)");
-
-  // Initialize config and state
   config.load();
-  
-  state.powerOn = false;
+  bootTimeline.mark(BootTimeline::CONFIG);
+
+  // Without a journal record, power applied at the wall switch means
+  // light and after any other reset the lamp comes back dark
+  state.powerOn = (esp_reset_reason() == ESP_RST_POWERON);
   state.brightness = config.defaultBrightness;
   state.colorR = config.defaultColorR;
   state.colorG = config.defaultColorG;
@@ -655,53 +986,153 @@ void setup() {
   state.sessionId = (uint32_t)esp_random();
   state.version = 1;
 
-  // Initialize hardware
+  // Otherwise resume exactly where the lamp was, animation included
+  anim.begin(&state, &config);
+  bool journaling = journalFlash.begin(JOURNAL_PARTITION) && journal.begin(&journalFlash);
+  StateJournal::Entry saved;
+  bool resumed = journaling && journal.restore(saved);
+  if (resumed) resumeJournal(saved);
+
   lamp.begin();
+  applyBrightnessCurve();
+  lamp.apply(state.powerOn, state.brightness,
+             state.colorR, state.colorG, state.colorB,
+             config.minPwmPercent, config.maxPwmPercent);
+  bootTimeline.mark(BootTimeline::LIGHT);
+
+  // Everything else follows first light
+  Serial.println("\n=== IKEA Head Lamp – Modular Firmware ===");
+  Serial.printf("[BOOT] Light %s after %lu us\n", state.powerOn ? "on" : "off",
+                (unsigned long)bootTimeline.atUs(BootTimeline::LIGHT));
+  if (!journaling) {
+    Serial.println("[JOURNAL] No journal partition, state is not kept");
+  } else {
+    Serial.printf("[JOURNAL] %s\n", resumed ? "Resumed saved state" : "No saved state");
+  }
+  sysmon.begin();
+  config.print();
+
+  // Enable watchdog. The loop never waits on the network and sleeps at
+  // most MAX_SLEEP_MS, so a short timeout is safe.
+  esp_task_wdt_init(10, true);
+  esp_task_wdt_add(NULL);
+  Serial.println("[SYS] Watchdog enabled (10s timeout)");
+
+  // Power management: loop sleeps between deadlines, button ISR wakes it
+  sleeper.begin();
+
+  button.setSleepManager(&sleeper);
   button.begin();
   statusLED.begin();
   statusLED.startupAnimation();
 
   // Initialize network
   wifi.setStatusLED(&statusLED);
+  wifi.setBootTimeline(&bootTimeline);
   wifi.begin();
   
+  // Own topic tree and client id per lamp, so many can share a broker
+  uint8_t mac[6];
+  esp_read_mac(mac, ESP_MAC_WIFI_STA);
+  mqtt.setIdentity(config.mqttBase.c_str(), mac);
+  router.setBase(mqtt.baseTopic());
+
   mqtt.setStatusLED(&statusLED);
+  mqtt.setBootTimeline(&bootTimeline);
+  mqtt.setPublishInterval(PUBLISH_MIN_INTERVAL_MS);
+  mqtt.setInbox(&inbox);
+  mqtt.setWakeOnReceive(&sleeper);
+  registerMqttRoutes();
   mqtt.begin(handleMqttMessage);
 
-  // Initialize animation engine
-  anim.begin(&state, &config);
+  // Wall-clock time for "at=" commands, synced by the network task
+  sntp.setServer(NTP_HOST);
 
-  // Apply initial state to hardware
-  lamp.apply(state.powerOn, state.brightness, 
-             state.colorR, state.colorG, state.colorB,
-             config.minPwmPercent, config.maxPwmPercent);
+  // WiFi and MQTT run in their own task from here on
+  vTaskPrioritySet(nullptr, RENDER_TASK_PRIORITY);
+  network.begin();
+
+  // Real-time frames from external effect engines (UDP, render loop)
+  stream.begin();
 
-  // Initial MQTT publishes will happen in loop() once connected
+  // Animation time shared with the other lamps of the group (multicast)
+  phaseGroup.setTransport();
+  phaseGroup.setMemberId(state.sessionId);
+  phaseGroup.join(config.phaseGroup.c_str());
+
+  // Sent by mqtt.service() once connected
+  mqtt.queueConfig(config);
+  mqtt.queueState(state, true);
   
-  Serial.println("[MAIN] Setup complete");
+  bootTimeline.mark(BootTimeline::READY);
+  Serial.printf("[MAIN] Setup complete after %lu us\n",
+                (unsigned long)bootTimeline.atUs(BootTimeline::READY));
+}
+
+// ======================= LOOP DEADLINES =====================
+
+// Remaining time of a periodic timer that fires once 'interval' has passed
+static unsigned long untilPeriod(unsigned long last, unsigned long interval, unsigned long now) {
+  unsigned long elapsed = now - last;
+  return elapsed > interval ? 0 : interval - elapsed + 1;
+}
+
+static unsigned long msUntilNextDeadline() {
+  unsigned long now = millis();
+  unsigned long wait = MAX_SLEEP_MS;
+
+  if (stream.active()) {
+    // Frames wake the loop through the socket; state waits for the timeout
+    wait = min(wait, stream.msUntilTimeout());
+  } else {
+    // Hardware apply is pending until the throttle window reopens
+    if (lastApplied.hasChanged(state.powerOn, state.brightness,
+                               state.colorR, state.colorG, state.colorB,
+                               config.minPwmPercent, config.maxPwmPercent)) {
+      unsigned long sinceApply = now - lastHardwareUpdate;
+      wait = min(wait, sinceApply >= HARDWARE_UPDATE_INTERVAL_MS ? 0UL : HARDWARE_UPDATE_INTERVAL_MS - sinceApply);
+    }
+    wait = min(wait, anim.msUntilUpdate());
+    wait = min(wait, colorTest.msUntilUpdate(now));
+  }
+
+  wait = min(wait, lamp.msUntilUpdate());
+  wait = min(wait, button.msUntilUpdate());
+  wait = min(wait, phaseGroup.msUntilPoll());
+  wait = min(wait, mqtt.msUntilService());
+  wait = min(wait, journal.msUntilWrite());
+  if (!inbox.isEmpty()) wait = 0;
+  uint64_t dueMs;
+  if (scheduler.nextDue(dueMs)) {
+    wait = min(wait, dueMs == 0 ? 0UL : wallClock.msUntil(dueMs));
+  }
+  wait = min(wait, untilPeriod(lastStatePublish, STATE_PUBLISH_INTERVAL_MS, now));
+  wait = min(wait, untilPeriod(lastHeartbeat, HEARTBEAT_INTERVAL_MS, now));
+  wait = min(wait, untilPeriod(lastDiagnosticsPublish, DIAGNOSTICS_PUBLISH_INTERVAL_MS, now));
+  return wait;
 }
 
 // ======================= MAIN LOOP ===============
 
 void loop() {
+  unsigned long frameStart = micros();
   esp_task_wdt_reset();
 
   // Update system monitor
   sysmon.incrementLoop();
   sysmon.update();
 
-  // Maintain network connections
-  wifi.loop();
-  mqtt.loop();
-  
-  // Publish initial state/config once after first MQTT connection
-  static bool initialPublishDone = false;
-  if (!initialPublishDone && mqtt.connected()) {
-    mqtt.publishConfig(config);
-    mqtt.publishState(state, true);
-    initialPublishDone = true;
+  // Adopt time syncs from the network task
+  WallClock::Sync sync;
+  while (sntp.takeSync(sync)) {
+    bool first = !wallClock.synced();
+    wallClock.apply(sync);
+    if (first) Serial.printf("[SYNC] Clock synced (round trip %u ms)\n", (unsigned)sync.rttMs);
   }
 
+  // Handle commands queued by the network task, then due timed commands
+  processCommands();
+  
   // Handle button input
   ButtonEvent btnEvent = button.update();
   
@@ -724,7 +1155,7 @@ void loop() {
       anim.stop();
     }
     
-    mqtt.publishState(state, true);
+    mqtt.queueState(state, true);
   }
   
   if (btnEvent == ButtonEvent::LongPress) {
@@ -733,7 +1164,7 @@ void loop() {
     // Long press: Toggle pause/play current animation
     anim.togglePause();
     
-    mqtt.publishState(state, true);
+    mqtt.queueState(state, true);
   }
   
   if (btnEvent == ButtonEvent::DoublePress) {
@@ -742,40 +1173,69 @@ void loop() {
     // Double click: Start favorite animation
     anim.startFavorite();
     
-    mqtt.publishState(state, true);
+    mqtt.queueState(state, true);
+  }
+
+  // Real-time stream: frames go straight to the LEDs, unthrottled, while
+  // animations and state wait; the state comes back when the sender stops
+  FrameStream::Event streamEvent = stream.poll();
+  if (streamEvent == FrameStream::Event::Frame) {
+    FrameStream::Color c = stream.color();
+    lamp.apply(true, 100, c.r, c.g, c.b, config.minPwmPercent, config.maxPwmPercent);
+  } else if (streamEvent == FrameStream::Event::Timeout) {
+    lastApplied.invalidate();
+  }
+
+  // Group beacons; looping animations run on the group's time
+  phaseGroup.poll();
+
+  if (!stream.active()) {
+    // Update animations and scheduled jobs
+    if (phaseGroup.locked()) anim.alignPhase(phaseGroup.now());
+    anim.loop();
+    colorTest.update(millis());
   }
 
-  // Update animations
-  anim.loop();
+  // Advance hardware fades (segment boundaries, slow channels)
+  lamp.update();
 
   // Apply state to hardware only if changed (throttled to ~30 FPS max)
-  static unsigned long lastHardwareUpdate = 0;
   unsigned long now = millis();
   
-  if ((now - lastHardwareUpdate) >= 33) {  // Max 30 updates/sec
+  if (!stream.active() && (now - lastHardwareUpdate) >= HARDWARE_UPDATE_INTERVAL_MS) {
     if (lastApplied.hasChanged(state.powerOn, state.brightness,
                                 state.colorR, state.colorG, state.colorB,
                                 config.minPwmPercent, config.maxPwmPercent)) {
-      lamp.apply(state.powerOn, state.brightness,
-                 state.colorR, state.colorG, state.colorB,
-                 config.minPwmPercent, config.maxPwmPercent);
+      lamp.fadeTo(state.powerOn, state.brightness,
+                  state.colorR, state.colorG, state.colorB,
+                  config.minPwmPercent, config.maxPwmPercent,
+                  state.transitionMs);
       lastApplied.update(state.powerOn, state.brightness,
                          state.colorR, state.colorG, state.colorB,
                          config.minPwmPercent, config.maxPwmPercent);
     }
+    state.transitionMs = 0;  // Consumed by this apply
     lastHardwareUpdate = now;
   }
 
+  // Record the light for power-loss resume (coalesced by the journal)
+  journal.record(journalEntry());
+
   // Periodic state publishing (only if state changed since last publish)
   static uint32_t lastPublishedVersion = 0;
   if (now - lastStatePublish > STATE_PUBLISH_INTERVAL_MS) {
     lastStatePublish = now;
     if (state.version != lastPublishedVersion) {
-      mqtt.publishState(state, false);
+      mqtt.queueState(state, false);
       lastPublishedVersion = state.version;
     }
   }
 
+  // Boot timeline, once the broker is first reachable
+  if (!bootReported && mqtt.connected()) {
+    bootReported = mqtt.publishBootReport(sysmon.getResetReason());
+  }
+
   // Periodic heartbeat (so you know it's alive)
   if (now - lastHeartbeat > HEARTBEAT_INTERVAL_MS) {
     lastHeartbeat = now;
@@ -786,20 +1246,25 @@ void loop() {
   if (now - lastDiagnosticsPublish > DIAGNOSTICS_PUBLISH_INTERVAL_MS) {
     lastDiagnosticsPublish = now;
     
-    // Calculate loops per second
-    static unsigned long lastLoopCount = 0;
-    unsigned long currentLoopCount = sysmon.getLoopCount();
-    unsigned long loopsPerSec = (currentLoopCount - lastLoopCount) / (DIAGNOSTICS_PUBLISH_INTERVAL_MS / 1000);
-    lastLoopCount = currentLoopCount;
-    
     // Diagnostics published to MQTT - no serial output needed
     // (was blocking and causing the slow loop it was trying to warn about!)
     
     mqtt.publishDiagnostics(sysmon.getUptimeSeconds(), sysmon.getFreeHeap(),
                             sysmon.getMinFreeHeap(), sysmon.getResetReason(),
-                            sysmon.getLoopCount());
+                            sysmon.getLoopCount(), sysmon.getIdlePercent(),
+                            frameStats, wallClock, scheduler, phaseGroup, wifi);
+    frameStats.reset();
+    scheduler.resetStats();
+    phaseGroup.resetStats();
   }
-  
-  // Small delay to reduce CPU load and heat (allows WiFi to use light sleep)
-  delay(1);  // 1ms delay = ~1000 loops/sec max (still plenty responsive)
+
+  // Hand due state/config publishes to the network task
+  mqtt.service();
+
+  frameStats.record(micros() - frameStart);
+
+  // Sleep until the earliest deadline (the network task wakes us for commands)
+  sleeper.setLightSleepAllowed(!lamp.isLit());
+  sysmon.addIdleTime(sleeper.sleep(msUntilNextDeadline(), stream.socketFd(), false,
+                                   phaseGroup.socketFd()));
 }
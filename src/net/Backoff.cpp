@@ -0,0 +1,52 @@
+#include "Backoff.h"
+
+namespace {
+
+const uint32_t DEFAULT_SEED = 2463534242UL;
+
+}  // namespace
+
+Backoff::Backoff(unsigned long first, unsigned long cap)
+  : clock(&Clock::system()), firstMs(first), capMs(cap), state(DEFAULT_SEED),
+    count(0), lastAttempt(0), delayMs(0) {
+}
+
+void Backoff::seed(uint32_t value) {
+  state = value ? value : DEFAULT_SEED;
+}
+
+uint32_t Backoff::random() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+bool Backoff::due() const {
+  return count == 0 || clock->millis() - lastAttempt >= delayMs;
+}
+
+void Backoff::attempt() {
+  // Window for the gap after attempt n: firstMs << (n - 1), capped
+  unsigned long window = firstMs;
+  for (uint32_t i = 0; i < count && window < capMs; i++) window <<= 1;
+  if (window > capMs) window = capMs;
+
+  // Equal jitter: never sooner than half the window, so the schedule
+  // still backs off, but spread over the other half
+  unsigned long half = window / 2;
+  delayMs = half + (half > 0 ? random() % (window - half + 1) : 0);
+  lastAttempt = clock->millis();
+  count++;
+}
+
+void Backoff::reset() {
+  count = 0;
+  delayMs = 0;
+}
+
+unsigned long Backoff::msUntilDue() const {
+  if (count == 0) return 0;
+  unsigned long elapsed = clock->millis() - lastAttempt;
+  return elapsed >= delayMs ? 0 : delayMs - elapsed;
+}
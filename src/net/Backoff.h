@@ -0,0 +1,70 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <Arduino.h>
+#include "../hw/Clock.h"
+
+/**
+ * Retry schedule for reconnecting: exponential backoff with jitter.
+ *
+ * Responsibilities:
+ * - Allow the first retry after reset() at once (a short blip heals fast)
+ * - Space the following ones by a random delay in [w/2, w], where the
+ *   window w doubles from firstMs with every attempt up to capMs
+ * - Count the attempts since the last reset() for diagnostics
+ *
+ * Lamps that lost the same broker or access point at the same moment
+ * would otherwise retry in lockstep and hit it all at once when it comes
+ * back. The jitter spreads them over the window; the doubling keeps the
+ * total rate low during a long outage. Each instance has its own
+ * generator, seeded per device (seed()).
+ */
+class Backoff {
+public:
+  Backoff(unsigned long firstMs, unsigned long capMs);
+
+  void setClock(const Clock* c) { clock = c; }
+
+  /**
+   * Seed the jitter; devices should use different seeds (0 is replaced).
+   */
+  void seed(uint32_t value);
+
+  /**
+   * Check if the next attempt may start now.
+   */
+  bool due() const;
+
+  /**
+   * Record an attempt started now and schedule the next one.
+   */
+  void attempt();
+
+  /**
+   * Connection is back (or healthy again): the next retry is immediate.
+   */
+  void reset();
+
+  /**
+   * Time until the next attempt is due.
+   *
+   * @return Milliseconds (0 = now)
+   */
+  unsigned long msUntilDue() const;
+
+  uint32_t attempts() const { return count; }
+  unsigned long lastDelayMs() const { return delayMs; }   // Delay scheduled by attempt()
+
+private:
+  const Clock* clock;
+  unsigned long firstMs;
+  unsigned long capMs;
+  uint32_t state;          // xorshift32
+  uint32_t count;
+  unsigned long lastAttempt;
+  unsigned long delayMs;
+
+  uint32_t random();
+};
+
+#endif // BACKOFF_H
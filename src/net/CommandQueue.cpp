@@ -0,0 +1,73 @@
+#include "CommandQueue.h"
+
+CommandQueue::CommandQueue()
+  : head(0), tail(0), coalesced(0), dropped(0) {
+  current.route = 0;
+  current.coalesce = false;
+  current.length = 0;
+}
+
+bool CommandQueue::push(uint8_t route, const MessageView& payload, bool coalesce) {
+  uint8_t h = head.load(std::memory_order_relaxed);
+  uint8_t next = (h + 1) & (QUEUE_SIZE - 1);
+  if (payload.length() > MAX_PAYLOAD || next == tail.load(std::memory_order_acquire)) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  Entry& e = entries[h];
+  e.route = route;
+  e.coalesce = coalesce;
+  e.length = (uint8_t)payload.length();
+  memcpy(e.payload, payload.data(), e.length);
+  head.store(next, std::memory_order_release);
+  return true;
+}
+
+bool CommandQueue::pop(Command& command) {
+  uint8_t h = head.load(std::memory_order_acquire);
+  uint8_t t = tail.load(std::memory_order_relaxed);
+
+  while (t != h) {
+    const Entry& e = entries[t];
+    bool skip = e.coalesce && supersededAfter(t, h);
+    if (!skip) current = e;
+    t = (t + 1) & (QUEUE_SIZE - 1);
+    tail.store(t, std::memory_order_release);
+
+    if (skip) {
+      coalesced++;
+      continue;
+    }
+    command.route = current.route;
+    command.payload = MessageView(current.payload, current.length);
+    return true;
+  }
+  return false;
+}
+
+// Entries between index and h are published and stable until popped
+bool CommandQueue::supersededAfter(uint8_t index, uint8_t h) const {
+  uint8_t route = entries[index].route;
+  for (uint8_t i = (index + 1) & (QUEUE_SIZE - 1); i != h; i = (i + 1) & (QUEUE_SIZE - 1)) {
+    if (entries[i].route == route && entries[i].coalesce) return true;
+  }
+  return false;
+}
+
+bool CommandQueue::isEmpty() const {
+  return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+}
+
+bool CommandQueue::isFull() const {
+  uint8_t next = (head.load(std::memory_order_acquire) + 1) & (QUEUE_SIZE - 1);
+  return next == tail.load(std::memory_order_acquire);
+}
+
+uint32_t CommandQueue::coalescedCount() const {
+  return coalesced;
+}
+
+uint32_t CommandQueue::droppedCount() const {
+  return dropped.load(std::memory_order_relaxed);
+}
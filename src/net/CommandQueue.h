@@ -0,0 +1,91 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "MessageView.h"
+
+/**
+ * Lock-free ring of received commands, filled by the network task and
+ * drained by the render loop.
+ *
+ * Responsibilities:
+ * - Copy payloads out of the MQTT client buffer so handlers run later,
+ *   on the render side
+ * - Collapse superseded commands of the same kind to the latest one
+ * - Report when full so the receiver can stop reading (backpressure)
+ *
+ * Single producer (push, isFull) and single consumer (pop). Coalescing
+ * happens when popping: a coalescing command is skipped if a newer one
+ * for the same route is already queued behind it, so ordering with other
+ * commands is preserved: "brightness 50, off, brightness 60" still ends
+ * with the lamp on at 60. Only coalescing commands supersede each other;
+ * a timed "brightness 50:at=T" neither replaces nor is replaced by its
+ * neighbours.
+ */
+class CommandQueue {
+public:
+  static const uint8_t QUEUE_SIZE = 8;          // Power of two
+  static const uint8_t MAX_PAYLOAD = 255;       // Room for a cmnd/json batch
+
+  /**
+   * A queued command. The payload view stays valid until the next pop().
+   */
+  struct Command {
+    uint8_t route;
+    MessageView payload;
+  };
+
+  CommandQueue();
+
+  /**
+   * Producer: queue a command.
+   *
+   * @param route Route id from TopicRouter::resolve()
+   * @param payload Payload (copied)
+   * @param coalesce Take part in coalescing: superseded by, and superseding,
+   *                 other coalescing commands of the route. False for
+   *                 commands that must run regardless (timed ones)
+   * @return False if dropped (queue full or payload too long)
+   */
+  bool push(uint8_t route, const MessageView& payload, bool coalesce);
+
+  /**
+   * Consumer: take the oldest command that has not been superseded.
+   *
+   * @return False if the queue is empty
+   */
+  bool pop(Command& command);
+
+  bool isEmpty() const;
+  bool isFull() const;
+
+  /**
+   * Commands skipped because a newer one of the same route followed.
+   */
+  uint32_t coalescedCount() const;
+
+  /**
+   * Commands dropped since boot.
+   */
+  uint32_t droppedCount() const;
+
+private:
+  struct Entry {
+    uint8_t route;
+    bool coalesce;
+    uint8_t length;
+    char payload[MAX_PAYLOAD];
+  };
+
+  Entry entries[QUEUE_SIZE];
+  std::atomic<uint8_t> head;  // Next write, owned by the producer
+  std::atomic<uint8_t> tail;  // Next read, owned by the consumer
+  Entry current;              // Popped entry the returned view points into
+  uint32_t coalesced;         // Consumer only
+  std::atomic<uint32_t> dropped;
+
+  bool supersededAfter(uint8_t index, uint8_t h) const;
+};
+
+#endif // COMMAND_QUEUE_H
@@ -0,0 +1,143 @@
+#include "CommandScheduler.h"
+#include "JsonReader.h"
+
+namespace {
+
+// Plain decimal, at most 16 digits (epoch milliseconds until year 318857)
+bool parseEpochMs(const MessageView& text, uint64_t& value) {
+  if (text.isEmpty() || text.length() > 16) return false;
+  uint64_t v = 0;
+  for (size_t i = 0; i < text.length(); i++) {
+    char c = text[i];
+    if (c < '0' || c > '9') return false;
+    v = v * 10 + (uint64_t)(c - '0');
+  }
+  value = v;
+  return true;
+}
+
+bool findJsonAt(const MessageView& payload, uint64_t& atMs) {
+  JsonReader json(payload);
+  MessageView key;
+  MessageView token;
+  bool found = false;
+
+  if (!json.enterObject()) return false;
+  while (json.nextKey(key)) {
+    if (key.equals("at") && json.peek() == JsonReader::Type::Number) {
+      json.readNumber(token);
+      found = parseEpochMs(token, atMs);
+    } else {
+      json.skipValue();
+    }
+  }
+  return json.finish() && found;
+}
+
+}  // namespace
+
+CommandScheduler::CommandScheduler()
+  : count(0), dropped(0), executed(0), maxSkew(0) {
+  current.atMs = 0;
+  current.route = 0;
+  current.length = 0;
+}
+
+bool CommandScheduler::findAt(const MessageView& payload, uint64_t& atMs,
+                              MessageView& head, MessageView& tail) {
+  if (!payload.isEmpty() && payload[0] == '{') {
+    if (!findJsonAt(payload, atMs)) return false;
+    head = payload;
+    tail = MessageView();
+    return true;
+  }
+
+  // ":at=" anywhere, or "at=" opening an otherwise empty payload
+  size_t start;
+  size_t digits;
+  int idx = payload.indexOf(":at=");
+  if (idx >= 0) {
+    start = (size_t)idx;
+    digits = start + 4;
+  } else if (payload.length() >= 3 && payload.substring(0, 3).equals("at=")) {
+    start = 0;
+    digits = 3;
+  } else {
+    return false;
+  }
+
+  size_t end = digits;
+  while (end < payload.length() && payload[end] >= '0' && payload[end] <= '9') end++;
+  if (!parseEpochMs(payload.substring(digits, end), atMs)) return false;
+
+  head = payload.substring(0, start);
+  tail = payload.substring(end);
+  if (head.isEmpty() && !tail.isEmpty() && tail[0] == ':') tail = tail.substring(1);
+  return true;
+}
+
+bool CommandScheduler::schedule(uint8_t route, uint64_t atMs, const MessageView& head,
+                                const MessageView& tail) {
+  size_t length = head.length() + tail.length();
+  if (count >= CAPACITY || length > MAX_PAYLOAD) {
+    dropped++;
+    return false;
+  }
+
+  // Free slot: the one not referenced by order[0..count)
+  uint8_t slot = 0;
+  for (; slot < CAPACITY; slot++) {
+    bool used = false;
+    for (uint8_t i = 0; i < count && !used; i++) used = order[i] == slot;
+    if (!used) break;
+  }
+
+  Entry& e = entries[slot];
+  e.atMs = atMs;
+  e.route = route;
+  e.length = (uint8_t)length;
+  if (!head.isEmpty()) memcpy(e.payload, head.data(), head.length());
+  if (!tail.isEmpty()) memcpy(e.payload + head.length(), tail.data(), tail.length());
+
+  // Insert after every entry due at the same time or earlier
+  uint8_t pos = count;
+  while (pos > 0 && entries[order[pos - 1]].atMs > atMs) {
+    order[pos] = order[pos - 1];
+    pos--;
+  }
+  order[pos] = slot;
+  count++;
+  return true;
+}
+
+bool CommandScheduler::popDue(uint64_t nowMs, Command& command) {
+  if (count == 0) return false;
+  const Entry& first = entries[order[0]];
+  if (first.atMs > nowMs) return false;
+
+  current = first;
+  count--;
+  memmove(order, order + 1, count);
+
+  if (current.atMs != 0) {
+    uint64_t skew = nowMs - current.atMs;
+    if (skew > maxSkew) maxSkew = skew > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)skew;
+    executed++;
+  }
+
+  command.route = current.route;
+  command.atMs = current.atMs;
+  command.payload = MessageView(current.payload, current.length);
+  return true;
+}
+
+bool CommandScheduler::nextDue(uint64_t& atMs) const {
+  if (count == 0) return false;
+  atMs = entries[order[0]].atMs;
+  return true;
+}
+
+void CommandScheduler::resetStats() {
+  executed = 0;
+  maxSkew = 0;
+}
@@ -0,0 +1,102 @@
+#ifndef COMMAND_SCHEDULER_H
+#define COMMAND_SCHEDULER_H
+
+#include <Arduino.h>
+#include "MessageView.h"
+#include "CommandQueue.h"
+
+/**
+ * Time-ordered queue of commands to run at a wall-clock instant.
+ *
+ * Responsibilities:
+ * - Find the execution time in a payload (":at=<epoch_ms>" suffix, or
+ *   an "at" member of a JSON object) and strip it
+ * - Keep deferred commands sorted by due time, ties in arrival order
+ * - Hand out due commands and measure how late each one ran
+ *
+ * Render loop only. Times are Unix epoch milliseconds from WallClock;
+ * time 0 means "as soon as possible" (used while the clock is not
+ * synced) and is not counted in the skew statistics.
+ */
+class CommandScheduler {
+public:
+  static const uint8_t CAPACITY = 8;
+  static const uint8_t MAX_PAYLOAD = CommandQueue::MAX_PAYLOAD;
+
+  /**
+   * A due command. The payload view stays valid until the next popDue().
+   */
+  struct Command {
+    uint8_t route;
+    uint64_t atMs;
+    MessageView payload;
+  };
+
+  CommandScheduler();
+
+  /**
+   * Look for an execution time in a payload.
+   *
+   * For text payloads the ":at=<ms>" part is cut out: "50:at=...:transition_ms=500"
+   * gives head "50" and tail ":transition_ms=500". JSON payloads are
+   * left whole (head), since handlers ignore unknown members.
+   *
+   * @return False if the payload has no (valid) execution time
+   */
+  static bool findAt(const MessageView& payload, uint64_t& atMs,
+                     MessageView& head, MessageView& tail);
+
+  /**
+   * Queue a command. The stored payload is head followed by tail.
+   *
+   * @return False if the queue is full or the payload too long
+   */
+  bool schedule(uint8_t route, uint64_t atMs, const MessageView& head,
+                const MessageView& tail = MessageView());
+
+  /**
+   * Take the earliest command due at nowMs.
+   *
+   * @return False if nothing is due
+   */
+  bool popDue(uint64_t nowMs, Command& command);
+
+  /**
+   * Due time of the earliest command.
+   *
+   * @return False if the queue is empty
+   */
+  bool nextDue(uint64_t& atMs) const;
+
+  bool isEmpty() const { return count == 0; }
+  uint8_t size() const { return count; }
+
+  /**
+   * Commands rejected because the queue was full.
+   */
+  uint32_t droppedCount() const { return dropped; }
+
+  // Skew statistics over timed commands since resetStats()
+  uint32_t executedCount() const { return executed; }
+  uint32_t maxSkewMs() const { return maxSkew; }       // Latest run past due time
+  void resetStats();
+
+private:
+  struct Entry {
+    uint64_t atMs;
+    uint8_t route;
+    uint8_t length;
+    char payload[MAX_PAYLOAD];
+  };
+
+  Entry entries[CAPACITY];
+  uint8_t order[CAPACITY];   // Entry indices by due time
+  uint8_t count;
+  Entry current;             // Popped entry the returned view points into
+
+  uint32_t dropped;
+  uint32_t executed;
+  uint32_t maxSkew;
+};
+
+#endif // COMMAND_SCHEDULER_H
@@ -0,0 +1,176 @@
+#include "FrameStream.h"
+#include "../state/Bytes.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+namespace {
+
+// DDP header (all fields big endian)
+//   0  flags: version (bits 7-6 = 01), timecode, storage, reply, query, push
+//   1  sequence number (low nibble, 0 = unused)
+//   2  data type
+//   3  destination id
+//   4  data offset in bytes
+//   8  data length in bytes
+//  10  timecode (only with the timecode flag), then the data
+const uint8_t DDP_VERSION_MASK = 0xC0;
+const uint8_t DDP_VERSION_1    = 0x40;
+const uint8_t DDP_FLAG_TIMECODE = 0x10;
+const uint8_t DDP_FLAG_QUERY   = 0x02;
+
+const size_t DDP_HEADER    = 10;
+const size_t DDP_TIMECODE  = 4;
+
+const uint8_t DDP_TYPE_UNDEFINED = 0x00;
+const uint8_t DDP_TYPE_RGB_LEGACY = 0x01;  // Sent by older tools
+const uint8_t DDP_TYPE_RGB8   = 0x0B;      // RGB, 8 bits per channel
+
+const uint8_t DDP_ID_DEFAULT = 1;
+
+}  // namespace
+
+FrameStream::FrameStream()
+  : clock(&Clock::system()), fd(-1), boundPort(0), timeoutMs(DEFAULT_TIMEOUT_MS),
+    streaming(false), lastFrameMs(0), lastSequence(0), current{0, 0, 0},
+    frames(0), lost(0), late(0) {
+}
+
+FrameStream::~FrameStream() {
+  if (fd >= 0) close(fd);
+}
+
+bool FrameStream::begin(uint16_t port) {
+  end();
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    Serial.println("[DDP] ERROR: Failed to create socket");
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    Serial.printf("[DDP] ERROR: Failed to bind port %u\n", port);
+    close(fd);
+    fd = -1;
+    return false;
+  }
+
+  socklen_t addrLen = sizeof(addr);
+  getsockname(fd, (struct sockaddr*)&addr, &addrLen);
+  boundPort = ntohs(addr.sin_port);
+  Serial.printf("[DDP] Listening on UDP port %u\n", boundPort);
+  return true;
+}
+
+void FrameStream::end() {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+  boundPort = 0;
+  streaming = false;
+}
+
+bool FrameStream::parse(const uint8_t* data, size_t length, Packet& packet) {
+  if (length < DDP_HEADER) return false;
+
+  uint8_t flags = data[0];
+  if ((flags & DDP_VERSION_MASK) != DDP_VERSION_1) return false;
+  if (flags & DDP_FLAG_QUERY) return false;
+
+  uint8_t type = data[2];
+  if (type != DDP_TYPE_UNDEFINED && type != DDP_TYPE_RGB_LEGACY && type != DDP_TYPE_RGB8) {
+    return false;
+  }
+  if (data[3] > DDP_ID_DEFAULT) return false;  // Control, config or status
+
+  size_t header = DDP_HEADER + ((flags & DDP_FLAG_TIMECODE) ? DDP_TIMECODE : 0);
+  if (length < header) return false;
+
+  // A long frame arrives truncated to the receive buffer; only the first
+  // pixel matters, so trust the shorter of stated and received length
+  uint32_t offset = Bytes::readU32(data + 4);
+  size_t dataLength = ((size_t)data[8] << 8) | data[9];
+  size_t available = length - header;
+  if (dataLength < available) available = dataLength;
+  if (offset != 0 || available < 3) return false;
+
+  packet.sequence = data[1] & 0x0F;
+  packet.color.r = data[header];
+  packet.color.g = data[header + 1];
+  packet.color.b = data[header + 2];
+  return true;
+}
+
+bool FrameStream::accept(const Packet& packet) {
+  if (streaming && packet.sequence != 0 && lastSequence != 0) {
+    // Sequence runs 1..15 and wraps past 0
+    int8_t step = (int8_t)((packet.sequence - lastSequence + 15) % 15);
+    if (step == 0 || step > 7) {
+      late++;
+      return false;
+    }
+    lost += step - 1;
+  }
+  lastSequence = packet.sequence;
+  current = packet.color;
+  frames++;
+  return true;
+}
+
+FrameStream::Event FrameStream::poll() {
+  if (fd < 0) return Event::None;
+
+  bool received = false;
+  uint8_t buf[PACKET_SIZE];
+  for (uint8_t i = 0; i < MAX_READS_PER_POLL; i++) {
+    ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, nullptr, nullptr);
+    if (n < 0) break;  // EWOULDBLOCK: drained
+
+    Packet packet;
+    if (!parse(buf, (size_t)n, packet)) continue;
+
+    if (!streaming) {
+      // New stream: forget the previous sender's sequence and counters
+      lastSequence = 0;
+      frames = lost = late = 0;
+    }
+    if (accept(packet)) {
+      received = true;
+      if (!streaming) {
+        streaming = true;
+        Serial.println("[DDP] Stream started");
+      }
+    }
+  }
+
+  unsigned long now = clock->millis();
+  if (received) {
+    lastFrameMs = now;
+    return Event::Frame;
+  }
+  if (streaming && now - lastFrameMs >= timeoutMs) {
+    streaming = false;
+    Serial.printf("[DDP] Stream ended: %lu frames, %lu lost, %lu late\n",
+                  (unsigned long)frames, (unsigned long)lost, (unsigned long)late);
+    return Event::Timeout;
+  }
+  return Event::None;
+}
+
+unsigned long FrameStream::msUntilTimeout() const {
+  if (!streaming) return Clock::NO_DEADLINE;
+  unsigned long elapsed = clock->millis() - lastFrameMs;
+  return elapsed >= timeoutMs ? 0 : timeoutMs - elapsed;
+}
@@ -0,0 +1,126 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <Arduino.h>
+#include "../hw/Clock.h"
+
+/**
+ * Real-time color frames over UDP (DDP, Distributed Display Protocol).
+ *
+ * Responsibilities:
+ * - Receive DDP packets on a non-blocking UDP socket
+ * - Extract the lamp's single RGB pixel (channels 0-2 of the frame)
+ * - Drop duplicate and late packets by their 4-bit sequence number and
+ *   count the ones lost on the way
+ * - End the stream when the sender goes quiet
+ *
+ * Owned by the render loop, which sleeps on socketFd() and writes each
+ * frame straight to LampHardware, so a frame costs one recvfrom() and
+ * one PWM write - no broker, task hop or animation in between. A burst
+ * of queued packets collapses into the newest one.
+ *
+ * Any DDP sender works (WLED, xLights, LedFx, Hyperion): configure the
+ * lamp as a one-pixel RGB device on port 4048.
+ */
+class FrameStream {
+public:
+  static const uint16_t DEFAULT_PORT = 4048;
+  static const uint32_t DEFAULT_TIMEOUT_MS = 2500;
+
+  enum class Event : uint8_t {
+    None,
+    Frame,      // A new color is ready (color())
+    Timeout     // No frame for the timeout; the stream ended
+  };
+
+  struct Color {
+    uint8_t r, g, b;
+  };
+
+  /**
+   * Decoded DDP packet.
+   */
+  struct Packet {
+    uint8_t sequence;   // 1-15, 0 = sender does not number packets
+    Color   color;
+  };
+
+  FrameStream();
+  ~FrameStream();
+
+  /**
+   * Open the UDP socket. Works before WiFi is up.
+   *
+   * @param port UDP port (0 = any free port, see localPort())
+   * @return False if the socket could not be opened
+   */
+  bool begin(uint16_t port = DEFAULT_PORT);
+
+  /**
+   * Close the socket and end a running stream.
+   */
+  void end();
+
+  /**
+   * Read queued packets and check the timeout. Never blocks.
+   */
+  Event poll();
+
+  /**
+   * Color of the last accepted frame.
+   */
+  Color color() const { return current; }
+
+  /**
+   * Check if frames are arriving (first frame seen, no timeout yet).
+   */
+  bool active() const { return streaming; }
+
+  /**
+   * Time until the stream times out.
+   *
+   * @return Milliseconds, Clock::NO_DEADLINE when not streaming
+   */
+  unsigned long msUntilTimeout() const;
+
+  int socketFd() const { return fd; }
+  uint16_t localPort() const { return boundPort; }
+
+  void setTimeout(uint32_t ms) { timeoutMs = ms; }
+  void setClock(const Clock* c) { clock = c; }
+
+  // Counters for the current (or last) stream
+  uint32_t framesReceived() const { return frames; }
+  uint32_t framesLost() const { return lost; }      // Sequence gaps
+  uint32_t framesLate() const { return late; }      // Duplicate or out of order
+
+  /**
+   * Decode a DDP packet that carries channels 0-2.
+   *
+   * @return False for malformed packets, queries, other data types and
+   *         packets that do not cover the lamp's pixel
+   */
+  static bool parse(const uint8_t* data, size_t length, Packet& packet);
+
+private:
+  static const uint8_t  MAX_READS_PER_POLL = 16;
+  static const size_t   PACKET_SIZE = 64;   // Enough for a header and a few pixels
+
+  const Clock* clock;
+  int fd;
+  uint16_t boundPort;
+  uint32_t timeoutMs;
+
+  bool streaming;
+  unsigned long lastFrameMs;
+  uint8_t lastSequence;
+  Color current;
+
+  uint32_t frames;
+  uint32_t lost;
+  uint32_t late;
+
+  bool accept(const Packet& packet);
+};
+
+#endif // FRAME_STREAM_H
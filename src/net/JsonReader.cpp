@@ -0,0 +1,250 @@
+#include "JsonReader.h"
+
+namespace {
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+}  // namespace
+
+JsonReader::JsonReader(const char* data, size_t len)
+  : text(data ? data : ""), length(data ? len : 0), pos(0), depth(0), firstItem(0),
+    objectLevel(0), failed(false) {
+}
+
+JsonReader::JsonReader(const MessageView& view)
+  : JsonReader(view.data(), view.length()) {
+}
+
+void JsonReader::skipSpace() {
+  while (pos < length && isSpace(text[pos])) pos++;
+}
+
+bool JsonReader::fail() {
+  failed = true;
+  return false;
+}
+
+JsonReader::Type JsonReader::peek() {
+  if (failed) return Type::Invalid;
+  skipSpace();
+  if (pos >= length) return Type::Invalid;
+
+  char c = text[pos];
+  if (c == '{') return Type::Object;
+  if (c == '[') return Type::Array;
+  if (c == '"') return Type::String;
+  if (c == '-' || isDigit(c)) return Type::Number;
+  if (c == 't' || c == 'f') return Type::Bool;
+  if (c == 'n') return Type::Null;
+  return Type::Invalid;
+}
+
+bool JsonReader::push(bool object) {
+  if (depth >= MAX_DEPTH) return fail();
+  pos++;
+  uint16_t bit = (uint16_t)(1u << depth);
+  firstItem |= bit;
+  if (object) objectLevel |= bit;
+  else objectLevel &= (uint16_t)~bit;
+  depth++;
+  return true;
+}
+
+bool JsonReader::enterObject() {
+  if (peek() != Type::Object) return fail();
+  return push(true);
+}
+
+bool JsonReader::enterArray() {
+  if (peek() != Type::Array) return fail();
+  return push(false);
+}
+
+// Consume the ',' before a member/element, or the closing bracket
+bool JsonReader::separator(bool object, bool& closed) {
+  closed = false;
+  if (failed || depth == 0) return fail();
+  uint16_t bit = (uint16_t)(1u << (depth - 1));
+  if (((objectLevel & bit) != 0) != object) return fail();
+  skipSpace();
+  if (pos >= length) return fail();
+
+  char close = object ? '}' : ']';
+  bool first = (firstItem & bit) != 0;
+  if (text[pos] == close) {
+    pos++;
+    depth--;
+    closed = true;
+    return true;
+  }
+  if (!first) {
+    if (text[pos] != ',') return fail();
+    pos++;
+    skipSpace();
+  }
+  firstItem &= (uint16_t)~bit;
+  return true;
+}
+
+bool JsonReader::nextKey(MessageView& key) {
+  bool closed;
+  if (!separator(true, closed) || closed) return false;
+
+  if (!scanString(key)) return fail();
+  skipSpace();
+  if (pos >= length || text[pos] != ':') return fail();
+  pos++;
+  return true;
+}
+
+bool JsonReader::nextElement() {
+  bool closed;
+  if (!separator(false, closed) || closed) return false;
+  // A ']' right after ',' is a trailing comma
+  if (peek() == Type::Invalid) return fail();
+  return true;
+}
+
+bool JsonReader::scanString(MessageView& value) {
+  skipSpace();
+  if (pos >= length || text[pos] != '"') return false;
+  size_t start = ++pos;
+  while (pos < length && text[pos] != '"') {
+    if (text[pos] == '\\') pos++;  // Keep the escaped character
+    pos++;
+  }
+  if (pos >= length) return false;
+  value = MessageView(text + start, pos - start);
+  pos++;
+  return true;
+}
+
+bool JsonReader::scanNumber(MessageView& token) {
+  skipSpace();
+  size_t start = pos;
+  if (pos < length && text[pos] == '-') pos++;
+  size_t digits = pos;
+  while (pos < length && isDigit(text[pos])) pos++;
+  if (pos == digits) return false;
+
+  if (pos < length && text[pos] == '.') {
+    pos++;
+    size_t fraction = pos;
+    while (pos < length && isDigit(text[pos])) pos++;
+    if (pos == fraction) return false;
+  }
+  if (pos < length && (text[pos] == 'e' || text[pos] == 'E')) {
+    pos++;
+    if (pos < length && (text[pos] == '+' || text[pos] == '-')) pos++;
+    size_t exponent = pos;
+    while (pos < length && isDigit(text[pos])) pos++;
+    if (pos == exponent) return false;
+  }
+  token = MessageView(text + start, pos - start);
+  return true;
+}
+
+bool JsonReader::scanLiteral(const char* word) {
+  size_t n = strlen(word);
+  if (length - pos < n || memcmp(text + pos, word, n) != 0) return false;
+  pos += n;
+  return true;
+}
+
+bool JsonReader::readString(MessageView& value) {
+  if (peek() != Type::String || !scanString(value)) return fail();
+  return true;
+}
+
+bool JsonReader::readNumber(MessageView& token) {
+  if (peek() != Type::Number || !scanNumber(token)) return fail();
+  return true;
+}
+
+bool JsonReader::readInt(long& value) {
+  MessageView token;
+  if (!readNumber(token)) return false;
+  value = token.toInt();
+  return true;
+}
+
+bool JsonReader::readFloat(float& value) {
+  MessageView token;
+  if (!readNumber(token)) return false;
+  value = token.toFloat();
+  return true;
+}
+
+bool JsonReader::readBool(bool& value) {
+  if (peek() != Type::Bool) return fail();
+  if (scanLiteral("true")) {
+    value = true;
+    return true;
+  }
+  if (scanLiteral("false")) {
+    value = false;
+    return true;
+  }
+  return fail();
+}
+
+bool JsonReader::skipValue(MessageView* raw) {
+  Type type = peek();
+  size_t start = pos;
+  MessageView ignored;
+  bool flag;
+
+  switch (type) {
+    case Type::String:
+      if (!scanString(ignored)) return fail();
+      break;
+    case Type::Number:
+      if (!scanNumber(ignored)) return fail();
+      break;
+    case Type::Bool:
+      if (!readBool(flag)) return false;
+      break;
+    case Type::Null:
+      if (!scanLiteral("null")) return fail();
+      break;
+    case Type::Object:
+    case Type::Array: {
+      // Walk the nested value iteratively, with the same checks a
+      // caller reading it would get
+      uint8_t base = depth;
+      if (!push(type == Type::Object)) return false;
+      while (depth > base) {
+        bool inObject = (objectLevel & (uint16_t)(1u << (depth - 1))) != 0;
+        bool more = inObject ? nextKey(ignored) : nextElement();
+        if (failed) return false;
+        if (!more) continue;  // Container closed
+
+        Type inner = peek();
+        if (inner == Type::Object || inner == Type::Array) {
+          if (!push(inner == Type::Object)) return false;
+        } else if (!skipValue()) {
+          return false;
+        }
+      }
+      break;
+    }
+    default:
+      return fail();
+  }
+
+  if (raw) *raw = MessageView(text + start, pos - start);
+  return true;
+}
+
+bool JsonReader::finish() {
+  if (failed || depth != 0) return fail();
+  skipSpace();
+  if (pos != length) return fail();
+  return true;
+}
@@ -0,0 +1,134 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <Arduino.h>
+#include "MessageView.h"
+
+/**
+ * Streaming pull reader for a JSON document in a length-delimited buffer.
+ *
+ * Responsibilities:
+ * - Walk objects and arrays token by token, without a DOM, recursion
+ *   or allocation
+ * - Hand out strings and numbers as views into the buffer
+ * - Skip values the caller does not care about
+ * - Reject malformed input (missing commas, unbalanced brackets,
+ *   trailing data) instead of guessing
+ *
+ * Typical use:
+ *
+ *   JsonReader json(payload);
+ *   MessageView key;
+ *   if (json.enterObject()) {
+ *     while (json.nextKey(key)) {
+ *       if (key.equals("brightness")) json.readInt(brightness);
+ *       else json.skipValue();
+ *     }
+ *   }
+ *   if (!json.finish()) return;  // Malformed
+ *
+ * Every value must be consumed (read or skipped) before the next
+ * nextKey()/nextElement(). After the first error every call fails.
+ * Strings are returned raw: escape sequences are kept, not decoded.
+ */
+class JsonReader {
+public:
+  enum class Type : uint8_t {
+    Invalid,   // End of input or not a JSON value
+    Object,
+    Array,
+    String,
+    Number,
+    Bool,
+    Null
+  };
+
+  static const uint8_t MAX_DEPTH = 16;
+
+  JsonReader(const char* data, size_t length);
+  explicit JsonReader(const MessageView& text);
+
+  /**
+   * Type of the next value, without consuming it.
+   */
+  Type peek();
+
+  /**
+   * Consume '{'.
+   */
+  bool enterObject();
+
+  /**
+   * Advance to the next member of the current object.
+   *
+   * @param key Set to the member name
+   * @return False at the closing '}' (consumed) or on error
+   */
+  bool nextKey(MessageView& key);
+
+  /**
+   * Consume '['.
+   */
+  bool enterArray();
+
+  /**
+   * Advance to the next element of the current array.
+   *
+   * @return False at the closing ']' (consumed) or on error
+   */
+  bool nextElement();
+
+  /**
+   * Read a string value (contents between the quotes).
+   */
+  bool readString(MessageView& value);
+
+  /**
+   * Read a number value as its text.
+   */
+  bool readNumber(MessageView& token);
+
+  /**
+   * Read a number, truncated to an integer.
+   */
+  bool readInt(long& value);
+
+  bool readFloat(float& value);
+  bool readBool(bool& value);
+
+  /**
+   * Skip the next value, including nested objects and arrays.
+   *
+   * @param raw Optional: set to the skipped text
+   */
+  bool skipValue(MessageView* raw = nullptr);
+
+  /**
+   * Check that the document was read completely and correctly.
+   *
+   * @return False after any error, with unclosed containers or with
+   *         anything but whitespace left
+   */
+  bool finish();
+
+  bool ok() const { return !failed; }
+
+private:
+  const char* text;
+  size_t length;
+  size_t pos;
+  uint8_t depth;
+  uint16_t firstItem;    // Bit per depth: no member/element read yet
+  uint16_t objectLevel;  // Bit per depth: object (else array)
+  bool failed;
+
+  void skipSpace();
+  bool fail();
+  bool push(bool object);
+  bool separator(bool object, bool& closed);
+  bool scanString(MessageView& value);
+  bool scanNumber(MessageView& token);
+  bool scanLiteral(const char* word);
+};
+
+#endif // JSON_READER_H
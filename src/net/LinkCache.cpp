@@ -0,0 +1,93 @@
+#include "LinkCache.h"
+#include <Preferences.h>
+#include "../state/Bytes.h"
+
+namespace {
+
+// Record layout (big endian)
+//   0  magic "WL"
+//   2  version
+//   3  channel
+//   4  BSSID (6 bytes)
+//  10  SSID hash
+//  14  CRC-32 of bytes 0..13
+const uint8_t RECORD_MAGIC_0 = 'W';
+const uint8_t RECORD_MAGIC_1 = 'L';
+const uint8_t RECORD_VERSION = 2;   // 1 also held the IP lease
+const size_t CRC_OFFSET = 14;
+
+}  // namespace
+
+const char* LinkCache::NVS_NAMESPACE = "wifi_link";
+const char* LinkCache::NVS_KEY = "link";
+
+LinkCache::LinkCache() : network(0), present(false), current() {
+}
+
+uint32_t LinkCache::hashSsid(const char* ssid) {
+  return Bytes::fnv1a(ssid, strlen(ssid));
+}
+
+void LinkCache::setNetwork(const char* ssid) {
+  network = hashSsid(ssid);
+  present = false;
+}
+
+void LinkCache::encode(uint8_t* record) const {
+  record[0] = RECORD_MAGIC_0;
+  record[1] = RECORD_MAGIC_1;
+  record[2] = RECORD_VERSION;
+  record[3] = current.channel;
+  memcpy(record + 4, current.bssid, 6);
+  Bytes::writeU32(record + 10, network);
+  Bytes::writeU32(record + CRC_OFFSET, Bytes::crc32(record, CRC_OFFSET));
+}
+
+bool LinkCache::decode(const uint8_t* record, size_t length, Link& link) const {
+  if (length < RECORD_SIZE) return false;
+  if (record[0] != RECORD_MAGIC_0 || record[1] != RECORD_MAGIC_1) return false;
+  if (record[2] != RECORD_VERSION) return false;
+  if (Bytes::readU32(record + CRC_OFFSET) != Bytes::crc32(record, CRC_OFFSET)) return false;
+  if (Bytes::readU32(record + 10) != network) return false;
+  if (record[3] < 1 || record[3] > 14) return false;
+
+  link.channel = record[3];
+  memcpy(link.bssid, record + 4, 6);
+  return true;
+}
+
+bool LinkCache::restore(const uint8_t* record, size_t length) {
+  Link link;
+  if (!decode(record, length, link)) return false;
+  current = link;
+  present = true;
+  return true;
+}
+
+bool LinkCache::load() {
+  uint8_t record[RECORD_SIZE];
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, true);
+  size_t length = prefs.getBytes(NVS_KEY, record, sizeof(record));
+  prefs.end();
+  return restore(record, length);
+}
+
+bool LinkCache::sameLink(const Link& a, const Link& b) {
+  return a.channel == b.channel && memcmp(a.bssid, b.bssid, 6) == 0;
+}
+
+bool LinkCache::store(const Link& link) {
+  if (present && sameLink(current, link)) return false;
+  current = link;
+  present = true;
+
+  // Flash wears; a lamp that always joins the same access point writes once
+  uint8_t record[RECORD_SIZE];
+  encode(record);
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putBytes(NVS_KEY, record, sizeof(record));
+  prefs.end();
+  return true;
+}
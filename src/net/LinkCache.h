@@ -0,0 +1,81 @@
+#ifndef LINK_CACHE_H
+#define LINK_CACHE_H
+
+#include <Arduino.h>
+
+/**
+ * The last good WiFi link: access point and channel.
+ *
+ * Responsibilities:
+ * - Pack a link into a small checksummed record tied to the SSID, for
+ *   RTC memory (survives a restart) and NVS (survives power loss)
+ * - Reject records that are torn, from another firmware or network
+ * - Write NVS only when the link changed, not on every join
+ *
+ * With a cached access point and channel the join skips the scan. The
+ * address still comes from DHCP on every join, so the lease is renewed
+ * and never outlives what the server handed out.
+ */
+class LinkCache {
+public:
+  static const size_t RECORD_SIZE = 18;
+
+  struct Link {
+    uint8_t  bssid[6];
+    uint8_t  channel;    // 1..14
+  };
+
+  LinkCache();
+
+  /**
+   * Network the cache belongs to; records for other SSIDs are ignored.
+   */
+  void setNetwork(const char* ssid);
+
+  /**
+   * Take the link from a record (e.g. the RTC copy).
+   *
+   * @return False (cache unchanged) if the record is not valid
+   */
+  bool restore(const uint8_t* record, size_t length);
+
+  /**
+   * Take the link from NVS.
+   *
+   * @return False if none is stored for this network
+   */
+  bool load();
+
+  /**
+   * Remember a link that just worked and save it to NVS if it differs
+   * from the stored one.
+   *
+   * @return True if NVS was written
+   */
+  bool store(const Link& link);
+
+  bool valid() const { return present; }
+  const Link& link() const { return current; }
+
+  /**
+   * The current link as a record.
+   *
+   * @param record RECORD_SIZE bytes
+   */
+  void encode(uint8_t* record) const;
+
+  static uint32_t hashSsid(const char* ssid);
+
+private:
+  static const char* NVS_NAMESPACE;
+  static const char* NVS_KEY;
+
+  uint32_t network;
+  bool present;
+  Link current;
+
+  bool decode(const uint8_t* record, size_t length, Link& link) const;
+  static bool sameLink(const Link& a, const Link& b);
+};
+
+#endif // LINK_CACHE_H
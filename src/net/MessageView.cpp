@@ -0,0 +1,103 @@
+#include "MessageView.h"
+#include <limits.h>
+
+namespace {
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+char toLowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+}  // namespace
+
+MessageView::MessageView()
+  : ptr(""), len(0) {
+}
+
+MessageView::MessageView(const char* data, size_t length)
+  : ptr(data ? data : ""), len(data ? length : 0) {
+}
+
+MessageView::MessageView(const char* text)
+  : ptr(text ? text : ""), len(text ? strlen(text) : 0) {
+}
+
+bool MessageView::equals(const char* text) const {
+  size_t n = strlen(text);
+  return n == len && memcmp(ptr, text, len) == 0;
+}
+
+bool MessageView::equalsIgnoreCase(const char* text) const {
+  size_t n = strlen(text);
+  if (n != len) return false;
+  for (size_t i = 0; i < len; i++) {
+    if (toLowerAscii(ptr[i]) != toLowerAscii(text[i])) return false;
+  }
+  return true;
+}
+
+int MessageView::indexOf(char c, size_t from) const {
+  for (size_t i = from; i < len; i++) {
+    if (ptr[i] == c) return (int)i;
+  }
+  return -1;
+}
+
+int MessageView::indexOf(const char* text, size_t from) const {
+  size_t n = strlen(text);
+  if (n == 0) return from <= len ? (int)from : -1;
+  for (size_t i = from; i + n <= len; i++) {
+    if (ptr[i] == text[0] && memcmp(ptr + i, text, n) == 0) return (int)i;
+  }
+  return -1;
+}
+
+MessageView MessageView::substring(size_t start, size_t end) const {
+  if (end > len) end = len;
+  if (start > end) start = end;
+  return MessageView(ptr + start, end - start);
+}
+
+MessageView MessageView::trim() const {
+  size_t start = 0, end = len;
+  while (start < end && isSpace(ptr[start])) start++;
+  while (end > start && isSpace(ptr[end - 1])) end--;
+  return MessageView(ptr + start, end - start);
+}
+
+long MessageView::toInt() const {
+  size_t i = 0;
+  while (i < len && isSpace(ptr[i])) i++;
+
+  bool negative = false;
+  if (i < len && (ptr[i] == '-' || ptr[i] == '+')) {
+    negative = ptr[i] == '-';
+    i++;
+  }
+
+  long value = 0;
+  while (i < len && ptr[i] >= '0' && ptr[i] <= '9') {
+    if (value <= (LONG_MAX - 9) / 10) {
+      value = value * 10 + (ptr[i] - '0');  // Saturates instead of overflowing
+    }
+    i++;
+  }
+  return negative ? -value : value;
+}
+
+float MessageView::toFloat() const {
+  char buf[24];
+  copyTo(buf, sizeof(buf));
+  return strtof(buf, nullptr);
+}
+
+size_t MessageView::copyTo(char* buffer, size_t size) const {
+  if (size == 0) return 0;
+  size_t n = len < size - 1 ? len : size - 1;
+  memcpy(buffer, ptr, n);
+  buffer[n] = '\0';
+  return n;
+}
@@ -0,0 +1,95 @@
+#ifndef MESSAGE_VIEW_H
+#define MESSAGE_VIEW_H
+
+#include <Arduino.h>
+
+/**
+ * Read-only, length-delimited view of an MQTT payload.
+ *
+ * Responsibilities:
+ * - Give handlers String-like helpers without copying or allocating
+ * - Never read past the end (payloads are not NUL-terminated)
+ *
+ * Views handed to the MQTT callback point into the client's receive
+ * buffer and are only valid until the callback returns: the next packet
+ * read overwrites them. Copy what is needed (CommandQueue does).
+ */
+class MessageView {
+public:
+  static const size_t NPOS = (size_t)-1;
+
+  MessageView();
+  MessageView(const char* data, size_t length);
+
+  /**
+   * View of a NUL-terminated string.
+   */
+  explicit MessageView(const char* text);
+
+  const char* data() const { return ptr; }
+  size_t length() const { return len; }
+  bool isEmpty() const { return len == 0; }
+  char operator[](size_t i) const { return ptr[i]; }
+
+  /**
+   * Exact comparison with a NUL-terminated string.
+   */
+  bool equals(const char* text) const;
+
+  /**
+   * ASCII case-insensitive comparison with a NUL-terminated string.
+   */
+  bool equalsIgnoreCase(const char* text) const;
+
+  /**
+   * Position of a character at or after 'from'.
+   *
+   * @return Index, or -1 if not found
+   */
+  int indexOf(char c, size_t from = 0) const;
+
+  /**
+   * Position of a substring at or after 'from'.
+   *
+   * @return Index, or -1 if not found
+   */
+  int indexOf(const char* text, size_t from = 0) const;
+
+  /**
+   * Sub-view [start, end), clamped to this view.
+   */
+  MessageView substring(size_t start, size_t end = NPOS) const;
+
+  /**
+   * Same view without leading/trailing spaces, tabs and line breaks.
+   */
+  MessageView trim() const;
+
+  /**
+   * Integer value like String::toInt(): optional whitespace and sign,
+   * then digits up to the first non-digit.
+   *
+   * @return Value, 0 if there are no digits
+   */
+  long toInt() const;
+
+  /**
+   * Floating point value like String::toFloat().
+   *
+   * @return Value, 0 if not a number
+   */
+  float toFloat() const;
+
+  /**
+   * Copy into a NUL-terminated buffer, truncating if needed.
+   *
+   * @return Characters copied (excluding the terminator)
+   */
+  size_t copyTo(char* buffer, size_t size) const;
+
+private:
+  const char* ptr;
+  size_t len;
+};
+
+#endif // MESSAGE_VIEW_H
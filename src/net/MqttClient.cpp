@@ -0,0 +1,540 @@
+#include "MqttClient.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+// MQTT control packet types (upper nibble of the fixed header)
+const uint8_t CONNECT    = 0x10;
+const uint8_t CONNACK    = 0x20;
+const uint8_t PUBLISH    = 0x30;
+const uint8_t PUBACK     = 0x40;
+const uint8_t SUBSCRIBE  = 0x82;  // Reserved flags 0010
+const uint8_t SUBACK     = 0x90;
+const uint8_t PINGREQ    = 0xC0;
+const uint8_t PINGRESP   = 0xD0;
+const uint8_t DISCONNECT = 0xE0;
+
+/**
+ * Bounds-checked writer for a packet body.
+ */
+struct PacketWriter {
+  char* buf;
+  size_t capacity;
+  size_t pos;
+  bool ok;
+
+  PacketWriter(char* b, size_t c) : buf(b), capacity(c), pos(0), ok(true) {}
+
+  void byte(uint8_t v) {
+    if (pos < capacity) buf[pos++] = (char)v;
+    else ok = false;
+  }
+
+  void u16(uint16_t v) {
+    byte(v >> 8);
+    byte(v & 0xFF);
+  }
+
+  void bytes(const char* data, size_t length) {
+    if (length > capacity - pos) {
+      ok = false;
+      return;
+    }
+    memcpy(buf + pos, data, length);
+    pos += length;
+  }
+
+  void string(const char* s) {
+    size_t length = strlen(s);
+    u16((uint16_t)length);
+    bytes(s, length);
+  }
+};
+
+}  // namespace
+
+MqttClient::MqttClient()
+  : clock(&Clock::system()), host(nullptr), port(1883), clientId(""), user(nullptr),
+    password(nullptr), keepAliveS(15), connectTimeoutMs(5000), subscriptions(nullptr),
+    subscriptionCount(0), subscriptionQos(0), cleanSession(true), resumed(false),
+    handler(nullptr), handlerContext(nullptr), fd(-1),
+    current(State::Disconnected), error(Error::None), resolved(false), address(0),
+    stepStart(0), lastSent(0), lastReceived(0), pingSent(0), pingOutstanding(false),
+    blocked(false), rxLength(0), skipRemaining(0) {
+}
+
+MqttClient::~MqttClient() {
+  if (fd >= 0) close(fd);
+}
+
+void MqttClient::setServer(const char* h, uint16_t p) {
+  host = h;
+  port = p;
+  resolved = false;
+}
+
+void MqttClient::setCredentials(const char* id, const char* u, const char* pass) {
+  clientId = id;
+  user = u;
+  password = pass;
+}
+
+void MqttClient::setKeepAlive(uint16_t seconds) {
+  keepAliveS = seconds;
+}
+
+void MqttClient::setConnectTimeout(unsigned long ms) {
+  connectTimeoutMs = ms;
+}
+
+void MqttClient::setSubscriptions(const char* const* topics, uint8_t count, uint8_t qos) {
+  subscriptions = topics;
+  subscriptionCount = count;
+  subscriptionQos = qos > 1 ? 1 : qos;
+}
+
+void MqttClient::setCleanSession(bool clean) {
+  cleanSession = clean;
+}
+
+void MqttClient::setHandler(MessageHandler h, void* context) {
+  handler = h;
+  handlerContext = context;
+}
+
+void MqttClient::setClock(const Clock* c) {
+  clock = c;
+}
+
+bool MqttClient::connect() {
+  if (current != State::Disconnected) disconnect();
+
+  if (!resolve()) {
+    fail(Error::Resolve);
+    return false;
+  }
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    fail(Error::Socket);
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  struct sockaddr_in server;
+  memset(&server, 0, sizeof(server));
+  server.sin_family = AF_INET;
+  server.sin_port = htons(port);
+  server.sin_addr.s_addr = address;
+
+  error = Error::None;
+  resumed = false;
+  enter(State::TcpConnecting);
+  if (::connect(fd, (struct sockaddr*)&server, sizeof(server)) < 0 && errno != EINPROGRESS) {
+    fail(Error::Refused);
+    return false;
+  }
+  return true;
+}
+
+bool MqttClient::resolve() {
+  if (resolved) return true;
+  if (!host) return false;
+
+  struct in_addr numeric;
+  if (inet_pton(AF_INET, host, &numeric) == 1) {
+    address = numeric.s_addr;
+    resolved = true;
+    return true;
+  }
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* result = nullptr;
+  if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) return false;
+
+  address = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(result);
+  resolved = true;
+  return true;
+}
+
+void MqttClient::poll() {
+  switch (current) {
+    case State::Disconnected:
+      return;
+    case State::TcpConnecting:
+      finishTcpConnect();
+      break;
+    default:
+      receive();
+      break;
+  }
+  if (current == State::Disconnected) return;
+
+  unsigned long now = clock->millis();
+  if (current != State::Connected) {
+    if (now - stepStart >= connectTimeoutMs) fail(Error::Timeout);
+    return;
+  }
+
+  unsigned long keepAlive = keepAliveMs();
+  if (keepAlive == 0) return;
+  if (pingOutstanding) {
+    if (now - pingSent >= keepAlive) fail(Error::KeepAlive);
+  } else if (now - lastSent >= keepAlive || now - lastReceived >= keepAlive) {
+    if (sendPacket(PINGREQ, 0)) {
+      pingOutstanding = true;
+      pingSent = now;
+    }
+  }
+}
+
+void MqttClient::finishTcpConnect() {
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(fd, &writeSet);
+  struct timeval tv = {0, 0};
+  if (select(fd + 1, nullptr, &writeSet, nullptr, &tv) <= 0) return;  // Still connecting
+
+  int err = 0;
+  socklen_t length = sizeof(err);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &length) < 0 || err != 0) {
+    fail(Error::Refused);
+    return;
+  }
+
+  enter(State::AwaitConnack);
+  sendConnect();
+}
+
+void MqttClient::receive() {
+  // A refused message stays first in the buffer; nothing more is read
+  // until it is taken, so TCP flow control pushes back on the broker
+  if (blocked && !deliverBuffered()) return;
+
+  for (uint8_t i = 0; i < MAX_READS_PER_POLL; i++) {
+    size_t room = BUFFER_SIZE - rxLength;
+    if (skipRemaining) room = skipRemaining < BUFFER_SIZE ? skipRemaining : BUFFER_SIZE;
+
+    ssize_t n = recv(fd, rx + rxLength, room, MSG_DONTWAIT);
+    if (n == 0) {
+      fail(Error::Closed);
+      return;
+    }
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) fail(Error::Closed);
+      return;
+    }
+    lastReceived = clock->millis();
+
+    if (skipRemaining) {
+      skipRemaining -= n;
+      continue;
+    }
+    rxLength += n;
+    if (!deliverBuffered()) return;
+  }
+}
+
+// Hand every complete packet at the start of rx to handlePacket().
+// Returns false if reading should stop (message refused or connection lost).
+bool MqttClient::deliverBuffered() {
+  size_t offset = 0;
+  bool accepted = true;
+
+  while (offset < rxLength) {
+    // Fixed header: type byte, then 1-4 bytes of remaining length
+    size_t remaining = 0;
+    uint8_t shift = 0;
+    size_t pos = offset + 1;
+    bool headerComplete = false;
+    while (pos < rxLength) {
+      uint8_t b = (uint8_t)rx[pos++];
+      remaining |= (size_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) {
+        headerComplete = true;
+        break;
+      }
+      shift += 7;
+      if (shift > 21) {
+        fail(Error::Protocol);
+        return false;
+      }
+    }
+    if (!headerComplete) break;
+
+    size_t total = (pos - offset) + remaining;
+    if (total > BUFFER_SIZE) {
+      // Cannot be buffered: discard it as it streams in. A QoS 1 message
+      // is acknowledged first, or the broker would resend it forever.
+      uint8_t header = (uint8_t)rx[offset];
+      if ((header & 0xF0) == PUBLISH && ((header >> 1) & 0x03) == 1) {
+        if (rxLength - pos < 2) break;
+        size_t idAt = pos + 2 + (((uint8_t)rx[pos] << 8) | (uint8_t)rx[pos + 1]);
+        if (idAt + 2 - offset <= BUFFER_SIZE) {
+          if (rxLength < idAt + 2) break;
+          tx[HEADER_RESERVE] = rx[idAt];
+          tx[HEADER_RESERVE + 1] = rx[idAt + 1];
+          if (!sendPacket(PUBACK, 2)) return false;
+        }
+      }
+      Serial.printf("[MQTT] Dropped a %u byte message, over the %u byte buffer\n",
+                    (unsigned)total, (unsigned)BUFFER_SIZE);
+      skipRemaining = total - (rxLength - offset);
+      offset = rxLength;
+      break;
+    }
+    if (rxLength - offset < total) break;
+
+    accepted = handlePacket((uint8_t)rx[offset], rx + pos, remaining);
+    if (current == State::Disconnected) return false;
+    if (!accepted) break;
+    offset += total;
+  }
+
+  if (offset > 0) {
+    memmove(rx, rx + offset, rxLength - offset);
+    rxLength -= offset;
+  }
+  blocked = !accepted;
+  return accepted;
+}
+
+bool MqttClient::handlePacket(uint8_t header, char* body, size_t length) {
+  switch (header & 0xF0) {
+    case CONNACK:
+      if (current != State::AwaitConnack || length < 2) {
+        fail(Error::Protocol);
+        return false;
+      }
+      if (body[1] != 0) {
+        fail(Error::Rejected);
+        return false;
+      }
+      resumed = !cleanSession && (body[0] & 0x01);
+      if (subscriptionCount == 0) {
+        enter(State::Connected);
+      } else if (resumed) {
+        // The broker still has the filters; refresh them, but the
+        // session is usable (and queued messages flow) right away
+        enter(State::Connected);
+        sendSubscribe();
+      } else {
+        enter(State::Subscribing);
+        sendSubscribe();
+      }
+      return true;
+
+    case SUBACK:
+      if (current == State::Subscribing) enter(State::Connected);
+      return true;
+
+    case PUBLISH: {
+      if (length < 2) {
+        fail(Error::Protocol);
+        return false;
+      }
+      uint8_t qos = (header >> 1) & 0x03;
+      size_t topicLength = ((uint8_t)body[0] << 8) | (uint8_t)body[1];
+      size_t pos = 2 + topicLength + (qos ? 2 : 0);
+      if (pos > length) {
+        fail(Error::Protocol);
+        return false;
+      }
+      if (handler && !handler(handlerContext, body + 2, topicLength, body + pos, length - pos)) {
+        return false;
+      }
+      if (qos == 1) {
+        tx[HEADER_RESERVE] = body[2 + topicLength];
+        tx[HEADER_RESERVE + 1] = body[3 + topicLength];
+        sendPacket(PUBACK, 2);
+      }
+      return true;
+    }
+
+    case PINGRESP:
+      pingOutstanding = false;
+      return true;
+
+    default:
+      return true;  // Acks for our QoS 0 publishes: nothing to do
+  }
+}
+
+bool MqttClient::sendConnect() {
+  PacketWriter w(tx + HEADER_RESERVE, BUFFER_SIZE - HEADER_RESERVE);
+  bool auth = user && user[0];
+  uint8_t flags = cleanSession ? 0x02 : 0x00;
+  if (auth) flags |= password ? 0xC0 : 0x80;
+
+  w.string("MQTT");
+  w.byte(4);  // Protocol level 3.1.1
+  w.byte(flags);
+  w.u16(keepAliveS);
+  w.string(clientId);
+  if (auth) {
+    w.string(user);
+    if (password) w.string(password);
+  }
+
+  if (!w.ok) {
+    fail(Error::Protocol);
+    return false;
+  }
+  return sendPacket(CONNECT, w.pos);
+}
+
+bool MqttClient::sendSubscribe() {
+  PacketWriter w(tx + HEADER_RESERVE, BUFFER_SIZE - HEADER_RESERVE);
+  w.u16(SUBSCRIBE_PACKET_ID);
+  for (uint8_t i = 0; i < subscriptionCount; i++) {
+    w.string(subscriptions[i]);
+    w.byte(subscriptionQos);
+  }
+
+  if (!w.ok) {
+    fail(Error::Protocol);
+    return false;
+  }
+  return sendPacket(SUBSCRIBE, w.pos);
+}
+
+bool MqttClient::publish(const char* topic, const char* payload, size_t length, bool retain) {
+  if (current != State::Connected) return false;
+
+  PacketWriter w(tx + HEADER_RESERVE, BUFFER_SIZE - HEADER_RESERVE);
+  w.string(topic);
+  w.bytes(payload, length);
+  if (!w.ok) return false;
+  return sendPacket(PUBLISH | (retain ? 0x01 : 0x00), w.pos, true);
+}
+
+void MqttClient::disconnect() {
+  if (current == State::Connected) {
+    sendPacket(DISCONNECT, 0, true);
+  }
+  fail(Error::None);  // Closes the socket; ending on request is not an error
+}
+
+// Body is already in tx at HEADER_RESERVE; the fixed header goes in front
+bool MqttClient::sendPacket(uint8_t header, size_t bodyLength, bool mayDrop) {
+  uint8_t encoded[4];
+  uint8_t n = 0;
+  size_t remaining = bodyLength;
+  do {
+    uint8_t b = remaining & 0x7F;
+    remaining >>= 7;
+    encoded[n++] = b | (remaining ? 0x80 : 0x00);
+  } while (remaining && n < sizeof(encoded));
+
+  size_t start = HEADER_RESERVE - 1 - n;
+  tx[start] = (char)header;
+  memcpy(tx + start + 1, encoded, n);
+  return writeAll(tx + start, 1 + n + bodyLength, mayDrop);
+}
+
+bool MqttClient::writeAll(const char* data, size_t length, bool mayDrop) {
+  size_t sent = 0;
+  while (sent < length) {
+    ssize_t n = send(fd, data + sent, length - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += n;
+      continue;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      fail(Error::Closed);
+      return false;
+    }
+    // Nothing written yet: the stream is intact and the caller can retry
+    if (sent == 0 && mayDrop) return false;
+
+    // Send buffer full mid-packet: finish it or the stream is corrupt
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+    struct timeval tv = {0, (long)(WRITE_TIMEOUT_MS * 1000)};
+    if (select(fd + 1, nullptr, &writeSet, nullptr, &tv) <= 0) {
+      fail(Error::Closed);
+      return false;
+    }
+  }
+  lastSent = clock->millis();
+  return true;
+}
+
+void MqttClient::enter(State next) {
+  current = next;
+  stepStart = clock->millis();
+  if (next == State::Connected) {
+    lastSent = stepStart;
+    lastReceived = stepStart;
+    pingOutstanding = false;
+  }
+}
+
+void MqttClient::fail(Error reason) {
+  if (fd >= 0) close(fd);
+  fd = -1;
+  current = State::Disconnected;
+  error = reason;
+  rxLength = 0;
+  skipRemaining = 0;
+  blocked = false;
+  pingOutstanding = false;
+}
+
+unsigned long MqttClient::keepAliveMs() const {
+  return keepAliveS * 1000UL;
+}
+
+int MqttClient::socketFd() const {
+  if (current == State::Disconnected || blocked) return -1;
+  return fd;
+}
+
+bool MqttClient::wantsWrite() const {
+  return current == State::TcpConnecting;
+}
+
+unsigned long MqttClient::msUntilPoll() const {
+  if (current == State::Disconnected) return Clock::NO_DEADLINE;
+  if (blocked) return BACKPRESSURE_RETRY_MS;
+
+  unsigned long now = clock->millis();
+  unsigned long limit;
+  unsigned long elapsed;
+  if (current != State::Connected) {
+    limit = connectTimeoutMs;
+    elapsed = now - stepStart;
+  } else {
+    limit = keepAliveMs();
+    if (limit == 0) return Clock::NO_DEADLINE;
+    if (pingOutstanding) {
+      elapsed = now - pingSent;
+    } else {
+      unsigned long sinceSent = now - lastSent;
+      unsigned long sinceReceived = now - lastReceived;
+      elapsed = sinceSent > sinceReceived ? sinceSent : sinceReceived;
+    }
+  }
+  return elapsed >= limit ? 0 : limit - elapsed;
+}
@@ -0,0 +1,208 @@
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include <Arduino.h>
+#include "../hw/Clock.h"
+
+/**
+ * Minimal MQTT 3.1.1 client on a non-blocking socket.
+ *
+ * Responsibilities:
+ * - Connect as a state machine: TCP connect, CONNECT/CONNACK and
+ *   SUBSCRIBE/SUBACK each advance in poll(), which never waits
+ * - Receive PUBLISH packets without copying and hand them to a handler,
+ *   acknowledging QoS 1 messages once the handler took them
+ * - Resume a persistent broker session without waiting for SUBACK
+ * - Publish, keep the connection alive and detect a dead broker
+ *
+ * Every step has a deadline; a broker that is down, unreachable or
+ * silent costs a few socket calls per poll(), never a blocking wait.
+ * Host names are resolved once with getaddrinfo() (the only blocking
+ * call, made on the first connect); numeric addresses never block.
+ */
+class MqttClient {
+public:
+  enum class State : uint8_t {
+    Disconnected,
+    TcpConnecting,     // Non-blocking connect() in progress
+    AwaitConnack,      // CONNECT sent
+    Subscribing,       // SUBSCRIBE sent, waiting for SUBACK
+    Connected
+  };
+
+  /**
+   * Why the last connection attempt or session ended.
+   */
+  enum class Error : uint8_t {
+    None,
+    Resolve,           // Host name did not resolve
+    Socket,            // Socket could not be created
+    Refused,           // TCP connect failed
+    Timeout,           // A connect step missed its deadline
+    Rejected,          // CONNACK with a non-zero return code
+    Protocol,          // Unexpected packet
+    Closed,            // Peer closed or socket error
+    KeepAlive          // No PINGRESP in time
+  };
+
+  /**
+   * Message handler. Topic and payload point into the receive buffer
+   * and are valid only during the call.
+   *
+   * @return False to refuse the message for now (backpressure); it is
+   *         offered again on a later poll()
+   */
+  typedef bool (*MessageHandler)(void* context, const char* topic, size_t topicLength,
+                                 const char* payload, size_t payloadLength);
+
+  static const size_t BUFFER_SIZE = 1024;
+
+  MqttClient();
+  ~MqttClient();
+
+  void setServer(const char* host, uint16_t port);
+
+  /**
+   * @param user Empty or nullptr for no authentication
+   */
+  void setCredentials(const char* clientId, const char* user, const char* password);
+
+  void setKeepAlive(uint16_t seconds);
+
+  /**
+   * Deadline for each connect step (TCP, CONNACK, SUBACK).
+   */
+  void setConnectTimeout(unsigned long ms);
+
+  /**
+   * Topic filters subscribed (in one SUBSCRIBE) on every connect.
+   *
+   * @param topics Array of filters (must outlive the client)
+   * @param count Number of filters
+   * @param qos Maximum QoS requested for all filters (0 or 1)
+   */
+  void setSubscriptions(const char* const* topics, uint8_t count, uint8_t qos = 0);
+
+  /**
+   * Ask for a clean session (default) or a persistent one, in which the
+   * broker keeps subscriptions and queues QoS 1 messages while the
+   * client is away. Needs a stable client id.
+   */
+  void setCleanSession(bool clean);
+
+  void setHandler(MessageHandler handler, void* context);
+
+  /**
+   * Start connecting. Progress happens in poll().
+   *
+   * @return False if the attempt failed immediately (see lastError())
+   */
+  bool connect();
+
+  /**
+   * Advance the connection, deliver received messages and send
+   * keepalive pings. Never blocks.
+   */
+  void poll();
+
+  /**
+   * Publish at QoS 0.
+   *
+   * @return False if not connected or the socket buffer is full
+   */
+  bool publish(const char* topic, const char* payload, size_t length, bool retain);
+
+  /**
+   * Send DISCONNECT (if connected) and close the socket.
+   */
+  void disconnect();
+
+  State state() const { return current; }
+  bool connected() const { return current == State::Connected; }
+  Error lastError() const { return error; }
+
+  /**
+   * The broker resumed a stored session on the last connect. The client
+   * is then ready at CONNACK; the SUBSCRIBE that refreshes the filters
+   * is answered in the background.
+   */
+  bool sessionPresent() const { return resumed; }
+
+  /**
+   * Socket to wait on, or -1 when there is nothing to wait for
+   * (disconnected, or a refused message is pending).
+   */
+  int socketFd() const;
+
+  /**
+   * The socket should be watched for writability (TCP connect pending).
+   */
+  bool wantsWrite() const;
+
+  /**
+   * Time until poll() has timed work (step deadline, keepalive).
+   *
+   * @return Milliseconds (0 = now), or Clock::NO_DEADLINE when disconnected
+   */
+  unsigned long msUntilPoll() const;
+
+  /**
+   * Replace the time source (defaults to the system clock).
+   */
+  void setClock(const Clock* clock);
+
+private:
+  static const uint16_t SUBSCRIBE_PACKET_ID = 1;
+  static const unsigned long BACKPRESSURE_RETRY_MS = 5;
+  static const unsigned long WRITE_TIMEOUT_MS = 250;  // Finish a partly sent packet
+  static const uint8_t MAX_READS_PER_POLL = 8;
+  static const size_t HEADER_RESERVE = 5;             // Fixed header room in tx
+
+  const Clock* clock;
+  const char* host;
+  uint16_t port;
+  const char* clientId;
+  const char* user;
+  const char* password;
+  uint16_t keepAliveS;
+  unsigned long connectTimeoutMs;
+  const char* const* subscriptions;
+  uint8_t subscriptionCount;
+  uint8_t subscriptionQos;
+  bool cleanSession;
+  bool resumed;
+  MessageHandler handler;
+  void* handlerContext;
+
+  int fd;
+  State current;
+  Error error;
+  bool resolved;
+  uint32_t address;              // IPv4, network byte order
+  unsigned long stepStart;       // Start of the current connect step
+  unsigned long lastSent;
+  unsigned long lastReceived;
+  unsigned long pingSent;
+  bool pingOutstanding;
+  bool blocked;                  // Handler refused the buffered message
+
+  char rx[BUFFER_SIZE];
+  size_t rxLength;
+  size_t skipRemaining;          // Bytes left of an oversized packet
+  char tx[BUFFER_SIZE];          // Packet body starts at HEADER_RESERVE
+
+  void enter(State next);
+  void fail(Error reason);
+  bool resolve();
+  void finishTcpConnect();
+  void receive();
+  bool deliverBuffered();
+  bool handlePacket(uint8_t header, char* body, size_t length);
+  bool sendConnect();
+  bool sendSubscribe();
+  bool sendPacket(uint8_t header, size_t bodyLength, bool mayDrop = false);
+  bool writeAll(const char* data, size_t length, bool mayDrop);
+  unsigned long keepAliveMs() const;
+};
+
+#endif // MQTT_CLIENT_H
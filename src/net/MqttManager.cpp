@@ -1,151 +1,255 @@
 #include "MqttManager.h"
+#include "esp_system.h"
 #include "mqtt_config.h"
 #include "../hw/StatusLED.h"
+#include "../hw/SleepManager.h"
+#include "WiFiManager.h"
 
 // Define missing MQTT constants from config
 #ifndef MQTT_PASS
 #define MQTT_PASS MQTT_PASSWORD
 #endif
 
-#ifndef MQTT_CLIENT_ID
-#define MQTT_CLIENT_ID "ikea_head_lamp_esp32"
-#endif
-
 // Static member initialization
-MqttManager* MqttManager::instance = nullptr;
-
 const char* MqttManager::MQTT_BASE = "ikea_head_lamp";
-const char* MqttManager::TOPIC_CMD_POWER      = "ikea_head_lamp/cmnd/power";
-const char* MqttManager::TOPIC_CMD_BRIGHTNESS = "ikea_head_lamp/cmnd/brightness";
-const char* MqttManager::TOPIC_CMD_COLOR      = "ikea_head_lamp/cmnd/color";
-const char* MqttManager::TOPIC_CMD_ANIMATION  = "ikea_head_lamp/cmnd/animation";
-const char* MqttManager::TOPIC_CMD_PAUSE      = "ikea_head_lamp/cmnd/pause";
-const char* MqttManager::TOPIC_CMD_MODE       = "ikea_head_lamp/cmnd/mode";
-const char* MqttManager::TOPIC_CMD_QUERY      = "ikea_head_lamp/cmnd/query";
-const char* MqttManager::TOPIC_CMD_TEST       = "ikea_head_lamp/cmnd/test";
-const char* MqttManager::TOPIC_CMD_APPLY_DEFAULTS = "ikea_head_lamp/cmnd/apply_defaults";
-const char* MqttManager::TOPIC_CFG_DEFAULT_BRI   = "ikea_head_lamp/config/default_brightness/set";
-const char* MqttManager::TOPIC_CFG_DEFAULT_COLOR = "ikea_head_lamp/config/default_color/set";
-const char* MqttManager::TOPIC_CFG_SUNRISE_MIN   = "ikea_head_lamp/config/sunrise_minutes/set";
-const char* MqttManager::TOPIC_CFG_MIN_PWM       = "ikea_head_lamp/config/min_pwm/set";
-const char* MqttManager::TOPIC_CFG_MAX_PWM       = "ikea_head_lamp/config/max_pwm/set";
-const char* MqttManager::TOPIC_CFG_SAVE    = "ikea_head_lamp/config/save";
-const char* MqttManager::TOPIC_CFG_RESET   = "ikea_head_lamp/config/reset";
-const char* MqttManager::TOPIC_CFG_REQUEST = "ikea_head_lamp/config/request";
-const char* MqttManager::TOPIC_CFG_FAVORITE_ANIMATION = "ikea_head_lamp/config/favorite_animation/set";
-const char* MqttManager::TOPIC_STATE_JSON  = "ikea_head_lamp/state/json";
-const char* MqttManager::TOPIC_CFG_STATE   = "ikea_head_lamp/config/state";
-const char* MqttManager::TOPIC_DIAGNOSTICS = "ikea_head_lamp/diagnostics";
-const char* MqttManager::TOPIC_HEARTBEAT   = "ikea_head_lamp/heartbeat";
 
 MqttManager::MqttManager() 
-  : client(espClient), statusLED(nullptr), lastReconnectAttempt(0) {
-  instance = this;
+  : reportedState(MqttClient::State::Disconnected), messageCallback(nullptr),
+    statusLED(nullptr), reconnect(RECONNECT_FIRST_MS, RECONNECT_CAP_MS), boot(nullptr), connectedAt(0),
+    inbox(nullptr), queuedState(nullptr),
+    queuedConfig(nullptr), renderWake(nullptr), networkWake(nullptr), outboxStalled(false),
+    isConnected(false),
+    sessions(0), servicedSessions(0), attemptStarted(0), lostAt(0), everLost(false),
+    readyMs(0), outageMs(0), retries(0), sessionResumed(false) {
+  topics.build(MQTT_BASE);
+  strcpy(clientId, MQTT_BASE);
+}
+
+void MqttManager::setIdentity(const char* base, const uint8_t mac[6]) {
+  // Without a configured base each lamp gets its own tree under MQTT_BASE
+  char macBase[TopicTable::MAX_BASE + 1];
+  snprintf(macBase, sizeof(macBase), "%s/%02x%02x%02x", MQTT_BASE, mac[3], mac[4], mac[5]);
+  if (!base || !*base) {
+    base = macBase;
+  } else if (!TopicTable::validBase(base)) {
+    Serial.printf("[MQTT] Invalid base topic '%s', using %s\n", base, macBase);
+    base = macBase;
+  }
+  topics.build(base);
+
+#ifdef MQTT_CLIENT_ID
+  snprintf(clientId, sizeof(clientId), "%s", MQTT_CLIENT_ID);
+#else
+  // The broker keeps one session per client id, so it has to be unique;
+  // 22 characters stays within the 23 every broker must accept
+  snprintf(clientId, sizeof(clientId), "ikea_lamp_%02x%02x%02x%02x%02x%02x",
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+#endif
+
+  Serial.printf("[MQTT] Base topic %s, client id %s\n", topics.base(), clientId);
 }
 
 void MqttManager::begin(MessageCallback callback) {
   Serial.println("[MQTT] Initializing MQTT manager");
   messageCallback = callback;
   
-  // Increase buffer size to 512 bytes for config messages with favorite animation
-  client.setBufferSize(512);
-  
-  // Reduce keepalive to detect connection issues faster
-  client.setKeepAlive(15);
+  client.setServer(MQTT_HOST, MQTT_PORT);
+  client.setCredentials(clientId, MQTT_USER, MQTT_PASS);
   
-  // Set socket timeout to prevent long blocking
-  client.setSocketTimeout(5);
+  // Short keepalive to detect connection issues faster
+  client.setKeepAlive(KEEPALIVE_S);
   
-  client.setServer(MQTT_HOST, MQTT_PORT);
-  client.setCallback(mqttCallbackWrapper);
+  // QoS 1 on a persistent session: commands sent while the lamp is
+  // offline are queued by the broker and delivered on reconnect
+  client.setSubscriptions(topics.subscriptions(), topics.subscriptionCount(), 1);
+  client.setCleanSession(false);
+  client.setHandler(onMessage, this);
+
+  // Lamps that lose the broker together must not come back together
+  reconnect.seed(esp_random());
   
   // Don't connect immediately - wait for WiFi to be ready
   // Connection will be attempted in loop()
 }
 
+void MqttManager::setInbox(const CommandQueue* queue) {
+  inbox = queue;
+}
+
+void MqttManager::setWakeOnReceive(SleepManager* sleeper) {
+  renderWake = sleeper;
+}
+
+void MqttManager::setWakeOnSend(SleepManager* sleeper) {
+  networkWake = sleeper;
+}
+
 void MqttManager::loop() {
-  if (!client.connected()) {
+  // Attempts only count while WiFi is up; without it there is nothing to back off from
+  if (client.state() == MqttClient::State::Disconnected && WiFi.status() == WL_CONNECTED &&
+      reconnect.due()) {
+    reconnect.attempt();
+    startConnect();
+  }
+
+  // One non-blocking step: connect progress, received packets, keepalive
+  client.poll();
+  if (client.state() != reportedState) {
+    onStateChange(client.state());
+  }
+  sendOutbox();  // Discards while disconnected: the render side re-queues on reconnect
+}
+
+void MqttManager::startConnect() {
+  if (statusLED) statusLED->mqttConnecting();
+  Serial.printf("[MQTT] Connecting to %s:%u\n", MQTT_HOST, MQTT_PORT);
+  attemptStarted = millis();
+
+  if (!client.connect()) {
+    Serial.printf("[MQTT] Connection failed, rc=%d\n", (int)client.lastError());
+    if (statusLED) statusLED->mqttFailed();
+    return;
+  }
+  reportedState = client.state();
+}
+
+void MqttManager::onStateChange(MqttClient::State next) {
+  MqttClient::State previous = reportedState;
+  reportedState = next;
+
+  if (next == MqttClient::State::Connected) {
     unsigned long now = millis();
-    if (now - lastReconnectAttempt > RECONNECT_INTERVAL_MS) {
-      lastReconnectAttempt = now;
-      connectMqtt();
+    readyMs.store(now - attemptStarted, std::memory_order_relaxed);
+    if (everLost) outageMs.store(now - lostAt, std::memory_order_relaxed);
+    retries.store(reconnect.attempts(), std::memory_order_relaxed);
+    if (boot) boot->mark(BootTimeline::MQTT);
+    connectedAt = now;
+    sessionResumed.store(client.sessionPresent(), std::memory_order_relaxed);
+    Serial.printf("[MQTT] Connected in %lu ms (%s session)\n", now - attemptStarted,
+                  client.sessionPresent() ? "resumed" : "new");
+    if (statusLED) statusLED->mqttConnected();
+
+    // New session: the render side re-sends retained state and config
+    isConnected.store(true, std::memory_order_release);
+    sessions.fetch_add(1, std::memory_order_release);
+    if (renderWake) renderWake->wake();
+  } else if (next == MqttClient::State::Disconnected) {
+    if (previous == MqttClient::State::Connected) {
+      isConnected.store(false, std::memory_order_release);
+      lostAt = millis();
+      everLost = true;
+      // A session that drops right after connecting keeps backing off,
+      // so a broker that accepts and then fails is not hammered
+      if (lostAt - connectedAt >= STABLE_SESSION_MS) reconnect.reset();
+      Serial.printf("[MQTT] Connection lost, rc=%d\n", (int)client.lastError());
+    } else {
+      Serial.printf("[MQTT] Connection failed, rc=%d\n", (int)client.lastError());
+      if (statusLED) statusLED->mqttFailed();
     }
-  } else {
-    // Throttle client.loop() to reduce WiFi overhead
-    static unsigned long lastClientLoop = 0;
-    unsigned long now = millis();
-    if ((now - lastClientLoop) >= 20) {  // Call max 50 times/sec
-      client.loop();
-      lastClientLoop = now;
+  }
+}
+
+void MqttManager::sendOutbox() {
+  OutboundMessage msg;
+  outboxStalled = false;
+  while (outbox.peek(msg)) {
+    if (client.connected() && !client.publish(msg.topic, msg.payload, msg.length, msg.retain)) {
+      if (client.connected()) {
+        // Send buffer full and nothing written: the render side has already
+        // let go of the topic, so keep the message for the next writable wake
+        // (handOver() only queues payloads that fit the client's buffer)
+        outboxStalled = true;
+        return;
+      }
+      Serial.printf("[MQTT] ERROR: Failed to publish %s\n", msg.topic);
     }
+    outbox.drop();
   }
 }
 
+unsigned long MqttManager::msUntilUpdate() {
+  if (client.state() != MqttClient::State::Disconnected) {
+    return client.msUntilPoll();
+  }
+  // WiFiManager polls while WiFi is down; loop() retries once it is up
+  if (WiFi.status() != WL_CONNECTED) return Clock::NO_DEADLINE;
+  return reconnect.msUntilDue();
+}
+
+int MqttManager::socketFd() {
+  return client.socketFd();
+}
+
+bool MqttManager::socketWantsWrite() {
+  return client.wantsWrite() || outboxStalled;
+}
+
 bool MqttManager::connected() {
-  return client.connected();
+  return isConnected.load(std::memory_order_acquire);
 }
 
 void MqttManager::setStatusLED(StatusLED* led) {
   statusLED = led;
 }
 
-bool MqttManager::connectMqtt() {
-  if (client.connected()) return true;
-  
-  // Don't attempt connection if WiFi isn't ready
-  if (WiFi.status() != WL_CONNECTED) {
-    return false;
-  }
+void MqttManager::queueState(const DeviceState& state, bool retain) {
+  queuedState = &state;
+  publishQueue.request(QUEUED_STATE, retain);
+}
 
-  if (statusLED) statusLED->mqttConnecting();
-  Serial.printf("[MQTT] Connecting to %s:%u\n", MQTT_HOST, MQTT_PORT);
-  
-  bool success = false;
-  if (strlen(MQTT_USER) > 0 || strlen(MQTT_PASS) > 0) {
-    success = client.connect(MQTT_CLIENT_ID, MQTT_USER, MQTT_PASS);
-  } else {
-    success = client.connect(MQTT_CLIENT_ID);
+void MqttManager::queueConfig(const DeviceConfig& config) {
+  queuedConfig = &config;
+  publishQueue.request(QUEUED_CONFIG, true);
+}
+
+void MqttManager::setPublishInterval(unsigned long ms) {
+  publishQueue.setMinInterval(ms);
+}
+
+void MqttManager::service() {
+  uint32_t current = sessions.load(std::memory_order_acquire);
+  if (current != servicedSessions) {
+    servicedSessions = current;
+    if (queuedConfig) publishQueue.request(QUEUED_CONFIG, true);
+    if (queuedState) publishQueue.request(QUEUED_STATE, true);
   }
 
-  if (!success) {
-    Serial.printf("[MQTT] Connection failed, rc=%d\n", client.state());
-    if (statusLED) statusLED->mqttFailed();
-    return false;
+  uint8_t topic;
+  bool retain;
+  while (connected() && publishQueue.takeDue(topic, retain)) {
+    bool sent = (topic == QUEUED_STATE) ? publishState(*queuedState, retain)
+                                        : publishConfig(*queuedConfig);
+    if (!sent) {
+      // Keep it pending; the final state must not be lost
+      publishQueue.request(topic, retain);
+      break;
+    }
   }
+}
 
-  Serial.println("[MQTT] Connected");
-  if (statusLED) statusLED->mqttConnected();
-  subscribeToTopics();
-  
-  return true;
+unsigned long MqttManager::msUntilService() {
+  if (sessions.load(std::memory_order_acquire) != servicedSessions) return 0;
+  return connected() ? publishQueue.msUntilDue() : Clock::NO_DEADLINE;
 }
 
-void MqttManager::subscribeToTopics() {
-  Serial.println("[MQTT] Subscribing to topics");
-  
-  client.subscribe(TOPIC_CMD_POWER);
-  client.subscribe(TOPIC_CMD_BRIGHTNESS);
-  client.subscribe(TOPIC_CMD_COLOR);
-  client.subscribe(TOPIC_CMD_ANIMATION);
-  client.subscribe(TOPIC_CMD_PAUSE);
-  client.subscribe(TOPIC_CMD_MODE);
-  client.subscribe(TOPIC_CMD_QUERY);
-  client.subscribe(TOPIC_CMD_TEST);
-  client.subscribe(TOPIC_CMD_APPLY_DEFAULTS);
-  
-  client.subscribe(TOPIC_CFG_DEFAULT_BRI);
-  client.subscribe(TOPIC_CFG_DEFAULT_COLOR);
-  client.subscribe(TOPIC_CFG_SUNRISE_MIN);
-  client.subscribe(TOPIC_CFG_MIN_PWM);
-  client.subscribe(TOPIC_CFG_MAX_PWM);
-  client.subscribe(TOPIC_CFG_SAVE);
-  client.subscribe(TOPIC_CFG_RESET);
-  client.subscribe(TOPIC_CFG_REQUEST);
-  client.subscribe(TOPIC_CFG_FAVORITE_ANIMATION);
+bool MqttManager::handOver(const char* topic, const char* payload, bool retain) {
+  if (!connected()) return false;
+
+  OutboundMessage msg;
+  size_t length = strlen(payload);
+  if (length >= MAX_OUTBOUND_PAYLOAD) return false;
+  msg.topic = topic;
+  msg.retain = retain;
+  msg.length = (uint16_t)length;
+  memcpy(msg.payload, payload, length + 1);
+
+  if (!outbox.push(msg)) return false;  // Network task is behind
+  if (networkWake) networkWake->wake();
+  return true;
 }
 
-void MqttManager::publishState(const DeviceState& state, bool retain) {
-  if (!client.connected()) return;
+bool MqttManager::publishState(const DeviceState& state, bool retain) {
+  if (!connected()) return false;
 
   char buf[256];
   
@@ -177,24 +281,20 @@ void MqttManager::publishState(const DeviceState& state, bool retain) {
              (unsigned long)state.version);
   }
 
-  // Log state publishes to help debug
-  Serial.print("[MQTT] Publishing to ");
-  Serial.print(TOPIC_STATE_JSON);
-  Serial.print(": ");
-  Serial.println(buf);
-  
-  bool success = client.publish(TOPIC_STATE_JSON, buf, retain);
-  if (!success) {
-    Serial.println("[MQTT] ERROR: Failed to publish state!");
-  } else {
-    Serial.println("[MQTT] State published successfully");
-  }
+  return handOver(topics.get(TopicTable::STATE_JSON), buf, retain);
 }
 
-void MqttManager::publishConfig(const DeviceConfig& config) {
-  if (!client.connected()) return;
+bool MqttManager::publishConfig(const DeviceConfig& config) {
+  if (!connected()) return false;
 
-  char buf[512];  // Increased buffer size for favorite animation
+  char curve[DeviceConfig::GAMMA_CURVE_MAX_POINTS * 5 + 1];
+  size_t pos = 0;
+  curve[0] = '\0';
+  for (uint8_t i = 0; i < config.gammaCurveLen && pos < sizeof(curve); i++) {
+    pos += snprintf(curve + pos, sizeof(curve) - pos, i ? ",%u" : "%u", config.gammaCurve[i]);
+  }
+
+  char buf[640];  // Increased buffer size for favorite animation and gamma curve
   snprintf(buf, sizeof(buf),
            "{\"default_brightness\":%u,"
            "\"default_color\":[%u,%u,%u],"
@@ -202,9 +302,13 @@ void MqttManager::publishConfig(const DeviceConfig& config) {
            "\"sunrise_final_brightness\":%u,"
            "\"min_pwm\":%u,"
            "\"max_pwm\":%u,"
+           "\"gamma\":%u.%02u,"
+           "\"gamma_curve\":[%s],"
            "\"favorite_animation\":\"%s\","
            "\"favorite_params\":[%u,%u,%u],"
            "\"favorite_color\":[%u,%u,%u],"
+           "\"phase_group\":\"%s\","
+           "\"base_topic\":\"%s\","
            "\"version\":%lu}",
            config.defaultBrightness,
            config.defaultColorR, config.defaultColorG, config.defaultColorB,
@@ -212,21 +316,30 @@ void MqttManager::publishConfig(const DeviceConfig& config) {
            config.sunriseFinalBrightness,
            config.minPwmPercent,
            config.maxPwmPercent,
+           config.gammaX100 / 100, config.gammaX100 % 100,
+           curve,
            config.favoriteAnimation.c_str(),
            config.favAnimParam1, config.favAnimParam2, config.favAnimParam3,
            config.favAnimColorR, config.favAnimColorG, config.favAnimColorB,
+           config.phaseGroup.c_str(), config.mqttBase.c_str(),
            (unsigned long)config.version);
 
-  client.publish(TOPIC_CFG_STATE, buf, true);
-  // Serial output removed - was blocking loop
+  return handOver(topics.get(TopicTable::CONFIG_STATE), buf, true);
 }
 
 void MqttManager::publishDiagnostics(unsigned long uptime, uint32_t freeHeap,
                                       uint32_t minHeap, const String& resetReason,
-                                      unsigned long loopCount) {
-  if (!client.connected()) return;
+                                      unsigned long loopCount, uint8_t idlePercent,
+                                      const FrameStats& frames, const WallClock& time,
+                                      const CommandScheduler& scheduler,
+                                      const PhaseGroup& group,
+                                      const WiFiManager& wifi) {
+  if (!connected()) return;
+
+  char hist[FrameStats::BUCKETS * 11 + 3];
+  frames.formatHistogram(hist, sizeof(hist));
 
-  char buf[300];
+  char buf[MAX_OUTBOUND_PAYLOAD];
   unsigned long loopsPerSec = (uptime > 0) ? (loopCount / uptime) : 0;
   
   snprintf(buf, sizeof(buf),
@@ -236,43 +349,82 @@ void MqttManager::publishDiagnostics(unsigned long uptime, uint32_t freeHeap,
            "\"reset_reason\":\"%s\","
            "\"loop_count\":%lu,"
            "\"loops_per_sec\":%lu,"
+           "\"idle_pct\":%u,"
+           "\"pub_coalesced\":%lu,"
+           "\"frame_hist\":%s,"
+           "\"frame_max_us\":%lu,"
+           "\"frame_overruns\":%lu,"
+           "\"mqtt_ready_ms\":%lu,"
+           "\"mqtt_outage_ms\":%lu,"
+           "\"mqtt_resumed\":%d,"
+           "\"mqtt_retries\":%lu,"
+           "\"wifi_retries\":%lu,"
+           "\"wifi_outage_ms\":%lu,"
+           "\"wifi_cached\":%d,"
+           "\"boot_wifi_ms\":%lu,"
+           "\"boot_mqtt_ms\":%lu,"
+           "\"time_synced\":%d,"
+           "\"clock_offset_ms\":%ld,"
+           "\"ntp_rtt_ms\":%u,"
+           "\"sched_run\":%lu,"
+           "\"sched_skew_ms\":%lu,"
+           "\"phase_locked\":%d,"
+           "\"phase_leader\":%d,"
+           "\"phase_err_ms\":%ld,"
+           "\"phase_err_max_ms\":%lu,"
            "\"wifi_rssi\":%d}",
            uptime, (unsigned long)freeHeap, (unsigned long)minHeap,
-           resetReason.c_str(), loopCount, loopsPerSec, WiFi.RSSI());
+           resetReason.c_str(), loopCount, loopsPerSec, idlePercent,
+           (unsigned long)publishQueue.coalescedCount(), hist,
+           (unsigned long)frames.maxUs(), (unsigned long)frames.overruns(),
+           (unsigned long)readyMs.load(std::memory_order_relaxed),
+           (unsigned long)outageMs.load(std::memory_order_relaxed),
+           sessionResumed.load(std::memory_order_relaxed) ? 1 : 0,
+           (unsigned long)retries.load(std::memory_order_relaxed),
+           (unsigned long)wifi.reconnectAttempts(), (unsigned long)wifi.outageMs(),
+           wifi.joinedFromCache() ? 1 : 0,
+           boot ? (unsigned long)(boot->atUs(BootTimeline::WIFI) / 1000) : 0UL,
+           boot ? (unsigned long)(boot->atUs(BootTimeline::MQTT) / 1000) : 0UL,
+           time.synced() ? 1 : 0, (long)time.lastCorrectionMs(),
+           (unsigned)time.lastRttMs(), (unsigned long)scheduler.executedCount(),
+           (unsigned long)scheduler.maxSkewMs(),
+           group.locked() ? 1 : 0, group.leading() ? 1 : 0,
+           (long)group.lastPhaseErrorMs(), (unsigned long)group.maxPhaseErrorMs(),
+           WiFi.RSSI());
 
-  client.publish(TOPIC_DIAGNOSTICS, buf, false);
+  handOver(topics.get(TopicTable::DIAGNOSTICS), buf, false);
   // Serial output removed - was blocking loop and causing watchdog timeouts
 }
 
 void MqttManager::publishHeartbeat() {
-  if (!client.connected()) return;
+  if (!connected()) return;
   
   char buf[32];
   snprintf(buf, sizeof(buf), "%lu", millis() / 1000);
-  client.publish(TOPIC_HEARTBEAT, buf, false);
+  handOver(topics.get(TopicTable::HEARTBEAT), buf, false);
 }
 
-void MqttManager::mqttCallbackWrapper(char* topic, byte* payload, unsigned int length) {
-  if (instance && instance->messageCallback) {
-    // Use static buffers to avoid heap fragmentation from String objects
-    static char topicBuf[64];
-    static char msgBuf[256];
-    
-    // Copy topic
-    strncpy(topicBuf, topic, sizeof(topicBuf) - 1);
-    topicBuf[sizeof(topicBuf) - 1] = '\0';
-    
-    // Copy payload
-    size_t copyLen = (length < sizeof(msgBuf) - 1) ? length : (sizeof(msgBuf) - 1);
-    memcpy(msgBuf, payload, copyLen);
-    msgBuf[copyLen] = '\0';
-    
-    // Trim trailing whitespace
-    while (copyLen > 0 && (msgBuf[copyLen-1] == ' ' || msgBuf[copyLen-1] == '\n' || msgBuf[copyLen-1] == '\r')) {
-      msgBuf[--copyLen] = '\0';
-    }
+bool MqttManager::publishBootReport(const String& resetReason) {
+  if (!connected() || !boot) return false;
 
-    // Serial output removed - was blocking loop
-    instance->messageCallback(String(topicBuf), String(msgBuf));
-  }
+  char timeline[BootTimeline::COUNT * 24 + 3];
+  boot->format(timeline, sizeof(timeline));
+
+  char buf[192];
+  snprintf(buf, sizeof(buf), "{\"reset_reason\":\"%s\",\"timeline\":%s}",
+           resetReason.c_str(), timeline);
+  return handOver(topics.get(TopicTable::BOOT), buf, true);
+}
+
+bool MqttManager::onMessage(void* context, const char* topic, size_t topicLength,
+                            const char* payload, size_t payloadLength) {
+  MqttManager* self = (MqttManager*)context;
+  if (!self->messageCallback) return true;
+  if (self->inbox && self->inbox->isFull()) return false;  // Offered again later
+
+  // No copies: both point into the client buffer
+  MessageView view(payload, payloadLength);
+  self->messageCallback(topic, topicLength, view.trim());
+  if (self->renderWake) self->renderWake->wake();
+  return true;
 }
@@ -2,29 +2,83 @@
 #define MQTT_MANAGER_H
 
 #include <Arduino.h>
-#include <PubSubClient.h>
 #include <WiFi.h>
-#include <functional>
+#include <atomic>
 #include "../state/DeviceState.h"
 #include "../state/DeviceConfig.h"
+#include "MessageView.h"
+#include "PublishQueue.h"
+#include "CommandQueue.h"
+#include "SpscQueue.h"
+#include "MqttClient.h"
+#include "Backoff.h"
+#include "../state/FrameStats.h"
+#include "../hw/WallClock.h"
+#include "CommandScheduler.h"
+#include "PhaseGroup.h"
+#include "TopicTable.h"
+#include "../state/BootTimeline.h"
 
 class StatusLED;
+class SleepManager;
+class WiFiManager;
 
 /**
  * MQTT connection and message routing.
  * 
  * Responsibilities:
- * - Connect and maintain MQTT connection
- * - Subscribe to command topics
- * - Publish state and config
+ * - Connect and maintain MQTT connection without blocking: the connect
+ *   handshake advances one step per loop()
+ * - Subscribe to command and config topics with two wildcard filters,
+ *   at QoS 1 on a persistent session so commands survive a disconnect
+ * - Give each device its own base topic and client id, so many lamps
+ *   can share one broker
+ * - Retry with jittered exponential backoff (see Backoff), so a fleet
+ *   does not reconnect in one burst when the broker comes back
+ * - Measure how long a (re)connect takes until commands flow
+ * - Publish the boot timeline once the broker is first reachable
+ * - Publish state and config through a coalescing queue
  * - Route messages to callback handler
+ * - Stop reading from the broker while the command inbox is full
+ * - Hand messages between the network task and the render loop
+ *
+ * Thread affinity: begin(), loop(), msUntilUpdate(), socketFd() and
+ * socketWantsWrite() belong to the network task, which owns the client
+ * and socket. Everything that builds a payload (queueState(),
+ * queueConfig(), service(), publishDiagnostics(), publishHeartbeat(),
+ * publishBootReport())
+ * belongs to the render loop.
+ * Payloads are formatted on the render side and passed over a lock-free
+ * SPSC ring, so the render loop never waits on the network.
  */
 class MqttManager {
 public:
-  using MessageCallback = std::function<void(const String& topic, const String& payload)>;
+  /**
+   * Message handler, called on the network task. Topic and payload
+   * point into the client buffer and are only valid during the call.
+   */
+  typedef void (*MessageCallback)(const char* topic, size_t topicLength, const MessageView& payload);
+
+  // Default base topic, and the prefix of per-device ones
+  static const char* MQTT_BASE;
 
   MqttManager();
 
+  /**
+   * Set the device's topics and client id. Call before begin().
+   *
+   * @param base Base topic ("" = MQTT_BASE/<last 3 MAC bytes>; invalid
+   *             ones fall back to that too)
+   * @param mac Station MAC address; the client id is ikea_lamp_<MAC>
+   *            unless MQTT_CLIENT_ID is defined
+   */
+  void setIdentity(const char* base, const uint8_t mac[6]);
+
+  /**
+   * Base topic in use (incoming topics are matched against it).
+   */
+  const char* baseTopic() const { return topics.base(); }
+
   /**
    * Initialize MQTT client and set callback.
    * 
@@ -33,25 +87,91 @@ public:
   void begin(MessageCallback callback);
 
   /**
-   * Maintain MQTT connection and process messages.
-   * Call in loop().
+   * Queue the callback fills. While it is full the callback is not
+   * called and no further packets are read, leaving them in the socket
+   * (TCP flow control pushes back on the broker).
+   */
+  void setInbox(const CommandQueue* inbox);
+
+  /**
+   * Sleep manager of the render loop, woken after a message was handed
+   * to the callback or a new broker session started.
+   */
+  void setWakeOnReceive(SleepManager* sleeper);
+
+  /**
+   * Sleep manager of the network task, woken when a payload is queued
+   * for sending.
+   */
+  void setWakeOnSend(SleepManager* sleeper);
+
+  // ---- Network task ----
+
+  /**
+   * Start or advance the connection, process messages and send
+   * handed-over payloads. Never blocks. Call in the network task loop.
    */
   void loop();
 
   /**
-   * Publish current device state to MQTT.
+   * Time until loop() has timed work to do (reconnect attempt, connect
+   * step deadline or keepalive). Incoming packets and a finished TCP
+   * connect are signalled through socketFd(), outgoing payloads through
+   * the setWakeOnSend() sleep manager.
+   *
+   * @return Milliseconds (0 = now)
+   */
+  unsigned long msUntilUpdate();
+
+  /**
+   * Socket of the broker connection, for waiting on incoming data.
+   *
+   * @return File descriptor, or -1 when there is nothing to wait for
+   */
+  int socketFd();
+
+  /**
+   * The socket should also be watched for writability (TCP connect in
+   * progress, or an outbox message waiting for send buffer space).
+   */
+  bool socketWantsWrite();
+
+  // ---- Render loop ----
+
+  /**
+   * Queue a state publish. Requests made before the queue flushes are
+   * merged; the state is rendered when it is sent, so the latest
+   * state always wins.
    * 
-   * @param state Current device state
+   * @param state Device state (must outlive the manager)
    * @param retain Whether to retain the message
    */
-  void publishState(const DeviceState& state, bool retain = false);
+  void queueState(const DeviceState& state, bool retain = false);
 
   /**
-   * Publish current device configuration to MQTT.
+   * Queue a config publish (always retained), merged like queueState().
    * 
-   * @param config Current device config
+   * @param config Device config (must outlive the manager)
+   */
+  void queueConfig(const DeviceConfig& config);
+
+  /**
+   * Format due publishes and hand them to the network task. After a
+   * reconnect, state and config are queued again. Call in loop().
+   */
+  void service();
+
+  /**
+   * Time until service() has a publish to hand over.
+   *
+   * @return Milliseconds (0 = now), or Clock::NO_DEADLINE
+   */
+  unsigned long msUntilService();
+
+  /**
+   * Minimum time between two publishes of the same topic.
    */
-  void publishConfig(const DeviceConfig& config);
+  void setPublishInterval(unsigned long ms);
 
   /**
    * Publish system diagnostics (uptime, heap, reset reason).
@@ -61,10 +181,20 @@ public:
    * @param minHeap Minimum heap seen
    * @param resetReason Reset reason string
    * @param loopCount Loop iteration count
+   * @param idlePercent Share of recent time the loop spent sleeping
+   * @param frames Render loop frame times since the last report
+   * @param time Wall clock (sync state, last correction and round trip)
+   * @param scheduler Timed commands and their skew since the last report
+   * @param group Animation phase group (lock, role, phase error)
+   * @param wifi Cached join, and reconnect attempts and outage of the
+   *             last WiFi recovery
    */
   void publishDiagnostics(unsigned long uptime, uint32_t freeHeap, 
                          uint32_t minHeap, const String& resetReason,
-                         unsigned long loopCount);
+                         unsigned long loopCount, uint8_t idlePercent,
+                         const FrameStats& frames, const WallClock& time,
+                         const CommandScheduler& scheduler, const PhaseGroup& group,
+                         const WiFiManager& wifi);
 
   /**
    * Publish heartbeat (simple alive signal).
@@ -72,7 +202,15 @@ public:
   void publishHeartbeat();
 
   /**
-   * Check if MQTT is currently connected.
+   * Publish the boot timeline (retained). Call once per boot, when
+   * connected; the network task has marked MQTT ready by then.
+   *
+   * @return False if not connected or the outbox was full (retry later)
+   */
+  bool publishBootReport(const String& resetReason);
+
+  /**
+   * Check if MQTT is currently connected. Safe from either side.
    */
   bool connected();
 
@@ -81,44 +219,73 @@ public:
    */
   void setStatusLED(StatusLED* led);
 
+  /**
+   * Timeline the network task marks MQTT ready on (and that
+   * publishBootReport() sends).
+   */
+  void setBootTimeline(BootTimeline* timeline) { boot = timeline; }
+
 private:
-  WiFiClient espClient;
-  PubSubClient client;
+  MqttClient client;
+  MqttClient::State reportedState;      // Last state acted on by loop()
   MessageCallback messageCallback;
   StatusLED* statusLED;
-  unsigned long lastReconnectAttempt;
-  static const unsigned long RECONNECT_INTERVAL_MS = 5000;
+  Backoff reconnect;                    // Network task only
+  BootTimeline* boot;
+  unsigned long connectedAt;            // Network task only
+  PublishQueue publishQueue;
+  const CommandQueue* inbox;
+  const DeviceState* queuedState;
+  const DeviceConfig* queuedConfig;
+  SleepManager* renderWake;
+  SleepManager* networkWake;
 
-  // MQTT Topics
-  static const char* MQTT_BASE;
-  static const char* TOPIC_CMD_POWER;
-  static const char* TOPIC_CMD_BRIGHTNESS;
-  static const char* TOPIC_CMD_COLOR;
-  static const char* TOPIC_CMD_ANIMATION;
-  static const char* TOPIC_CMD_PAUSE;
-  static const char* TOPIC_CMD_MODE;
-  static const char* TOPIC_CMD_QUERY;
-  static const char* TOPIC_CMD_TEST;
-  static const char* TOPIC_CMD_APPLY_DEFAULTS;
-  static const char* TOPIC_CFG_DEFAULT_BRI;
-  static const char* TOPIC_CFG_DEFAULT_COLOR;
-  static const char* TOPIC_CFG_SUNRISE_MIN;
-  static const char* TOPIC_CFG_MIN_PWM;
-  static const char* TOPIC_CFG_MAX_PWM;
-  static const char* TOPIC_CFG_SAVE;
-  static const char* TOPIC_CFG_RESET;
-  static const char* TOPIC_CFG_REQUEST;
-  static const char* TOPIC_CFG_FAVORITE_ANIMATION;
-  static const char* TOPIC_STATE_JSON;
-  static const char* TOPIC_CFG_STATE;
-  static const char* TOPIC_DIAGNOSTICS;   // System health info
-  static const char* TOPIC_HEARTBEAT;     // Alive signal
-
-  bool connectMqtt();
-  void subscribeToTopics();
-  static void mqttCallbackWrapper(char* topic, byte* payload, unsigned int length);
-  
-  static MqttManager* instance;
+  // Payload formatted by the render loop, sent by the network task
+  static const size_t MAX_OUTBOUND_PAYLOAD = 896;   // Fits MqttClient::BUFFER_SIZE with the topic
+  struct OutboundMessage {
+    const char* topic;
+    bool retain;
+    uint16_t length;
+    char payload[MAX_OUTBOUND_PAYLOAD];
+  };
+  SpscQueue<OutboundMessage, 4> outbox;
+  bool outboxStalled;                   // Network task only: head waits for a writable socket
+
+  std::atomic<bool> isConnected;
+  std::atomic<uint32_t> sessions;       // Incremented on every connect
+  uint32_t servicedSessions;            // Render side copy
+
+  // Time-to-ready: written by the network task, read for diagnostics
+  unsigned long attemptStarted;         // Network task only
+  unsigned long lostAt;                 // Network task only
+  bool everLost;                        // Network task only
+  std::atomic<uint32_t> readyMs;        // Connect attempt to ready
+  std::atomic<uint32_t> outageMs;       // Connection lost to ready again
+  std::atomic<uint32_t> retries;        // Attempts the last connect took
+  std::atomic<bool> sessionResumed;
+  static const unsigned long RECONNECT_FIRST_MS = 1000;
+  static const unsigned long RECONNECT_CAP_MS = 60000;
+  static const unsigned long STABLE_SESSION_MS = 30000;  // Shorter sessions keep backing off
+  static const uint16_t KEEPALIVE_S = 15;
+
+  // Device topics, built once by setIdentity()
+  TopicTable topics;
+  char clientId[TopicTable::MAX_BASE + 14];
+
+  // PublishQueue topic indexes
+  enum QueuedTopic : uint8_t {
+    QUEUED_STATE,
+    QUEUED_CONFIG
+  };
+
+  void startConnect();
+  void onStateChange(MqttClient::State next);
+  void sendOutbox();
+  bool publishState(const DeviceState& state, bool retain);
+  bool publishConfig(const DeviceConfig& config);
+  bool handOver(const char* topic, const char* payload, bool retain);
+  static bool onMessage(void* context, const char* topic, size_t topicLength,
+                        const char* payload, size_t payloadLength);
 };
 
 #endif // MQTT_MANAGER_H
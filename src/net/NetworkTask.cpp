@@ -0,0 +1,43 @@
+#include "NetworkTask.h"
+
+NetworkTask::NetworkTask(WiFiManager& w, MqttManager& m, SntpClient& s)
+  : wifi(w), mqtt(m), sntp(s) {
+}
+
+void NetworkTask::begin() {
+  sleeper.begin(false);
+  mqtt.setWakeOnSend(&sleeper);
+
+  if (xTaskCreate(run, "network", STACK_SIZE, this, PRIORITY, nullptr) != pdPASS) {
+    Serial.println("[NET] ERROR: Failed to start network task");
+    return;
+  }
+  Serial.println("[NET] Network task started");
+}
+
+void NetworkTask::run(void* arg) {
+  NetworkTask* self = (NetworkTask*)arg;
+  for (;;) {
+    self->loop();
+  }
+}
+
+void NetworkTask::loop() {
+  // First, so an SNTP reply is timestamped right after the wake-up
+  bool online = wifi.connected();
+  if (online) sntp.poll();
+
+  wifi.loop();
+  mqtt.loop();
+
+  unsigned long wait = MAX_SLEEP_MS;
+  wait = min(wait, wifi.msUntilUpdate());
+  wait = min(wait, mqtt.msUntilUpdate());
+  if (online) wait = min(wait, sntp.msUntilPoll());
+  if (wait == 0) {
+    // Give equal-priority tasks a turn while reconnect work is pending
+    taskYIELD();
+    return;
+  }
+  sleeper.sleep(wait, mqtt.socketFd(), mqtt.socketWantsWrite(), sntp.socketFd());
+}
@@ -0,0 +1,47 @@
+#ifndef NETWORK_TASK_H
+#define NETWORK_TASK_H
+
+#include <Arduino.h>
+#include "WiFiManager.h"
+#include "MqttManager.h"
+#include "SntpClient.h"
+#include "../hw/SleepManager.h"
+
+/**
+ * FreeRTOS task that owns WiFi, the MQTT client and time sync.
+ *
+ * Responsibilities:
+ * - Run wifi.loop(), mqtt.loop() and the SNTP client off the render loop
+ * - Sleep until a network deadline, socket data (MQTT or an SNTP reply),
+ *   a finished TCP connect or an outgoing payload
+ *
+ * The MQTT connect and SNTP exchanges are non-blocking, so a dead broker
+ * or time server never stalls this task; WiFi joins and the one-time
+ * name lookups still block here. The render loop runs at a higher
+ * priority and talks to it only through lock-free rings (MqttManager's
+ * command and publish rings, SntpClient's sync results).
+ */
+class NetworkTask {
+public:
+  NetworkTask(WiFiManager& wifi, MqttManager& mqtt, SntpClient& sntp);
+
+  /**
+   * Start the task. Call after wifi.begin() and mqtt.begin().
+   */
+  void begin();
+
+private:
+  static const uint32_t STACK_SIZE = 6144;
+  static const UBaseType_t PRIORITY = 1;        // Below the render loop
+  static const unsigned long MAX_SLEEP_MS = 1000;
+
+  WiFiManager& wifi;
+  MqttManager& mqtt;
+  SntpClient& sntp;
+  SleepManager sleeper;
+
+  static void run(void* arg);
+  void loop();
+};
+
+#endif // NETWORK_TASK_H
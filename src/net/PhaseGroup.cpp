@@ -0,0 +1,277 @@
+#include "PhaseGroup.h"
+#include "../state/Bytes.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace {
+
+// Beacon layout (big endian)
+//   0  magic "LP"
+//   2  version
+//   3  flags (reserved, 0)
+//   4  group hash
+//   8  sender id
+//  12  group time in ms
+const uint8_t BEACON_MAGIC_0 = 'L';
+const uint8_t BEACON_MAGIC_1 = 'P';
+const uint8_t BEACON_VERSION = 1;
+
+}  // namespace
+
+const char* const PhaseGroup::DEFAULT_ADDRESS = "239.255.76.67";
+
+PhaseGroup::PhaseGroup()
+  : clock(&Clock::system()), memberId(0), port(0), address(DEFAULT_ADDRESS), fd(-1),
+    membership(false), inGroup(false), groupName{0}, groupHash(0), joinedAt(0),
+    listened(false), lastBeaconMs(0), leaderId(0), leaderSeenMs(0), offset(0),
+    haveSample(false), window{0}, windowCount(0), windowPos(0),
+    lastError(0), maxError(0) {
+}
+
+PhaseGroup::~PhaseGroup() {
+  closeSocket();
+}
+
+uint32_t PhaseGroup::hashName(const char* name) {
+  return Bytes::fnv1a(name, strlen(name));
+}
+
+size_t PhaseGroup::encode(const Beacon& beacon, uint8_t* data) {
+  data[0] = BEACON_MAGIC_0;
+  data[1] = BEACON_MAGIC_1;
+  data[2] = BEACON_VERSION;
+  data[3] = 0;
+  Bytes::writeU32(data + 4, beacon.groupHash);
+  Bytes::writeU32(data + 8, beacon.senderId);
+  Bytes::writeU32(data + 12, beacon.groupMs);
+  return BEACON_SIZE;
+}
+
+bool PhaseGroup::decode(const uint8_t* data, size_t length, Beacon& beacon) {
+  if (length < BEACON_SIZE) return false;
+  if (data[0] != BEACON_MAGIC_0 || data[1] != BEACON_MAGIC_1) return false;
+  if (data[2] != BEACON_VERSION) return false;
+  beacon.groupHash = Bytes::readU32(data + 4);
+  beacon.senderId = Bytes::readU32(data + 8);
+  beacon.groupMs = Bytes::readU32(data + 12);
+  return true;
+}
+
+bool PhaseGroup::join(const char* name) {
+  if (!name || !*name) {
+    leave();
+    return true;
+  }
+  if (strlen(name) > MAX_NAME) return false;
+
+  leave();
+  if (port != 0 && !openSocket()) return false;
+
+  unsigned long now = clock->millis();
+  strcpy(groupName, name);
+  groupHash = hashName(name);
+  inGroup = true;
+  joinedAt = now;
+  listened = false;
+  lastBeaconMs = now - BEACON_INTERVAL_MS;
+  leaderId = memberId;
+  leaderSeenMs = now;
+  offset = 0;
+  haveSample = false;
+  windowCount = 0;
+  windowPos = 0;
+  lastError = 0;
+  maxError = 0;
+
+  Serial.printf("[GRP] Joined group '%s' as %08lx\n", groupName, (unsigned long)memberId);
+  return true;
+}
+
+void PhaseGroup::leave() {
+  closeSocket();
+  if (!inGroup) return;
+  inGroup = false;
+  Serial.printf("[GRP] Left group '%s'\n", groupName);
+  groupName[0] = '\0';
+}
+
+void PhaseGroup::follow(uint32_t id) {
+  leaderId = id;
+
+  // The group time carries over; start the new window from our estimate
+  // so a delayed first beacon does not pull it back
+  window[0] = 0;
+  windowCount = locked() ? 1 : 0;
+  windowPos = windowCount;
+  if (id == memberId) {
+    Serial.println("[GRP] Leading group time");
+  } else {
+    Serial.printf("[GRP] Following %08lx\n", (unsigned long)id);
+  }
+}
+
+void PhaseGroup::update(unsigned long now) {
+  if (!inGroup) return;
+  if (!listened && now - joinedAt >= LISTEN_MS) listened = true;
+
+  if (leaderId != memberId) {
+    // A silent leader is gone; lead with the time we have. After the
+    // listen period the lowest id leads, keeping the adopted time
+    if (now - leaderSeenMs > LEADER_TIMEOUT_MS || (listened && memberId < leaderId)) {
+      follow(memberId);
+    }
+  }
+}
+
+void PhaseGroup::handleBeacon(const Beacon& beacon) {
+  if (!inGroup || beacon.groupHash != groupHash || beacon.senderId == memberId) return;
+
+  unsigned long now = clock->millis();
+  update(now);
+
+  if (beacon.senderId != leaderId) {
+    // Lower ids win; before having any time, take the first one heard.
+    // Higher ids are other followers (or will follow us)
+    if (beacon.senderId > leaderId && (haveSample || listened)) return;
+    follow(beacon.senderId);
+  }
+  leaderSeenMs = now;
+
+  // Delivery delay only makes a beacon look older, so the largest
+  // estimate of group minus local time is the least delayed one
+  int32_t residual = (int32_t)(beacon.groupMs - (uint32_t)now - offset);
+  if (windowCount > 0 && (residual > (int32_t)RESYNC_MS || residual < -(int32_t)RESYNC_MS)) {
+    windowCount = 0;  // The leader's time is not ours (groups merged); take it over
+  }
+  if (windowCount == 0) windowPos = 0;
+  window[windowPos] = residual;
+  windowPos = (windowPos + 1) % WINDOW;
+  if (windowCount < WINDOW) windowCount++;
+
+  int32_t best = window[0];
+  for (uint8_t i = 1; i < windowCount; i++) {
+    if (window[i] > best) best = window[i];
+  }
+
+  // Move to the new estimate; the window stays relative to it. The
+  // phase error is the step this makes
+  offset += (uint32_t)best;
+  for (uint8_t i = 0; i < windowCount; i++) window[i] -= best;
+  if (haveSample || listened) {
+    lastError = best;
+    uint32_t magnitude = best < 0 ? (uint32_t)(-(int64_t)best) : (uint32_t)best;
+    if (magnitude > maxError) maxError = magnitude;
+  }
+  haveSample = true;
+}
+
+bool PhaseGroup::nextBeacon(Beacon& beacon) {
+  if (!inGroup) return false;
+  unsigned long local = clock->millis();
+  update(local);
+
+  // Stay quiet while listening: our own time would pull the group
+  if (!listened || local - lastBeaconMs < BEACON_INTERVAL_MS) return false;
+  lastBeaconMs = local;
+
+  beacon.groupHash = groupHash;
+  beacon.senderId = memberId;
+  beacon.groupMs = (uint32_t)local + offset;
+  return true;
+}
+
+void PhaseGroup::poll() {
+  if (!inGroup) return;
+
+  if (fd >= 0) {
+    uint8_t packet[BEACON_SIZE + 16];
+    Beacon beacon;
+    for (uint8_t i = 0; i < MAX_READS_PER_POLL; i++) {
+      ssize_t n = recv(fd, packet, sizeof(packet), 0);
+      if (n < 0) break;
+      if (decode(packet, (size_t)n, beacon)) handleBeacon(beacon);
+    }
+  }
+
+  Beacon beacon;
+  if (!nextBeacon(beacon) || fd < 0) return;
+
+  // Joining fails until WiFi is up; retry with each beacon
+  if (!membership) membership = joinMembership();
+
+  uint8_t packet[BEACON_SIZE];
+  encode(beacon, packet);
+  struct sockaddr_in dest;
+  memset(&dest, 0, sizeof(dest));
+  dest.sin_family = AF_INET;
+  dest.sin_port = htons(port);
+  dest.sin_addr.s_addr = inet_addr(address);
+  sendto(fd, packet, sizeof(packet), 0, (struct sockaddr*)&dest, sizeof(dest));
+}
+
+unsigned long PhaseGroup::msUntilPoll() const {
+  if (!inGroup) return Clock::NO_DEADLINE;
+  unsigned long now = clock->millis();
+
+  unsigned long due = listened ? lastBeaconMs + BEACON_INTERVAL_MS : joinedAt + LISTEN_MS;
+  if (leaderId != memberId) {
+    unsigned long timeout = leaderSeenMs + LEADER_TIMEOUT_MS + 1;
+    if ((long)(timeout - due) < 0) due = timeout;
+  }
+  long until = (long)(due - now);
+  return until > 0 ? (unsigned long)until : 0;
+}
+
+bool PhaseGroup::openSocket() {
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    Serial.println("[GRP] ERROR: Failed to create socket");
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  int reuse = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    Serial.printf("[GRP] ERROR: Failed to bind port %u\n", port);
+    closeSocket();
+    return false;
+  }
+
+  // Beacons stay on the local network; our own are not looped back
+  uint8_t ttl = 1;
+  uint8_t loop = 0;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+  membership = joinMembership();
+  return true;
+}
+
+bool PhaseGroup::joinMembership() {
+  struct ip_mreq request;
+  memset(&request, 0, sizeof(request));
+  request.imr_multiaddr.s_addr = inet_addr(address);
+  request.imr_interface.s_addr = htonl(INADDR_ANY);
+  return setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) == 0;
+}
+
+void PhaseGroup::closeSocket() {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+  membership = false;
+}
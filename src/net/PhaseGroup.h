@@ -0,0 +1,164 @@
+#ifndef PHASE_GROUP_H
+#define PHASE_GROUP_H
+
+#include <Arduino.h>
+#include "../hw/Clock.h"
+
+/**
+ * Shared animation time for a named group of lamps (UDP multicast).
+ *
+ * Responsibilities:
+ * - Send a small beacon with the group time once a second
+ * - Elect the member with the lowest id as time leader; the others
+ *   follow it, and the next one takes over without a jump when it leaves
+ * - Estimate the leader's time from the beacons with the shortest
+ *   delivery delay, which tracks clock drift without adding jitter
+ * - Measure the phase error: how far each leader beacon moved the
+ *   local estimate of the group time
+ *
+ * The group time is a free-running millisecond counter that only the
+ * group agrees on; it is not wall-clock time, so it needs neither NTP
+ * nor a broker. Animations take it as their running time (see
+ * AnimationEngine::alignPhase), which keeps looping effects of all
+ * members in phase for as long as they run.
+ *
+ * Owned by the render loop, which sleeps on socketFd(). The election and
+ * estimation work on decoded beacons (handleBeacon(), nextBeacon()), so
+ * several members can be simulated without sockets.
+ */
+class PhaseGroup {
+public:
+  static const uint16_t DEFAULT_PORT = 4049;
+  static const char* const DEFAULT_ADDRESS;     // 239.255.76.67, site-local
+  static const size_t   MAX_NAME = 31;
+  static const size_t   BEACON_SIZE = 16;
+  static const uint32_t BEACON_INTERVAL_MS = 1000;
+  static const uint32_t LISTEN_MS = 2500;        // Look for a leader before leading
+  static const uint32_t LEADER_TIMEOUT_MS = 3500;
+
+  struct Beacon {
+    uint32_t groupHash;   // FNV-1a of the group name
+    uint32_t senderId;
+    uint32_t groupMs;     // Sender's group time when sent
+  };
+
+  PhaseGroup();
+  ~PhaseGroup();
+
+  /**
+   * Use the multicast socket. Without it the group only works through
+   * handleBeacon()/nextBeacon().
+   *
+   * @param address Multicast group address (must outlive the object)
+   */
+  void setTransport(uint16_t p = DEFAULT_PORT, const char* a = DEFAULT_ADDRESS) {
+    port = p;
+    address = a;
+  }
+
+  /**
+   * Member id; the lowest one leads. Set before join().
+   */
+  void setMemberId(uint32_t id) { memberId = id; }
+
+  void setClock(const Clock* c) { clock = c; }
+
+  /**
+   * Join a group, leaving the current one. An empty name leaves.
+   *
+   * @return False if the name is too long or the socket failed
+   */
+  bool join(const char* name);
+
+  void leave();
+
+  /**
+   * Read beacons and send ours when due. Never blocks.
+   */
+  void poll();
+
+  /**
+   * Time until poll() has work to do.
+   *
+   * @return Milliseconds, Clock::NO_DEADLINE when not in a group
+   */
+  unsigned long msUntilPoll() const;
+
+  /**
+   * Process a beacon received now.
+   */
+  void handleBeacon(const Beacon& beacon);
+
+  /**
+   * Our beacon, if one is due now.
+   *
+   * @return False if not in a group or not due
+   */
+  bool nextBeacon(Beacon& beacon);
+
+  bool joined() const { return inGroup; }
+  const char* name() const { return groupName; }
+
+  /**
+   * Check if the group time is usable: a leader was heard, or nobody
+   * answered within LISTEN_MS and this member leads.
+   */
+  bool locked() const { return inGroup && (haveSample || listened); }
+
+  bool leading() const { return inGroup && leaderId == memberId; }
+  uint32_t leader() const { return leaderId; }
+
+  /**
+   * Current group time in milliseconds.
+   */
+  uint32_t now() const { return (uint32_t)clock->millis() + offset; }
+
+  int socketFd() const { return fd; }
+
+  // Phase error statistics: correction made by the last leader beacon
+  int32_t lastPhaseErrorMs() const { return lastError; }
+  uint32_t maxPhaseErrorMs() const { return maxError; }   // Largest magnitude since resetStats()
+  void resetStats() { maxError = 0; }
+
+  static size_t encode(const Beacon& beacon, uint8_t* data);
+  static bool decode(const uint8_t* data, size_t length, Beacon& beacon);
+  static uint32_t hashName(const char* name);
+
+private:
+  static const uint8_t WINDOW = 8;               // Beacons in the offset estimate
+  static const uint32_t RESYNC_MS = 500;         // Larger differences restart the estimate
+  static const uint8_t MAX_READS_PER_POLL = 8;
+
+  const Clock* clock;
+  uint32_t memberId;
+  uint16_t port;            // 0 = no socket
+  const char* address;
+  int fd;
+  bool membership;          // Multicast group joined on the interface
+
+  bool inGroup;
+  char groupName[MAX_NAME + 1];
+  uint32_t groupHash;
+  unsigned long joinedAt;
+  bool listened;            // LISTEN_MS passed since join()
+  unsigned long lastBeaconMs;
+
+  uint32_t leaderId;
+  unsigned long leaderSeenMs;
+  uint32_t offset;          // Group time minus local time (mod 2^32)
+  bool haveSample;
+  int32_t window[WINDOW];   // Recent estimates from the leader, relative to offset
+  uint8_t windowCount;
+  uint8_t windowPos;
+
+  int32_t lastError;
+  uint32_t maxError;
+
+  void update(unsigned long now);
+  void follow(uint32_t id);
+  bool openSocket();
+  void closeSocket();
+  bool joinMembership();
+};
+
+#endif // PHASE_GROUP_H
@@ -0,0 +1,75 @@
+#include "PublishQueue.h"
+
+PublishQueue::PublishQueue()
+  : clock(&Clock::system()), minIntervalMs(100), pending(0), retained(0), everSent(0),
+    nextScan(0), coalesced(0) {
+  for (uint8_t i = 0; i < MAX_TOPICS; i++) {
+    lastSent[i] = 0;
+  }
+}
+
+void PublishQueue::request(uint8_t topic, bool retain) {
+  if (topic >= MAX_TOPICS) return;
+  uint8_t bit = 1 << topic;
+
+  if (pending & bit) coalesced++;
+  pending |= bit;
+  if (retain) retained |= bit;
+}
+
+bool PublishQueue::takeDue(uint8_t& topic, bool& retain) {
+  if (!pending) return false;
+  unsigned long now = clock->millis();
+
+  // Round-robin so a busy topic cannot starve the others
+  for (uint8_t n = 0; n < MAX_TOPICS; n++) {
+    uint8_t i = (nextScan + n) % MAX_TOPICS;
+    uint8_t bit = 1 << i;
+    if (!(pending & bit) || msUntilDue(i, now) > 0) continue;
+
+    topic = i;
+    retain = (retained & bit) != 0;
+    pending &= ~bit;
+    retained &= ~bit;
+    everSent |= bit;
+    lastSent[i] = now;
+    nextScan = (i + 1) % MAX_TOPICS;
+    return true;
+  }
+  return false;
+}
+
+unsigned long PublishQueue::msUntilDue() const {
+  if (!pending) return Clock::NO_DEADLINE;
+  unsigned long now = clock->millis();
+
+  unsigned long wait = Clock::NO_DEADLINE;
+  for (uint8_t i = 0; i < MAX_TOPICS; i++) {
+    if (!(pending & (1 << i))) continue;
+    unsigned long w = msUntilDue(i, now);
+    if (w < wait) wait = w;
+  }
+  return wait;
+}
+
+unsigned long PublishQueue::msUntilDue(uint8_t topic, unsigned long now) const {
+  if (!(everSent & (1 << topic))) return 0;
+  unsigned long elapsed = now - lastSent[topic];
+  return elapsed >= minIntervalMs ? 0 : minIntervalMs - elapsed;
+}
+
+bool PublishQueue::isPending(uint8_t topic) const {
+  return topic < MAX_TOPICS && (pending & (1 << topic));
+}
+
+void PublishQueue::setMinInterval(unsigned long ms) {
+  minIntervalMs = ms;
+}
+
+uint32_t PublishQueue::coalescedCount() const {
+  return coalesced;
+}
+
+void PublishQueue::setClock(const Clock* c) {
+  clock = c;
+}
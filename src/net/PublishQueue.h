@@ -0,0 +1,87 @@
+#ifndef PUBLISH_QUEUE_H
+#define PUBLISH_QUEUE_H
+
+#include <Arduino.h>
+#include "../hw/Clock.h"
+
+/**
+ * Outbound publish scheduler keyed by topic, latest state wins.
+ *
+ * Responsibilities:
+ * - Collapse repeated publish requests for the same topic into one
+ * - Space publishes of each topic at least a minimum interval apart
+ * - Keep a request pending until it has actually been sent
+ *
+ * The queue only stores which topics are due, never payloads: the
+ * payload is rendered from the current state when the topic is flushed,
+ * so a superseded value can never be sent after a newer one and the
+ * final state is always the one published.
+ */
+class PublishQueue {
+public:
+  static const uint8_t MAX_TOPICS = 8;
+
+  PublishQueue();
+
+  /**
+   * Ask for a topic to be published.
+   * A request while one is pending is merged into it (retained if any
+   * request asked for retain).
+   *
+   * @param topic Topic index (0..MAX_TOPICS-1)
+   * @param retain Publish as retained
+   */
+  void request(uint8_t topic, bool retain);
+
+  /**
+   * Take the next topic whose interval has elapsed and mark it sent.
+   * If publishing fails, request() it again.
+   *
+   * @param topic Set to the topic index
+   * @param retain Set to the merged retain flag
+   * @return False if nothing is due
+   */
+  bool takeDue(uint8_t& topic, bool& retain);
+
+  /**
+   * Time until takeDue() would return a topic.
+   *
+   * @return Milliseconds (0 = now), or Clock::NO_DEADLINE if nothing is pending
+   */
+  unsigned long msUntilDue() const;
+
+  /**
+   * Whether a topic is waiting to be published.
+   */
+  bool isPending(uint8_t topic) const;
+
+  /**
+   * Minimum time between two publishes of the same topic.
+   * A request after a quiet period is sent immediately.
+   */
+  void setMinInterval(unsigned long ms);
+
+  /**
+   * Requests merged into an already pending one since boot.
+   */
+  uint32_t coalescedCount() const;
+
+  /**
+   * Replace the time source (defaults to the system clock).
+   */
+  void setClock(const Clock* clock);
+
+private:
+  const Clock* clock;
+  unsigned long minIntervalMs;
+  uint8_t pending;                        // Bit per topic
+  uint8_t retained;                       // Bit per topic
+  uint8_t everSent;                       // Bit per topic
+  unsigned long lastSent[MAX_TOPICS];
+  uint8_t nextScan;                       // Round-robin start for takeDue()
+  uint32_t coalesced;
+
+  unsigned long msUntilDue(uint8_t topic, unsigned long now) const;
+};
+
+#endif // PUBLISH_QUEUE_H
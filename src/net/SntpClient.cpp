@@ -0,0 +1,211 @@
+#include "SntpClient.h"
+#include "../state/Bytes.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace {
+
+// First byte of a request: no leap indicator, version 4, mode 3 (client)
+const uint8_t NTP_CLIENT_REQUEST = 0x23;
+const uint8_t NTP_MODE_SERVER = 4;
+const uint8_t NTP_LEAP_UNSYNCHRONIZED = 3;
+
+// Field offsets in the 48-byte packet
+const size_t NTP_ORIGINATE = 24;
+const size_t NTP_RECEIVE   = 32;
+const size_t NTP_TRANSMIT  = 40;
+
+const uint64_t NTP_TO_UNIX_SECONDS = 2208988800ULL;  // 1900 → 1970
+
+}  // namespace
+
+SntpClient::SntpClient()
+  : clock(&Clock::system()), host(NTP_HOST), port(DEFAULT_PORT),
+    intervalMs(DEFAULT_INTERVAL_MS), replyTimeoutMs(DEFAULT_REPLY_TIMEOUT_MS),
+    fd(-1), resolved(false), address(0), started(false), nextRoundAt(0), attempts(0),
+    awaiting(false), sentMs(0), sentUs(0), nonce{0, 0}, haveBest(false), best{0, 0, 0},
+    bestDelayUs(0), rounds(0), rejected(0) {
+}
+
+SntpClient::~SntpClient() {
+  if (fd >= 0) close(fd);
+}
+
+void SntpClient::setServer(const char* h, uint16_t p) {
+  host = h;
+  port = p;
+  resolved = false;
+}
+
+uint64_t SntpClient::ntpToEpochUs(uint32_t seconds, uint32_t fraction) {
+  // Era 1 starts in 2036; small second counts belong to it
+  uint64_t ntpSeconds = seconds;
+  if ((seconds & 0x80000000UL) == 0) ntpSeconds += 1ULL << 32;
+  uint64_t us = ((uint64_t)fraction * 1000000ULL) >> 32;
+  return (ntpSeconds - NTP_TO_UNIX_SECONDS) * 1000000ULL + us;
+}
+
+bool SntpClient::resolve() {
+  if (resolved) return true;
+  if (!host) return false;
+
+  struct in_addr numeric;
+  if (inet_pton(AF_INET, host, &numeric) == 1) {
+    address = numeric.s_addr;
+    resolved = true;
+    return true;
+  }
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  struct addrinfo* result = nullptr;
+  if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) return false;
+
+  address = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(result);
+  resolved = true;
+  return true;
+}
+
+bool SntpClient::openSocket() {
+  if (fd < 0) {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  }
+
+  // A connected UDP socket only receives from the server
+  struct sockaddr_in server;
+  memset(&server, 0, sizeof(server));
+  server.sin_family = AF_INET;
+  server.sin_port = htons(port);
+  server.sin_addr.s_addr = address;
+  return ::connect(fd, (struct sockaddr*)&server, sizeof(server)) == 0;
+}
+
+void SntpClient::poll() {
+  unsigned long now = clock->millis();
+  if (!started) {
+    started = true;
+    nextRoundAt = now;
+  }
+
+  if (awaiting) {
+    readReplies();
+    if (awaiting && now - sentMs >= replyTimeoutMs) {
+      awaiting = false;  // Lost; counts as an attempt
+    }
+  }
+  if (awaiting) return;
+
+  if (attempts >= ROUND_ATTEMPTS) {
+    endRound();
+  } else if (attempts > 0) {
+    sendRequest();  // Next exchange of this round
+  } else if ((long)(now - nextRoundAt) >= 0) {
+    if (!resolve() || !openSocket()) {
+      resolved = false;
+      nextRoundAt = now + RETRY_INTERVAL_MS;
+      return;
+    }
+    haveBest = false;
+    sendRequest();
+  }
+}
+
+void SntpClient::sendRequest() {
+  uint8_t packet[PACKET_SIZE];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = NTP_CLIENT_REQUEST;
+
+  // The transmit field is echoed as the reply's originate timestamp; it
+  // only has to be unique, so it carries our local time, not the epoch
+  attempts++;
+  sentMs = clock->millis();
+  sentUs = clock->micros();
+  nonce[0] = (uint32_t)sentMs;
+  nonce[1] = (uint32_t)sentUs ^ ((uint32_t)rounds << 8) ^ attempts;
+  Bytes::writeU32(packet + NTP_TRANSMIT, nonce[0]);
+  Bytes::writeU32(packet + NTP_TRANSMIT + 4, nonce[1]);
+
+  awaiting = send(fd, packet, sizeof(packet), 0) == (ssize_t)sizeof(packet);
+}
+
+void SntpClient::readReplies() {
+  uint8_t packet[PACKET_SIZE + 16];
+  for (uint8_t i = 0; i < ROUND_ATTEMPTS; i++) {
+    ssize_t n = recv(fd, packet, sizeof(packet), 0);
+    if (n < 0) return;
+    if (handleReply(packet, (size_t)n, clock->micros())) {
+      awaiting = false;
+      return;
+    }
+    rejected++;
+  }
+}
+
+bool SntpClient::handleReply(const uint8_t* data, size_t length, unsigned long receivedUs) {
+  if (length < PACKET_SIZE) return false;
+  if ((data[0] & 0x07) != NTP_MODE_SERVER) return false;
+  if ((data[0] >> 6) == NTP_LEAP_UNSYNCHRONIZED) return false;
+  if (data[1] == 0 || data[1] > 15) return false;  // Kiss-o'-death or bad stratum
+  if (Bytes::readU32(data + NTP_ORIGINATE) != nonce[0] ||
+      Bytes::readU32(data + NTP_ORIGINATE + 4) != nonce[1]) {
+    return false;  // Stale or not ours
+  }
+
+  uint64_t serverReceived = ntpToEpochUs(Bytes::readU32(data + NTP_RECEIVE), Bytes::readU32(data + NTP_RECEIVE + 4));
+  uint64_t serverSent = ntpToEpochUs(Bytes::readU32(data + NTP_TRANSMIT), Bytes::readU32(data + NTP_TRANSMIT + 4));
+  if (serverSent < serverReceived) return false;
+
+  // Round trip minus the server's processing time
+  int64_t delay = (int64_t)(uint32_t)(receivedUs - sentUs) - (int64_t)(serverSent - serverReceived);
+  if (delay < 0) delay = 0;
+
+  if (!haveBest || (uint32_t)delay < bestDelayUs) {
+    best.localMs = (uint32_t)clock->millis();
+    best.epochMs = (serverSent + (uint64_t)delay / 2) / 1000;
+    best.rttMs = delay / 1000 > 0xFFFF ? 0xFFFF : (uint16_t)(delay / 1000);
+    bestDelayUs = (uint32_t)delay;
+    haveBest = true;
+  }
+  return true;
+}
+
+void SntpClient::endRound() {
+  unsigned long now = clock->millis();
+  attempts = 0;
+  if (haveBest) {
+    results.push(best);
+    rounds++;
+    nextRoundAt = now + intervalMs;
+  } else {
+    resolved = false;  // Look the name up again; pools rotate
+    nextRoundAt = now + RETRY_INTERVAL_MS;
+  }
+}
+
+unsigned long SntpClient::msUntilPoll() const {
+  if (!started) return 0;
+  unsigned long now = clock->millis();
+  if (awaiting) {
+    unsigned long elapsed = now - sentMs;
+    return elapsed >= replyTimeoutMs ? 0 : replyTimeoutMs - elapsed;
+  }
+  if (attempts > 0) return 0;
+  long until = (long)(nextRoundAt - now);
+  return until > 0 ? (unsigned long)until : 0;
+}
+
+bool SntpClient::takeSync(WallClock::Sync& sync) {
+  return results.pop(sync);
+}
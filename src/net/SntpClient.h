@@ -0,0 +1,130 @@
+#ifndef SNTP_CLIENT_H
+#define SNTP_CLIENT_H
+
+#include <Arduino.h>
+#include "SpscQueue.h"
+#include "../hw/Clock.h"
+#include "../hw/WallClock.h"
+
+// Override with -DNTP_HOST=\"192.168.1.10\" (e.g. a local stand-in)
+#ifndef NTP_HOST
+#define NTP_HOST "pool.ntp.org"
+#endif
+
+/**
+ * Minimal SNTP (RFC 4330) client on a non-blocking UDP socket.
+ *
+ * Responsibilities:
+ * - Query the time server periodically, a few exchanges per round
+ * - Keep the exchange with the shortest round trip, which has the
+ *   smallest asymmetry error
+ * - Reject replies that do not answer our request (wrong origin
+ *   timestamp, unsynchronized server, wrong mode)
+ * - Hand results to the render loop through a lock-free ring
+ *
+ * Owned and polled by the network task, which sleeps on socketFd() so a
+ * reply is timestamped as soon as it arrives. The render loop takes the
+ * results with takeSync() and applies them to its WallClock. Like
+ * MqttClient, host names are resolved once with getaddrinfo() (again
+ * after a round without any reply); numeric addresses never block.
+ */
+class SntpClient {
+public:
+  static const uint16_t DEFAULT_PORT = 123;
+  static const uint32_t DEFAULT_INTERVAL_MS = 60000;
+
+  SntpClient();
+  ~SntpClient();
+
+  /**
+   * @param host Server name or address (must outlive the client)
+   */
+  void setServer(const char* host, uint16_t port = DEFAULT_PORT);
+
+  /**
+   * Time between sync rounds.
+   */
+  void setInterval(uint32_t ms) { intervalMs = ms; }
+
+  /**
+   * How long to wait for each reply.
+   */
+  void setReplyTimeout(uint32_t ms) { replyTimeoutMs = ms; }
+
+  void setClock(const Clock* c) { clock = c; }
+
+  /**
+   * Network side: send due requests and read replies. Never blocks
+   * except for the first lookup of a host name.
+   */
+  void poll();
+
+  /**
+   * Network side: time until poll() has work to do.
+   */
+  unsigned long msUntilPoll() const;
+
+  /**
+   * Network side: socket to sleep on, -1 while idle.
+   */
+  int socketFd() const { return awaiting ? fd : -1; }
+
+  /**
+   * Render side: take the next sync result.
+   *
+   * @return False if none is waiting
+   */
+  bool takeSync(WallClock::Sync& sync);
+
+  // Network side counters
+  uint32_t roundsCompleted() const { return rounds; }
+  uint32_t repliesRejected() const { return rejected; }
+
+  /**
+   * Convert an NTP timestamp (seconds since 1900, 32.32 fixed point)
+   * to Unix epoch microseconds.
+   */
+  static uint64_t ntpToEpochUs(uint32_t seconds, uint32_t fraction);
+
+private:
+  static const uint8_t  ROUND_ATTEMPTS = 4;
+  static const uint32_t RETRY_INTERVAL_MS = 10000;   // After a round without replies
+  static const uint32_t DEFAULT_REPLY_TIMEOUT_MS = 1000;
+  static const size_t   PACKET_SIZE = 48;
+
+  const Clock* clock;
+  const char* host;
+  uint16_t port;
+  uint32_t intervalMs;
+  uint32_t replyTimeoutMs;
+
+  int fd;
+  bool resolved;
+  uint32_t address;          // Network byte order
+
+  bool started;
+  unsigned long nextRoundAt;
+  uint8_t attempts;          // Requests sent this round
+  bool awaiting;             // Request in flight
+  unsigned long sentMs;
+  unsigned long sentUs;
+  uint32_t nonce[2];         // Transmit timestamp we expect echoed back
+
+  bool haveBest;
+  WallClock::Sync best;
+  uint32_t bestDelayUs;
+
+  uint32_t rounds;
+  uint32_t rejected;
+
+  SpscQueue<WallClock::Sync, 4> results;
+
+  bool resolve();
+  bool openSocket();
+  void sendRequest();
+  void readReplies();
+  bool handleReply(const uint8_t* data, size_t length, unsigned long receivedUs);
+  void endRound();
+};
+
+#endif // SNTP_CLIENT_H
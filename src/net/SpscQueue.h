@@ -0,0 +1,100 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * Lock-free single-producer, single-consumer ring.
+ *
+ * Responsibilities:
+ * - Pass fixed-size messages between exactly two tasks without locks
+ * - Never block: a full ring rejects the push, an empty one the pop
+ *
+ * One slot is kept free to tell full from empty, so the ring holds
+ * SIZE - 1 messages.
+ *
+ * @tparam T Message type (copied in and out)
+ * @tparam SIZE Slot count, power of two
+ */
+template <typename T, uint8_t SIZE>
+class SpscQueue {
+  static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two");
+
+public:
+  SpscQueue() : head(0), tail(0) {}
+
+  /**
+   * Producer: copy a message in.
+   *
+   * @return False if the ring is full
+   */
+  bool push(const T& message) {
+    uint8_t h = head.load(std::memory_order_relaxed);
+    uint8_t next = (h + 1) & (SIZE - 1);
+    if (next == tail.load(std::memory_order_acquire)) return false;
+
+    slots[h] = message;
+    head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Consumer: copy the oldest message out.
+   *
+   * @return False if the ring is empty
+   */
+  bool pop(T& message) {
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+
+    message = slots[t];
+    tail.store((t + 1) & (SIZE - 1), std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Consumer: copy the oldest message out but leave it queued, so a
+   * failed hand-on can be retried. drop() removes it.
+   *
+   * @return False if the ring is empty
+   */
+  bool peek(T& message) const {
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+
+    message = slots[t];
+    return true;
+  }
+
+  /**
+   * Consumer: remove the oldest message (after peek()).
+   */
+  void drop() {
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return;
+    tail.store((t + 1) & (SIZE - 1), std::memory_order_release);
+  }
+
+  /**
+   * Either side: nothing queued.
+   */
+  bool isEmpty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Either side: the next push() would fail.
+   */
+  bool isFull() const {
+    uint8_t next = (head.load(std::memory_order_acquire) + 1) & (SIZE - 1);
+    return next == tail.load(std::memory_order_acquire);
+  }
+
+private:
+  T slots[SIZE];
+  std::atomic<uint8_t> head;  // Written by the producer
+  std::atomic<uint8_t> tail;  // Written by the consumer
+};
+
+#endif // SPSC_QUEUE_H
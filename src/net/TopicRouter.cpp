@@ -0,0 +1,86 @@
+#include "TopicRouter.h"
+#include "../state/Bytes.h"
+
+TopicRouter::TopicRouter(const char* baseTopic)
+  : count(0), base(baseTopic), baseLength(strlen(baseTopic)) {
+  for (uint8_t i = 0; i < TABLE_SIZE; i++) {
+    table[i].hash = 0;
+    table[i].suffix = nullptr;
+    table[i].length = 0;
+    table[i].coalesce = false;
+    table[i].handler = nullptr;
+  }
+}
+
+void TopicRouter::setBase(const char* baseTopic) {
+  base = baseTopic;
+  baseLength = strlen(baseTopic);
+}
+
+uint32_t TopicRouter::hash(const char* text, size_t length) {
+  return Bytes::fnv1a(text, length);
+}
+
+bool TopicRouter::add(const char* suffix, Handler handler, bool coalesce) {
+  size_t length = strlen(suffix);
+  if (count >= MAX_ROUTES || length > 255 || !handler) return false;
+
+  uint32_t h = hash(suffix, length);
+  if (lookup(suffix, length, h)) return false;
+
+  uint8_t i = h & (TABLE_SIZE - 1);
+  while (table[i].suffix) {
+    i = (i + 1) & (TABLE_SIZE - 1);
+  }
+  table[i].hash = h;
+  table[i].suffix = suffix;
+  table[i].length = (uint8_t)length;
+  table[i].coalesce = coalesce;
+  table[i].handler = handler;
+  count++;
+  return true;
+}
+
+bool TopicRouter::dispatch(const char* topic, size_t topicLength, const MessageView& payload) const {
+  int route = resolve(topic, topicLength);
+  return route >= 0 && invoke((uint8_t)route, payload);
+}
+
+int TopicRouter::resolve(const char* topic, size_t topicLength) const {
+  // Only "<base>/..." is ours
+  if (topicLength <= baseLength || memcmp(topic, base, baseLength) != 0 ||
+      topic[baseLength] != '/') {
+    return -1;
+  }
+
+  const char* suffix = topic + baseLength + 1;
+  size_t length = topicLength - baseLength - 1;
+  const Route* route = lookup(suffix, length, hash(suffix, length));
+  return route ? (int)(route - table) : -1;
+}
+
+bool TopicRouter::invoke(uint8_t route, const MessageView& payload) const {
+  if (route >= TABLE_SIZE || !table[route].handler) return false;
+  table[route].handler(payload);
+  return true;
+}
+
+bool TopicRouter::coalesces(uint8_t route) const {
+  return route < TABLE_SIZE && table[route].coalesce;
+}
+
+uint8_t TopicRouter::size() const {
+  return count;
+}
+
+const TopicRouter::Route* TopicRouter::lookup(const char* suffix, size_t length, uint32_t h) const {
+  uint8_t i = h & (TABLE_SIZE - 1);
+  while (table[i].suffix) {
+    const Route& r = table[i];
+    if (r.hash == h && r.length == length && memcmp(r.suffix, suffix, length) == 0) {
+      return &r;
+    }
+    i = (i + 1) & (TABLE_SIZE - 1);
+  }
+  return nullptr;
+}
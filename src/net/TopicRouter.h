@@ -0,0 +1,106 @@
+#ifndef TOPIC_ROUTER_H
+#define TOPIC_ROUTER_H
+
+#include <Arduino.h>
+#include "MessageView.h"
+
+/**
+ * Fixed-size hash table from MQTT topic to handler.
+ *
+ * Responsibilities:
+ * - Strip the device base topic ("<base>/") from incoming topics
+ * - Find the handler for the remaining suffix in constant time
+ * - Dispatch without copying or allocating
+ * - Resolve topics to small route ids so commands can be queued and
+ *   dispatched later
+ *
+ * Suffixes are hashed with FNV-1a into an open-addressed table; a hit is
+ * confirmed by comparing the suffix, so hash collisions cannot misroute.
+ */
+class TopicRouter {
+public:
+  typedef void (*Handler)(const MessageView& payload);
+
+  /**
+   * @param base Base topic without trailing '/' (must outlive the router)
+   */
+  explicit TopicRouter(const char* base);
+
+  /**
+   * Change the base topic (e.g. once the device identity is known).
+   *
+   * @param base Base topic without trailing '/' (must outlive the router)
+   */
+  void setBase(const char* base);
+
+  /**
+   * Register a handler for "<base>/<suffix>".
+   *
+   * @param suffix Topic suffix, e.g. "cmnd/power" (must outlive the router)
+   * @param handler Function called with the payload
+   * @param coalesce A newer queued command on this topic supersedes an
+   *                 older one (e.g. brightness)
+   * @return False if the table is full or the suffix is already routed
+   */
+  bool add(const char* suffix, Handler handler, bool coalesce = false);
+
+  /**
+   * Route a message.
+   *
+   * @param topic Full topic
+   * @param topicLength Topic length
+   * @param payload Message payload
+   * @return True if a handler ran
+   */
+  bool dispatch(const char* topic, size_t topicLength, const MessageView& payload) const;
+
+  /**
+   * Route id for a full topic.
+   *
+   * @return Id (< 0xFF), or -1 if not routed
+   */
+  int resolve(const char* topic, size_t topicLength) const;
+
+  /**
+   * Run the handler of a resolved route.
+   *
+   * @return False if the id is not a route
+   */
+  bool invoke(uint8_t route, const MessageView& payload) const;
+
+  /**
+   * Whether commands on a route coalesce.
+   */
+  bool coalesces(uint8_t route) const;
+
+  /**
+   * Number of registered routes.
+   */
+  uint8_t size() const;
+
+  /**
+   * FNV-1a hash of a string.
+   */
+  static uint32_t hash(const char* text, size_t length);
+
+private:
+  static const uint8_t TABLE_SIZE = 64;  // Power of two, kept under half full
+  static const uint8_t MAX_ROUTES = TABLE_SIZE / 2;
+
+  struct Route {
+    uint32_t hash;
+    const char* suffix;     // nullptr = empty slot
+    uint8_t length;
+    bool coalesce;
+    Handler handler;
+  };
+
+  Route table[TABLE_SIZE];
+  uint8_t count;
+  const char* base;
+  size_t baseLength;
+
+  const Route* lookup(const char* suffix, size_t length, uint32_t h) const;
+};
+
+#endif // TOPIC_ROUTER_H
@@ -0,0 +1,48 @@
+#include "TopicTable.h"
+
+namespace {
+
+// Appended to the base, in Id order
+const char* const SUFFIXES[TopicTable::COUNT] = {
+  "",
+  "/state/json",
+  "/config/state",
+  "/diagnostics",
+  "/heartbeat",
+  "/boot",
+  "/cmnd/#",
+  "/config/#"
+};
+
+}  // namespace
+
+TopicTable::TopicTable() : offsets(), filters() {
+  buffer[0] = '\0';
+}
+
+bool TopicTable::validBase(const char* base) {
+  size_t length = base ? strlen(base) : 0;
+  if (length == 0 || length > MAX_BASE) return false;
+  if (base[0] == '/' || base[length - 1] == '/') return false;
+
+  for (size_t i = 0; i < length; i++) {
+    char c = base[i];
+    if (c == '+' || c == '#' || (unsigned char)c < 0x20) return false;
+    if (c == '"' || c == '\\') return false;   // Published inside JSON unescaped
+    if (c == '/' && base[i + 1] == '/') return false;
+  }
+  return true;
+}
+
+bool TopicTable::build(const char* base) {
+  if (!validBase(base)) return false;
+
+  size_t pos = 0;
+  for (uint8_t id = 0; id < COUNT; id++) {
+    offsets[id] = (uint16_t)pos;
+    pos += snprintf(buffer + pos, sizeof(buffer) - pos, "%s%s", base, SUFFIXES[id]) + 1;
+  }
+  filters[0] = get(CMND_FILTER);
+  filters[1] = get(CONFIG_FILTER);
+  return true;
+}
@@ -0,0 +1,67 @@
+#ifndef TOPIC_TABLE_H
+#define TOPIC_TABLE_H
+
+#include <Arduino.h>
+
+/**
+ * The device's MQTT topics, built once from its base topic.
+ *
+ * Responsibilities:
+ * - Validate a base topic (no wildcards, no empty levels, bounded length)
+ * - Build every published topic and subscription filter into one buffer
+ *   at boot, so publishing and subscribing never concatenate strings
+ *
+ * The base gives each lamp its own topic tree ("<base>/cmnd/power",
+ * "<base>/state/json", ...). TopicRouter matches incoming topics against
+ * base() and routes by suffix, so dispatch does not depend on it either.
+ */
+class TopicTable {
+public:
+  static const size_t MAX_BASE = 40;    // Leaves room for the diagnostics payload in a packet
+
+  enum Id : uint8_t {
+    BASE,
+    STATE_JSON,
+    CONFIG_STATE,
+    DIAGNOSTICS,
+    HEARTBEAT,
+    BOOT,
+    CMND_FILTER,      // "<base>/cmnd/#"
+    CONFIG_FILTER,    // "<base>/config/#"
+    COUNT
+  };
+
+  TopicTable();
+
+  /**
+   * Build all topics from a base topic.
+   *
+   * @return False (table unchanged) if the base is not valid
+   */
+  bool build(const char* base);
+
+  const char* get(Id id) const { return buffer + offsets[id]; }
+  const char* base() const { return get(BASE); }
+
+  /**
+   * Subscription filters, in the form MqttClient::setSubscriptions() takes.
+   */
+  const char* const* subscriptions() const { return filters; }
+  uint8_t subscriptionCount() const { return FILTER_COUNT; }
+
+  /**
+   * Check a base topic: 1..MAX_BASE characters, no '+', '#', quotes,
+   * backslashes or control characters, no leading, trailing or double '/'.
+   */
+  static bool validBase(const char* base);
+
+private:
+  static const uint8_t FILTER_COUNT = 2;
+  static const size_t LONGEST_SUFFIX = 13;   // "/config/state"
+
+  char buffer[COUNT * (MAX_BASE + LONGEST_SUFFIX + 1)];
+  uint16_t offsets[COUNT];
+  const char* filters[FILTER_COUNT];
+};
+
+#endif // TOPIC_TABLE_H
@@ -1,15 +1,33 @@
 #include "WiFiManager.h"
+#include "esp_system.h"
 #include "wifi_config.h"
 #include "../hw/StatusLED.h"
+#include "../hw/Clock.h"
+
+// Last good link, kept across restarts (not power loss) in RTC memory;
+// LinkCache checks it, so power-on garbage is ignored
+RTC_NOINIT_ATTR static uint8_t rtcLink[LinkCache::RECORD_SIZE];
 
 WiFiManager::WiFiManager() 
-  : statusLED(nullptr), wasConnected(false), lastReconnectAttempt(0) {
+  : statusLED(nullptr), boot(nullptr), wasConnected(false), lostAt(0), everLost(false),
+    reconnect(RECONNECT_FIRST_MS, RECONNECT_CAP_MS), retries(0), outage(0), cachedJoin(false), directJoin(false),
+    associated(false), joinStarted(0) {
 }
 
 void WiFiManager::begin() {
   Serial.println("[WIFI] Starting WiFi manager");
   WiFi.mode(WIFI_STA);
-  connect();
+  reconnect.seed(esp_random());
+  // The direct join times association only: a slow DHCP server is no
+  // reason to give up on the access point
+  WiFi.onEvent([this](arduino_event_id_t, arduino_event_info_t) {
+    associated.store(true, std::memory_order_relaxed);
+  }, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+
+  cache.setNetwork(WIFI_SSID);
+  if (!cache.restore(rtcLink, sizeof(rtcLink))) cache.load();
+  connect(cache.valid());
+  reconnect.attempt();  // The join just started counts as the first try
 }
 
 void WiFiManager::loop() {
@@ -19,23 +37,56 @@ void WiFiManager::loop() {
     Serial.println("[WIFI] Connection lost");
     if (statusLED) statusLED->wifiFailed();
     wasConnected = false;
+    lostAt = millis();
+    everLost = true;
+    // Auto-reconnect rejoins at once; ours follow with backoff
+    reconnect.reset();
+    reconnect.attempt();
   }
 
-  if (!isConnected) {
-    unsigned long now = millis();
-    if (now - lastReconnectAttempt > RECONNECT_INTERVAL_MS) {
-      lastReconnectAttempt = now;
+  if (!isConnected && directJoin && !associated.load(std::memory_order_relaxed) &&
+      millis() - joinStarted > DIRECT_JOIN_TIMEOUT_MS) {
+    // Access point gone, moved channel or replaced, or just busy. Scan;
+    // the record is kept unless the scan joins a different one
+    Serial.println("[WIFI] Cached access point did not answer, scanning");
+    connect(false);
+    reconnect.reset();
+    reconnect.attempt();
+  } else if (!isConnected) {
+    if (reconnect.due()) {
+      reconnect.attempt();
       if (statusLED) statusLED->wifiConnecting();
       // Serial output removed - was blocking loop
-      WiFi.reconnect();  // Non-blocking
+      connect(false);  // Full scan: the access point may have changed
     }
   } else if (!wasConnected) {
-    Serial.printf("[WIFI] Connected. IP=%s\n", WiFi.localIP().toString().c_str());
+    Serial.printf("[WIFI] Connected. IP=%s (%lu attempts)\n", WiFi.localIP().toString().c_str(),
+                  (unsigned long)reconnect.attempts());
     if (statusLED) statusLED->wifiConnected();
+    retries.store(reconnect.attempts(), std::memory_order_relaxed);
+    if (everLost) outage.store(millis() - lostAt, std::memory_order_relaxed);
+    if (boot) boot->mark(BootTimeline::WIFI);
+    cachedJoin.store(directJoin, std::memory_order_relaxed);
+    directJoin = false;
+    remember();
+    reconnect.reset();
     wasConnected = true;
   }
 }
 
+unsigned long WiFiManager::msUntilUpdate() {
+  if (WiFi.status() == WL_CONNECTED && wasConnected) {
+    return Clock::NO_DEADLINE;
+  }
+  unsigned long untilRetry = reconnect.msUntilDue();
+  if (directJoin && !associated.load(std::memory_order_relaxed)) {
+    unsigned long elapsed = millis() - joinStarted;
+    unsigned long untilScan = elapsed > DIRECT_JOIN_TIMEOUT_MS ? 0 : DIRECT_JOIN_TIMEOUT_MS - elapsed + 1;
+    if (untilScan < untilRetry) untilRetry = untilScan;
+  }
+  return untilRetry < CONNECT_POLL_MS ? untilRetry : CONNECT_POLL_MS;
+}
+
 bool WiFiManager::connected() {
   return WiFi.status() == WL_CONNECTED;
 }
@@ -44,16 +95,54 @@ void WiFiManager::setStatusLED(StatusLED* led) {
   statusLED = led;
 }
 
-void WiFiManager::connect() {
-  Serial.printf("[WIFI] Connecting to %s\n", WIFI_SSID);
-  
+void WiFiManager::connect(bool useCache) {
   // Enable light sleep for power savings while maintaining connectivity
   WiFi.setSleep(WIFI_PS_MIN_MODEM);  // Light sleep between DTIM beacons
   WiFi.setAutoReconnect(true);
-  
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+
+  configureAddress();
+  if (useCache) {
+    // No scan: straight to the access point that worked last time
+    const LinkCache::Link& link = cache.link();
+    Serial.printf("[WIFI] Connecting to %s on channel %u (cached)\n", WIFI_SSID, link.channel);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD, link.channel, link.bssid);
+  } else {
+    Serial.printf("[WIFI] Connecting to %s\n", WIFI_SSID);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  }
+  directJoin = useCache;
+  associated.store(false, std::memory_order_relaxed);
+  joinStarted = millis();
 
   // Non-blocking connection - check in loop()
   // Just initiate, don't wait here
-  Serial.println("[WIFI] Connection initiated (non-blocking)");
+}
+
+void WiFiManager::configureAddress() {
+#ifdef WIFI_STATIC_IP
+  IPAddress ip, gateway, subnet(255, 255, 255, 0), dns;
+  ip.fromString(WIFI_STATIC_IP);
+  gateway.fromString(WIFI_GATEWAY);
+#ifdef WIFI_SUBNET
+  subnet.fromString(WIFI_SUBNET);
+#endif
+#ifdef WIFI_DNS
+  dns.fromString(WIFI_DNS);
+#else
+  dns = gateway;
+#endif
+  WiFi.config(ip, gateway, subnet, dns);
+#else
+  WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);  // DHCP
+#endif
+}
+
+void WiFiManager::remember() {
+  LinkCache::Link link;
+  memcpy(link.bssid, WiFi.BSSID(), sizeof(link.bssid));
+  link.channel = WiFi.channel();
+  if (cache.store(link)) {
+    Serial.printf("[WIFI] Saved access point on channel %u\n", link.channel);
+  }
+  cache.encode(rtcLink);
 }
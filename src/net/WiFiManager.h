@@ -3,6 +3,10 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
+#include <atomic>
+#include "Backoff.h"
+#include "LinkCache.h"
+#include "../state/BootTimeline.h"
 
 class StatusLED;
 
@@ -11,8 +15,14 @@ class StatusLED;
  * 
  * Responsibilities:
  * - Establish and maintain WiFi connection
- * - Auto-reconnect on disconnection
- * - Connection status reporting
+ * - Join the last good access point directly (cached BSSID and channel),
+ *   falling back to a full scan
+ * - Optional static IP (WIFI_STATIC_IP in wifi_config.h)
+ * - Auto-reconnect on disconnection, with jittered exponential backoff
+ *   so lamps that lost the same access point do not rejoin in lockstep
+ * - Connection status reporting, and for diagnostics (readable from any
+ *   task) the attempts and outage of the last recovery
+ * - Mark the first connect on the boot timeline
  */
 class WiFiManager {
 public:
@@ -30,6 +40,13 @@ public:
    */
   void loop();
 
+  /**
+   * Time until loop() has work to do.
+   *
+   * @return Milliseconds (0 = now), Clock::NO_DEADLINE while connected
+   */
+  unsigned long msUntilUpdate();
+
   /**
    * Check if WiFi is currently connected.
    */
@@ -40,13 +57,46 @@ public:
    */
   void setStatusLED(StatusLED* led);
 
+  void setBootTimeline(BootTimeline* timeline) { boot = timeline; }
+
+  /**
+   * Reconnect attempts the last recovery took.
+   */
+  uint32_t reconnectAttempts() const { return retries.load(std::memory_order_relaxed); }
+
+  /**
+   * Connection lost to connected again, last time it happened.
+   */
+  uint32_t outageMs() const { return outage.load(std::memory_order_relaxed); }
+
+  /**
+   * The last join went straight to the cached access point.
+   */
+  bool joinedFromCache() const { return cachedJoin.load(std::memory_order_relaxed); }
+
 private:
   StatusLED* statusLED;
+  BootTimeline* boot;
   bool wasConnected;
-  unsigned long lastReconnectAttempt;
-  static const unsigned long RECONNECT_INTERVAL_MS = 10000;
+  unsigned long lostAt;
+  bool everLost;
+  Backoff reconnect;
+  std::atomic<uint32_t> retries;
+  std::atomic<uint32_t> outage;
+  std::atomic<bool> cachedJoin;
+  LinkCache cache;
+  bool directJoin;          // Joining the cached access point without a scan
+  std::atomic<bool> associated;  // Set from the WiFi event task; DHCP may still run
+  unsigned long joinStarted;
+  // A join takes a few seconds; shorter gaps would abort it
+  static const unsigned long RECONNECT_FIRST_MS = 10000;
+  static const unsigned long RECONNECT_CAP_MS = 60000;
+  static const unsigned long CONNECT_POLL_MS = 250;  // Notice a completed join promptly
+  static const unsigned long DIRECT_JOIN_TIMEOUT_MS = 3000;  // To associate, then scan instead
 
-  void connect();
+  void connect(bool useCache);
+  void configureAddress();
+  void remember();
 };
 
 #endif // WIFI_MANAGER_H
@@ -0,0 +1,55 @@
+#include "BootTimeline.h"
+
+namespace {
+
+const char* const NAMES[BootTimeline::COUNT] = {
+  "setup",
+  "config",
+  "light",
+  "ready",
+  "wifi",
+  "mqtt"
+};
+
+}  // namespace
+
+BootTimeline::BootTimeline() : clock(&Clock::system()) {
+  for (uint8_t i = 0; i < COUNT; i++) marks[i].store(0, std::memory_order_relaxed);
+}
+
+const char* BootTimeline::name(Phase phase) {
+  return phase < COUNT ? NAMES[phase] : "";
+}
+
+void BootTimeline::mark(Phase phase) {
+  if (phase >= COUNT) return;
+  uint32_t now = (uint32_t)clock->micros();
+  if (now == 0) now = 1;   // 0 means not reached
+  uint32_t unset = 0;
+  marks[phase].compare_exchange_strong(unset, now, std::memory_order_relaxed);
+}
+
+uint32_t BootTimeline::atUs(Phase phase) const {
+  return phase < COUNT ? marks[phase].load(std::memory_order_relaxed) : 0;
+}
+
+size_t BootTimeline::format(char* buffer, size_t size) const {
+  if (size == 0) return 0;
+
+  size_t pos = (size_t)snprintf(buffer, size, "{");
+  bool first = true;
+  for (uint8_t i = 0; i < COUNT && pos < size; i++) {
+    uint32_t at = marks[i].load(std::memory_order_relaxed);
+    if (at == 0) continue;
+    int n = snprintf(buffer + pos, size - pos, first ? "\"%s_us\":%lu" : ",\"%s_us\":%lu",
+                     NAMES[i], (unsigned long)at);
+    if (n < 0) break;
+    pos += n;
+    first = false;
+  }
+  if (pos + 1 < size) {
+    buffer[pos++] = '}';
+    buffer[pos] = '\0';
+  }
+  return pos < size ? pos : size - 1;
+}
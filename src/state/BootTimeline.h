@@ -0,0 +1,64 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "../hw/Clock.h"
+
+/**
+ * Timestamps of the boot phases, from reset to MQTT ready.
+ *
+ * Responsibilities:
+ * - Record when each phase was first reached, in microseconds since
+ *   the system timer started (shortly after reset; the ROM and
+ *   bootloader before it are not counted)
+ * - Take marks from any task: the render loop marks setup phases, the
+ *   network task WiFi and MQTT
+ * - Format the timeline as JSON for the boot report
+ */
+class BootTimeline {
+public:
+  enum Phase : uint8_t {
+    SETUP,      // setup() entered
+    CONFIG,     // Configuration loaded
+    LIGHT,      // Light output restored
+    READY,      // setup() done, render loop starts
+    WIFI,       // WiFi connected
+    MQTT,       // MQTT ready
+    COUNT
+  };
+
+  BootTimeline();
+
+  void setClock(const Clock* c) { clock = c; }
+
+  /**
+   * Record a phase as reached now. Later marks of the same phase are
+   * ignored.
+   */
+  void mark(Phase phase);
+
+  /**
+   * When a phase was reached.
+   *
+   * @return Microseconds, 0 if not reached yet
+   */
+  uint32_t atUs(Phase phase) const;
+
+  bool reached(Phase phase) const { return atUs(phase) != 0; }
+
+  /**
+   * Write {"setup_us":n,...} with the phases reached so far.
+   *
+   * @return Characters written (excluding the terminator)
+   */
+  size_t format(char* buffer, size_t size) const;
+
+  static const char* name(Phase phase);
+
+private:
+  const Clock* clock;
+  std::atomic<uint32_t> marks[COUNT];
+};
+
+#endif // BOOT_TIMELINE_H
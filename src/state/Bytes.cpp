@@ -0,0 +1,29 @@
+#include "Bytes.h"
+
+#ifndef NATIVE_BUILD
+#include "esp_crc.h"
+#endif
+
+uint32_t Bytes::crc32(const uint8_t* data, size_t length) {
+#ifndef NATIVE_BUILD
+  return esp_crc32_le(0, data, length);
+#else
+  uint32_t crc = 0xFFFFFFFFUL;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+#endif
+}
+
+uint32_t Bytes::fnv1a(const char* text, size_t length) {
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < length; i++) {
+    h ^= (uint8_t)text[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
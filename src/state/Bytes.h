@@ -0,0 +1,39 @@
+#ifndef BYTES_H
+#define BYTES_H
+
+#include <Arduino.h>
+
+/**
+ * Big-endian fields, CRC-32 and FNV-1a for the records and packets the
+ * lamp reads and writes (config blob, link cache, state journal, sync
+ * beacons, NTP and DDP packets) and for topic lookup.
+ */
+namespace Bytes {
+
+  inline uint32_t readU32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+  }
+
+  inline void writeU32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+  }
+
+  /**
+   * CRC-32 as in zlib and Ethernet (reflected, polynomial 0xEDB88320).
+   * On the lamp it runs from ROM; records written by either build check
+   * out on the other.
+   */
+  uint32_t crc32(const uint8_t* data, size_t length);
+
+  /**
+   * 32-bit FNV-1a of a string. Some results are stored (link cache) or
+   * sent to other lamps (sync group), so it must never change.
+   */
+  uint32_t fnv1a(const char* text, size_t length);
+
+}  // namespace Bytes
+
+#endif // BYTES_H
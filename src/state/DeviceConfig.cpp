@@ -1,6 +1,76 @@
 #include "DeviceConfig.h"
+#include "Bytes.h"
+
+namespace {
+
+// Blob layout (big endian)
+//   0  magic "DC"
+//   2  schema version
+//   3  config version
+//   7  default brightness, red, green, blue
+//  11  sunrise minutes (2 bytes), sunrise final brightness
+//  14  min PWM, max PWM
+//  16  gamma * 100 (2 bytes)
+//  18  curve points n, then n x 2 bytes
+//      favorite param 1..3, red, green, blue
+//      favorite animation, phase group, MQTT base: length byte + chars
+//      CRC-32 of all bytes before
+const uint8_t BLOB_MAGIC_0 = 'D';
+const uint8_t BLOB_MAGIC_1 = 'C';
+
+// Key-per-field layout of earlier firmware. "cfg_ver" goes last: while it
+// is there the migration has not finished.
+const char* const LEGACY_KEYS[] = {
+  "def_bri", "def_r", "def_g", "def_b", "sun_min", "sun_bri", "min_pwm", "max_pwm",
+  "gamma", "gamma_crv", "fav_anim", "fav_p1", "fav_p2", "fav_p3", "fav_r", "fav_g",
+  "fav_b", "phase_grp", "mqtt_base", "cfg_ver"
+};
+const char* const LEGACY_VERSION_KEY = "cfg_ver";
+
+// Appends to a blob
+struct BlobWriter {
+  uint8_t* data;
+  size_t pos;
+
+  void u8(uint8_t v) { data[pos++] = v; }
+  void u16(uint16_t v) { u8(v >> 8); u8(v); }
+  void u32(uint32_t v) { u16(v >> 16); u16(v); }
+  void str(const String& v, size_t max) {
+    size_t n = v.length() < max ? v.length() : max;
+    u8((uint8_t)n);
+    memcpy(data + pos, v.c_str(), n);
+    pos += n;
+  }
+};
+
+// Walks a blob; reading past the end clears ok
+struct BlobReader {
+  const uint8_t* data;
+  size_t length;
+  size_t pos;
+  bool ok;
+
+  uint8_t u8() {
+    if (pos >= length) { ok = false; return 0; }
+    return data[pos++];
+  }
+  uint16_t u16() { uint16_t hi = u8(); return (hi << 8) | u8(); }
+  uint32_t u32() { uint32_t hi = u16(); return (hi << 16) | u16(); }
+  String str() {
+    char text[256];
+    size_t n = u8();
+    if (!ok || n > length - pos) { ok = false; return String(); }
+    memcpy(text, data + pos, n);
+    text[n] = '\0';
+    pos += n;
+    return String(text);
+  }
+};
+
+}  // namespace
 
 const char* DeviceConfig::NVS_NAMESPACE = "ikea_head_lamp";
+const char* DeviceConfig::NVS_KEY = "cfg";
 
 DeviceConfig::DeviceConfig() 
   : defaultBrightness(70),
@@ -11,6 +81,9 @@ DeviceConfig::DeviceConfig()
     sunriseFinalBrightness(100),
     minPwmPercent(20),
     maxPwmPercent(100),
+    gammaX100(220),
+    gammaCurveLen(0),
+    gammaCurve(),
     favoriteAnimation("fire"),
     favAnimParam1(70),      // Default: fire intensity
     favAnimParam2(5),       // Default: fire speed
@@ -18,6 +91,8 @@ DeviceConfig::DeviceConfig()
     favAnimColorR(0),
     favAnimColorG(0),
     favAnimColorB(0),
+    phaseGroup(""),
+    mqttBase(""),
     version(1) {
 }
 
@@ -25,6 +100,38 @@ void DeviceConfig::load() {
   Preferences prefs;
   prefs.begin(NVS_NAMESPACE, true); // read-only
 
+  uint8_t blob[BLOB_MAX];
+  size_t length = prefs.getBytes(NVS_KEY, blob, sizeof(blob));
+  bool loaded = length > 0 && decode(blob, length);
+  bool legacy = !loaded && loadLegacy(prefs);
+  bool leftover = loaded && prefs.isKey(LEGACY_VERSION_KEY);  // Migration cut short
+
+  prefs.end();
+
+  clampValues();
+
+  // Once after an update: the blob replaces the per-field keys. It is
+  // written first, so losing power halfway leaves one copy or the other.
+  // Other keys in the namespace stay.
+  if (legacy || leftover) {
+    prefs.begin(NVS_NAMESPACE, false);
+    if (legacy) {
+      length = encode(blob);
+      if (!prefs.putBytes(NVS_KEY, blob, length)) {
+        prefs.end();
+        return;   // Keep the old keys; try again next boot
+      }
+    }
+    for (const char* key : LEGACY_KEYS) {
+      prefs.remove(key);
+    }
+    prefs.end();
+  }
+}
+
+bool DeviceConfig::loadLegacy(Preferences& prefs) {
+  if (!prefs.isKey(LEGACY_VERSION_KEY)) return false;
+
   defaultBrightness = prefs.getUChar("def_bri", defaultBrightness);
   defaultColorR     = prefs.getUChar("def_r",   defaultColorR);
   defaultColorG     = prefs.getUChar("def_g",   defaultColorG);
@@ -36,6 +143,10 @@ void DeviceConfig::load() {
   minPwmPercent = prefs.getUChar("min_pwm", minPwmPercent);
   maxPwmPercent = prefs.getUChar("max_pwm", maxPwmPercent);
 
+  gammaX100 = prefs.getUShort("gamma", gammaX100);
+  size_t curveBytes = prefs.getBytes("gamma_crv", gammaCurve, sizeof(gammaCurve));
+  gammaCurveLen = (uint8_t)(curveBytes / sizeof(gammaCurve[0]));
+
   // Load favorite animation settings
   favoriteAnimation = prefs.getString("fav_anim", favoriteAnimation);
   favAnimParam1 = prefs.getUChar("fav_p1", favAnimParam1);
@@ -45,12 +156,14 @@ void DeviceConfig::load() {
   favAnimColorG = prefs.getUChar("fav_g", favAnimColorG);
   favAnimColorB = prefs.getUChar("fav_b", favAnimColorB);
 
-  version = prefs.getUInt("cfg_ver", version);
-
-  prefs.end();
+  phaseGroup = prefs.getString("phase_grp", phaseGroup);
+  mqttBase = prefs.getString("mqtt_base", mqttBase);
 
-  clampValues();
+  version = prefs.getUInt(LEGACY_VERSION_KEY, version);
+  return true;
+}
 
+void DeviceConfig::print() const {
   Serial.println("[CFG] Loaded from NVS:");
   Serial.printf("      defaultBrightness=%u\n", defaultBrightness);
   Serial.printf("      defaultColor=(%u,%u,%u)\n", defaultColorR, defaultColorG, defaultColorB);
@@ -58,43 +171,115 @@ void DeviceConfig::load() {
                 sunriseMinutes, sunriseFinalBrightness);
   Serial.printf("      minPwm=%u%%, maxPwm=%u%%\n",
                 minPwmPercent, maxPwmPercent);
+  Serial.printf("      gamma=%u.%02u, curvePoints=%u\n",
+                gammaX100 / 100, gammaX100 % 100, gammaCurveLen);
   Serial.printf("      favoriteAnimation=%s, params=(%u,%u,%u), color=(%u,%u,%u)\n",
                 favoriteAnimation.c_str(), favAnimParam1, favAnimParam2, favAnimParam3,
                 favAnimColorR, favAnimColorG, favAnimColorB);
+  Serial.printf("      phaseGroup=%s\n", phaseGroup.length() ? phaseGroup.c_str() : "(none)");
+  Serial.printf("      mqttBase=%s\n", mqttBase.length() ? mqttBase.c_str() : "(from MAC)");
   Serial.printf("      version=%lu\n", (unsigned long)version);
 }
 
-void DeviceConfig::save() {
+bool DeviceConfig::save() {
+  uint8_t blob[BLOB_MAX];
+  uint8_t stored[BLOB_MAX];
+  size_t length = encode(blob);
+
   Preferences prefs;
   prefs.begin(NVS_NAMESPACE, false); // write mode
 
+  // Flash wears; saving an unchanged configuration writes nothing
+  size_t storedLength = prefs.getBytes(NVS_KEY, stored, sizeof(stored));
+  if (storedLength == length && memcmp(stored, blob, length) == 0) {
+    prefs.end();
+    Serial.println("[CFG] Unchanged, not saved");
+    return false;
+  }
+
   version++;
+  length = encode(blob);
+  prefs.putBytes(NVS_KEY, blob, length);
+  prefs.end();
 
-  prefs.putUChar("def_bri", defaultBrightness);
-  prefs.putUChar("def_r",   defaultColorR);
-  prefs.putUChar("def_g",   defaultColorG);
-  prefs.putUChar("def_b",   defaultColorB);
+  Serial.printf("[CFG] Saved to NVS. New version=%lu\n", (unsigned long)version);
+  return true;
+}
 
-  prefs.putUShort("sun_min", sunriseMinutes);
-  prefs.putUChar("sun_bri",  sunriseFinalBrightness);
+size_t DeviceConfig::encode(uint8_t* blob) const {
+  BlobWriter out = { blob, 0 };
+  out.u8(BLOB_MAGIC_0);
+  out.u8(BLOB_MAGIC_1);
+  out.u8(SCHEMA_VERSION);
+  out.u32(version);
 
-  prefs.putUChar("min_pwm", minPwmPercent);
-  prefs.putUChar("max_pwm", maxPwmPercent);
+  out.u8(defaultBrightness);
+  out.u8(defaultColorR);
+  out.u8(defaultColorG);
+  out.u8(defaultColorB);
+  out.u16(sunriseMinutes);
+  out.u8(sunriseFinalBrightness);
+  out.u8(minPwmPercent);
+  out.u8(maxPwmPercent);
 
-  // Save favorite animation settings
-  prefs.putString("fav_anim", favoriteAnimation);
-  prefs.putUChar("fav_p1", favAnimParam1);
-  prefs.putUChar("fav_p2", favAnimParam2);
-  prefs.putUChar("fav_p3", favAnimParam3);
-  prefs.putUChar("fav_r", favAnimColorR);
-  prefs.putUChar("fav_g", favAnimColorG);
-  prefs.putUChar("fav_b", favAnimColorB);
+  out.u16(gammaX100);
+  out.u8(gammaCurveLen);
+  for (uint8_t i = 0; i < gammaCurveLen; i++) out.u16(gammaCurve[i]);
 
-  prefs.putUInt("cfg_ver", version);
+  out.u8(favAnimParam1);
+  out.u8(favAnimParam2);
+  out.u8(favAnimParam3);
+  out.u8(favAnimColorR);
+  out.u8(favAnimColorG);
+  out.u8(favAnimColorB);
+  out.str(favoriteAnimation, MAX_STRING);
+  out.str(phaseGroup, MAX_STRING);
+  out.str(mqttBase, MAX_STRING);
 
-  prefs.end();
+  out.u32(Bytes::crc32(blob, out.pos));
+  return out.pos;
+}
 
-  Serial.printf("[CFG] Saved to NVS. New version=%lu\n", (unsigned long)version);
+bool DeviceConfig::decode(const uint8_t* blob, size_t length) {
+  if (length < 7 || length > BLOB_MAX) return false;
+  if (blob[0] != BLOB_MAGIC_0 || blob[1] != BLOB_MAGIC_1) return false;
+  if (blob[2] != SCHEMA_VERSION) return false;
+
+  size_t body = length - 4;
+  if (Bytes::readU32(blob + body) != Bytes::crc32(blob, body)) return false;
+
+  BlobReader in = { blob, body, 3, true };
+
+  DeviceConfig c;
+  c.version = in.u32();
+
+  c.defaultBrightness = in.u8();
+  c.defaultColorR = in.u8();
+  c.defaultColorG = in.u8();
+  c.defaultColorB = in.u8();
+  c.sunriseMinutes = in.u16();
+  c.sunriseFinalBrightness = in.u8();
+  c.minPwmPercent = in.u8();
+  c.maxPwmPercent = in.u8();
+
+  c.gammaX100 = in.u16();
+  c.gammaCurveLen = in.u8();
+  if (c.gammaCurveLen > GAMMA_CURVE_MAX_POINTS) return false;
+  for (uint8_t i = 0; i < c.gammaCurveLen; i++) c.gammaCurve[i] = in.u16();
+
+  c.favAnimParam1 = in.u8();
+  c.favAnimParam2 = in.u8();
+  c.favAnimParam3 = in.u8();
+  c.favAnimColorR = in.u8();
+  c.favAnimColorG = in.u8();
+  c.favAnimColorB = in.u8();
+  c.favoriteAnimation = in.str();
+  c.phaseGroup = in.str();
+  c.mqttBase = in.str();
+
+  if (!in.ok || in.pos != in.length) return false;
+  *this = c;
+  return true;
 }
 
 void DeviceConfig::reset() {
@@ -117,4 +302,7 @@ void DeviceConfig::clampValues() {
   if (minPwmPercent > 100) minPwmPercent = 20;
   if (maxPwmPercent > 100) maxPwmPercent = 100;
   if (maxPwmPercent <= minPwmPercent) maxPwmPercent = 100;
+
+  if (gammaX100 < 50 || gammaX100 > 400) gammaX100 = 220;
+  if (gammaCurveLen == 1 || gammaCurveLen > GAMMA_CURVE_MAX_POINTS) gammaCurveLen = 0;
 }
@@ -12,6 +12,10 @@
  * - Animation parameters
  * - PWM calibration
  * - Load/save to non-volatile storage
+ *
+ * Stored as one CRC-checked blob under a single NVS key, so a load is
+ * one read and a save one write. Configurations saved as one key per
+ * field by older firmware are migrated on the first load.
  */
 class DeviceConfig {
 public:
@@ -26,6 +30,12 @@ public:
   uint8_t  minPwmPercent;
   uint8_t  maxPwmPercent;
 
+  // Brightness transfer curve (applied by LampHardware)
+  static const uint8_t GAMMA_CURVE_MAX_POINTS = 17;
+  uint16_t gammaX100;            // Gamma exponent * 100 (220 = 2.2)
+  uint8_t  gammaCurveLen;        // Custom curve points (0 = use gammaX100)
+  uint16_t gammaCurve[GAMMA_CURVE_MAX_POINTS];  // Output permille, evenly spaced
+
   // Favorite animation (triggered by double-click)
   String   favoriteAnimation;    // "fire", "breathe", "ocean", "rainbow", etc.
   uint8_t  favAnimParam1;        // Generic param 1 (intensity, speed, duration, etc.)
@@ -35,29 +45,70 @@ public:
   uint8_t  favAnimColorG;        // Color G
   uint8_t  favAnimColorB;        // Color B
 
+  String   phaseGroup;           // Animation phase group ("" = none)
+  String   mqttBase;             // MQTT base topic ("" = derived from the MAC address)
+
   uint32_t version;         // Config version, increments on save
 
   DeviceConfig();
 
   /**
    * Load configuration from NVS flash.
-   * Falls back to defaults if not present.
+   * Falls back to defaults if not present. Quiet, so it can run before
+   * first light; print() logs the result. Only the first boot after an
+   * update from the key-per-field layout writes (the migration).
    */
   void load();
 
+  /**
+   * Log the configuration to the serial console.
+   */
+  void print() const;
+
   /**
    * Save current configuration to NVS flash.
-   * Increments version counter.
+   * Increments version counter; skipped when nothing changed.
+   *
+   * @return True if flash was written
    */
-  void save();
+  bool save();
 
   /**
    * Reset configuration to built-in defaults and save.
    */
   void reset();
 
+  // Blob layout; bump when fields change and migrate in decode()
+  static const uint8_t SCHEMA_VERSION = 1;
+  static const size_t  MAX_STRING = 63;    // Longer strings are cut
+  static const size_t  BLOB_MAX = 288;
+
+  /**
+   * Serialize to the stored blob format.
+   *
+   * @param blob Buffer of BLOB_MAX bytes
+   * @return Blob length
+   */
+  size_t encode(uint8_t* blob) const;
+
+  /**
+   * Take the values of a stored blob.
+   *
+   * @return False (and nothing changed) if the blob is damaged or of an
+   *         unknown schema
+   */
+  bool decode(const uint8_t* blob, size_t length);
+
 private:
   static const char* NVS_NAMESPACE;
+  static const char* NVS_KEY;
+
+  /**
+   * Read the one-key-per-field layout of older firmware.
+   *
+   * @return False if the namespace holds none of it
+   */
+  bool loadLegacy(Preferences& prefs);
 
   /**
    * Clamp configuration values to valid ranges.
@@ -7,6 +7,7 @@ DeviceState::DeviceState()
     colorG(200),
     colorB(160),
     brightness(70),
+    transitionMs(0),
     animationPaused(false),
     animationName(""),
     progress(0),
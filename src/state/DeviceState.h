@@ -5,7 +5,7 @@
 #include "DeviceTypes.h"
 
 /**
- * Runtime state of the device (ephemeral, not persisted).
+ * Runtime state of the device (journaled by StateJournal across power loss).
  * 
  * Responsibilities:
  * - Current lamp power/brightness/color
@@ -21,6 +21,7 @@ public:
   uint8_t  colorG;
   uint8_t  colorB;
   uint8_t  brightness;      // Logical 0-100
+  uint32_t transitionMs;    // Fade time for the next hardware apply (0 = immediate)
 
   bool     animationPaused;
   String   animationName;
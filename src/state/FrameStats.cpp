@@ -0,0 +1,62 @@
+#include "FrameStats.h"
+
+FrameStats::FrameStats(uint32_t budgetUs)
+  : budget(budgetUs) {
+  reset();
+}
+
+void FrameStats::record(uint32_t us) {
+  uint8_t i = 0;
+  uint32_t limit = BASE_US;
+  while (i < BUCKETS - 1 && us >= limit) {
+    limit <<= 1;
+    i++;
+  }
+  buckets[i]++;
+
+  if (us > worst) worst = us;
+  if (us > budget) overrun++;
+  total++;
+}
+
+uint32_t FrameStats::bucket(uint8_t i) const {
+  return i < BUCKETS ? buckets[i] : 0;
+}
+
+uint32_t FrameStats::maxUs() const {
+  return worst;
+}
+
+uint32_t FrameStats::overruns() const {
+  return overrun;
+}
+
+uint32_t FrameStats::count() const {
+  return total;
+}
+
+size_t FrameStats::formatHistogram(char* buffer, size_t size) const {
+  if (size == 0) return 0;
+
+  size_t pos = 0;
+  buffer[0] = '\0';
+  for (uint8_t i = 0; i < BUCKETS && pos < size; i++) {
+    int n = snprintf(buffer + pos, size - pos, i ? ",%lu" : "[%lu", (unsigned long)buckets[i]);
+    if (n < 0) break;
+    pos += n;
+  }
+  if (pos + 1 < size) {
+    buffer[pos++] = ']';
+    buffer[pos] = '\0';
+  }
+  return pos < size ? pos : size - 1;
+}
+
+void FrameStats::reset() {
+  for (uint8_t i = 0; i < BUCKETS; i++) {
+    buckets[i] = 0;
+  }
+  worst = 0;
+  overrun = 0;
+  total = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <Arduino.h>
+
+/**
+ * Histogram of render loop iteration times.
+ *
+ * Responsibilities:
+ * - Bucket each loop's busy time (wake to next sleep) by power of two
+ * - Track the worst frame and how many overran the frame budget
+ * - Format the histogram for diagnostics
+ *
+ * Bucket i counts frames shorter than 2^i * BASE_US (bucket 0: < 250 us,
+ * the last bucket everything at or above 2^(BUCKETS-2) * BASE_US).
+ */
+class FrameStats {
+public:
+  static const uint8_t BUCKETS = 10;           // < 250 us ... >= 64 ms
+  static const uint32_t BASE_US = 250;
+
+  /**
+   * @param budgetUs Frames longer than this count as overruns
+   */
+  explicit FrameStats(uint32_t budgetUs = 33000);
+
+  /**
+   * Record one frame.
+   *
+   * @param us Busy time of the frame
+   */
+  void record(uint32_t us);
+
+  /**
+   * Frames in a bucket.
+   */
+  uint32_t bucket(uint8_t i) const;
+
+  /**
+   * Longest frame recorded.
+   */
+  uint32_t maxUs() const;
+
+  /**
+   * Frames longer than the budget.
+   */
+  uint32_t overruns() const;
+
+  /**
+   * Frames recorded.
+   */
+  uint32_t count() const;
+
+  /**
+   * Write "[n0,n1,...]" into a buffer.
+   *
+   * @return Characters written (excluding the terminator)
+   */
+  size_t formatHistogram(char* buffer, size_t size) const;
+
+  /**
+   * Start a new measurement window.
+   */
+  void reset();
+
+private:
+  uint32_t budget;
+  uint32_t buckets[BUCKETS];
+  uint32_t worst;
+  uint32_t overrun;
+  uint32_t total;
+};
+
+#endif // FRAME_STATS_H
@@ -0,0 +1,287 @@
+#include "StateJournal.h"
+#include "Bytes.h"
+
+namespace {
+
+// Sector header, in the first slot of each sector (big endian)
+//   0  magic "SJ"
+//   2  version
+//   4  generation
+//  28  CRC-32 of bytes 0..27
+//
+// Record, in the other slots
+//   0  magic 'R'
+//   1  flags: bit 0 power, bit 1 animating, bit 2 paused
+//   2  brightness, red, green, blue
+//   6  animation id
+//   7  animation parameters (6 bytes)
+//  13  brightness, red, green, blue before the animation started
+//  17  reserved (zero)
+//  20  animation running time in ms
+//  24  reserved (zero)
+//  28  CRC-32 of bytes 0..27
+const uint8_t HEADER_MAGIC_0 = 'S';
+const uint8_t HEADER_MAGIC_1 = 'J';
+const uint8_t RECORD_MAGIC = 'R';
+const uint8_t FORMAT_VERSION = 1;
+const size_t CRC_OFFSET = 28;
+
+const uint8_t FLAG_POWER = 0x01;
+const uint8_t FLAG_ANIMATING = 0x02;
+const uint8_t FLAG_PAUSED = 0x04;
+
+bool erased(const uint8_t* slot) {
+  for (size_t i = 0; i < StateJournal::RECORD_SIZE; i++) {
+    if (slot[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+unsigned long remaining(unsigned long now, unsigned long since, unsigned long period) {
+  unsigned long gone = now - since;
+  return gone >= period ? 0 : period - gone;
+}
+
+}  // namespace
+
+StateJournal::StateJournal()
+  : clock(&Clock::system()), flash(nullptr), sectors(0),
+    activeSector(-1), generation(0), nextSlot(1),
+    present(false), last(), offered(false), pending(false), latest(),
+    changedAt(0), pendingSince(0), writtenAt(0), writeCount(0), eraseCount(0) {
+}
+
+void StateJournal::encode(const Entry& entry, uint8_t* record) {
+  memset(record, 0, RECORD_SIZE);
+  record[0] = RECORD_MAGIC;
+  record[1] = (entry.powerOn ? FLAG_POWER : 0) |
+              (entry.animating ? FLAG_ANIMATING : 0) |
+              (entry.paused ? FLAG_PAUSED : 0);
+  record[2] = entry.brightness;
+  record[3] = entry.colorR;
+  record[4] = entry.colorG;
+  record[5] = entry.colorB;
+  record[6] = entry.animation;
+  memcpy(record + 7, entry.params, 6);
+  record[13] = entry.originBrightness;
+  record[14] = entry.originR;
+  record[15] = entry.originG;
+  record[16] = entry.originB;
+  Bytes::writeU32(record + 20, entry.elapsedMs);
+  Bytes::writeU32(record + CRC_OFFSET, Bytes::crc32(record, CRC_OFFSET));
+}
+
+bool StateJournal::decode(const uint8_t* record, Entry& entry) {
+  if (record[0] != RECORD_MAGIC) return false;
+  if (Bytes::readU32(record + CRC_OFFSET) != Bytes::crc32(record, CRC_OFFSET)) return false;
+
+  entry.powerOn = record[1] & FLAG_POWER;
+  entry.animating = record[1] & FLAG_ANIMATING;
+  entry.paused = record[1] & FLAG_PAUSED;
+  entry.brightness = record[2];
+  entry.colorR = record[3];
+  entry.colorG = record[4];
+  entry.colorB = record[5];
+  entry.animation = record[6];
+  memcpy(entry.params, record + 7, 6);
+  entry.originBrightness = record[13];
+  entry.originR = record[14];
+  entry.originG = record[15];
+  entry.originB = record[16];
+  entry.elapsedMs = Bytes::readU32(record + 20);
+  return true;
+}
+
+bool StateJournal::readSector(size_t sector, uint32_t& gen) const {
+  uint8_t header[RECORD_SIZE];
+  if (!flash->read(sector * FlashRegion::SECTOR_SIZE, header, sizeof(header))) return false;
+  if (header[0] != HEADER_MAGIC_0 || header[1] != HEADER_MAGIC_1) return false;
+  if (header[2] != FORMAT_VERSION) return false;
+  if (Bytes::readU32(header + CRC_OFFSET) != Bytes::crc32(header, CRC_OFFSET)) return false;
+  gen = Bytes::readU32(header + 4);
+  return true;
+}
+
+bool StateJournal::lastRecord(size_t sector, Entry& out, size_t& freeSlot) const {
+  bool found = false;
+  freeSlot = SLOTS_PER_SECTOR;
+
+  uint8_t slot[RECORD_SIZE];
+  for (size_t i = 1; i < SLOTS_PER_SECTOR; i++) {
+    if (!flash->read(sector * FlashRegion::SECTOR_SIZE + i * RECORD_SIZE, slot, sizeof(slot))) break;
+    if (erased(slot)) {
+      freeSlot = i;
+      break;
+    }
+    // A torn record fails its CRC; the one before it still counts
+    Entry entry;
+    if (decode(slot, entry)) {
+      out = entry;
+      found = true;
+    }
+  }
+  return found;
+}
+
+bool StateJournal::begin(FlashRegion* region) {
+  flash = nullptr;
+  sectors = region ? region->size() / FlashRegion::SECTOR_SIZE : 0;
+  if (sectors < 2) return false;
+  flash = region;
+
+  activeSector = -1;
+  generation = 0;
+  nextSlot = 1;
+  present = false;
+  offered = false;
+  pending = false;
+  writtenAt = clock->millis();
+
+  // Newest sector first; only if it holds no intact record (power lost
+  // right after a rotation) look at the one before
+  uint32_t bound = 0xFFFFFFFFUL;
+  for (size_t tries = 0; tries < sectors && !present; tries++) {
+    int best = -1;
+    uint32_t bestGen = 0;
+    for (size_t s = 0; s < sectors; s++) {
+      uint32_t gen;
+      if (readSector(s, gen) && gen < bound && (best < 0 || gen > bestGen)) {
+        best = (int)s;
+        bestGen = gen;
+      }
+    }
+    if (best < 0) break;
+
+    size_t freeSlot;
+    present = lastRecord(best, last, freeSlot);
+    if (tries == 0) {
+      activeSector = best;
+      generation = bestGen;
+      nextSlot = freeSlot;
+    }
+    bound = bestGen;
+  }
+  return true;
+}
+
+bool StateJournal::restore(Entry& out) const {
+  if (!present) return false;
+  out = last;
+  return true;
+}
+
+bool StateJournal::sameState(const Entry& a, const Entry& b) {
+  if (a.animating != b.animating) return false;
+
+  // An animation drives the light itself; what matters is how it was
+  // started and whether it is paused
+  if (a.animating) {
+    return a.animation == b.animation && a.paused == b.paused &&
+           memcmp(a.params, b.params, sizeof(a.params)) == 0 &&
+           a.originBrightness == b.originBrightness && a.originR == b.originR &&
+           a.originG == b.originG && a.originB == b.originB;
+  }
+  return a.powerOn == b.powerOn && a.brightness == b.brightness &&
+         a.colorR == b.colorR && a.colorG == b.colorG && a.colorB == b.colorB;
+}
+
+void StateJournal::record(const Entry& entry) {
+  if (!flash) return;
+  unsigned long now = clock->millis();
+
+  if (!present || !sameState(entry, last)) {
+    if (!pending) {
+      pending = true;
+      pendingSince = now;
+      changedAt = now;
+    } else if (!sameState(entry, latest)) {
+      changedAt = now;
+    }
+  } else {
+    pending = false;   // Changed back to what is on flash
+  }
+  latest = entry;
+  offered = true;
+
+  if (pending) {
+    if (now - changedAt >= SETTLE_MS || now - pendingSince >= MAX_DELAY_MS) {
+      write(latest);
+    }
+  } else if (entry.animating && !entry.paused && entry.elapsedMs != last.elapsedMs &&
+             now - writtenAt >= PROGRESS_INTERVAL_MS) {
+    write(latest);
+  }
+}
+
+unsigned long StateJournal::msUntilWrite() const {
+  if (!flash || !offered) return Clock::NO_DEADLINE;
+  unsigned long now = clock->millis();
+
+  if (pending) {
+    unsigned long settle = remaining(now, changedAt, SETTLE_MS);
+    unsigned long cap = remaining(now, pendingSince, MAX_DELAY_MS);
+    return settle < cap ? settle : cap;
+  }
+  if (latest.animating && !latest.paused) {
+    return remaining(now, writtenAt, PROGRESS_INTERVAL_MS);
+  }
+  return Clock::NO_DEADLINE;
+}
+
+bool StateJournal::openNextSector() {
+  size_t next = activeSector < 0 ? 0 : ((size_t)activeSector + 1) % sectors;
+  if (!flash->erase(next * FlashRegion::SECTOR_SIZE)) {
+    Serial.println("[JOURNAL] Sector erase failed");
+    return false;
+  }
+  eraseCount++;
+
+  uint8_t header[RECORD_SIZE];
+  memset(header, 0, sizeof(header));
+  header[0] = HEADER_MAGIC_0;
+  header[1] = HEADER_MAGIC_1;
+  header[2] = FORMAT_VERSION;
+  Bytes::writeU32(header + 4, generation + 1);
+  Bytes::writeU32(header + CRC_OFFSET, Bytes::crc32(header, CRC_OFFSET));
+  if (!flash->write(next * FlashRegion::SECTOR_SIZE, header, sizeof(header))) {
+    Serial.println("[JOURNAL] Sector header write failed");
+    return false;
+  }
+
+  activeSector = (int)next;
+  generation++;
+  nextSlot = 1;
+  return true;
+}
+
+bool StateJournal::append(const Entry& entry) {
+  if (activeSector < 0 || nextSlot >= SLOTS_PER_SECTOR) {
+    if (!openNextSector()) return false;
+  }
+
+  uint8_t record[RECORD_SIZE];
+  encode(entry, record);
+  size_t offset = (size_t)activeSector * FlashRegion::SECTOR_SIZE + nextSlot * RECORD_SIZE;
+  nextSlot++;   // Even a failed slot may be partly programmed
+  if (!flash->write(offset, record, sizeof(record))) {
+    Serial.println("[JOURNAL] Record write failed");
+    return false;
+  }
+  return true;
+}
+
+void StateJournal::write(const Entry& entry) {
+  unsigned long now = clock->millis();
+  writtenAt = now;
+  if (!append(entry)) {
+    // Keep the change pending and try again once it settles anew
+    changedAt = now;
+    pendingSince = now;
+    return;
+  }
+
+  writeCount++;
+  last = entry;
+  present = true;
+  pending = false;
+}
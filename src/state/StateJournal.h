@@ -0,0 +1,124 @@
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include <Arduino.h>
+#include "../hw/Clock.h"
+#include "../hw/FlashRegion.h"
+
+/**
+ * Append-only journal of the light state, for resuming after power loss.
+ *
+ * Responsibilities:
+ * - Append fixed-size, CRC-checked records to a dedicated flash region,
+ *   moving to the next sector when one is full, so erases are spread
+ *   over the whole region
+ * - Coalesce writes: a change of the light is written once it has
+ *   settled, the progress of a running animation at most every
+ *   PROGRESS_INTERVAL_MS
+ * - Find the last intact record at boot; a write cut short by the power
+ *   going away only loses that record
+ *
+ * Each sector starts with a header slot carrying a generation number
+ * that grows with every rotation; the sector with the highest
+ * generation is the one being appended to.
+ */
+class StateJournal {
+public:
+  static const size_t RECORD_SIZE = 32;
+  static const size_t SLOTS_PER_SECTOR = FlashRegion::SECTOR_SIZE / RECORD_SIZE;
+
+  // A change is written when nothing changed for SETTLE_MS, and at the
+  // latest MAX_DELAY_MS after it (a slider being dragged)
+  static const unsigned long SETTLE_MS = 2000;
+  static const unsigned long MAX_DELAY_MS = 10000;
+
+  // Running animations record their progress this often
+  static const unsigned long PROGRESS_INTERVAL_MS = 10000;
+
+  /**
+   * One record: the light, and the animation producing it if any.
+   */
+  struct Entry {
+    bool powerOn;
+    uint8_t brightness;
+    uint8_t colorR, colorG, colorB;
+
+    bool animating;
+    bool paused;
+    uint8_t animation;          // AnimationId
+    uint8_t params[6];          // AnimationParams in declaration order
+    uint8_t originBrightness;
+    uint8_t originR, originG, originB;
+    uint32_t elapsedMs;
+  };
+
+  StateJournal();
+
+  void setClock(const Clock* c) { clock = c; }
+
+  /**
+   * Scan the region for the newest record. Quiet and read-only, so it
+   * can run before first light; the first sector is only erased when
+   * the first record is appended.
+   *
+   * @return False if the region is too small to rotate (under 2 sectors)
+   */
+  bool begin(FlashRegion* region);
+
+  /**
+   * The newest record on flash.
+   *
+   * @return False if the journal was empty
+   */
+  bool restore(Entry& out) const;
+
+  /**
+   * Offer the current state. Call every loop; writes when due.
+   */
+  void record(const Entry& entry);
+
+  /**
+   * Time until record() would write if nothing changes.
+   *
+   * @return Milliseconds (0 = now), Clock::NO_DEADLINE when up to date
+   */
+  unsigned long msUntilWrite() const;
+
+  uint32_t writes() const { return writeCount; }
+  uint32_t erases() const { return eraseCount; }
+
+  static void encode(const Entry& entry, uint8_t* record);
+  static bool decode(const uint8_t* record, Entry& entry);
+
+private:
+  const Clock* clock;
+  FlashRegion* flash;
+  size_t sectors;
+
+  int activeSector;             // -1 until the first sector is opened
+  uint32_t generation;          // Of the active sector
+  size_t nextSlot;              // Next free slot in the active sector
+
+  bool present;
+  Entry last;                   // Restored or last written
+  bool offered;                 // record() called at least once
+
+  bool pending;                 // Changed since the last write
+  Entry latest;
+  unsigned long changedAt;
+  unsigned long pendingSince;
+  unsigned long writtenAt;
+
+  uint32_t writeCount;
+  uint32_t eraseCount;
+
+  bool readSector(size_t sector, uint32_t& gen) const;
+  bool lastRecord(size_t sector, Entry& out, size_t& freeSlot) const;
+  bool openNextSector();
+  bool append(const Entry& entry);
+  void write(const Entry& entry);
+
+  static bool sameState(const Entry& a, const Entry& b);
+};
+
+#endif // STATE_JOURNAL_H
@@ -1,11 +1,13 @@
 #include "SystemMonitor.h"
 
 SystemMonitor::SystemMonitor() 
-  : bootTime(0), loopCount(0), minFreeHeap(0xFFFFFFFF) {
+  : bootTime(0), loopCount(0), minFreeHeap(0xFFFFFFFF),
+    idleWindowStart(0), idleWindowUs(0), idlePercent(0) {
 }
 
 void SystemMonitor::begin() {
   bootTime = millis();
+  idleWindowStart = bootTime;
   resetReason = esp_reset_reason();
   minFreeHeap = ESP.getFreeHeap();
 
@@ -23,6 +25,15 @@ void SystemMonitor::update() {
   if (currentHeap < minFreeHeap) {
     minFreeHeap = currentHeap;
   }
+
+  unsigned long now = millis();
+  unsigned long windowMs = now - idleWindowStart;
+  if (windowMs >= IDLE_WINDOW_MS) {
+    uint64_t percent = idleWindowUs / (windowMs * 10ULL);
+    idlePercent = percent > 100 ? 100 : (uint8_t)percent;
+    idleWindowUs = 0;
+    idleWindowStart = now;
+  }
 }
 
 unsigned long SystemMonitor::getUptimeSeconds() const {
@@ -61,3 +72,11 @@ unsigned long SystemMonitor::getLoopCount() const {
 void SystemMonitor::incrementLoop() {
   loopCount++;
 }
+
+void SystemMonitor::addIdleTime(unsigned long idleUs) {
+  idleWindowUs += idleUs;
+}
+
+uint8_t SystemMonitor::getIdlePercent() const {
+  return idlePercent;
+}
@@ -12,6 +12,7 @@
  * - Monitor free heap
  * - Detect WiFi/MQTT issues
  * - Provide reset reason
+ * - Measure how much of the time the main loop sleeps
  */
 class SystemMonitor {
 public:
@@ -57,11 +58,28 @@ public:
    */
   void incrementLoop();
 
+  /**
+   * Account time the main loop spent blocked in sleep.
+   *
+   * @param idleUs Microseconds slept
+   */
+  void addIdleTime(unsigned long idleUs);
+
+  /**
+   * Get idle percentage over the last complete measurement window.
+   */
+  uint8_t getIdlePercent() const;
+
 private:
+  static const unsigned long IDLE_WINDOW_MS = 10000;
+
   unsigned long bootTime;
   unsigned long loopCount;
   uint32_t minFreeHeap;
   esp_reset_reason_t resetReason;
+  unsigned long idleWindowStart;
+  uint64_t idleWindowUs;
+  uint8_t idlePercent;
 };
 
 #endif // SYSTEM_MONITOR_H
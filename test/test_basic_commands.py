@@ -149,6 +149,56 @@ def test_basic_commands(client: MQTTTestClient) -> list[TestResult]:
     print_result(result)
     print()
 
+    # Test 10: JSON batch (power, brightness and color in one message)
+    print_step(10, "JSON batch: on, 40%, blue")
+    client.clear_messages()
+    client.publish("cmnd/json", '{"state":"ON","brightness":40,"color":[0,0,255]}')
+    time.sleep(1)
+
+    result = client.assert_json_field("state/json", "bri", 40)
+    results.append(result)
+    print_result(result)
+    result = client.assert_json_field("state/json", "rgb", [0, 0, 255])
+    results.append(result)
+    print_result(result)
+    print()
+
+    # Test 11: Malformed JSON batch changes nothing
+    print_step(11, "Malformed JSON batch is ignored")
+    client.clear_messages()
+    client.publish("cmnd/json", '{"brightness":90,"color":[255,0]}')
+    time.sleep(1)
+    client.publish("cmnd/query", "1")
+    time.sleep(1)
+
+    result = client.assert_json_field("state/json", "bri", 40)
+    results.append(result)
+    print_result(result)
+    print()
+
+    # Test 12: Timed command waits for its instant (needs NTP on this host too)
+    print_step(12, "Timed brightness 25% two seconds ahead")
+    client.clear_messages()
+    at_ms = int(time.time() * 1000) + 2000
+    client.publish("cmnd/brightness", f"25:at={at_ms}")
+    time.sleep(0.5)
+    client.publish("cmnd/query", "1")
+    time.sleep(0.5)
+
+    result = client.assert_json_field("state/json", "bri", 40)
+    results.append(result)
+    print_result(result)
+
+    client.clear_messages()
+    time.sleep(2)
+    client.publish("cmnd/query", "1")
+    time.sleep(1)
+
+    result = client.assert_json_field("state/json", "bri", 25)
+    results.append(result)
+    print_result(result)
+    print()
+
     return results
 
 
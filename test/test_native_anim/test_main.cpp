@@ -0,0 +1,316 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "anim/AnimationEngine.h"
+#include "anim/AnimationRegistry.h"
+#include "hw/Clock.h"
+#include "state/DeviceConfig.h"
+#include "state/DeviceState.h"
+
+static DeviceState* state;
+static DeviceConfig* config;
+static VirtualClock* vclock;
+static AnimationEngine* engine;
+
+void setUp() {
+  state = new DeviceState();
+  config = new DeviceConfig();
+  vclock = new VirtualClock(1);
+  engine = new AnimationEngine();
+  engine->begin(state, config, vclock);
+}
+
+void tearDown() {
+  delete engine;
+  delete vclock;
+  delete config;
+  delete state;
+}
+
+static void runFor(unsigned long ms, unsigned long stepMs) {
+  for (unsigned long t = 0; t < ms; t += stepMs) {
+    vclock->advance(stepMs);
+    engine->loop();
+  }
+}
+
+void test_sunrise_completes_in_virtual_time() {
+  engine->startSunrise(30, 80, 255, 200, 100);
+  TEST_ASSERT_TRUE(engine->isActive());
+  TEST_ASSERT_EQUAL_UINT8(1, state->brightness);
+
+  runFor(15UL * 60UL * 1000UL, 100);
+  TEST_ASSERT_TRUE(engine->isActive());
+  TEST_ASSERT_UINT8_WITHIN(2, 50, state->progress);
+
+  runFor(15UL * 60UL * 1000UL + 200, 100);
+  TEST_ASSERT_FALSE(engine->isActive());
+  TEST_ASSERT_EQUAL(LampMode::STATIC, state->mode);
+  TEST_ASSERT_EQUAL_UINT8(80, state->brightness);
+  TEST_ASSERT_EQUAL_UINT8(255, state->colorR);
+  TEST_ASSERT_EQUAL_UINT8(200, state->colorG);
+  TEST_ASSERT_EQUAL_UINT8(100, state->colorB);
+}
+
+void test_sunrise_hands_segments_to_fader() {
+  engine->startSunrise(30, 80, 255, 200, 100);
+
+  // Each segment targets its end point with a matching transition
+  unsigned long segments = 0, fadedMs = 0;
+  while (engine->isActive()) {
+    vclock->advance(100);
+    engine->loop();
+    if (state->transitionMs > 0) {
+      segments++;
+      fadedMs += state->transitionMs;
+      state->transitionMs = 0;
+    }
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(101, segments);
+  TEST_ASSERT_UINT32_WITHIN(100 * 100, 30UL * 60UL * 1000UL, fadedMs);
+  TEST_ASSERT_EQUAL_UINT8(80, state->brightness);
+}
+
+void test_pause_freezes_segment() {
+  engine->startSunrise(10, 100);
+  runFor(30000, 100);
+  TEST_ASSERT_TRUE(state->transitionMs > 0);
+
+  engine->setPaused(true);
+  TEST_ASSERT_EQUAL_UINT32(0, state->transitionMs);
+  uint8_t frozen = state->brightness;
+  runFor(60000, 100);
+  TEST_ASSERT_EQUAL_UINT8(frozen, state->brightness);
+}
+
+void test_sunset_turns_off_at_end() {
+  state->brightness = 60;
+  engine->startSunset(2, 0);
+  runFor(2UL * 60UL * 1000UL + 200, 100);
+  TEST_ASSERT_FALSE(engine->isActive());
+  TEST_ASSERT_FALSE(state->powerOn);
+}
+
+void test_pause_freezes_progress() {
+  engine->startSunrise(10, 100);
+  runFor(60000, 100);
+  uint8_t before = state->progress;
+
+  engine->setPaused(true);
+  runFor(5UL * 60UL * 1000UL, 100);
+  TEST_ASSERT_EQUAL_UINT8(before, state->progress);
+
+  engine->setPaused(false);
+  runFor(60000, 100);
+  TEST_ASSERT_GREATER_THAN_UINT8(before, state->progress);
+}
+
+void test_loop_animations_keep_running() {
+  engine->startFire(70, 5);
+  runFor(60000, 33);
+  TEST_ASSERT_TRUE(engine->isActive());
+  TEST_ASSERT_EQUAL_STRING("fire", state->animationName.c_str());
+
+  engine->startBreathe(4, 70, 10);
+  TEST_ASSERT_EQUAL_STRING("breathe", state->animationName.c_str());
+  runFor(60000, 33);
+  TEST_ASSERT_TRUE(state->brightness >= 10 && state->brightness <= 70);
+
+  engine->startOcean(5, 70);
+  runFor(60000, 33);
+  TEST_ASSERT_TRUE(state->brightness <= 70);
+
+  engine->startRainbow();
+  runFor(60000, 16);
+  TEST_ASSERT_TRUE(engine->isActive());
+
+  engine->stop();
+  TEST_ASSERT_FALSE(engine->isActive());
+  TEST_ASSERT_EQUAL(LampMode::STATIC, state->mode);
+}
+
+void test_registry_lookup_and_params() {
+  TEST_ASSERT_NULL(AnimationRegistry::find("disco"));
+
+  const AnimationInfo* breathe = AnimationRegistry::find("breathe");
+  TEST_ASSERT_NOT_NULL(breathe);
+  TEST_ASSERT_EQUAL(AnimationId::Breathe, breathe->id);
+
+  // "brightness" must not match inside "min_brightness"
+  AnimationParams params = AnimationRegistry::defaults(*breathe);
+  AnimationRegistry::parseParams("min_brightness=5,duration=6,color=0,100,255", *breathe, params);
+  TEST_ASSERT_EQUAL_UINT8(6, params.param1);
+  TEST_ASSERT_EQUAL_UINT8(70, params.param2);
+  TEST_ASSERT_EQUAL_UINT8(5, params.param3);
+  TEST_ASSERT_EQUAL_UINT8(0, params.colorR);
+  TEST_ASSERT_EQUAL_UINT8(100, params.colorG);
+  TEST_ASSERT_EQUAL_UINT8(255, params.colorB);
+
+  // Favorite-style aliases
+  AnimationRegistry::parseParams("max=90,min=20", *breathe, params);
+  TEST_ASSERT_EQUAL_UINT8(90, params.param2);
+  TEST_ASSERT_EQUAL_UINT8(20, params.param3);
+}
+
+void test_registry_schema_clamps_and_skips() {
+  const AnimationInfo* fire = AnimationRegistry::find("fire");
+  AnimationParams params = AnimationRegistry::defaults(*fire);
+  TEST_ASSERT_EQUAL_UINT8(70, params.param1);
+  TEST_ASSERT_EQUAL_UINT8(5, params.param2);
+
+  // Out-of-range values are clamped; unknown keys and bare tokens skipped
+  AnimationRegistry::parseParams("bogus=1,intensity=250,flag,speed=0", *fire, params);
+  TEST_ASSERT_EQUAL_UINT8(100, params.param1);
+  TEST_ASSERT_EQUAL_UINT8(1, params.param2);
+
+  // A non-numeric value leaves the parameter alone
+  AnimationRegistry::parseParams("speed=fast", *fire, params);
+  TEST_ASSERT_EQUAL_UINT8(1, params.param2);
+}
+
+void test_registry_parse_command() {
+  const char cmd[] = "Breathe:color=300,-5,7,duration=0";
+  AnimationParams params;
+  const AnimationInfo* info = AnimationRegistry::parseCommand(cmd, strlen(cmd), params);
+  TEST_ASSERT_NOT_NULL(info);
+  TEST_ASSERT_EQUAL(AnimationId::Breathe, info->id);
+  TEST_ASSERT_EQUAL_UINT8(1, params.param1);   // Clamped to the 1 s minimum
+  TEST_ASSERT_EQUAL_UINT8(70, params.param2);  // Defaults for absent keys
+  TEST_ASSERT_EQUAL_UINT8(10, params.param3);
+  TEST_ASSERT_EQUAL_UINT8(255, params.colorR);
+  TEST_ASSERT_EQUAL_UINT8(0, params.colorG);
+  TEST_ASSERT_EQUAL_UINT8(7, params.colorB);
+
+  TEST_ASSERT_NULL(AnimationRegistry::parseCommand("disco:speed=1", 13, params));
+}
+
+void test_registry_set_param_by_key() {
+  const AnimationInfo& breathe = AnimationRegistry::get(AnimationId::Breathe);
+  AnimationParams params = AnimationRegistry::defaults(breathe);
+
+  long speed = 99;
+  TEST_ASSERT_TRUE(AnimationRegistry::setParam(breathe, "max", 3, &speed, 1, params));
+  TEST_ASSERT_EQUAL_UINT8(99, params.param2);
+
+  long rgb[3] = { 1, 300, -4 };
+  TEST_ASSERT_TRUE(AnimationRegistry::setParam(breathe, "color", 5, rgb, 3, params));
+  TEST_ASSERT_EQUAL_UINT8(1, params.colorR);
+  TEST_ASSERT_EQUAL_UINT8(255, params.colorG);
+  TEST_ASSERT_EQUAL_UINT8(0, params.colorB);
+
+  // Unknown keys and mismatched value counts change nothing
+  TEST_ASSERT_FALSE(AnimationRegistry::setParam(breathe, "speed", 5, &speed, 1, params));
+  TEST_ASSERT_FALSE(AnimationRegistry::setParam(breathe, "color", 5, &speed, 1, params));
+  TEST_ASSERT_FALSE(AnimationRegistry::setParam(breathe, "duration", 8, rgb, 3, params));
+  TEST_ASSERT_EQUAL_UINT8(4, params.param1);
+}
+
+void test_engine_single_active_slot() {
+  engine->startFire(70, 5);
+  TEST_ASSERT_EQUAL_STRING("fire", state->animationName.c_str());
+
+  AnimationParams params = AnimationRegistry::defaults(AnimationRegistry::get(AnimationId::Rainbow));
+  engine->start(AnimationId::Rainbow, params);
+  TEST_ASSERT_TRUE(engine->isActive());
+  TEST_ASSERT_EQUAL_STRING("rainbow", state->animationName.c_str());
+
+  engine->setPaused(true);
+  TEST_ASSERT_TRUE(state->animationPaused);
+  engine->stop();
+  TEST_ASSERT_FALSE(engine->isActive());
+}
+
+void test_favorite_ocean_params() {
+  // Favorite layout for ocean is brightness, speed
+  config->favoriteAnimation = "ocean";
+  config->favAnimParam1 = 40;
+  config->favAnimParam2 = 8;
+  engine->startFavorite();
+  TEST_ASSERT_EQUAL_STRING("ocean", state->animationName.c_str());
+
+  runFor(60000, 33);
+  TEST_ASSERT_TRUE(state->brightness <= 40);
+
+  config->favoriteAnimation = "unknown";
+  engine->startFavorite();
+  TEST_ASSERT_EQUAL_STRING("fire", state->animationName.c_str());
+}
+
+void test_engine_reports_frame_deadlines() {
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, engine->msUntilUpdate());
+
+  engine->startFire(70, 5);
+  TEST_ASSERT_LESS_OR_EQUAL(33, engine->msUntilUpdate());
+  engine->setPaused(true);
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, engine->msUntilUpdate());
+
+  // A sunrise only needs to wake once per segment
+  engine->startSunrise(30, 80);
+  unsigned long wakeups = 0;
+  while (engine->isActive() && wakeups < 1000) {
+    vclock->advance(engine->msUntilUpdate());
+    engine->loop();
+    wakeups++;
+  }
+  TEST_ASSERT_FALSE(engine->isActive());
+  TEST_ASSERT_EQUAL_UINT8(80, state->brightness);
+  TEST_ASSERT_LESS_OR_EQUAL(110, wakeups);
+}
+
+void test_engine_resumes_from_snapshot() {
+  state->brightness = 80;
+  state->colorR = 255;
+  state->colorG = 147;
+  state->colorB = 41;
+  engine->startSunset(30, 0);
+  runFor(10UL * 60UL * 1000UL, 100);
+
+  AnimationSnapshot saved;
+  TEST_ASSERT_TRUE(engine->snapshot(saved));
+  TEST_ASSERT_EQUAL(AnimationId::Sunset, saved.id);
+  TEST_ASSERT_EQUAL_UINT8(80, saved.originBrightness);
+  TEST_ASSERT_UINT32_WITHIN(100, 10UL * 60UL * 1000UL, saved.elapsedMs);
+
+  // After a restart, from a different light
+  DeviceState restarted;
+  restarted.brightness = 5;
+  AnimationEngine resumed;
+  resumed.begin(&restarted, config, vclock);
+  resumed.resume(saved);
+  resumed.loop();
+  TEST_ASSERT_EQUAL_UINT8(state->brightness, restarted.brightness);
+  TEST_ASSERT_EQUAL_UINT8(state->colorG, restarted.colorG);
+  TEST_ASSERT_UINT8_WITHIN(1, state->progress, restarted.progress);
+
+  // Paused animations come back paused at the same point
+  engine->setPaused(true);
+  TEST_ASSERT_TRUE(engine->snapshot(saved));
+  TEST_ASSERT_TRUE(saved.paused);
+  vclock->advance(60000);
+  TEST_ASSERT_TRUE(engine->snapshot(saved));
+  resumed.resume(saved);
+  TEST_ASSERT_TRUE(restarted.animationPaused);
+  TEST_ASSERT_EQUAL_UINT8(state->brightness, restarted.brightness);
+
+  engine->stop();
+  TEST_ASSERT_FALSE(engine->snapshot(saved));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sunrise_completes_in_virtual_time);
+  RUN_TEST(test_sunrise_hands_segments_to_fader);
+  RUN_TEST(test_pause_freezes_segment);
+  RUN_TEST(test_sunset_turns_off_at_end);
+  RUN_TEST(test_pause_freezes_progress);
+  RUN_TEST(test_loop_animations_keep_running);
+  RUN_TEST(test_registry_lookup_and_params);
+  RUN_TEST(test_registry_schema_clamps_and_skips);
+  RUN_TEST(test_registry_parse_command);
+  RUN_TEST(test_registry_set_param_by_key);
+  RUN_TEST(test_engine_single_active_slot);
+  RUN_TEST(test_favorite_ocean_params);
+  RUN_TEST(test_engine_reports_frame_deadlines);
+  RUN_TEST(test_engine_resumes_from_snapshot);
+  return UNITY_END();
+}
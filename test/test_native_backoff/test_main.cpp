@@ -0,0 +1,349 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "hw/Clock.h"
+#include "net/Backoff.h"
+#include "net/MqttClient.h"
+
+// Reconnect backoff, and a fleet of MqttClients reconnecting to a local
+// stand-in broker after it restarts. Time is virtual; the sockets are real.
+
+static const unsigned long FIRST_MS = 1000;
+static const unsigned long CAP_MS = 60000;
+
+/**
+ * Broker stand-in for many clients: answers CONNECT and PINGREQ and
+ * records when each CONNECT arrived. Polled from the test loop, so it
+ * sees the same virtual time as the clients.
+ */
+class FleetBroker {
+public:
+  std::vector<unsigned long> connectTimes;
+
+  explicit FleetBroker(const Clock* c) : clock(c), listenFd(-1), port(0) {}
+  ~FleetBroker() { kill(); }
+
+  bool start(uint16_t requestedPort = 0) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(requestedPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 256) < 0) {
+      return false;
+    }
+    socklen_t length = sizeof(addr);
+    getsockname(listenFd, (struct sockaddr*)&addr, &length);
+    port = ntohs(addr.sin_port);
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL, 0) | O_NONBLOCK);
+    return true;
+  }
+
+  // Drop the listener and every session, like a broker restart
+  void kill() {
+    for (Session& s : sessions) close(s.fd);
+    sessions.clear();
+    if (listenFd >= 0) close(listenFd);
+    listenFd = -1;
+  }
+
+  void poll() {
+    if (listenFd < 0) return;
+    for (;;) {
+      int c = accept(listenFd, nullptr, nullptr);
+      if (c < 0) break;
+      fcntl(c, F_SETFL, fcntl(c, F_GETFL, 0) | O_NONBLOCK);
+      sessions.push_back({ c, 0, {0} });
+    }
+
+    for (size_t i = 0; i < sessions.size();) {
+      if (serve(sessions[i])) {
+        i++;
+      } else {
+        close(sessions[i].fd);
+        sessions.erase(sessions.begin() + i);
+      }
+    }
+  }
+
+  uint16_t boundPort() const { return port; }
+
+private:
+  struct Session {
+    int fd;
+    size_t used;
+    uint8_t buffer[256];
+  };
+
+  const Clock* clock;
+  int listenFd;
+  uint16_t port;
+  std::vector<Session> sessions;
+
+  // Handle the complete packets received so far. False when closed
+  bool serve(Session& s) {
+    ssize_t n = recv(s.fd, s.buffer + s.used, sizeof(s.buffer) - s.used, 0);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+    s.used += n;
+
+    for (;;) {
+      if (s.used < 2) return true;
+      size_t remaining = 0;
+      size_t pos = 1;
+      uint8_t shift = 0;
+      do {
+        if (pos >= s.used) return true;
+        remaining |= (size_t)(s.buffer[pos] & 0x7F) << shift;
+        shift += 7;
+      } while (s.buffer[pos++] & 0x80);
+      if (pos + remaining > sizeof(s.buffer)) return false;
+      if (pos + remaining > s.used) return true;
+
+      uint8_t type = s.buffer[0] & 0xF0;
+      if (type == 0x10) {
+        connectTimes.push_back(clock->millis());
+        const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+        send(s.fd, connack, sizeof(connack), 0);
+      } else if (type == 0xC0) {
+        const uint8_t pingresp[] = {0xD0, 0x00};
+        send(s.fd, pingresp, sizeof(pingresp), 0);
+      } else if (type == 0xE0) {
+        return false;
+      }
+      memmove(s.buffer, s.buffer + pos + remaining, s.used - pos - remaining);
+      s.used -= pos + remaining;
+    }
+  }
+};
+
+/**
+ * A lamp's MQTT connection with either the old fixed retry interval or
+ * the backoff.
+ */
+struct EmulatedLamp {
+  MqttClient client;
+  Backoff backoff;
+  unsigned long lastAttempt;
+  char clientId[24];
+
+  EmulatedLamp() : backoff(FIRST_MS, CAP_MS), lastAttempt(0) {}
+};
+
+/**
+ * The whole fleet against one broker that restarts during the run.
+ */
+class Fleet {
+public:
+  static const unsigned long STEP_MS = 10;
+  static const unsigned long FIXED_INTERVAL_MS = 5000;   // The retry rule before backoff
+
+  VirtualClock clock;
+  FleetBroker broker;
+  std::vector<EmulatedLamp*> lamps;
+  bool useBackoff;
+
+  Fleet(size_t count, bool backoff) : clock(100000), broker(&clock), useBackoff(backoff) {
+    broker.start();
+    for (size_t i = 0; i < count; i++) {
+      EmulatedLamp* lamp = new EmulatedLamp();
+      snprintf(lamp->clientId, sizeof(lamp->clientId), "lamp_%u", (unsigned)i);
+      lamp->client.setClock(&clock);
+      lamp->client.setServer("127.0.0.1", broker.boundPort());
+      lamp->client.setCredentials(lamp->clientId, nullptr, nullptr);
+      lamp->client.setKeepAlive(60);
+      lamp->backoff.setClock(&clock);
+      lamp->backoff.seed(0x9E3779B9UL * (uint32_t)(i + 1));
+      lamps.push_back(lamp);
+    }
+  }
+
+  ~Fleet() {
+    for (EmulatedLamp* lamp : lamps) delete lamp;
+  }
+
+  size_t connectedCount() const {
+    size_t n = 0;
+    for (EmulatedLamp* lamp : lamps) n += lamp->client.connected() ? 1 : 0;
+    return n;
+  }
+
+  void step() {
+    clock.advance(STEP_MS);
+    for (EmulatedLamp* lamp : lamps) {
+      bool wasConnected = lamp->client.connected();
+      if (lamp->client.state() == MqttClient::State::Disconnected && due(*lamp)) {
+        lamp->lastAttempt = clock.millis();
+        lamp->backoff.attempt();
+        lamp->client.connect();
+      }
+      lamp->client.poll();
+      if (!wasConnected && lamp->client.connected()) lamp->backoff.reset();
+    }
+    broker.poll();
+  }
+
+  // Run until every lamp is connected; false if that takes over limitMs
+  bool runUntilConnected(unsigned long limitMs) {
+    for (unsigned long t = 0; t < limitMs; t += STEP_MS) {
+      step();
+      if (connectedCount() == lamps.size()) return true;
+    }
+    return false;
+  }
+
+  void run(unsigned long ms) {
+    for (unsigned long t = 0; t < ms; t += STEP_MS) step();
+  }
+
+  // Most CONNECTs the broker received in any bucketMs since `since`
+  size_t peakConnects(unsigned long since, unsigned long bucketMs) const {
+    std::vector<size_t> buckets;
+    for (unsigned long at : broker.connectTimes) {
+      if (at < since) continue;
+      size_t index = (at - since) / bucketMs;
+      if (index >= buckets.size()) buckets.resize(index + 1, 0);
+      buckets[index]++;
+    }
+    size_t peak = 0;
+    for (size_t n : buckets) peak = n > peak ? n : peak;
+    return peak;
+  }
+
+private:
+  bool due(const EmulatedLamp& lamp) const {
+    if (useBackoff) return lamp.backoff.due();
+    return clock.millis() - lamp.lastAttempt > FIXED_INTERVAL_MS;
+  }
+};
+
+struct RestartResult {
+  size_t peak;
+  unsigned long recoverMs;
+  bool recovered;
+};
+
+// Connect the fleet, take the broker down for outageMs, bring it back on
+// the same port and measure the reconnect
+static RestartResult restartBroker(bool useBackoff, size_t count, unsigned long outageMs) {
+  Fleet fleet(count, useBackoff);
+  RestartResult result = { 0, 0, false };
+  if (!fleet.runUntilConnected(10000)) return result;
+  fleet.run(1000);
+
+  uint16_t port = fleet.broker.boundPort();
+  fleet.broker.kill();
+  fleet.run(outageMs);
+  if (!fleet.broker.start(port)) return result;
+
+  unsigned long restartedAt = fleet.clock.millis();
+  result.recovered = fleet.runUntilConnected(2 * CAP_MS);
+  result.recoverMs = fleet.clock.millis() - restartedAt;
+  result.peak = fleet.peakConnects(restartedAt, 100);
+  return result;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_first_retry_is_immediate() {
+  VirtualClock clock(5000);
+  Backoff backoff(FIRST_MS, CAP_MS);
+  backoff.setClock(&clock);
+
+  TEST_ASSERT_TRUE(backoff.due());
+  TEST_ASSERT_EQUAL(0, backoff.msUntilDue());
+  backoff.attempt();
+  TEST_ASSERT_EQUAL_UINT32(1, backoff.attempts());
+  TEST_ASSERT_FALSE(backoff.due());
+
+  clock.advance(backoff.msUntilDue());
+  TEST_ASSERT_TRUE(backoff.due());
+
+  backoff.attempt();
+  backoff.reset();
+  TEST_ASSERT_TRUE(backoff.due());
+  TEST_ASSERT_EQUAL_UINT32(0, backoff.attempts());
+}
+
+void test_windows_double_up_to_the_cap() {
+  VirtualClock clock(0);
+  Backoff backoff(FIRST_MS, CAP_MS);
+  backoff.setClock(&clock);
+  backoff.seed(42);
+
+  unsigned long window = FIRST_MS;
+  for (int i = 0; i < 20; i++) {
+    backoff.attempt();
+    unsigned long delay = backoff.lastDelayMs();
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(window / 2, delay);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(window, delay);
+    TEST_ASSERT_EQUAL_UINT32(delay, backoff.msUntilDue());
+
+    clock.advance(delay - 1);
+    TEST_ASSERT_FALSE(backoff.due());
+    clock.advance(1);
+    TEST_ASSERT_TRUE(backoff.due());
+    window = window * 2 > CAP_MS ? CAP_MS : window * 2;
+  }
+}
+
+void test_seeds_spread_the_retries() {
+  VirtualClock clock(0);
+  const int COUNT = 100;
+  unsigned long lo = CAP_MS, hi = 0;
+  for (int i = 0; i < COUNT; i++) {
+    Backoff backoff(FIRST_MS, CAP_MS);
+    backoff.setClock(&clock);
+    backoff.seed(0x9E3779B9UL * (uint32_t)(i + 1));
+    for (int n = 0; n < 4; n++) backoff.attempt();   // Window of 8 s
+    unsigned long delay = backoff.lastDelayMs();
+    if (delay < lo) lo = delay;
+    if (delay > hi) hi = delay;
+  }
+  // Spread over most of the upper half of the window
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(4500, lo);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(7500, hi);
+}
+
+void test_fleet_reconnect_spike_flattens() {
+  const size_t COUNT = 100;
+  RestartResult fixed = restartBroker(false, COUNT, 20000);
+  RestartResult jittered = restartBroker(true, COUNT, 20000);
+
+  printf("fixed interval: peak %u CONNECTs per 100 ms, recovered in %lu ms\n",
+         (unsigned)fixed.peak, fixed.recoverMs);
+  printf("backoff:        peak %u CONNECTs per 100 ms, recovered in %lu ms\n",
+         (unsigned)jittered.peak, jittered.recoverMs);
+
+  TEST_ASSERT_TRUE(fixed.recovered);
+  TEST_ASSERT_TRUE(jittered.recovered);
+
+  // In lockstep the whole fleet arrives at once
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(COUNT * 9 / 10, fixed.peak);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(COUNT / 10, jittered.peak);
+
+  // Never later than one capped window
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(CAP_MS, jittered.recoverMs);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_retry_is_immediate);
+  RUN_TEST(test_windows_double_up_to_the_cap);
+  RUN_TEST(test_seeds_spread_the_retries);
+  RUN_TEST(test_fleet_reconnect_spike_flattens);
+  return UNITY_END();
+}
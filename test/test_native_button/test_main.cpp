@@ -0,0 +1,128 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "hw/Button.h"
+#include "hw/Clock.h"
+
+// Edges are injected the way the GPIO interrupt records them; the click
+// state machine must classify them by their timestamps, not by when
+// update() happens to run.
+
+static Button* button;
+static VirtualClock* vclock;
+
+void setUp() {
+  vclock = new VirtualClock(1);
+  button = new Button();
+  button->setClock(vclock);
+  button->begin();
+}
+
+void tearDown() {
+  delete button;
+  delete vclock;
+}
+
+// Press at 'downMs' for 'holdMs', with a short contact bounce on both edges
+static void click(unsigned long downMs, unsigned long holdMs) {
+  uint32_t down = downMs * 1000UL;
+  uint32_t up = (downMs + holdMs) * 1000UL;
+  button->onEdge(LOW, down);
+  button->onEdge(HIGH, down + 300);
+  button->onEdge(LOW, down + 900);
+  button->onEdge(HIGH, up);
+  button->onEdge(LOW, up + 500);
+  button->onEdge(HIGH, up + 1200);
+}
+
+// Run update() until an event appears or time reaches 'untilMs'
+static ButtonEvent pollUntil(unsigned long untilMs) {
+  while (true) {
+    ButtonEvent event = button->update();
+    if (event != ButtonEvent::None) return event;
+    unsigned long wait = button->msUntilUpdate();
+    if (wait == Clock::NO_DEADLINE || vclock->millis() + wait > untilMs) return ButtonEvent::None;
+    vclock->advance(wait > 0 ? wait : 1);
+  }
+}
+
+void test_idle_has_no_deadline() {
+  TEST_ASSERT_EQUAL(ButtonEvent::None, button->update());
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, button->msUntilUpdate());
+}
+
+void test_single_press_after_double_click_window() {
+  click(100, 120);
+  TEST_ASSERT_EQUAL_UINT32(0, button->msUntilUpdate());
+
+  vclock->set(230);
+  TEST_ASSERT_EQUAL(ButtonEvent::Press, pollUntil(2000));
+  // Window closes 400 ms after the last release bounce at 221.2 ms
+  TEST_ASSERT_UINT32_WITHIN(1, 622, vclock->millis());
+}
+
+void test_double_press() {
+  click(100, 80);
+  click(400, 80);
+  vclock->set(500);
+  TEST_ASSERT_EQUAL(ButtonEvent::DoublePress, button->update());
+  TEST_ASSERT_EQUAL(ButtonEvent::None, pollUntil(3000));
+}
+
+void test_long_press_while_held() {
+  button->onEdge(LOW, 100000);
+  vclock->set(100);
+  TEST_ASSERT_EQUAL(ButtonEvent::LongPress, pollUntil(5000));
+  TEST_ASSERT_UINT32_WITHIN(2, 1100, vclock->millis());
+
+  // Release after a long press is not a click
+  button->onEdge(HIGH, vclock->micros());
+  TEST_ASSERT_EQUAL(ButtonEvent::None, pollUntil(5000));
+}
+
+void test_late_update_keeps_edge_timing() {
+  // Two quick clicks while the loop was blocked for 3 s: still a double press
+  click(100, 80);
+  click(400, 80);
+  vclock->set(3100);
+  TEST_ASSERT_EQUAL(ButtonEvent::DoublePress, button->update());
+
+  // Two clicks 600 ms apart are two single presses, even when read late
+  click(4000, 80);
+  click(4600, 80);
+  vclock->set(8000);
+  TEST_ASSERT_EQUAL(ButtonEvent::Press, button->update());
+  TEST_ASSERT_EQUAL(ButtonEvent::Press, button->update());
+  TEST_ASSERT_EQUAL(ButtonEvent::None, button->update());
+}
+
+void test_short_hold_is_not_long_press() {
+  // 900 ms hold read 5 s later must not be reported as a long press
+  click(100, 900);
+  vclock->set(5100);
+  TEST_ASSERT_EQUAL(ButtonEvent::Press, button->update());
+  TEST_ASSERT_EQUAL(ButtonEvent::None, button->update());
+}
+
+void test_overflow_resyncs_from_pin() {
+  for (int i = 0; i < 100; i++) {
+    button->onEdge(i % 2 ? HIGH : LOW, 100000 + i * 100);
+  }
+  TEST_ASSERT_TRUE(button->droppedEdges() > 0);
+
+  vclock->set(200);
+  TEST_ASSERT_EQUAL(ButtonEvent::None, pollUntil(3000));
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, button->msUntilUpdate());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_idle_has_no_deadline);
+  RUN_TEST(test_single_press_after_double_click_window);
+  RUN_TEST(test_double_press);
+  RUN_TEST(test_long_press_while_held);
+  RUN_TEST(test_late_update_keeps_edge_timing);
+  RUN_TEST(test_short_hold_is_not_long_press);
+  RUN_TEST(test_overflow_resyncs_from_pin);
+  return UNITY_END();
+}
@@ -0,0 +1,194 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <unity.h>
+
+#include "state/Bytes.h"
+#include "state/DeviceConfig.h"
+
+// Configuration blob: round trip, skipped saves, damage, checksum and
+// migration.
+
+static const char* NAMESPACE = "ikea_head_lamp";
+
+void setUp() {
+  Preferences::resetAll();
+}
+
+void tearDown() {}
+
+static DeviceConfig customConfig() {
+  DeviceConfig config;
+  config.defaultBrightness = 55;
+  config.defaultColorR = 10;
+  config.defaultColorG = 20;
+  config.defaultColorB = 30;
+  config.sunriseMinutes = 45;
+  config.minPwmPercent = 15;
+  config.gammaX100 = 180;
+  config.gammaCurveLen = 3;
+  config.gammaCurve[0] = 0;
+  config.gammaCurve[1] = 400;
+  config.gammaCurve[2] = 1000;
+  config.favoriteAnimation = "ocean";
+  config.favAnimParam1 = 8;
+  config.favAnimColorB = 200;
+  config.phaseGroup = "living";
+  config.mqttBase = "home/bedroom/lamp";
+  return config;
+}
+
+void test_config_round_trip_in_one_key() {
+  DeviceConfig saved = customConfig();
+  TEST_ASSERT_TRUE(saved.save());
+  TEST_ASSERT_EQUAL_UINT32(2, saved.version);
+
+  Preferences prefs;
+  prefs.begin(NAMESPACE, true);
+  TEST_ASSERT_TRUE(prefs.isKey("cfg"));
+  TEST_ASSERT_FALSE(prefs.isKey("def_bri"));
+  TEST_ASSERT_TRUE(prefs.getBytesLength("cfg") <= DeviceConfig::BLOB_MAX);
+  prefs.end();
+
+  DeviceConfig loaded;
+  loaded.load();
+  TEST_ASSERT_EQUAL_UINT8(55, loaded.defaultBrightness);
+  TEST_ASSERT_EQUAL_UINT8(30, loaded.defaultColorB);
+  TEST_ASSERT_EQUAL_UINT16(45, loaded.sunriseMinutes);
+  TEST_ASSERT_EQUAL_UINT8(15, loaded.minPwmPercent);
+  TEST_ASSERT_EQUAL_UINT16(180, loaded.gammaX100);
+  TEST_ASSERT_EQUAL_UINT8(3, loaded.gammaCurveLen);
+  TEST_ASSERT_EQUAL_UINT16(400, loaded.gammaCurve[1]);
+  TEST_ASSERT_EQUAL_STRING("ocean", loaded.favoriteAnimation.c_str());
+  TEST_ASSERT_EQUAL_UINT8(8, loaded.favAnimParam1);
+  TEST_ASSERT_EQUAL_UINT8(200, loaded.favAnimColorB);
+  TEST_ASSERT_EQUAL_STRING("living", loaded.phaseGroup.c_str());
+  TEST_ASSERT_EQUAL_STRING("home/bedroom/lamp", loaded.mqttBase.c_str());
+  TEST_ASSERT_EQUAL_UINT32(2, loaded.version);
+}
+
+void test_unchanged_config_is_not_written() {
+  DeviceConfig config = customConfig();
+  TEST_ASSERT_TRUE(config.save());
+  TEST_ASSERT_FALSE(config.save());
+  TEST_ASSERT_EQUAL_UINT32(2, config.version);
+
+  DeviceConfig loaded;
+  loaded.load();
+  TEST_ASSERT_FALSE(loaded.save());
+
+  loaded.defaultBrightness = 60;
+  TEST_ASSERT_TRUE(loaded.save());
+  TEST_ASSERT_EQUAL_UINT32(3, loaded.version);
+
+  // Reset writes the defaults unless they are already stored
+  loaded.reset();
+  DeviceConfig defaults;
+  defaults.load();
+  TEST_ASSERT_EQUAL_UINT8(70, defaults.defaultBrightness);
+  TEST_ASSERT_FALSE(defaults.save());
+}
+
+void test_damaged_blob_falls_back_to_defaults() {
+  DeviceConfig config = customConfig();
+  config.save();
+
+  uint8_t blob[DeviceConfig::BLOB_MAX];
+  Preferences prefs;
+  prefs.begin(NAMESPACE, false);
+  size_t length = prefs.getBytes("cfg", blob, sizeof(blob));
+  blob[9] ^= 0x01;
+  prefs.putBytes("cfg", blob, length);
+  prefs.end();
+
+  DeviceConfig loaded;
+  loaded.load();
+  TEST_ASSERT_EQUAL_UINT8(70, loaded.defaultBrightness);
+  TEST_ASSERT_EQUAL_STRING("fire", loaded.favoriteAnimation.c_str());
+
+  // Truncated and foreign blobs too
+  DeviceConfig check;
+  blob[9] ^= 0x01;
+  TEST_ASSERT_TRUE(check.decode(blob, length));
+  TEST_ASSERT_FALSE(check.decode(blob, length - 1));
+  blob[2] = DeviceConfig::SCHEMA_VERSION + 1;
+  TEST_ASSERT_FALSE(check.decode(blob, length));
+}
+
+void test_crc_is_the_standard_one() {
+  // The firmware takes it from ROM; stored blobs must check out either way
+  const char check[] = "123456789";
+  TEST_ASSERT_EQUAL_UINT32(0xCBF43926UL, Bytes::crc32((const uint8_t*)check, 9));
+  TEST_ASSERT_EQUAL_UINT32(0, Bytes::crc32(nullptr, 0));
+
+  uint8_t field[4];
+  Bytes::writeU32(field, 0x01020304UL);
+  TEST_ASSERT_EQUAL_UINT8(0x01, field[0]);
+  TEST_ASSERT_EQUAL_UINT32(0x01020304UL, Bytes::readU32(field));
+}
+
+void test_key_per_field_layout_is_migrated() {
+  // As saved by earlier firmware
+  Preferences prefs;
+  prefs.begin(NAMESPACE, false);
+  prefs.putUChar("def_bri", 40);
+  prefs.putUChar("def_r", 200);
+  prefs.putUShort("sun_min", 20);
+  uint16_t curve[2] = { 0, 1000 };
+  prefs.putBytes("gamma_crv", curve, sizeof(curve));
+  prefs.putString("fav_anim", "breathe");
+  prefs.putUChar("fav_p1", 6);
+  prefs.putString("phase_grp", "hall");
+  prefs.putUInt("cfg_ver", 7);
+  prefs.putUInt("other", 99);   // Not ours
+  prefs.end();
+
+  DeviceConfig config;
+  config.load();
+  TEST_ASSERT_EQUAL_UINT8(40, config.defaultBrightness);
+  TEST_ASSERT_EQUAL_UINT8(200, config.defaultColorR);
+  TEST_ASSERT_EQUAL_UINT16(20, config.sunriseMinutes);
+  TEST_ASSERT_EQUAL_UINT8(2, config.gammaCurveLen);
+  TEST_ASSERT_EQUAL_STRING("breathe", config.favoriteAnimation.c_str());
+  TEST_ASSERT_EQUAL_STRING("hall", config.phaseGroup.c_str());
+  TEST_ASSERT_EQUAL_UINT32(7, config.version);
+
+  // Only the blob is left, and it already holds the migrated values
+  prefs.begin(NAMESPACE, true);
+  TEST_ASSERT_TRUE(prefs.isKey("cfg"));
+  TEST_ASSERT_FALSE(prefs.isKey("def_bri"));
+  TEST_ASSERT_FALSE(prefs.isKey("fav_anim"));
+  TEST_ASSERT_FALSE(prefs.isKey("cfg_ver"));
+  TEST_ASSERT_EQUAL_UINT32(99, prefs.getUInt("other", 0));
+  prefs.end();
+  TEST_ASSERT_FALSE(config.save());
+
+  DeviceConfig again;
+  again.load();
+  TEST_ASSERT_EQUAL_STRING("breathe", again.favoriteAnimation.c_str());
+  TEST_ASSERT_EQUAL_UINT32(7, again.version);
+
+  // Power lost after the blob was written but before the old keys went:
+  // the blob wins and the leftovers are removed on the next boot
+  prefs.begin(NAMESPACE, false);
+  prefs.putUChar("def_bri", 10);
+  prefs.putUInt("cfg_ver", 3);
+  prefs.end();
+  DeviceConfig resumed;
+  resumed.load();
+  TEST_ASSERT_EQUAL_UINT8(40, resumed.defaultBrightness);
+  prefs.begin(NAMESPACE, true);
+  TEST_ASSERT_FALSE(prefs.isKey("def_bri"));
+  TEST_ASSERT_FALSE(prefs.isKey("cfg_ver"));
+  TEST_ASSERT_TRUE(prefs.isKey("cfg"));
+  prefs.end();
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_config_round_trip_in_one_key);
+  RUN_TEST(test_unchanged_config_is_not_written);
+  RUN_TEST(test_damaged_blob_falls_back_to_defaults);
+  RUN_TEST(test_crc_is_the_standard_one);
+  RUN_TEST(test_key_per_field_layout_is_migrated);
+  return UNITY_END();
+}
@@ -0,0 +1,152 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "anim/AnimationEngine.h"
+#include "anim/FixedTrig.h"
+#include "hw/Clock.h"
+#include "state/DeviceConfig.h"
+#include "state/DeviceState.h"
+
+// The fixed-point animations must match the original float formulas
+// within one brightness/color step.
+
+static DeviceState* state;
+static DeviceConfig* config;
+static VirtualClock* vclock;
+static AnimationEngine* engine;
+
+void setUp() {
+  state = new DeviceState();
+  config = new DeviceConfig();
+  vclock = new VirtualClock(1);
+  engine = new AnimationEngine();
+  engine->begin(state, config, vclock);
+}
+
+void tearDown() {
+  delete engine;
+  delete vclock;
+  delete config;
+  delete state;
+}
+
+static double clampd(double v, double lo, double hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+void test_sine_table_accuracy() {
+  int maxErr = 0;
+  for (uint32_t a = 0; a < 65536; a++) {
+    int expected = (int)lround(sin(2.0 * PI * a / 65536.0) * 32767.0);
+    int err = abs(FixedTrig::sinQ15((uint16_t)a) - expected);
+    if (err > maxErr) maxErr = err;
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(4, maxErr);
+  TEST_ASSERT_EQUAL_INT(32767, FixedTrig::cosQ15(0));
+}
+
+void test_fire_matches_float() {
+  const uint8_t intensity = 80, speed = 7;
+  engine->startFire(intensity, speed);
+
+  for (int k = 1; k <= 5000; k++) {
+    vclock->advance(33);
+    engine->loop();
+
+    double x = 0.01 * speed * k;
+    double n = clampd(sin(x) * 0.5 + sin(x * 2.3) * 0.3 + sin(x * 4.7) * 0.2, -1.0, 1.0);
+    uint8_t g = (uint8_t)(80 + (n + 1.0) / 2.0 * 100);
+    double bf = clampd(0.5 + n * 0.5 * intensity / 100.0, 0.3, 1.0);
+    uint8_t bri = (uint8_t)(70 * bf);
+
+    TEST_ASSERT_UINT8_WITHIN(1, g, state->colorG);
+    TEST_ASSERT_UINT8_WITHIN(1, bri, state->brightness);
+  }
+}
+
+void test_ocean_matches_float() {
+  const uint8_t speed = 5, maxBri = 90;
+  engine->startOcean(speed, maxBri);
+
+  double p = 0;
+  const double step = 0.005 * speed;
+  for (int k = 1; k <= 5000; k++) {
+    vclock->advance(33);
+    engine->loop();
+
+    p += step;
+    if (p > 2 * PI) p -= 2 * PI;
+    // The 1.3x/0.7x harmonics jump at the wrap; skip frames right at it
+    if (p < 2 * step || p > 2 * PI - 2 * step) continue;
+
+    double w = (sin(p) * 0.5 + sin(p * 1.3 + 1.0) * 0.3 + sin(p * 0.7 + 2.0) * 0.2 + 1.0) / 2.0;
+    uint8_t g, b;
+    if (w < 0.5) {
+      g = 100 + (uint8_t)(w * 2 * 80);
+      b = 180 + (uint8_t)(w * 2 * 40);
+    } else {
+      g = 180 + (uint8_t)((w - 0.5) * 2 * 20);
+      b = 220 - (uint8_t)((w - 0.5) * 2 * 40);
+    }
+    uint8_t bri = (uint8_t)(maxBri * (0.7 + sin(p * 0.5) * 0.3));
+
+    TEST_ASSERT_UINT8_WITHIN(1, g, state->colorG);
+    TEST_ASSERT_UINT8_WITHIN(1, b, state->colorB);
+    TEST_ASSERT_UINT8_WITHIN(1, bri, state->brightness);
+  }
+}
+
+void test_breathe_matches_float() {
+  const uint8_t maxBri = 90, minBri = 5, cycle = 3;
+  unsigned long start = vclock->millis();
+  engine->startBreathe(cycle, maxBri, minBri, 10, 20, 30);
+
+  for (int k = 1; k <= 2000; k++) {
+    vclock->advance(33);
+    engine->loop();
+
+    double pos = (double)((vclock->millis() - start) % (cycle * 1000UL)) / (cycle * 1000.0);
+    double f = (sin(pos * 2 * PI - PI / 2) + 1) / 2;
+    uint8_t bri = minBri + (uint8_t)(f * (maxBri - minBri));
+
+    TEST_ASSERT_UINT8_WITHIN(1, bri, state->brightness);
+    TEST_ASSERT_EQUAL_UINT8(20, state->colorG);
+  }
+}
+
+void test_rainbow_matches_float() {
+  state->brightness = 100;
+  config->defaultBrightness = 63;
+  unsigned long start = vclock->millis();
+  engine->startRainbow();
+
+  for (int k = 1; k <= 1000; k++) {
+    vclock->advance(16);
+    engine->loop();
+
+    double h = (double)((vclock->millis() - start) % 10000) / 10000.0 * 360.0;
+    double v = state->brightness / 100.0;
+    double x = v * (1 - fabs(fmod(h / 60.0, 2.0) - 1));
+    double rp, gp, bp;
+    if (h < 60)       { rp = v; gp = x; bp = 0; }
+    else if (h < 120) { rp = x; gp = v; bp = 0; }
+    else if (h < 180) { rp = 0; gp = v; bp = x; }
+    else if (h < 240) { rp = 0; gp = x; bp = v; }
+    else if (h < 300) { rp = x; gp = 0; bp = v; }
+    else              { rp = v; gp = 0; bp = x; }
+
+    TEST_ASSERT_UINT8_WITHIN(1, (uint8_t)lround(rp * 255), state->colorR);
+    TEST_ASSERT_UINT8_WITHIN(1, (uint8_t)lround(gp * 255), state->colorG);
+    TEST_ASSERT_UINT8_WITHIN(1, (uint8_t)lround(bp * 255), state->colorB);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sine_table_accuracy);
+  RUN_TEST(test_fire_matches_float);
+  RUN_TEST(test_ocean_matches_float);
+  RUN_TEST(test_breathe_matches_float);
+  RUN_TEST(test_rainbow_matches_float);
+  return UNITY_END();
+}
@@ -0,0 +1,220 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "hw/Clock.h"
+#include "hw/FlashRegion.h"
+#include "state/StateJournal.h"
+
+// State journal: coalescing, sector rotation and recovery after power loss.
+
+static VirtualClock* vclock;
+
+void setUp() {
+  vclock = new VirtualClock(1);
+}
+
+void tearDown() {
+  delete vclock;
+}
+
+static StateJournal::Entry staticLight(uint8_t brightness) {
+  StateJournal::Entry entry = {};
+  entry.powerOn = true;
+  entry.brightness = brightness;
+  entry.colorR = 255;
+  entry.colorG = 180;
+  entry.colorB = 100;
+  return entry;
+}
+
+static StateJournal::Entry sunset(uint32_t elapsedMs) {
+  StateJournal::Entry entry = staticLight(40);
+  entry.animating = true;
+  entry.animation = 1;
+  entry.params[0] = 30;
+  entry.originBrightness = 80;
+  entry.originR = 255;
+  entry.originG = 147;
+  entry.originB = 41;
+  entry.elapsedMs = elapsedMs;
+  return entry;
+}
+
+// Offer the same entry every 100 ms, like the render loop
+static void hold(StateJournal& journal, const StateJournal::Entry& entry, unsigned long ms) {
+  for (unsigned long t = 0; t < ms; t += 100) {
+    journal.record(entry);
+    vclock->advance(100);
+  }
+}
+
+// Let a running animation record its progress `records` times
+static void runAnimation(StateJournal& journal, uint32_t records) {
+  hold(journal, sunset(0), StateJournal::SETTLE_MS + 100);
+  for (uint32_t i = 1; i < records; i++) {
+    vclock->advance(StateJournal::PROGRESS_INTERVAL_MS);
+    journal.record(sunset(i * StateJournal::PROGRESS_INTERVAL_MS));
+  }
+}
+
+void test_state_survives_a_restart() {
+  MemoryFlash flash(4);
+  StateJournal before;
+  before.setClock(vclock);
+  TEST_ASSERT_TRUE(before.begin(&flash));
+  StateJournal::Entry nothing;
+  TEST_ASSERT_FALSE(before.restore(nothing));
+  TEST_ASSERT_EQUAL_UINT32(0, flash.eraseCount(0));   // Boot does not write
+
+  hold(before, staticLight(60), 3000);
+  TEST_ASSERT_EQUAL_UINT32(1, before.writes());
+
+  StateJournal after;
+  after.setClock(vclock);
+  TEST_ASSERT_TRUE(after.begin(&flash));
+  StateJournal::Entry restored;
+  TEST_ASSERT_TRUE(after.restore(restored));
+  TEST_ASSERT_TRUE(restored.powerOn);
+  TEST_ASSERT_FALSE(restored.animating);
+  TEST_ASSERT_EQUAL_UINT8(60, restored.brightness);
+  TEST_ASSERT_EQUAL_UINT8(180, restored.colorG);
+
+  // Unchanged state is not written again
+  hold(after, staticLight(60), 60000);
+  TEST_ASSERT_EQUAL_UINT32(0, after.writes());
+
+  MemoryFlash tiny(1);
+  StateJournal cramped;
+  TEST_ASSERT_FALSE(cramped.begin(&tiny));
+}
+
+void test_writes_are_coalesced() {
+  MemoryFlash flash(4);
+  StateJournal journal;
+  journal.setClock(vclock);
+  journal.begin(&flash);
+
+  // A dragged slider: one write once it stops...
+  for (uint8_t b = 10; b < 20; b++) hold(journal, staticLight(b), 500);
+  TEST_ASSERT_EQUAL_UINT32(0, journal.writes());
+  hold(journal, staticLight(20), StateJournal::SETTLE_MS + 100);
+  TEST_ASSERT_EQUAL_UINT32(1, journal.writes());
+
+  // ...and one every MAX_DELAY_MS while it keeps moving
+  for (uint8_t b = 30; b < 75; b++) hold(journal, staticLight(b), 500);
+  TEST_ASSERT_EQUAL_UINT32(3, journal.writes());
+
+  // A running animation records its progress, paused it does not
+  hold(journal, staticLight(70), 3000);
+  uint32_t settled = journal.writes();
+  for (uint32_t t = 0; t < 60000; t += 100) {
+    journal.record(sunset(t));
+    vclock->advance(100);
+  }
+  TEST_ASSERT_UINT32_WITHIN(1, settled + 60000 / StateJournal::PROGRESS_INTERVAL_MS,
+                            journal.writes());
+
+  StateJournal::Entry paused = sunset(60000);
+  paused.paused = true;
+  hold(journal, paused, 3000);
+  uint32_t atPause = journal.writes();
+  hold(journal, paused, 60000);
+  TEST_ASSERT_EQUAL_UINT32(atPause, journal.writes());
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, journal.msUntilWrite());
+}
+
+void test_sectors_rotate_evenly() {
+  MemoryFlash flash(4);
+  StateJournal journal;
+  journal.setClock(vclock);
+  journal.begin(&flash);
+
+  // Ten sectors' worth of records
+  const uint32_t count = 10 * (StateJournal::SLOTS_PER_SECTOR - 1);
+  runAnimation(journal, count);
+  TEST_ASSERT_EQUAL_UINT32(count, journal.writes());
+  TEST_ASSERT_EQUAL_UINT32(10, journal.erases());
+  for (size_t s = 0; s < 4; s++) {
+    TEST_ASSERT_UINT32_WITHIN(1, 10 / 4, flash.eraseCount(s));
+  }
+
+  StateJournal after;
+  after.setClock(vclock);
+  after.begin(&flash);
+  StateJournal::Entry restored;
+  TEST_ASSERT_TRUE(after.restore(restored));
+  TEST_ASSERT_EQUAL_UINT32((count - 1) * StateJournal::PROGRESS_INTERVAL_MS, restored.elapsedMs);
+}
+
+void test_torn_write_keeps_previous_record() {
+  MemoryFlash flash(4);
+  StateJournal journal;
+  journal.setClock(vclock);
+  journal.begin(&flash);
+  hold(journal, staticLight(30), 3000);
+  hold(journal, staticLight(90), 3000);
+  TEST_ASSERT_EQUAL_UINT32(2, journal.writes());
+
+  // Power lost halfway through programming the second record
+  uint8_t* second = flash.data() + 2 * StateJournal::RECORD_SIZE;
+  memset(second + 16, 0xFF, 16);
+
+  StateJournal after;
+  after.setClock(vclock);
+  after.begin(&flash);
+  StateJournal::Entry restored;
+  TEST_ASSERT_TRUE(after.restore(restored));
+  TEST_ASSERT_EQUAL_UINT8(30, restored.brightness);
+
+  // Appending continues after the torn slot
+  hold(after, staticLight(50), 3000);
+  StateJournal again;
+  again.setClock(vclock);
+  again.begin(&flash);
+  TEST_ASSERT_TRUE(again.restore(restored));
+  TEST_ASSERT_EQUAL_UINT8(50, restored.brightness);
+}
+
+void test_power_loss_during_rotation() {
+  MemoryFlash flash(2);
+  StateJournal journal;
+  journal.setClock(vclock);
+  journal.begin(&flash);
+  const uint32_t count = StateJournal::SLOTS_PER_SECTOR - 1;
+  runAnimation(journal, count);
+  TEST_ASSERT_EQUAL_UINT32(1, journal.erases());   // First sector full
+
+  // Rotation erased the next sector and wrote its header, then the power
+  // went before the first record
+  vclock->advance(StateJournal::PROGRESS_INTERVAL_MS);
+  journal.record(sunset(count * StateJournal::PROGRESS_INTERVAL_MS));
+  TEST_ASSERT_EQUAL_UINT32(2, journal.erases());
+  memset(flash.data() + FlashRegion::SECTOR_SIZE + StateJournal::RECORD_SIZE, 0xFF,
+         FlashRegion::SECTOR_SIZE - StateJournal::RECORD_SIZE);
+
+  StateJournal after;
+  after.setClock(vclock);
+  after.begin(&flash);
+  StateJournal::Entry restored;
+  TEST_ASSERT_TRUE(after.restore(restored));
+  TEST_ASSERT_TRUE(restored.animating);
+  TEST_ASSERT_EQUAL_UINT32((count - 1) * StateJournal::PROGRESS_INTERVAL_MS, restored.elapsedMs);
+
+  // And an erase cut short leaves a sector without a valid header
+  memset(flash.data() + FlashRegion::SECTOR_SIZE, 0x00, 8);
+  StateJournal salvaged;
+  salvaged.setClock(vclock);
+  salvaged.begin(&flash);
+  TEST_ASSERT_TRUE(salvaged.restore(restored));
+  TEST_ASSERT_EQUAL_UINT8(1, restored.animation);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_state_survives_a_restart);
+  RUN_TEST(test_writes_are_coalesced);
+  RUN_TEST(test_sectors_rotate_evenly);
+  RUN_TEST(test_torn_write_keeps_previous_record);
+  RUN_TEST(test_power_loss_during_rotation);
+  return UNITY_END();
+}
@@ -0,0 +1,190 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <math.h>
+
+#include "driver/ledc.h"
+#include "hw/Clock.h"
+#include "hw/LampHardware.h"
+
+// The precomputed duty table must reproduce the original per-frame
+// pow()-based mapping within one duty step.
+
+static LampHardware* lamp;
+static VirtualClock* vclock;
+
+void setUp() {
+  ledcShimReset();
+  vclock = new VirtualClock(1);
+  lamp = new LampHardware();
+  lamp->setClock(vclock);
+  lamp->begin();
+}
+
+void tearDown() {
+  delete lamp;
+  delete vclock;
+}
+
+static uint32_t referenceDuty(uint8_t color, uint8_t brightness,
+                              uint8_t minPwm, uint8_t maxPwm, float gamma) {
+  if (brightness == 0) return 0;
+  float phys = minPwm / 100.0f + brightness / 100.0f * (maxPwm - minPwm) / 100.0f;
+  return (uint32_t)round(color * pow(phys, gamma));
+}
+
+static void checkAgainstReference(uint8_t minPwm, uint8_t maxPwm, float gamma) {
+  const uint8_t colors[] = { 0, 1, 37, 128, 200, 254, 255 };
+  for (uint8_t bri = 0; bri <= 100; bri++) {
+    for (size_t i = 0; i < sizeof(colors); i++) {
+      uint8_t c = colors[i];
+      lamp->apply(true, bri, c, 255 - c, c / 2, minPwm, maxPwm);
+      TEST_ASSERT_UINT32_WITHIN(1, referenceDuty(c, bri, minPwm, maxPwm, gamma), ledcRead(0));
+      TEST_ASSERT_UINT32_WITHIN(1, referenceDuty(255 - c, bri, minPwm, maxPwm, gamma), ledcRead(1));
+      TEST_ASSERT_UINT32_WITHIN(1, referenceDuty(c / 2, bri, minPwm, maxPwm, gamma), ledcRead(2));
+    }
+  }
+}
+
+void test_factory_table_matches_builder() {
+  uint16_t built[101];
+  LampHardware::buildScaleTable(built, 20, 100, LampHardware::DEFAULT_GAMMA_X100, nullptr, 0);
+
+  // Drive the factory path and compare a full-scale channel against the builder
+  for (uint8_t bri = 0; bri <= 100; bri++) {
+    lamp->apply(true, bri, 255, 255, 255, 20, 100);
+    TEST_ASSERT_EQUAL_UINT32((255UL * built[bri] + 16384) >> 15, ledcRead(0));
+  }
+}
+
+void test_factory_calibration_matches_float() {
+  checkAgainstReference(20, 100, 2.2f);
+}
+
+void test_other_calibrations_match_float() {
+  checkAgainstReference(0, 100, 2.2f);
+  checkAgainstReference(5, 60, 2.2f);
+  checkAgainstReference(35, 90, 2.2f);
+}
+
+void test_custom_gamma() {
+  lamp->setGamma(180);
+  checkAgainstReference(20, 100, 1.8f);
+  lamp->setGamma(LampHardware::DEFAULT_GAMMA_X100);
+  checkAgainstReference(20, 100, 2.2f);
+}
+
+void test_custom_curve() {
+  // Linear curve: output equals the physical PWM fraction
+  const uint16_t linear[] = { 0, 1000 };
+  lamp->setCurve(linear, 2);
+  checkAgainstReference(10, 100, 1.0f);
+
+  // Clearing the curve returns to the gamma exponent
+  lamp->setCurve(nullptr, 0);
+  checkAgainstReference(10, 100, 2.2f);
+}
+
+void test_power_off_writes_zero() {
+  lamp->apply(true, 100, 255, 255, 255, 20, 100);
+  TEST_ASSERT_EQUAL_UINT32(255, ledcRead(0));
+  lamp->apply(false, 100, 255, 255, 255, 20, 100);
+  TEST_ASSERT_EQUAL_UINT32(0, ledcRead(0));
+  TEST_ASSERT_EQUAL_UINT32(0, ledcRead(1));
+  TEST_ASSERT_EQUAL_UINT32(0, ledcRead(2));
+}
+
+void test_fast_fade_uses_hardware_segments() {
+  lamp->apply(true, 0, 255, 255, 255, 20, 100);
+  lamp->fadeTo(true, 100, 255, 255, 255, 20, 100, 3000);
+  TEST_ASSERT_TRUE(lamp->isFading());
+  TEST_ASSERT_EQUAL_UINT32(1, ledcShimFadeCount(0));
+  TEST_ASSERT_EQUAL_UINT32(1000, ledcShimFadeTime(0));
+
+  // Firmware only wakes at segment boundaries
+  for (int t = 0; t < 3000; t += 10) {
+    vclock->advance(10);
+    lamp->update();
+  }
+  TEST_ASSERT_FALSE(lamp->isFading());
+  TEST_ASSERT_EQUAL_UINT32(3, ledcShimFadeCount(0));
+  TEST_ASSERT_EQUAL_UINT32(255, ledcRead(0));
+}
+
+void test_slow_fade_is_stepped() {
+  // 10 duty steps over 60 s is too slow for the fade unit
+  lamp->apply(true, 100, 10, 0, 0, 0, 100);
+  lamp->fadeTo(true, 100, 20, 0, 0, 0, 100, 60000);
+
+  uint32_t writes = 0, last = ledcRead(0);
+  for (int t = 0; t < 60000; t += 100) {
+    vclock->advance(100);
+    lamp->update();
+    if (ledcRead(0) != last) {
+      TEST_ASSERT_EQUAL_UINT32(last + 1, ledcRead(0));
+      last = ledcRead(0);
+      writes++;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, ledcShimFadeCount(0));
+  TEST_ASSERT_EQUAL_UINT32(10, writes);
+  TEST_ASSERT_FALSE(lamp->isFading());
+}
+
+void test_apply_waits_for_running_segment() {
+  lamp->apply(true, 0, 255, 255, 255, 20, 100);
+  lamp->fadeTo(true, 100, 255, 255, 255, 20, 100, 5000);
+  vclock->advance(400);
+  lamp->update();
+
+  // Host has no ledc_fade_stop(): the write lands when the segment ends
+  lamp->apply(true, 50, 0, 0, 0, 20, 100);
+  TEST_ASSERT_TRUE(lamp->isFading());
+  vclock->advance(600);
+  lamp->update();
+  TEST_ASSERT_FALSE(lamp->isFading());
+  TEST_ASSERT_EQUAL_UINT32(0, ledcRead(0));
+
+  vclock->advance(5000);
+  lamp->update();
+  TEST_ASSERT_EQUAL_UINT32(0, ledcRead(0));
+}
+
+void test_fade_reports_deadlines() {
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, lamp->msUntilUpdate());
+  TEST_ASSERT_FALSE(lamp->isLit());
+
+  // Waking only at reported deadlines completes both fade kinds
+  lamp->apply(true, 0, 255, 10, 255, 0, 100);
+  lamp->fadeTo(true, 100, 255, 20, 255, 0, 100, 3000);
+  TEST_ASSERT_TRUE(lamp->isLit());
+
+  int wakeups = 0;
+  while (lamp->msUntilUpdate() != Clock::NO_DEADLINE && wakeups < 100) {
+    vclock->advance(lamp->msUntilUpdate());
+    lamp->update();
+    wakeups++;
+  }
+  TEST_ASSERT_FALSE(lamp->isFading());
+  TEST_ASSERT_EQUAL_UINT32(255, ledcRead(0));
+  TEST_ASSERT_EQUAL_UINT32(20, ledcRead(1));
+  // Three hardware segments plus ten single steps on the slow channel
+  TEST_ASSERT_LESS_OR_EQUAL(13, wakeups);
+
+  lamp->apply(false, 100, 255, 255, 255, 0, 100);
+  TEST_ASSERT_FALSE(lamp->isLit());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_factory_table_matches_builder);
+  RUN_TEST(test_factory_calibration_matches_float);
+  RUN_TEST(test_other_calibrations_match_float);
+  RUN_TEST(test_custom_gamma);
+  RUN_TEST(test_custom_curve);
+  RUN_TEST(test_power_off_writes_zero);
+  RUN_TEST(test_fast_fade_uses_hardware_segments);
+  RUN_TEST(test_slow_fade_is_stepped);
+  RUN_TEST(test_apply_waits_for_running_segment);
+  RUN_TEST(test_fade_reports_deadlines);
+  return UNITY_END();
+}
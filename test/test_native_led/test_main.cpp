@@ -0,0 +1,91 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "hw/StatusLED.h"
+
+// Patterns are played by a timer; here each onTimer() call stands in for
+// one timer expiry. GPIO 8 is active low.
+
+static const uint8_t PIN_LED = 8;
+static StatusLED* led;
+
+void setUp() {
+  led = new StatusLED();
+  led->begin();
+}
+
+void tearDown() {
+  delete led;
+}
+
+static bool ledOn() {
+  return digitalRead(PIN_LED) == LOW;
+}
+
+// Step through everything queued, recording the LED level after each step
+static int runPatterns(bool* levels, int maxSteps) {
+  int steps = 0;
+  while (led->isBusy() && steps < maxSteps) {
+    levels[steps++] = ledOn();
+    led->onTimer();
+  }
+  return steps;
+}
+
+void test_blink_returns_with_led_on() {
+  led->blink(2, 50);
+  TEST_ASSERT_TRUE(led->isBusy());
+  TEST_ASSERT_TRUE(ledOn());
+
+  bool levels[16];
+  int steps = runPatterns(levels, 16);
+  TEST_ASSERT_EQUAL_INT(3, steps);  // on, off, on
+  TEST_ASSERT_TRUE(levels[0]);
+  TEST_ASSERT_FALSE(levels[1]);
+  TEST_ASSERT_TRUE(levels[2]);
+  TEST_ASSERT_FALSE(ledOn());
+  TEST_ASSERT_FALSE(led->isBusy());
+}
+
+void test_patterns_play_in_order_with_gap() {
+  led->blink(1, 30);
+  led->mqttFailed();
+
+  bool levels[32];
+  int steps = runPatterns(levels, 32);
+  // blink (1) + gap (1) + failed pattern (7)
+  TEST_ASSERT_EQUAL_INT(9, steps);
+  TEST_ASSERT_TRUE(levels[0]);
+  TEST_ASSERT_FALSE(levels[1]);
+  TEST_ASSERT_TRUE(levels[2]);
+  TEST_ASSERT_FALSE(ledOn());
+}
+
+void test_command_burst_is_coalesced() {
+  for (int i = 0; i < 50; i++) {
+    led->blink(1, 30);
+  }
+  bool levels[256];
+  int steps = runPatterns(levels, 256);
+  // The playing blink plus one queued copy
+  TEST_ASSERT_EQUAL_INT(3, steps);
+}
+
+void test_full_queue_drops_new_patterns() {
+  for (uint8_t i = 1; i <= 8; i++) {
+    led->blink(i, 10);
+  }
+  bool levels[256];
+  int steps = runPatterns(levels, 256);
+  // Playing (1 blink) + three queued (2, 3, 4 blinks) with gaps
+  TEST_ASSERT_EQUAL_INT(1 + 1 + 3 + 1 + 5 + 1 + 7, steps);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_blink_returns_with_led_on);
+  RUN_TEST(test_patterns_play_in_order_with_gap);
+  RUN_TEST(test_command_burst_is_coalesced);
+  RUN_TEST(test_full_queue_drops_new_patterns);
+  return UNITY_END();
+}
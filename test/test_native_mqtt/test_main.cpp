@@ -0,0 +1,454 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <thread>
+
+#include "anim/AnimationRegistry.h"
+#include "hw/Clock.h"
+#include "net/CommandQueue.h"
+#include "net/JsonReader.h"
+#include "net/MessageView.h"
+#include "net/PublishQueue.h"
+#include "net/SpscQueue.h"
+#include "net/TopicRouter.h"
+#include "net/TopicTable.h"
+
+// Incoming MQTT payloads are views into a buffer that is not
+// NUL-terminated; nothing here may read past the view.
+
+static int powerCalls;
+static int colorCalls;
+static char lastPayload[32];
+
+static void onPower(const MessageView& msg) {
+  powerCalls++;
+  msg.copyTo(lastPayload, sizeof(lastPayload));
+}
+
+static void onColor(const MessageView& msg) {
+  colorCalls++;
+}
+
+void setUp() {
+  powerCalls = 0;
+  colorCalls = 0;
+  lastPayload[0] = '\0';
+}
+
+void tearDown() {}
+
+void test_view_helpers_stay_in_bounds() {
+  // Digits right after the view must not be picked up
+  const char buffer[] = "42,7:transition_ms=1500999";
+  MessageView msg(buffer, 23);
+
+  TEST_ASSERT_EQUAL_INT32(42, msg.toInt());
+  TEST_ASSERT_EQUAL_INT(2, msg.indexOf(','));
+  TEST_ASSERT_EQUAL_INT(5, msg.indexOf("transition_ms="));
+  TEST_ASSERT_EQUAL_INT32(1500, msg.substring(19).toInt());
+  TEST_ASSERT_EQUAL_INT32(7, msg.substring(3, 4).toInt());
+  TEST_ASSERT_EQUAL_INT(-1, msg.indexOf("999"));
+}
+
+void test_view_comparisons() {
+  MessageView msg("  Toggle\r\n");
+  MessageView trimmed = msg.trim();
+  TEST_ASSERT_EQUAL_UINT32(6, trimmed.length());
+  TEST_ASSERT_TRUE(trimmed.equalsIgnoreCase("toggle"));
+  TEST_ASSERT_FALSE(trimmed.equals("toggle"));
+  TEST_ASSERT_FALSE(trimmed.equalsIgnoreCase("toggles"));
+  TEST_ASSERT_EQUAL_INT32(-12, MessageView("-12abc").toInt());
+  TEST_ASSERT_EQUAL_FLOAT(2.2f, MessageView("2.2").toFloat());
+}
+
+void test_router_dispatches_by_suffix() {
+  TopicRouter router("ikea_head_lamp");
+  TEST_ASSERT_TRUE(router.add("cmnd/power", onPower));
+  TEST_ASSERT_TRUE(router.add("cmnd/color", onColor));
+  TEST_ASSERT_FALSE(router.add("cmnd/power", onColor));
+  TEST_ASSERT_EQUAL_UINT8(2, router.size());
+
+  const char* topic = "ikea_head_lamp/cmnd/power";
+  TEST_ASSERT_TRUE(router.dispatch(topic, strlen(topic), MessageView("on")));
+  TEST_ASSERT_EQUAL_INT(1, powerCalls);
+  TEST_ASSERT_EQUAL_STRING("on", lastPayload);
+
+  // Other devices, prefixes and unknown suffixes are ignored
+  const char* misses[] = {
+    "other_lamp/cmnd/power", "ikea_head_lampx/cmnd/power", "ikea_head_lamp/cmnd/powe",
+    "ikea_head_lamp/cmnd/power/x", "ikea_head_lamp", "ikea_head_lamp/"
+  };
+  for (size_t i = 0; i < sizeof(misses) / sizeof(misses[0]); i++) {
+    TEST_ASSERT_FALSE(router.dispatch(misses[i], strlen(misses[i]), MessageView("on")));
+  }
+  TEST_ASSERT_EQUAL_INT(1, powerCalls);
+  TEST_ASSERT_EQUAL_INT(0, colorCalls);
+}
+
+void test_router_table_limit() {
+  static char suffixes[40][8];
+  TopicRouter router("base");
+  int added = 0;
+  for (int i = 0; i < 40; i++) {
+    snprintf(suffixes[i], sizeof(suffixes[i]), "t/%d", i);
+    if (router.add(suffixes[i], onColor)) added++;
+  }
+  TEST_ASSERT_EQUAL_INT(32, added);
+
+  // Every registered route is still found
+  char topic[16];
+  for (int i = 0; i < added; i++) {
+    snprintf(topic, sizeof(topic), "base/t/%d", i);
+    TEST_ASSERT_TRUE(router.dispatch(topic, strlen(topic), MessageView()));
+  }
+  TEST_ASSERT_EQUAL_INT(added, colorCalls);
+}
+
+void test_params_parsed_from_unterminated_view() {
+  const AnimationInfo* fire = AnimationRegistry::find("fire:intensity", 4);
+  TEST_ASSERT_NOT_NULL(fire);
+  TEST_ASSERT_NULL(AnimationRegistry::find("fir", 3));
+
+  // "speed=3" followed by more digits outside the view
+  const char buffer[] = "intensity=80,speed=3456";
+  AnimationParams params = AnimationRegistry::defaults(*fire);
+  AnimationRegistry::parseParams(buffer, 20, *fire, params);
+  TEST_ASSERT_EQUAL_UINT8(80, params.param1);
+  TEST_ASSERT_EQUAL_UINT8(3, params.param2);
+}
+
+void test_json_reader_walks_batch() {
+  // The view stops before the trailing garbage
+  const char buffer[] = "{ \"state\":\"ON\", \"color\":[255,147,41], \"x\":{\"a\":[1,{\"b\":null}]},"
+                        "\"brightness\":80.6, \"pause\":false }}}";
+  JsonReader json(buffer, sizeof(buffer) - 3);
+  MessageView key;
+  MessageView text;
+  MessageView raw;
+  long number = 0;
+  long rgb[3] = { 0, 0, 0 };
+  bool flag = true;
+  uint8_t n = 0;
+
+  TEST_ASSERT_TRUE(json.enterObject());
+  TEST_ASSERT_TRUE(json.nextKey(key));
+  TEST_ASSERT_TRUE(key.equals("state"));
+  TEST_ASSERT_TRUE(json.readString(text));
+  TEST_ASSERT_TRUE(text.equals("ON"));
+
+  TEST_ASSERT_TRUE(json.nextKey(key));
+  TEST_ASSERT_TRUE(json.enterArray());
+  while (json.nextElement()) json.readInt(rgb[n++]);
+  TEST_ASSERT_EQUAL_UINT8(3, n);
+  TEST_ASSERT_EQUAL_INT32(147, rgb[1]);
+
+  TEST_ASSERT_TRUE(json.nextKey(key));
+  TEST_ASSERT_TRUE(json.skipValue(&raw));
+  TEST_ASSERT_TRUE(raw.equals("{\"a\":[1,{\"b\":null}]}"));
+
+  TEST_ASSERT_TRUE(json.nextKey(key));
+  TEST_ASSERT_TRUE(json.readInt(number));
+  TEST_ASSERT_EQUAL_INT32(80, number);
+  TEST_ASSERT_TRUE(json.nextKey(key));
+  TEST_ASSERT_TRUE(json.readBool(flag));
+  TEST_ASSERT_FALSE(flag);
+
+  TEST_ASSERT_FALSE(json.nextKey(key));
+  TEST_ASSERT_TRUE(json.finish());
+}
+
+// Read every member of a flat or nested document, skipping values
+static bool walkJson(const char* text) {
+  JsonReader json(text, strlen(text));
+  MessageView key;
+  if (!json.enterObject()) return false;
+  while (json.nextKey(key)) json.skipValue();
+  return json.finish();
+}
+
+void test_json_reader_rejects_malformed() {
+  TEST_ASSERT_TRUE(walkJson("{}"));
+  TEST_ASSERT_TRUE(walkJson(" {\"a\":[],\"b\":{},\"c\":\"q\\\"}\"} "));
+  TEST_ASSERT_FALSE(walkJson("{\"a\":1 \"b\":2}"));     // Missing comma
+  TEST_ASSERT_FALSE(walkJson("{\"a\":1,}"));              // Trailing comma
+  TEST_ASSERT_FALSE(walkJson("{\"a\":[1,2,]}"));
+  TEST_ASSERT_FALSE(walkJson("{\"a\":[1,2}"));            // Unbalanced
+  TEST_ASSERT_FALSE(walkJson("{\"a\":1"));                // Truncated
+  TEST_ASSERT_FALSE(walkJson("{\"a\":tru}"));
+  TEST_ASSERT_FALSE(walkJson("{\"a\":1} x"));             // Trailing data
+  TEST_ASSERT_FALSE(walkJson("{\"a\":[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]}"));  // Too deep
+
+  // Wrong type for a read fails the whole document
+  JsonReader json("{\"a\":\"x\"}", 9);
+  MessageView key;
+  long v;
+  json.enterObject();
+  json.nextKey(key);
+  TEST_ASSERT_FALSE(json.readInt(v));
+  TEST_ASSERT_FALSE(json.nextKey(key));
+  TEST_ASSERT_FALSE(json.finish());
+}
+
+void test_publish_queue_coalesces_burst() {
+  VirtualClock vclock(1000);
+  PublishQueue queue;
+  queue.setClock(&vclock);
+  queue.setMinInterval(100);
+
+  uint8_t topic;
+  bool retain;
+  TEST_ASSERT_FALSE(queue.takeDue(topic, retain));
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, queue.msUntilDue());
+
+  // First request after a quiet period goes out at once
+  queue.request(0, false);
+  TEST_ASSERT_EQUAL_UINT32(0, queue.msUntilDue());
+  TEST_ASSERT_TRUE(queue.takeDue(topic, retain));
+  TEST_ASSERT_EQUAL_UINT8(0, topic);
+  TEST_ASSERT_FALSE(retain);
+
+  // A slider drag: 20 requests inside one interval collapse into one
+  for (int i = 0; i < 20; i++) {
+    vclock.advance(4);
+    queue.request(0, i == 3);
+    TEST_ASSERT_FALSE(queue.takeDue(topic, retain));
+  }
+  TEST_ASSERT_EQUAL_UINT32(19, queue.coalescedCount());
+  TEST_ASSERT_EQUAL_UINT32(20, queue.msUntilDue());
+
+  vclock.advance(20);
+  TEST_ASSERT_TRUE(queue.takeDue(topic, retain));
+  TEST_ASSERT_TRUE(retain);  // Any retained request makes the merge retained
+  TEST_ASSERT_FALSE(queue.isPending(0));
+  TEST_ASSERT_FALSE(queue.takeDue(topic, retain));
+}
+
+void test_publish_queue_topics_independent() {
+  VirtualClock vclock(0);
+  PublishQueue queue;
+  queue.setClock(&vclock);
+  queue.setMinInterval(100);
+
+  uint8_t topic;
+  bool retain;
+  queue.request(0, true);
+  TEST_ASSERT_TRUE(queue.takeDue(topic, retain));
+
+  // Topic 0 is throttled, topic 1 is not
+  queue.request(0, true);
+  queue.request(1, true);
+  TEST_ASSERT_TRUE(queue.takeDue(topic, retain));
+  TEST_ASSERT_EQUAL_UINT8(1, topic);
+  TEST_ASSERT_FALSE(queue.takeDue(topic, retain));
+
+  // A failed send is re-requested and stays pending
+  vclock.advance(100);
+  TEST_ASSERT_TRUE(queue.takeDue(topic, retain));
+  TEST_ASSERT_EQUAL_UINT8(0, topic);
+  queue.request(topic, retain);
+  TEST_ASSERT_TRUE(queue.isPending(0));
+}
+
+void test_router_resolves_route_ids() {
+  TopicRouter router("base");
+  router.add("cmnd/power", onPower);
+  router.add("cmnd/color", onColor, true);
+
+  int power = router.resolve("base/cmnd/power", 15);
+  int color = router.resolve("base/cmnd/color", 15);
+  TEST_ASSERT_TRUE(power >= 0 && color >= 0 && power != color);
+  TEST_ASSERT_EQUAL_INT(-1, router.resolve("base/cmnd/nope", 14));
+  TEST_ASSERT_FALSE(router.coalesces((uint8_t)power));
+  TEST_ASSERT_TRUE(router.coalesces((uint8_t)color));
+
+  TEST_ASSERT_TRUE(router.invoke((uint8_t)power, MessageView("on")));
+  TEST_ASSERT_EQUAL_STRING("on", lastPayload);
+}
+
+void test_topic_table_per_device() {
+  TopicTable topics;
+  TEST_ASSERT_TRUE(topics.build("ikea_head_lamp/a1b2c3"));
+  TEST_ASSERT_EQUAL_STRING("ikea_head_lamp/a1b2c3", topics.base());
+  TEST_ASSERT_EQUAL_STRING("ikea_head_lamp/a1b2c3/state/json", topics.get(TopicTable::STATE_JSON));
+  TEST_ASSERT_EQUAL_STRING("ikea_head_lamp/a1b2c3/config/state", topics.get(TopicTable::CONFIG_STATE));
+  TEST_ASSERT_EQUAL_STRING("ikea_head_lamp/a1b2c3/heartbeat", topics.get(TopicTable::HEARTBEAT));
+  TEST_ASSERT_EQUAL_STRING("ikea_head_lamp/a1b2c3/boot", topics.get(TopicTable::BOOT));
+  TEST_ASSERT_EQUAL(2, topics.subscriptionCount());
+  TEST_ASSERT_EQUAL_STRING("ikea_head_lamp/a1b2c3/cmnd/#", topics.subscriptions()[0]);
+  TEST_ASSERT_EQUAL_STRING("ikea_head_lamp/a1b2c3/config/#", topics.subscriptions()[1]);
+
+  // Invalid bases leave the table as it was
+  const char* invalid[] = { "", "/lamp", "lamp/", "a//b", "lamps/+", "lamps/#", "say\"hi\"",
+                            "0123456789012345678901234567890123456789x" };
+  for (const char* base : invalid) {
+    TEST_ASSERT_TRUE_MESSAGE(!topics.build(base), base);
+  }
+  TEST_ASSERT_EQUAL_STRING("ikea_head_lamp/a1b2c3", topics.base());
+  TEST_ASSERT_TRUE(topics.build("0123456789012345678901234567890123456789"));
+  TEST_ASSERT_EQUAL_STRING("0123456789012345678901234567890123456789/config/state",
+                           topics.get(TopicTable::CONFIG_STATE));
+
+  // Two lamps on one broker only see their own commands
+  TopicTable desk, shelf;
+  desk.build("home/desk");
+  shelf.build("home/desk2");
+  TopicRouter router("ikea_head_lamp");
+  router.setBase(desk.base());
+  router.add("cmnd/power", onPower);
+  TEST_ASSERT_TRUE(router.resolve("home/desk/cmnd/power", 20) >= 0);
+  TEST_ASSERT_EQUAL_INT(-1, router.resolve("home/desk2/cmnd/power", 21));
+  TEST_ASSERT_EQUAL_INT(-1, router.resolve("ikea_head_lamp/cmnd/power", 25));
+  router.setBase(shelf.base());
+  TEST_ASSERT_TRUE(router.resolve("home/desk2/cmnd/power", 21) >= 0);
+}
+
+void test_command_queue_coalesces_in_order() {
+  CommandQueue queue;
+  const uint8_t BRIGHTNESS = 3, POWER = 7;
+
+  // Payload buffer is overwritten after each push, like the MQTT client's
+  char buffer[8];
+  strcpy(buffer, "50");
+  queue.push(BRIGHTNESS, MessageView(buffer), true);
+  strcpy(buffer, "off");
+  queue.push(POWER, MessageView(buffer), false);
+  strcpy(buffer, "60");
+  queue.push(BRIGHTNESS, MessageView(buffer), true);
+  strcpy(buffer, "xx");
+
+  // "50" is skipped; "off" still runs before "60"
+  CommandQueue::Command cmd;
+  TEST_ASSERT_TRUE(queue.pop(cmd));
+  TEST_ASSERT_EQUAL_UINT8(POWER, cmd.route);
+  TEST_ASSERT_TRUE(cmd.payload.equals("off"));
+  TEST_ASSERT_TRUE(queue.pop(cmd));
+  TEST_ASSERT_EQUAL_UINT8(BRIGHTNESS, cmd.route);
+  TEST_ASSERT_TRUE(cmd.payload.equals("60"));
+  TEST_ASSERT_FALSE(queue.pop(cmd));
+  TEST_ASSERT_TRUE(queue.isEmpty());
+  TEST_ASSERT_EQUAL_UINT32(1, queue.coalescedCount());
+}
+
+void test_command_queue_keeps_timed_commands() {
+  CommandQueue queue;
+  const uint8_t BRIGHTNESS = 3;
+
+  // Timed commands are pushed without coalescing, as handleMqttMessage does
+  queue.push(BRIGHTNESS, MessageView("20"), true);
+  queue.push(BRIGHTNESS, MessageView("50:at=1700000000"), false);
+  queue.push(BRIGHTNESS, MessageView("10:at=1700003600"), false);
+  queue.push(BRIGHTNESS, MessageView("60"), true);
+
+  // Only "20" gives way, to "60"; neither timed one replaces it or is replaced
+  CommandQueue::Command cmd;
+  TEST_ASSERT_TRUE(queue.pop(cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("50:at=1700000000"));
+  TEST_ASSERT_TRUE(queue.pop(cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("10:at=1700003600"));
+  TEST_ASSERT_TRUE(queue.pop(cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("60"));
+  TEST_ASSERT_FALSE(queue.pop(cmd));
+  TEST_ASSERT_EQUAL_UINT32(1, queue.coalescedCount());
+
+  // A later timed command does not supersede an earlier plain one
+  queue.push(BRIGHTNESS, MessageView("30"), true);
+  queue.push(BRIGHTNESS, MessageView("80:at=1700007200"), false);
+  TEST_ASSERT_TRUE(queue.pop(cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("30"));
+  TEST_ASSERT_TRUE(queue.pop(cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("80:at=1700007200"));
+  TEST_ASSERT_EQUAL_UINT32(1, queue.coalescedCount());
+}
+
+void test_command_queue_backpressure() {
+  CommandQueue queue;
+  for (uint8_t i = 0; i < CommandQueue::QUEUE_SIZE - 1; i++) {
+    TEST_ASSERT_TRUE(queue.push(i, MessageView("x"), false));
+  }
+  TEST_ASSERT_TRUE(queue.isFull());
+  TEST_ASSERT_FALSE(queue.push(99, MessageView("x"), true));
+  TEST_ASSERT_EQUAL_UINT32(1, queue.droppedCount());
+
+  char big[CommandQueue::MAX_PAYLOAD + 2];
+  memset(big, 'a', sizeof(big) - 1);
+  big[sizeof(big) - 1] = '\0';
+  CommandQueue::Command cmd;
+  TEST_ASSERT_TRUE(queue.pop(cmd));
+  TEST_ASSERT_FALSE(queue.isFull());
+  TEST_ASSERT_FALSE(queue.push(1, MessageView(big), false));
+  TEST_ASSERT_EQUAL_UINT32(2, queue.droppedCount());
+}
+
+void test_command_queue_across_threads() {
+  // Producer thread stands in for the network task
+  static CommandQueue queue;
+  const int COUNT = 20000;
+  std::thread producer([]() {
+    char text[8];
+    for (int i = 0; i < COUNT; i++) {
+      snprintf(text, sizeof(text), "%d", i);
+      while (!queue.push((uint8_t)(i % 5), MessageView(text), false)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // Every command arrives once, in order, with its own payload
+  CommandQueue::Command cmd;
+  int expected = 0;
+  while (expected < COUNT) {
+    if (!queue.pop(cmd)) {
+      std::this_thread::yield();
+      continue;
+    }
+    TEST_ASSERT_EQUAL_UINT8(expected % 5, cmd.route);
+    TEST_ASSERT_EQUAL_INT32(expected, cmd.payload.toInt());
+    expected++;
+  }
+  producer.join();
+  TEST_ASSERT_TRUE(queue.isEmpty());
+}
+
+void test_outbox_keeps_message_until_sent() {
+  SpscQueue<int, 4> ring;
+  int v = 0;
+  TEST_ASSERT_FALSE(ring.peek(v));
+  ring.push(1);
+  ring.push(2);
+
+  // A failed send leaves the head in place for the retry
+  TEST_ASSERT_TRUE(ring.peek(v));
+  TEST_ASSERT_EQUAL(1, v);
+  TEST_ASSERT_TRUE(ring.peek(v));
+  TEST_ASSERT_EQUAL(1, v);
+
+  ring.drop();
+  TEST_ASSERT_TRUE(ring.peek(v));
+  TEST_ASSERT_EQUAL(2, v);
+  ring.drop();
+  TEST_ASSERT_TRUE(ring.isEmpty());
+  ring.drop();   // Nothing to drop
+  TEST_ASSERT_TRUE(ring.push(3));
+  TEST_ASSERT_TRUE(ring.pop(v));
+  TEST_ASSERT_EQUAL(3, v);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_view_helpers_stay_in_bounds);
+  RUN_TEST(test_view_comparisons);
+  RUN_TEST(test_router_dispatches_by_suffix);
+  RUN_TEST(test_router_table_limit);
+  RUN_TEST(test_router_resolves_route_ids);
+  RUN_TEST(test_topic_table_per_device);
+  RUN_TEST(test_params_parsed_from_unterminated_view);
+  RUN_TEST(test_json_reader_walks_batch);
+  RUN_TEST(test_json_reader_rejects_malformed);
+  RUN_TEST(test_command_queue_coalesces_in_order);
+  RUN_TEST(test_command_queue_keeps_timed_commands);
+  RUN_TEST(test_command_queue_backpressure);
+  RUN_TEST(test_command_queue_across_threads);
+  RUN_TEST(test_publish_queue_coalesces_burst);
+  RUN_TEST(test_publish_queue_topics_independent);
+  RUN_TEST(test_outbox_keeps_message_until_sent);
+  return UNITY_END();
+}
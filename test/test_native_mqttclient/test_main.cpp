@@ -0,0 +1,495 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "hw/Clock.h"
+#include "net/MqttClient.h"
+
+// MqttClient against a stand-in broker on 127.0.0.1 that is started and
+// killed during the run. No poll() may wait on the network, whatever the
+// broker does.
+
+static const unsigned long MAX_POLL_US = 20000;
+
+/**
+ * Minimal broker: answers CONNECT, SUBSCRIBE and PINGREQ, and sends one
+ * PUBLISH after each SUBACK. Runs in its own thread.
+ */
+class FakeBroker {
+public:
+  enum Mode {
+    NORMAL,
+    SILENT,      // Accepts TCP but never answers
+    NO_PINGRESP  // Ignores keepalive pings
+  };
+
+  std::atomic<int> connects{0};
+  std::atomic<int> subscribes{0};
+  std::atomic<int> pings{0};
+  std::atomic<int> publishes{0};
+  std::atomic<int> pubacks{0};
+  std::atomic<int> firstPubackId{-1};
+  std::atomic<int> cleanSession{-1};   // Flag of the last CONNECT
+  std::atomic<int> subscribeQos{-1};   // QoS requested for the first filter
+  char firstFilter[64];
+  uint8_t publishQos;
+  bool sessionStored;                  // Answer CONNACK with session present
+  bool holdSuback;                     // Never answer SUBSCRIBE
+  size_t oversized;                    // Precede the PUBLISH with one of this payload size
+
+  FakeBroker()
+    : publishQos(0), sessionStored(false), holdSuback(false), oversized(0), listenFd(-1), clientFd(-1),
+      mode(NORMAL), port(0) {
+    firstFilter[0] = '\0';
+  }
+
+  ~FakeBroker() { kill(); }
+
+  bool start(Mode m, uint16_t requestedPort = 0) {
+    mode = m;
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(requestedPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 1) < 0) {
+      return false;
+    }
+    socklen_t length = sizeof(addr);
+    getsockname(listenFd, (struct sockaddr*)&addr, &length);
+    port = ntohs(addr.sin_port);
+
+    thread = std::thread([this] { run(); });
+    return true;
+  }
+
+  // Drop the listener and any open session, like a crashed broker
+  void kill() {
+    if (listenFd < 0) return;
+    shutdown(listenFd, SHUT_RDWR);
+    int c = clientFd.exchange(-1);
+    if (c >= 0) shutdown(c, SHUT_RDWR);
+    thread.join();
+    close(listenFd);
+    listenFd = -1;
+  }
+
+  uint16_t boundPort() const { return port; }
+
+private:
+  int listenFd;
+  std::atomic<int> clientFd;
+  Mode mode;
+  uint16_t port;
+  std::thread thread;
+
+  void run() {
+    for (;;) {
+      int c = accept(listenFd, nullptr, nullptr);
+      if (c < 0) return;
+      clientFd = c;
+      serve(c);
+      close(c);
+      clientFd = -1;
+    }
+  }
+
+  static bool readAll(int c, uint8_t* buf, size_t length) {
+    size_t got = 0;
+    while (got < length) {
+      ssize_t n = read(c, buf + got, length - got);
+      if (n <= 0) return false;
+      got += n;
+    }
+    return true;
+  }
+
+  void serve(int c) {
+    uint8_t body[1024];
+    for (;;) {
+      uint8_t header;
+      if (!readAll(c, &header, 1)) return;
+      size_t remaining = 0;
+      uint8_t shift = 0;
+      uint8_t b;
+      do {
+        if (!readAll(c, &b, 1)) return;
+        remaining |= (size_t)(b & 0x7F) << shift;
+        shift += 7;
+      } while (b & 0x80);
+      if (remaining > sizeof(body) || !readAll(c, body, remaining)) return;
+
+      switch (header & 0xF0) {
+        case 0x10: {
+          connects++;
+          cleanSession = (body[7] & 0x02) ? 1 : 0;
+          if (mode == SILENT) break;
+          const uint8_t connack[] = {0x20, 0x02, (uint8_t)(sessionStored ? 0x01 : 0x00), 0x00};
+          write(c, connack, sizeof(connack));
+          break;
+        }
+        case 0x80: {
+          subscribes++;
+          size_t filterLength = (body[2] << 8) | body[3];
+          if (filterLength < sizeof(firstFilter)) {
+            memcpy(firstFilter, body + 4, filterLength);
+            firstFilter[filterLength] = '\0';
+          }
+          subscribeQos = body[4 + filterLength];
+          if (holdSuback) break;
+          const uint8_t suback[] = {0x90, 0x03, body[0], body[1], 0x00};
+          write(c, suback, sizeof(suback));
+          sendCommand(c);
+          break;
+        }
+        case 0xC0: {
+          pings++;
+          if (mode == NO_PINGRESP) break;
+          const uint8_t pingresp[] = {0xD0, 0x00};
+          write(c, pingresp, sizeof(pingresp));
+          break;
+        }
+        case 0x30:
+          publishes++;
+          break;
+        case 0x40:
+          if (pubacks++ == 0) firstPubackId = (body[0] << 8) | body[1];
+          break;
+        case 0xE0:
+          return;
+      }
+    }
+  }
+
+  void sendCommand(int c) {
+    const char topic[] = "lamp/cmnd/power";
+    if (oversized) sendOversized(c, topic, sizeof(topic) - 1);
+    uint8_t packet[64];
+    size_t pos = 2;
+    packet[pos++] = 0;
+    packet[pos++] = sizeof(topic) - 1;
+    memcpy(packet + pos, topic, sizeof(topic) - 1);
+    pos += sizeof(topic) - 1;
+    if (publishQos) {
+      packet[pos++] = 0x12;
+      packet[pos++] = 0x34;
+    }
+    packet[pos++] = 'O';
+    packet[pos++] = 'N';
+    packet[0] = 0x30 | (publishQos << 1);
+    packet[1] = pos - 2;
+    write(c, packet, pos);
+  }
+
+  // QoS 1 PUBLISH with packet id 0x5678, too large for the client's buffer
+  void sendOversized(int c, const char* topic, size_t topicLength) {
+    size_t remaining = 2 + topicLength + 2 + oversized;
+    uint8_t head[8];
+    size_t pos = 0;
+    head[pos++] = 0x32;
+    do {
+      uint8_t b = remaining & 0x7F;
+      remaining >>= 7;
+      head[pos++] = b | (remaining ? 0x80 : 0x00);
+    } while (remaining);
+    head[pos++] = 0;
+    head[pos++] = topicLength;
+    write(c, head, pos);
+    write(c, topic, topicLength);
+    const uint8_t id[] = {0x56, 0x78};
+    write(c, id, sizeof(id));
+    uint8_t filler[256];
+    memset(filler, 'x', sizeof(filler));
+    for (size_t sent = 0; sent < oversized; sent += sizeof(filler)) {
+      size_t n = oversized - sent < sizeof(filler) ? oversized - sent : sizeof(filler);
+      write(c, filler, n);
+    }
+  }
+};
+
+static int delivered;
+static int refusals;
+static char lastTopic[32];
+static char lastPayload[16];
+
+static bool onMessage(void* context, const char* topic, size_t topicLength,
+                      const char* payload, size_t payloadLength) {
+  if (refusals > 0) {
+    refusals--;
+    return false;
+  }
+  delivered++;
+  snprintf(lastTopic, sizeof(lastTopic), "%.*s", (int)topicLength, topic);
+  snprintf(lastPayload, sizeof(lastPayload), "%.*s", (int)payloadLength, payload);
+  return true;
+}
+
+static const char* const FILTERS[] = {"lamp/cmnd/power", "lamp/cmnd/color"};
+
+static MqttClient* client;
+static unsigned long maxPollUs;
+
+// Poll until the client reaches the state (or time runs out), tracking
+// the slowest single poll()
+static bool pollUntil(MqttClient::State wanted, unsigned long timeoutMs) {
+  unsigned long start = millis();
+  while (millis() - start < timeoutMs) {
+    unsigned long before = micros();
+    client->poll();
+    unsigned long took = micros() - before;
+    if (took > maxPollUs) maxPollUs = took;
+    if (client->state() == wanted) return true;
+    delay(1);
+  }
+  return false;
+}
+
+static void pollFor(unsigned long ms) {
+  unsigned long start = millis();
+  while (millis() - start < ms) {
+    client->poll();
+    delay(1);
+  }
+}
+
+void setUp() {
+  delivered = 0;
+  refusals = 0;
+  lastTopic[0] = '\0';
+  lastPayload[0] = '\0';
+  maxPollUs = 0;
+  client = new MqttClient();
+  client->setCredentials("test-client", "", "");
+  client->setSubscriptions(FILTERS, 2);
+  client->setHandler(onMessage, nullptr);
+}
+
+void tearDown() {
+  delete client;
+}
+
+void test_unreachable_broker_fails_fast() {
+  // Reserve a port, then close it: nothing listens there
+  FakeBroker probe;
+  TEST_ASSERT_TRUE(probe.start(FakeBroker::NORMAL));
+  uint16_t port = probe.boundPort();
+  probe.kill();
+
+  client->setServer("127.0.0.1", port);
+  if (client->connect()) {
+    TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Disconnected, 1000));
+  }
+  TEST_ASSERT_EQUAL_INT((int)MqttClient::Error::Refused, (int)client->lastError());
+  TEST_ASSERT_LESS_THAN(MAX_POLL_US, maxPollUs);
+  TEST_ASSERT_EQUAL_INT(-1, client->socketFd());
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, client->msUntilPoll());
+}
+
+void test_connect_receive_and_reconnect_after_broker_restart() {
+  FakeBroker broker;
+  TEST_ASSERT_TRUE(broker.start(FakeBroker::NORMAL));
+  uint16_t port = broker.boundPort();
+
+  client->setServer("127.0.0.1", port);
+  TEST_ASSERT_TRUE(client->connect());
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Connected, 1000));
+  TEST_ASSERT_EQUAL_INT(1, broker.connects.load());
+  TEST_ASSERT_EQUAL_INT(1, broker.subscribes.load());
+  TEST_ASSERT_EQUAL_STRING("lamp/cmnd/power", broker.firstFilter);
+
+  // The PUBLISH sent after SUBACK reaches the handler
+  unsigned long start = millis();
+  while (delivered == 0 && millis() - start < 1000) {
+    client->poll();
+    delay(1);
+  }
+  TEST_ASSERT_EQUAL_INT(1, delivered);
+  TEST_ASSERT_EQUAL_STRING("lamp/cmnd/power", lastTopic);
+  TEST_ASSERT_EQUAL_STRING("ON", lastPayload);
+
+  TEST_ASSERT_TRUE(client->publish("lamp/state/json", "{}", 2, true));
+  start = millis();
+  while (broker.publishes.load() == 0 && millis() - start < 1000) delay(1);
+  TEST_ASSERT_EQUAL_INT(1, broker.publishes.load());
+
+  // Broker dies: the loss is noticed without a keepalive timeout
+  broker.kill();
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Disconnected, 1000));
+  TEST_ASSERT_EQUAL_INT((int)MqttClient::Error::Closed, (int)client->lastError());
+  TEST_ASSERT_FALSE(client->publish("lamp/state/json", "{}", 2, true));
+
+  // Broker comes back on the same port: a fresh attempt succeeds
+  FakeBroker restarted;
+  TEST_ASSERT_TRUE(restarted.start(FakeBroker::NORMAL, port));
+  TEST_ASSERT_TRUE(client->connect());
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Connected, 1000));
+  TEST_ASSERT_EQUAL_INT(1, restarted.connects.load());
+  TEST_ASSERT_LESS_THAN(MAX_POLL_US, maxPollUs);
+
+  client->disconnect();
+  TEST_ASSERT_EQUAL_INT((int)MqttClient::Error::None, (int)client->lastError());
+}
+
+void test_silent_broker_times_out_without_blocking() {
+  FakeBroker broker;
+  TEST_ASSERT_TRUE(broker.start(FakeBroker::SILENT));
+
+  client->setServer("127.0.0.1", broker.boundPort());
+  client->setConnectTimeout(200);
+  unsigned long start = millis();
+  TEST_ASSERT_TRUE(client->connect());
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Disconnected, 2000));
+  unsigned long elapsed = millis() - start;
+
+  TEST_ASSERT_EQUAL_INT((int)MqttClient::Error::Timeout, (int)client->lastError());
+  TEST_ASSERT_GREATER_OR_EQUAL(200, elapsed);
+  TEST_ASSERT_LESS_THAN(1000, elapsed);
+  TEST_ASSERT_LESS_THAN(MAX_POLL_US, maxPollUs);
+  TEST_ASSERT_EQUAL_INT(1, broker.connects.load());
+}
+
+void test_refused_message_is_offered_again() {
+  FakeBroker broker;
+  broker.publishQos = 1;
+  TEST_ASSERT_TRUE(broker.start(FakeBroker::NORMAL));
+
+  refusals = 3;
+  client->setServer("127.0.0.1", broker.boundPort());
+  TEST_ASSERT_TRUE(client->connect());
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Connected, 1000));
+
+  // While refused, the socket is not watched and a short retry is due
+  unsigned long start = millis();
+  while (refusals > 2 && millis() - start < 1000) {
+    client->poll();
+    delay(1);
+  }
+  TEST_ASSERT_EQUAL_INT(-1, client->socketFd());
+  TEST_ASSERT_LESS_OR_EQUAL(5, client->msUntilPoll());
+  TEST_ASSERT_EQUAL_INT(0, broker.pubacks.load());
+
+  pollFor(50);
+  TEST_ASSERT_EQUAL_INT(1, delivered);
+  TEST_ASSERT_EQUAL_STRING("ON", lastPayload);
+  TEST_ASSERT_NOT_EQUAL(-1, client->socketFd());
+
+  // Acknowledged only once it was taken
+  start = millis();
+  while (broker.pubacks.load() == 0 && millis() - start < 1000) delay(1);
+  TEST_ASSERT_EQUAL_INT(1, broker.pubacks.load());
+}
+
+void test_oversized_message_is_acknowledged_and_skipped() {
+  FakeBroker broker;
+  broker.publishQos = 1;
+  broker.oversized = 3000;
+  TEST_ASSERT_TRUE(broker.start(FakeBroker::NORMAL));
+
+  client->setServer("127.0.0.1", broker.boundPort());
+  TEST_ASSERT_TRUE(client->connect());
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Connected, 1000));
+
+  // The message after it still arrives intact
+  unsigned long start = millis();
+  while (delivered == 0 && millis() - start < 1000) {
+    client->poll();
+    delay(1);
+  }
+  TEST_ASSERT_EQUAL_INT(1, delivered);
+  TEST_ASSERT_EQUAL_STRING("ON", lastPayload);
+  TEST_ASSERT_TRUE(client->connected());
+
+  // Both were acknowledged, the dropped one first
+  start = millis();
+  while (broker.pubacks.load() < 2 && millis() - start < 1000) delay(1);
+  TEST_ASSERT_EQUAL_INT(2, broker.pubacks.load());
+  TEST_ASSERT_EQUAL_INT(0x5678, broker.firstPubackId.load());
+}
+
+void test_keepalive_detects_dead_broker() {
+  FakeBroker broker;
+  TEST_ASSERT_TRUE(broker.start(FakeBroker::NO_PINGRESP));
+
+  VirtualClock clock(1000);
+  client->setClock(&clock);
+  client->setKeepAlive(15);
+  client->setServer("127.0.0.1", broker.boundPort());
+  TEST_ASSERT_TRUE(client->connect());
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Connected, 1000));
+  pollFor(20);
+  TEST_ASSERT_EQUAL_UINT32(15000, client->msUntilPoll());
+
+  clock.advance(15000);
+  client->poll();
+  unsigned long start = millis();
+  while (broker.pings.load() == 0 && millis() - start < 1000) delay(1);
+  TEST_ASSERT_EQUAL_INT(1, broker.pings.load());
+  TEST_ASSERT_TRUE(client->connected());
+
+  clock.advance(15000);
+  client->poll();
+  TEST_ASSERT_EQUAL_INT((int)MqttClient::State::Disconnected, (int)client->state());
+  TEST_ASSERT_EQUAL_INT((int)MqttClient::Error::KeepAlive, (int)client->lastError());
+}
+
+void test_persistent_session_ready_at_connack() {
+  FakeBroker broker;
+  broker.sessionStored = true;
+  broker.holdSuback = true;
+  TEST_ASSERT_TRUE(broker.start(FakeBroker::NORMAL));
+
+  client->setSubscriptions(FILTERS, 2, 1);
+  client->setCleanSession(false);
+  client->setServer("127.0.0.1", broker.boundPort());
+  TEST_ASSERT_TRUE(client->connect());
+
+  // Ready without a SUBACK: the broker kept the filters
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Connected, 1000));
+  TEST_ASSERT_TRUE(client->sessionPresent());
+  TEST_ASSERT_EQUAL_INT(0, broker.cleanSession.load());
+
+  // Filters are still refreshed, at QoS 1
+  unsigned long start = millis();
+  while (broker.subscribes.load() == 0 && millis() - start < 1000) delay(1);
+  TEST_ASSERT_EQUAL_INT(1, broker.subscribes.load());
+  TEST_ASSERT_EQUAL_INT(1, broker.subscribeQos.load());
+}
+
+void test_new_session_waits_for_suback() {
+  FakeBroker broker;
+  broker.holdSuback = true;
+  TEST_ASSERT_TRUE(broker.start(FakeBroker::NORMAL));
+
+  client->setCleanSession(false);
+  client->setConnectTimeout(100);
+  client->setServer("127.0.0.1", broker.boundPort());
+  TEST_ASSERT_TRUE(client->connect());
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Subscribing, 1000));
+  TEST_ASSERT_FALSE(client->sessionPresent());
+
+  TEST_ASSERT_TRUE(pollUntil(MqttClient::State::Disconnected, 1000));
+  TEST_ASSERT_EQUAL_INT((int)MqttClient::Error::Timeout, (int)client->lastError());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unreachable_broker_fails_fast);
+  RUN_TEST(test_connect_receive_and_reconnect_after_broker_restart);
+  RUN_TEST(test_silent_broker_times_out_without_blocking);
+  RUN_TEST(test_refused_message_is_offered_again);
+  RUN_TEST(test_oversized_message_is_acknowledged_and_skipped);
+  RUN_TEST(test_keepalive_detects_dead_broker);
+  RUN_TEST(test_persistent_session_ready_at_connack);
+  RUN_TEST(test_new_session_waits_for_suback);
+  return UNITY_END();
+}
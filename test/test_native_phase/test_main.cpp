@@ -0,0 +1,283 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+
+#include "anim/AnimationEngine.h"
+#include "hw/Clock.h"
+#include "net/PhaseGroup.h"
+#include "state/DeviceConfig.h"
+#include "state/DeviceState.h"
+
+// Group time election and tracking, simulated without sockets: each lamp
+// has its own clock (offset and drift), beacons are delivered to the
+// others after a random delay.
+
+/**
+ * A lamp on the simulated network. Local time is startMs plus the true
+ * time scaled by its clock rate.
+ */
+struct SimLamp {
+  VirtualClock clock;
+  PhaseGroup group;
+  unsigned long startMs;
+  double ppm;
+  bool online;
+
+  SimLamp(uint32_t id, unsigned long start, double drift)
+    : clock(start), startMs(start), ppm(drift), online(false) {
+    group.setClock(&clock);
+    group.setMemberId(id);
+  }
+
+  void setTrueTime(unsigned long trueMs) {
+    clock.set(startMs + (unsigned long)(trueMs * (1.0 + ppm / 1e6)));
+  }
+};
+
+struct InFlight {
+  unsigned long deliverAt;
+  size_t from;
+  PhaseGroup::Beacon beacon;
+};
+
+/**
+ * Delivers beacons between lamps with 1-15 ms of delay, and one in four
+ * held back 40-100 ms (a receiver in power save).
+ */
+class SimNetwork {
+public:
+  std::vector<SimLamp*> lamps;
+  std::vector<InFlight> inFlight;
+  unsigned long trueMs = 0;
+  uint32_t seed = 12345;
+
+  ~SimNetwork() {
+    for (SimLamp* lamp : lamps) delete lamp;
+  }
+
+  SimLamp* add(uint32_t id, unsigned long startMs, double ppm) {
+    SimLamp* lamp = new SimLamp(id, startMs, ppm);
+    lamp->setTrueTime(trueMs);
+    lamps.push_back(lamp);
+    return lamp;
+  }
+
+  void join(SimLamp* lamp) {
+    lamp->setTrueTime(trueMs);
+    lamp->online = true;
+    lamp->group.join("living-room");
+  }
+
+  void leave(SimLamp* lamp) {
+    lamp->online = false;
+    lamp->group.leave();
+  }
+
+  // Advance one millisecond of true time
+  void step() {
+    trueMs++;
+    for (SimLamp* lamp : lamps) lamp->setTrueTime(trueMs);
+
+    for (size_t i = 0; i < inFlight.size();) {
+      if (inFlight[i].deliverAt <= trueMs) {
+        for (size_t to = 0; to < lamps.size(); to++) {
+          if (to != inFlight[i].from && lamps[to]->online) {
+            lamps[to]->group.handleBeacon(inFlight[i].beacon);
+          }
+        }
+        inFlight.erase(inFlight.begin() + i);
+      } else {
+        i++;
+      }
+    }
+
+    for (size_t i = 0; i < lamps.size(); i++) {
+      PhaseGroup::Beacon beacon;
+      if (lamps[i]->online && lamps[i]->group.nextBeacon(beacon)) {
+        inFlight.push_back({ trueMs + delay(), i, beacon });
+      }
+    }
+  }
+
+  void run(unsigned long ms) {
+    for (unsigned long i = 0; i < ms; i++) step();
+  }
+
+  // Largest difference in group time between online lamps
+  uint32_t spread() const {
+    int32_t lo = 0, hi = 0;
+    bool first = true;
+    uint32_t reference = 0;
+    for (SimLamp* lamp : lamps) {
+      if (!lamp->online) continue;
+      if (first) reference = lamp->group.now();
+      int32_t d = (int32_t)(lamp->group.now() - reference);
+      if (first || d < lo) lo = d;
+      if (first || d > hi) hi = d;
+      first = false;
+    }
+    return (uint32_t)(hi - lo);
+  }
+
+private:
+  unsigned long delay() {
+    seed = seed * 1103515245UL + 12345UL;
+    uint32_t r = (seed >> 8) & 0xFFFF;
+    if ((r & 3) == 0) return 40 + (r >> 2) % 61;
+    return 1 + (r >> 2) % 15;
+  }
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_beacon_round_trip() {
+  PhaseGroup::Beacon in = { PhaseGroup::hashName("kitchen"), 0xDEADBEEF, 123456789 };
+  uint8_t data[PhaseGroup::BEACON_SIZE];
+  TEST_ASSERT_EQUAL(PhaseGroup::BEACON_SIZE, PhaseGroup::encode(in, data));
+
+  PhaseGroup::Beacon out;
+  TEST_ASSERT_TRUE(PhaseGroup::decode(data, sizeof(data), out));
+  TEST_ASSERT_EQUAL_UINT32(in.groupHash, out.groupHash);
+  TEST_ASSERT_EQUAL_UINT32(in.senderId, out.senderId);
+  TEST_ASSERT_EQUAL_UINT32(in.groupMs, out.groupMs);
+
+  TEST_ASSERT_FALSE(PhaseGroup::decode(data, sizeof(data) - 1, out));
+  data[2] = 2;  // Unknown version
+  TEST_ASSERT_FALSE(PhaseGroup::decode(data, sizeof(data), out));
+  data[2] = 1;
+  data[0] = 'X';
+  TEST_ASSERT_FALSE(PhaseGroup::decode(data, sizeof(data), out));
+}
+
+void test_lone_member_leads_after_listening() {
+  SimNetwork net;
+  SimLamp* lamp = net.add(7, 5000, 0);
+  net.join(lamp);
+
+  net.run(PhaseGroup::LISTEN_MS - 1);
+  TEST_ASSERT_FALSE(lamp->group.locked());
+  TEST_ASSERT_TRUE(net.inFlight.empty());   // Quiet while listening
+
+  net.run(1);
+  TEST_ASSERT_TRUE(lamp->group.locked());
+  TEST_ASSERT_TRUE(lamp->group.leading());
+  TEST_ASSERT_EQUAL(1, net.inFlight.size());
+
+  TEST_ASSERT_TRUE(lamp->group.join(""));
+  TEST_ASSERT_FALSE(lamp->group.joined());
+  TEST_ASSERT_EQUAL(Clock::NO_DEADLINE, lamp->group.msUntilPoll());
+}
+
+void test_members_stay_in_phase_for_an_hour() {
+  SimNetwork net;
+  SimLamp* a = net.add(30, 1000, +80);
+  SimLamp* second = net.add(10, 4000000000UL, -60);   // Local time wraps during the run
+  SimLamp* c = net.add(20, 77777, 0);
+
+  net.join(a);
+  net.run(5000);
+  net.join(second);
+  net.run(700);
+  net.join(c);
+  net.run(10000);
+  for (SimLamp* lamp : net.lamps) lamp->group.resetStats();
+
+  uint32_t worst = 0;
+  for (int i = 0; i < 3600; i++) {
+    net.run(1000);
+    uint32_t spread = net.spread();
+    if (spread > worst) worst = spread;
+  }
+
+  for (SimLamp* lamp : net.lamps) {
+    TEST_ASSERT_TRUE(lamp->group.locked());
+    TEST_ASSERT_EQUAL_UINT32(10, lamp->group.leader());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(20, lamp->group.maxPhaseErrorMs());
+  }
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(15, worst);
+}
+
+void test_new_leader_keeps_group_time() {
+  SimNetwork net;
+  SimLamp* a = net.add(10, 1000, +50);
+  SimLamp* second = net.add(20, 2000000, -50);
+  SimLamp* c = net.add(30, 30000, 0);
+  net.join(a);
+  net.run(3000);
+  net.join(second);
+  net.join(c);
+  net.run(20000);
+  TEST_ASSERT_EQUAL_UINT32(10, c->group.leader());
+
+  // Leader goes away: the next lowest id leads, time runs on
+  uint32_t before = c->group.now();
+  net.leave(a);
+  net.run(10000);
+  TEST_ASSERT_TRUE(second->group.leading());
+  TEST_ASSERT_EQUAL_UINT32(20, c->group.leader());
+  TEST_ASSERT_INT32_WITHIN(15, 10000, (int32_t)(c->group.now() - before));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(15, net.spread());
+
+  // A lower id joining adopts the group time first, then takes over
+  SimLamp* d = net.add(5, 123, 0);
+  before = c->group.now();
+  net.join(d);
+  net.run(10000);
+  TEST_ASSERT_TRUE(d->group.leading());
+  TEST_ASSERT_EQUAL_UINT32(5, second->group.leader());
+  TEST_ASSERT_EQUAL_UINT32(5, c->group.leader());
+  TEST_ASSERT_INT32_WITHIN(15, 10000, (int32_t)(c->group.now() - before));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(15, net.spread());
+}
+
+void test_other_groups_are_ignored() {
+  SimNetwork net;
+  SimLamp* a = net.add(10, 1000, 0);
+  SimLamp* second = net.add(20, 900000, 0);
+  net.join(a);
+  second->online = true;
+  second->group.join("bedroom");
+  net.run(10000);
+
+  TEST_ASSERT_TRUE(a->group.leading());
+  TEST_ASSERT_TRUE(second->group.leading());
+}
+
+void test_aligned_engines_show_the_same_frame() {
+  DeviceState stateA, stateB;
+  DeviceConfig config;
+  VirtualClock clockA(1000), clockB(987654);
+  AnimationEngine engineA, engineB;
+  engineA.begin(&stateA, &config, &clockA);
+  engineB.begin(&stateB, &config, &clockB);
+
+  engineA.startRainbow();
+  clockA.advance(3333);
+  clockB.advance(100);
+  engineB.startRainbow();
+
+  // Same group time on both lamps, different local clocks
+  for (uint32_t groupMs = 500000; groupMs < 520000; groupMs += 250) {
+    clockA.advance(250);
+    clockB.advance(250);
+    engineA.alignPhase(groupMs);
+    engineB.alignPhase(groupMs);
+    engineA.loop();
+    engineB.loop();
+    TEST_ASSERT_EQUAL_UINT8(stateA.colorR, stateB.colorR);
+    TEST_ASSERT_EQUAL_UINT8(stateA.colorG, stateB.colorG);
+    TEST_ASSERT_EQUAL_UINT8(stateA.colorB, stateB.colorB);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_beacon_round_trip);
+  RUN_TEST(test_lone_member_leads_after_listening);
+  RUN_TEST(test_members_stay_in_phase_for_an_hour);
+  RUN_TEST(test_new_leader_keeps_group_time);
+  RUN_TEST(test_other_groups_are_ignored);
+  RUN_TEST(test_aligned_engines_show_the_same_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,118 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "hw/SleepManager.h"
+#include "state/FrameStats.h"
+#include "state/BootTimeline.h"
+#include "hw/Clock.h"
+
+// SleepManager must honour its timeout and return early on wake() or
+// socket data, reporting the time actually slept.
+
+static SleepManager* sleeper;
+
+void setUp() {
+  sleeper = new SleepManager();
+  sleeper->begin();
+}
+
+void tearDown() {
+  delete sleeper;
+}
+
+void test_sleep_honours_timeout() {
+  unsigned long sleptUs = sleeper->sleep(50);
+  TEST_ASSERT_UINT32_WITHIN(30000, 50000, sleptUs);
+  TEST_ASSERT_EQUAL_UINT32(0, sleeper->sleep(0));
+}
+
+void test_wake_from_other_thread() {
+  std::thread waker([] {
+    delay(20);
+    sleeper->wake();
+  });
+  unsigned long sleptUs = sleeper->sleep(1000);
+  waker.join();
+  TEST_ASSERT_LESS_THAN(500000, sleptUs);
+
+  // The event is consumed: the next sleep runs to its timeout
+  TEST_ASSERT_GREATER_OR_EQUAL(20000, sleeper->sleep(20));
+}
+
+void test_wake_before_sleep_is_not_lost() {
+  sleeper->wake();
+  TEST_ASSERT_LESS_THAN(100000, sleeper->sleep(1000));
+}
+
+void test_socket_data_wakes() {
+  int fds[2];
+  TEST_ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  TEST_ASSERT_EQUAL_INT(1, (int)write(fds[1], "x", 1));
+  TEST_ASSERT_LESS_THAN(100000, sleeper->sleep(1000, fds[0]));
+  close(fds[0]);
+  close(fds[1]);
+}
+
+void test_frame_stats_histogram() {
+  FrameStats stats(33000);
+  stats.record(100);      // < 250 us
+  stats.record(250);      // < 500 us
+  stats.record(1500);     // < 2 ms
+  stats.record(40000);    // < 64 ms, over budget
+  stats.record(5000000);  // Last bucket
+
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bucket(0));
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bucket(1));
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bucket(3));
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bucket(8));
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bucket(FrameStats::BUCKETS - 1));
+  TEST_ASSERT_EQUAL_UINT32(5000000, stats.maxUs());
+  TEST_ASSERT_EQUAL_UINT32(2, stats.overruns());
+
+  char buf[64];
+  stats.formatHistogram(buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_STRING("[1,1,0,1,0,0,0,0,1,1]", buf);
+
+  stats.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, stats.count());
+}
+
+void test_boot_timeline_marks_once() {
+  VirtualClock clock(0);
+  clock.advanceMicros(41000);
+  BootTimeline boot;
+  boot.setClock(&clock);
+
+  boot.mark(BootTimeline::SETUP);
+  clock.advanceMicros(3500);
+  boot.mark(BootTimeline::LIGHT);
+  clock.advanceMicros(900000);
+  boot.mark(BootTimeline::LIGHT);   // Already reached
+  boot.mark(BootTimeline::MQTT);
+
+  TEST_ASSERT_EQUAL_UINT32(41000, boot.atUs(BootTimeline::SETUP));
+  TEST_ASSERT_EQUAL_UINT32(44500, boot.atUs(BootTimeline::LIGHT));
+  TEST_ASSERT_FALSE(boot.reached(BootTimeline::WIFI));
+
+  char buf[128];
+  boot.format(buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_STRING("{\"setup_us\":41000,\"light_us\":44500,\"mqtt_us\":944500}", buf);
+
+  // Truncated output stays terminated
+  TEST_ASSERT_EQUAL(9, boot.format(buf, 10));
+  TEST_ASSERT_EQUAL(9, strlen(buf));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sleep_honours_timeout);
+  RUN_TEST(test_wake_from_other_thread);
+  RUN_TEST(test_wake_before_sleep_is_not_lost);
+  RUN_TEST(test_socket_data_wakes);
+  RUN_TEST(test_frame_stats_histogram);
+  RUN_TEST(test_boot_timeline_marks_once);
+  return UNITY_END();
+}
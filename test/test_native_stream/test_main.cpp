@@ -0,0 +1,230 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "hw/Clock.h"
+#include "hw/SleepManager.h"
+#include "net/FrameStream.h"
+
+// FrameStream must decode DDP packets sent over loopback, order them by
+// sequence number, end the stream on silence and keep up with a sender
+// well above 60 fps.
+
+static FrameStream* stream;
+static int sender = -1;
+
+void setUp() {
+  stream = new FrameStream();
+  TEST_ASSERT_TRUE(stream->begin(0));
+  sender = socket(AF_INET, SOCK_DGRAM, 0);
+}
+
+void tearDown() {
+  delete stream;
+  close(sender);
+}
+
+// DDP packet for one RGB pixel (push flag set, RGB 8-bit, default id)
+static size_t buildPacket(uint8_t* buf, uint8_t sequence, uint8_t r, uint8_t g, uint8_t b) {
+  const uint8_t header[10] = { 0x41, sequence, 0x0B, 0x01, 0, 0, 0, 0, 0, 3 };
+  memcpy(buf, header, sizeof(header));
+  buf[10] = r;
+  buf[11] = g;
+  buf[12] = b;
+  return 13;
+}
+
+static void sendPacket(uint8_t sequence, uint8_t r, uint8_t g, uint8_t b) {
+  uint8_t buf[16];
+  size_t length = buildPacket(buf, sequence, r, g, b);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(stream->localPort());
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sendto(sender, buf, length, 0, (struct sockaddr*)&addr, sizeof(addr));
+}
+
+// Poll until a frame arrives or the socket stays quiet for 200 ms
+static FrameStream::Event waitEvent(SleepManager& sleeper) {
+  for (int i = 0; i < 20; i++) {
+    FrameStream::Event event = stream->poll();
+    if (event != FrameStream::Event::None) return event;
+    sleeper.sleep(10, stream->socketFd());
+  }
+  return FrameStream::Event::None;
+}
+
+void test_parse_accepts_rgb_pixel() {
+  uint8_t buf[32];
+  FrameStream::Packet packet;
+
+  size_t length = buildPacket(buf, 5, 10, 20, 30);
+  TEST_ASSERT_TRUE(FrameStream::parse(buf, length, packet));
+  TEST_ASSERT_EQUAL_UINT8(5, packet.sequence);
+  TEST_ASSERT_EQUAL_UINT8(10, packet.color.r);
+  TEST_ASSERT_EQUAL_UINT8(30, packet.color.b);
+
+  // Timecode shifts the data by four bytes
+  const uint8_t timed[17] = { 0x51, 1, 0x0B, 1, 0, 0, 0, 0, 0, 3, 9, 9, 9, 9, 7, 8, 9 };
+  TEST_ASSERT_TRUE(FrameStream::parse(timed, sizeof(timed), packet));
+  TEST_ASSERT_EQUAL_UINT8(7, packet.color.r);
+
+  // A longer frame (or one truncated by the receive buffer) still works
+  uint8_t longFrame[64] = { 0x41, 0, 0x01, 1, 0, 0, 0, 0, 0x05, 0xA0 };
+  longFrame[10] = 1;
+  TEST_ASSERT_TRUE(FrameStream::parse(longFrame, sizeof(longFrame), packet));
+  TEST_ASSERT_EQUAL_UINT8(1, packet.color.r);
+}
+
+void test_parse_rejects_other_packets() {
+  uint8_t buf[32];
+  FrameStream::Packet packet;
+  size_t length = buildPacket(buf, 1, 1, 2, 3);
+
+  TEST_ASSERT_FALSE(FrameStream::parse(buf, 9, packet));           // Short header
+  TEST_ASSERT_FALSE(FrameStream::parse(buf, 12, packet));          // Short data
+
+  buf[0] = 0x81;                                                   // Version 2
+  TEST_ASSERT_FALSE(FrameStream::parse(buf, length, packet));
+  buf[0] = 0x43;                                                   // Query
+  TEST_ASSERT_FALSE(FrameStream::parse(buf, length, packet));
+  buf[0] = 0x41;
+
+  buf[2] = 0x1B;                                                   // RGB, 16 bit
+  TEST_ASSERT_FALSE(FrameStream::parse(buf, length, packet));
+  buf[2] = 0x0B;
+
+  buf[3] = 251;                                                    // Status id
+  TEST_ASSERT_FALSE(FrameStream::parse(buf, length, packet));
+  buf[3] = 1;
+
+  buf[7] = 3;                                                      // Next pixel
+  TEST_ASSERT_FALSE(FrameStream::parse(buf, length, packet));
+  buf[7] = 0;
+
+  buf[9] = 2;                                                      // Stated length
+  TEST_ASSERT_FALSE(FrameStream::parse(buf, length, packet));
+}
+
+void test_sequence_drops_late_and_counts_lost() {
+  SleepManager sleeper;
+  sleeper.begin(false);
+
+  sendPacket(14, 1, 0, 0);
+  TEST_ASSERT_EQUAL(FrameStream::Event::Frame, waitEvent(sleeper));
+  TEST_ASSERT_TRUE(stream->active());
+
+  sendPacket(14, 2, 0, 0);   // Duplicate
+  sendPacket(13, 3, 0, 0);   // Out of order
+  sendPacket(2, 4, 0, 0);    // Wraps past 15 and 1: two lost
+  delay(20);
+  TEST_ASSERT_EQUAL(FrameStream::Event::Frame, stream->poll());
+  TEST_ASSERT_EQUAL_UINT8(4, stream->color().r);
+  TEST_ASSERT_EQUAL_UINT32(2, stream->framesReceived());
+  TEST_ASSERT_EQUAL_UINT32(2, stream->framesLate());
+  TEST_ASSERT_EQUAL_UINT32(2, stream->framesLost());
+
+  // Unnumbered packets are always taken, newest of a burst wins
+  sendPacket(0, 5, 0, 0);
+  sendPacket(0, 6, 0, 0);
+  delay(20);
+  TEST_ASSERT_EQUAL(FrameStream::Event::Frame, stream->poll());
+  TEST_ASSERT_EQUAL_UINT8(6, stream->color().r);
+  TEST_ASSERT_EQUAL(FrameStream::Event::None, stream->poll());
+}
+
+void test_timeout_ends_stream() {
+  VirtualClock clock(1000);
+  SleepManager sleeper;
+  sleeper.begin(false);
+  stream->setClock(&clock);
+  stream->setTimeout(500);
+
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, stream->msUntilTimeout());
+  sendPacket(3, 9, 9, 9);
+  TEST_ASSERT_EQUAL(FrameStream::Event::Frame, waitEvent(sleeper));
+  TEST_ASSERT_EQUAL_UINT32(500, stream->msUntilTimeout());
+
+  clock.advance(499);
+  TEST_ASSERT_EQUAL(FrameStream::Event::None, stream->poll());
+  TEST_ASSERT_TRUE(stream->active());
+
+  clock.advance(1);
+  TEST_ASSERT_EQUAL(FrameStream::Event::Timeout, stream->poll());
+  TEST_ASSERT_FALSE(stream->active());
+  TEST_ASSERT_EQUAL(FrameStream::Event::None, stream->poll());
+
+  // A restarted sender begins a new stream, whatever its sequence
+  sendPacket(1, 7, 7, 7);
+  TEST_ASSERT_EQUAL(FrameStream::Event::Frame, waitEvent(sleeper));
+  TEST_ASSERT_EQUAL_UINT32(1, stream->framesReceived());
+  TEST_ASSERT_EQUAL_UINT32(0, stream->framesLate());
+}
+
+// Loopback sender at 250 fps against the render loop's receive path:
+// sleep on the socket, poll, note when each frame showed up
+void test_loopback_rate_and_latency() {
+  const int FRAMES = 250;
+  const unsigned long INTERVAL_US = 4000;
+  static std::atomic<unsigned long> sentUs[FRAMES];
+  static unsigned long latencyUs[FRAMES];
+  bool seen[FRAMES] = {};
+
+  SleepManager sleeper;
+  sleeper.begin(false);
+
+  std::thread source([] {
+    for (int i = 0; i < FRAMES; i++) {
+      sentUs[i] = micros();
+      sendPacket((uint8_t)(i % 15 + 1), (uint8_t)(i >> 8), (uint8_t)i, 0);
+      delayMicroseconds(INTERVAL_US);
+    }
+  });
+
+  unsigned long start = micros();
+  int received = 0;
+  while (micros() - start < 3000000UL) {
+    if (stream->poll() == FrameStream::Event::Frame) {
+      unsigned long now = micros();
+      FrameStream::Color c = stream->color();
+      int index = (c.r << 8) | c.g;
+      if (index < FRAMES && !seen[index]) {
+        seen[index] = true;
+        latencyUs[received++] = now - sentUs[index];
+      }
+      if (index == FRAMES - 1) break;
+    }
+    sleeper.sleep(50, stream->socketFd());
+  }
+  unsigned long elapsedUs = micros() - start;
+  source.join();
+
+  std::sort(latencyUs, latencyUs + received);
+  unsigned long p95 = latencyUs[received * 95 / 100];
+  float fps = received * 1e6f / elapsedUs;
+  printf("stream: %d/%d frames, %.0f fps, latency median %lu us, p95 %lu us\n",
+         received, FRAMES, fps, latencyUs[received / 2], p95);
+
+  TEST_ASSERT_GREATER_OR_EQUAL(FRAMES * 9 / 10, received);
+  TEST_ASSERT_GREATER_THAN(60, (int)fps);
+  TEST_ASSERT_LESS_THAN(10000, p95);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_accepts_rgb_pixel);
+  RUN_TEST(test_parse_rejects_other_packets);
+  RUN_TEST(test_sequence_drops_late_and_counts_lost);
+  RUN_TEST(test_timeout_ends_stream);
+  RUN_TEST(test_loopback_rate_and_latency);
+  return UNITY_END();
+}
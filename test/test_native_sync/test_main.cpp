@@ -0,0 +1,290 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "hw/Clock.h"
+#include "hw/SleepManager.h"
+#include "hw/WallClock.h"
+#include "net/CommandScheduler.h"
+#include "net/SntpClient.h"
+
+// Time sync against a stand-in NTP server on 127.0.0.1 whose clock runs
+// at a known offset from ours, then the wall clock and the time-ordered
+// command queue that runs "at=" commands.
+
+// Unity's 64-bit asserts are not enabled on every host
+#define ASSERT_EQUAL_U64(expected, actual) \
+  TEST_ASSERT_TRUE((uint64_t)(expected) == (uint64_t)(actual))
+
+static const uint64_t SERVER_EPOCH_BASE_US = 1700000000000000ULL;  // Nov 2023
+static const uint32_t NTP_TO_UNIX = 2208988800UL;
+
+/**
+ * Minimal NTP server: echoes the request's transmit timestamp and
+ * reports SERVER_EPOCH_BASE_US + micros() as its time.
+ */
+class FakeTimeServer {
+public:
+  std::atomic<int> requests{0};
+  bool silent = false;
+  bool sendForgedFirst = false;      // Precede each reply with a wrong-origin one
+  unsigned long processingUs = 0;    // Between receive and transmit timestamps
+
+  ~FakeTimeServer() { stop(); }
+
+  uint16_t start() {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct timeval tv = { 0, 20000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    socklen_t length = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &length);
+
+    running = true;
+    thread = std::thread([this] { run(); });
+    return ntohs(addr.sin_port);
+  }
+
+  void stop() {
+    if (!running) return;
+    running = false;
+    thread.join();
+    close(fd);
+  }
+
+private:
+  int fd = -1;
+  std::atomic<bool> running{false};
+  std::thread thread;
+
+  static void putTimestamp(uint8_t* p, uint64_t epochUs) {
+    uint32_t seconds = (uint32_t)(epochUs / 1000000ULL) + NTP_TO_UNIX;
+    uint32_t fraction = (uint32_t)(((epochUs % 1000000ULL) << 32) / 1000000ULL);
+    for (int i = 0; i < 4; i++) {
+      p[i] = seconds >> (24 - 8 * i);
+      p[4 + i] = fraction >> (24 - 8 * i);
+    }
+  }
+
+  static uint64_t now() { return SERVER_EPOCH_BASE_US + micros(); }
+
+  void run() {
+    while (running) {
+      uint8_t request[48];
+      struct sockaddr_in from;
+      socklen_t fromLength = sizeof(from);
+      ssize_t n = recvfrom(fd, request, sizeof(request), 0, (struct sockaddr*)&from, &fromLength);
+      if (n != 48) continue;
+      uint64_t received = now();
+      requests++;
+      if (silent) continue;
+
+      uint8_t reply[48] = {};
+      reply[0] = 0x24;   // Version 4, mode 4 (server)
+      reply[1] = 1;      // Stratum 1
+      memcpy(reply + 24, request + 40, 8);
+      putTimestamp(reply + 32, received);
+
+      if (sendForgedFirst) {
+        uint8_t forged[48];
+        memcpy(forged, reply, sizeof(forged));
+        forged[31] ^= 0xFF;
+        putTimestamp(forged + 40, received + 3600000000ULL);
+        sendto(fd, forged, sizeof(forged), 0, (struct sockaddr*)&from, fromLength);
+      }
+
+      if (processingUs) delayMicroseconds(processingUs);
+      putTimestamp(reply + 40, now());
+      sendto(fd, reply, sizeof(reply), 0, (struct sockaddr*)&from, fromLength);
+    }
+  }
+};
+
+void setUp() {}
+void tearDown() {}
+
+// Drive the client like the network task until a sync result appears
+static bool runUntilSync(SntpClient& sntp, WallClock::Sync& sync, unsigned long limitMs) {
+  SleepManager sleeper;
+  sleeper.begin(false);
+  unsigned long start = millis();
+  while (millis() - start < limitMs) {
+    sntp.poll();
+    if (sntp.takeSync(sync)) return true;
+    sleeper.sleep(min(sntp.msUntilPoll(), 50UL), -1, false, sntp.socketFd());
+  }
+  return false;
+}
+
+void test_ntp_timestamp_conversion() {
+  // 2024-01-01 00:00:00.5 UTC
+  ASSERT_EQUAL_U64(1704067200500000ULL,
+                   SntpClient::ntpToEpochUs(1704067200UL + NTP_TO_UNIX, 0x80000000UL));
+  // Era 1 (after 2036-02-07) wraps the 32-bit seconds
+  ASSERT_EQUAL_U64(2085978496000000ULL + 4000000ULL,
+                   SntpClient::ntpToEpochUs(4, 0));
+}
+
+void test_sync_against_local_server() {
+  FakeTimeServer server;
+  server.processingUs = 5000;    // Must not count as network delay
+  server.sendForgedFirst = true;
+  uint16_t port = server.start();
+
+  SntpClient sntp;
+  sntp.setServer("127.0.0.1", port);
+  WallClock::Sync sync;
+  TEST_ASSERT_TRUE(runUntilSync(sntp, sync, 2000));
+  TEST_ASSERT_EQUAL_UINT32(1, sntp.roundsCompleted());
+  TEST_ASSERT_GREATER_OR_EQUAL(4, server.requests.load());
+  TEST_ASSERT_GREATER_OR_EQUAL(4, (int)sntp.repliesRejected());
+  TEST_ASSERT_LESS_THAN(3, sync.rttMs);
+
+  WallClock wall;
+  wall.apply(sync);
+  int64_t error = (int64_t)(wall.now() - (SERVER_EPOCH_BASE_US + micros()) / 1000);
+  printf("sync: rtt %u ms, error %lld ms\n", (unsigned)sync.rttMs, (long long)error);
+  TEST_ASSERT_TRUE(error >= -2 && error <= 2);
+
+  // The next round waits for the interval
+  TEST_ASSERT_GREATER_THAN(50000, sntp.msUntilPoll());
+}
+
+void test_silent_server_retries() {
+  FakeTimeServer server;
+  server.silent = true;
+  uint16_t port = server.start();
+
+  SntpClient sntp;
+  sntp.setServer("127.0.0.1", port);
+  sntp.setReplyTimeout(30);
+  WallClock::Sync sync;
+  TEST_ASSERT_FALSE(runUntilSync(sntp, sync, 400));
+  TEST_ASSERT_EQUAL_INT(4, server.requests.load());
+  TEST_ASSERT_EQUAL_UINT32(0, sntp.roundsCompleted());
+  TEST_ASSERT_GREATER_THAN(5000, sntp.msUntilPoll());
+  TEST_ASSERT_EQUAL_INT(-1, sntp.socketFd());
+}
+
+void test_wall_clock_tracks_and_corrects() {
+  VirtualClock clock(5000);
+  WallClock wall;
+  wall.setClock(&clock);
+
+  TEST_ASSERT_FALSE(wall.synced());
+  ASSERT_EQUAL_U64(0, wall.now());
+  TEST_ASSERT_EQUAL_UINT32(Clock::NO_DEADLINE, wall.msUntil(1));
+
+  wall.apply({ 5000, 1700000000000ULL, 4 });
+  clock.advance(250);
+  ASSERT_EQUAL_U64(1700000000250ULL, wall.now());
+  TEST_ASSERT_EQUAL_UINT32(750, wall.msUntil(1700000001000ULL));
+  TEST_ASSERT_EQUAL_UINT32(0, wall.msUntil(1700000000000ULL));
+
+  // Local oscillator ran 3 ms slow over 60 s
+  clock.advance(60000);
+  wall.apply({ (uint32_t)clock.millis(), 1700000060253ULL, 2 });
+  TEST_ASSERT_EQUAL_INT32(3, wall.lastCorrectionMs());
+  TEST_ASSERT_EQUAL_UINT16(2, wall.lastRttMs());
+  ASSERT_EQUAL_U64(1700000060253ULL, wall.now());
+}
+
+void test_find_at_in_payloads() {
+  uint64_t at = 0;
+  MessageView head, tail;
+
+  TEST_ASSERT_TRUE(CommandScheduler::findAt(MessageView("ON:at=1700000000123"), at, head, tail));
+  ASSERT_EQUAL_U64(1700000000123ULL, at);
+  TEST_ASSERT_TRUE(head.equals("ON"));
+  TEST_ASSERT_TRUE(tail.isEmpty());
+
+  TEST_ASSERT_TRUE(CommandScheduler::findAt(MessageView("50:at=42:transition_ms=500"), at, head, tail));
+  ASSERT_EQUAL_U64(42, at);
+  TEST_ASSERT_TRUE(head.equals("50"));
+  TEST_ASSERT_TRUE(tail.equals(":transition_ms=500"));
+
+  TEST_ASSERT_TRUE(CommandScheduler::findAt(MessageView("at=7"), at, head, tail));
+  TEST_ASSERT_TRUE(head.isEmpty() && tail.isEmpty());
+
+  MessageView json("{\"state\":\"ON\",\"at\":1700000000999,\"brightness\":80}");
+  TEST_ASSERT_TRUE(CommandScheduler::findAt(json, at, head, tail));
+  ASSERT_EQUAL_U64(1700000000999ULL, at);
+  TEST_ASSERT_EQUAL(json.length(), head.length());
+
+  TEST_ASSERT_FALSE(CommandScheduler::findAt(MessageView("255,0,0"), at, head, tail));
+  TEST_ASSERT_FALSE(CommandScheduler::findAt(MessageView("ON:at=soon"), at, head, tail));
+  TEST_ASSERT_FALSE(CommandScheduler::findAt(MessageView("{\"at\":-5}"), at, head, tail));
+  TEST_ASSERT_FALSE(CommandScheduler::findAt(MessageView("{\"at\":1.5}"), at, head, tail));
+  TEST_ASSERT_FALSE(CommandScheduler::findAt(MessageView("{\"brightness\":80}"), at, head, tail));
+}
+
+void test_scheduler_orders_and_measures_skew() {
+  CommandScheduler scheduler;
+  CommandScheduler::Command cmd;
+
+  TEST_ASSERT_TRUE(scheduler.schedule(1, 3000, MessageView("c")));
+  TEST_ASSERT_TRUE(scheduler.schedule(2, 1000, MessageView("a")));
+  TEST_ASSERT_TRUE(scheduler.schedule(3, 3000, MessageView("d")));      // Tie: after "c"
+  TEST_ASSERT_TRUE(scheduler.schedule(4, 2000, MessageView("5"), MessageView(":x")));
+
+  uint64_t due = 0;
+  TEST_ASSERT_TRUE(scheduler.nextDue(due));
+  ASSERT_EQUAL_U64(1000, due);
+  TEST_ASSERT_FALSE(scheduler.popDue(999, cmd));
+
+  TEST_ASSERT_TRUE(scheduler.popDue(1001, cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("a"));
+  TEST_ASSERT_FALSE(scheduler.popDue(1001, cmd));
+
+  TEST_ASSERT_TRUE(scheduler.popDue(3000, cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("5:x"));
+  TEST_ASSERT_EQUAL_UINT8(4, cmd.route);
+  TEST_ASSERT_TRUE(scheduler.popDue(3000, cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("c"));
+  TEST_ASSERT_TRUE(scheduler.popDue(3000, cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("d"));
+  TEST_ASSERT_TRUE(scheduler.isEmpty());
+
+  TEST_ASSERT_EQUAL_UINT32(4, scheduler.executedCount());
+  TEST_ASSERT_EQUAL_UINT32(1000, scheduler.maxSkewMs());   // "5:x" ran 1 s late
+  scheduler.resetStats();
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.maxSkewMs());
+
+  // "As soon as possible" entries run at any time and are not measured
+  TEST_ASSERT_TRUE(scheduler.schedule(5, 0, MessageView("now")));
+  TEST_ASSERT_TRUE(scheduler.popDue(0, cmd));
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.executedCount());
+
+  // Full queue rejects, slots are reused after popping
+  for (uint8_t i = 0; i < CommandScheduler::CAPACITY; i++) {
+    TEST_ASSERT_TRUE(scheduler.schedule(i, 100 + i, MessageView("x")));
+  }
+  TEST_ASSERT_FALSE(scheduler.schedule(9, 50, MessageView("y")));
+  TEST_ASSERT_EQUAL_UINT32(1, scheduler.droppedCount());
+  TEST_ASSERT_TRUE(scheduler.popDue(100, cmd));
+  TEST_ASSERT_TRUE(scheduler.schedule(9, 50, MessageView("y")));
+  TEST_ASSERT_TRUE(scheduler.popDue(100, cmd));
+  TEST_ASSERT_TRUE(cmd.payload.equals("y"));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ntp_timestamp_conversion);
+  RUN_TEST(test_sync_against_local_server);
+  RUN_TEST(test_silent_server_retries);
+  RUN_TEST(test_wall_clock_tracks_and_corrects);
+  RUN_TEST(test_find_at_in_payloads);
+  RUN_TEST(test_scheduler_orders_and_measures_skew);
+  return UNITY_END();
+}
@@ -0,0 +1,94 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <unity.h>
+
+#include "net/LinkCache.h"
+
+// Cached WiFi link: record checks and when NVS gets written.
+
+static LinkCache::Link sampleLink() {
+  LinkCache::Link link = {
+    { 0x24, 0x0A, 0xC4, 0x12, 0x34, 0x56 }, 6
+  };
+  return link;
+}
+
+void setUp() {
+  Preferences::resetAll();
+}
+
+void tearDown() {}
+
+void test_link_survives_a_restart() {
+  LinkCache before;
+  before.setNetwork("home");
+  TEST_ASSERT_TRUE(before.store(sampleLink()));
+  uint8_t rtc[LinkCache::RECORD_SIZE];
+  before.encode(rtc);
+
+  LinkCache after;
+  after.setNetwork("home");
+  TEST_ASSERT_TRUE(after.restore(rtc, sizeof(rtc)));
+  TEST_ASSERT_EQUAL_UINT8(6, after.link().channel);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(sampleLink().bssid, after.link().bssid, 6);
+
+  // And a power cut, through NVS
+  LinkCache cold;
+  cold.setNetwork("home");
+  TEST_ASSERT_TRUE(cold.load());
+  TEST_ASSERT_EQUAL_UINT8(6, cold.link().channel);
+}
+
+void test_bad_records_are_ignored() {
+  LinkCache cache;
+  cache.setNetwork("home");
+  cache.store(sampleLink());
+  uint8_t record[LinkCache::RECORD_SIZE];
+  cache.encode(record);
+
+  LinkCache other;
+  other.setNetwork("office");   // SSID changed since
+  TEST_ASSERT_FALSE(other.restore(record, sizeof(record)));
+  TEST_ASSERT_FALSE(other.valid());
+
+  LinkCache fresh;
+  fresh.setNetwork("home");
+  TEST_ASSERT_FALSE(fresh.restore(record, sizeof(record) - 1));
+  record[7] ^= 0x01;             // Torn or power-on garbage
+  TEST_ASSERT_FALSE(fresh.restore(record, sizeof(record)));
+  record[7] ^= 0x01;
+  TEST_ASSERT_TRUE(fresh.restore(record, sizeof(record)));
+
+  // Stored in every record: a different hash would orphan them all
+  TEST_ASSERT_EQUAL_UINT32(0xD2C8C28EUL, LinkCache::hashSsid("home"));
+
+  uint8_t zeros[LinkCache::RECORD_SIZE] = {0};
+  LinkCache empty;
+  empty.setNetwork("home");
+  TEST_ASSERT_FALSE(empty.restore(zeros, sizeof(zeros)));
+}
+
+void test_nvs_written_only_on_change() {
+  LinkCache cache;
+  cache.setNetwork("home");
+  TEST_ASSERT_TRUE(cache.store(sampleLink()));
+  TEST_ASSERT_FALSE(cache.store(sampleLink()));   // Same access point
+
+  LinkCache::Link roamed = sampleLink();
+  roamed.channel = 11;
+  TEST_ASSERT_TRUE(cache.store(roamed));
+
+  LinkCache reloaded;
+  reloaded.setNetwork("home");
+  TEST_ASSERT_TRUE(reloaded.load());
+  TEST_ASSERT_EQUAL_UINT8(11, reloaded.link().channel);
+  TEST_ASSERT_FALSE(reloaded.store(roamed));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_link_survives_a_restart);
+  RUN_TEST(test_bad_records_are_ignored);
+  RUN_TEST(test_nvs_written_only_on_change);
+  return UNITY_END();
+}